@@ -0,0 +1,317 @@
+//
+//  frozen_packed_graph.hpp
+//
+//  Contains a static implementation of a sequence graph with paths, based on
+//  succinct arrays.
+//
+
+#ifndef BDSG_FROZEN_PACKED_GRAPH_HPP_INCLUDED
+#define BDSG_FROZEN_PACKED_GRAPH_HPP_INCLUDED
+
+#include <handlegraph/path_handle_graph.hpp>
+#include <handlegraph/serializable_handle_graph.hpp>
+
+#include "bdsg/internal/packed_structs.hpp"
+
+namespace bdsg {
+
+using namespace std;
+using namespace handlegraph;
+
+/**
+ * FrozenPackedGraph is an immutable PathHandleGraph, made by freezing a copy
+ * of another graph, often a PackedGraph that will not be edited any more.
+ *
+ * Instead of the linked records that let PackedGraph be edited, each kind of
+ * record is stored contiguously in bit-packed arrays: the edges leaving each
+ * oriented node, the steps of each path, and the visits of paths to each
+ * node. The boundaries between the groups of records are stored in
+ * Elias-Fano encoding, and the edges and steps are page-compressed with page
+ * widths chosen to fit the graph. As a result, FrozenPackedGraph uses much
+ * less memory than PackedGraph, and traversing a path or a node's edges reads
+ * adjacent memory.
+ *
+ * As in PackedGraph, sequences are upper-cased and anything other than A, C,
+ * G, or T becomes N. Paths are ordered by name.
+ */
+class FrozenPackedGraph : public PathHandleGraph, public SerializableHandleGraph {
+
+public:
+
+    /// Make an empty graph
+    FrozenPackedGraph() = default;
+
+    /// Make a frozen copy of the given graph, including its paths
+    FrozenPackedGraph(const PathHandleGraph* graph);
+
+    ~FrozenPackedGraph() = default;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // I/O methods
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// Deserialize from a stream of data
+    FrozenPackedGraph(istream& in);
+
+    /// Returns a number that is specific to the serialized implementation for type
+    /// checking. Does not depend on the contents of any particular instantiation
+    /// (i.e. behaves as if static, but cannot be static and virtual).
+    uint32_t get_magic_number() const;
+
+private:
+
+    /// Write the graph to an out stream (called from the inherited 'serialize'  method)
+    void serialize_members(ostream& out) const;
+
+    /// Read the graph from an in stream (called from the inherited 'deserialize'  method)
+    void deserialize_members(istream& in);
+
+public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Handle methods
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// Method to check if a node exists by ID
+    bool has_node(nid_t node_id) const;
+
+    /// Look up the handle for the node with the given ID in the given orientation
+    handle_t get_handle(const nid_t& node_id, bool is_reverse = false) const;
+
+    /// Get the ID from a handle
+    nid_t get_id(const handle_t& handle) const;
+
+    /// Get the orientation of a handle
+    bool get_is_reverse(const handle_t& handle) const;
+
+    /// Invert the orientation of a handle (potentially without getting its ID)
+    handle_t flip(const handle_t& handle) const;
+
+    /// Get the length of a node
+    size_t get_length(const handle_t& handle) const;
+
+    /// Get the sequence of a node, presented in the handle's local forward orientation.
+    string get_sequence(const handle_t& handle) const;
+
+    /// Returns one base of a handle's sequence, in the orientation of the
+    /// handle.
+    char get_base(const handle_t& handle, size_t index) const;
+
+    /// Returns a substring of a handle's sequence, in the orientation of the
+    /// handle. If the indicated substring would extend beyond the end of the
+    /// handle's sequence, the return value is truncated to the sequence's end.
+    string get_subsequence(const handle_t& handle, size_t index, size_t size) const;
+
+    /// Loop over all the handles to next/previous (right/left) nodes. Passes
+    /// them to a callback which returns false to stop iterating and true to
+    /// continue. Returns true if we finished and false if we stopped early.
+    bool follow_edges_impl(const handle_t& handle, bool go_left, const std::function<bool(const handle_t&)>& iteratee) const;
+
+    /// Loop over all the nodes in the graph in their local forward
+    /// orientations, in the order of the graph they were frozen from. Stop if
+    /// the iteratee returns false. Can be told to run in parallel, in which
+    /// case stopping after a false return value is on a best-effort basis and
+    /// iteration order is not defined.
+    bool for_each_handle_impl(const std::function<bool(const handle_t&)>& iteratee, bool parallel = false) const;
+
+    /// Get the number of edges on the right (go_left = false) or left (go_left
+    /// = true) side of the given handle.
+    size_t get_degree(const handle_t& handle, bool go_left) const;
+
+    /// Return the number of edges in the graph
+    size_t get_edge_count() const;
+
+    /// Return the number of nodes in the graph
+    size_t get_node_count(void) const;
+
+    /// Return the smallest ID in the graph, or some smaller number if the
+    /// smallest ID is unavailable. Return value is unspecified if the graph is empty.
+    nid_t min_node_id(void) const;
+
+    /// Return the largest ID in the graph, or some larger number if the
+    /// largest ID is unavailable. Return value is unspecified if the graph is empty.
+    nid_t max_node_id(void) const;
+
+    /// Return the total length of all nodes' sequences
+    size_t get_total_length() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Path handle interface
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// Returns the number of paths stored in the graph
+    size_t get_path_count() const;
+
+    /// Determine if a path name exists and is legal to get a path handle for.
+    bool has_path(const std::string& path_name) const;
+
+    /// Look up the path handle for the given path name.
+    /// The path with that name must exist.
+    path_handle_t get_path_handle(const std::string& path_name) const;
+
+    /// Look up the name of a path from a handle to it
+    std::string get_path_name(const path_handle_t& path_handle) const;
+
+    /// Look up whether a path is circular
+    bool get_is_circular(const path_handle_t& path_handle) const;
+
+    /// Returns the number of node steps in the path
+    size_t get_step_count(const path_handle_t& path_handle) const;
+
+    /// Returns the number of node steps on a handle
+    size_t get_step_count(const handle_t& handle) const;
+
+    /// Get a node handle (node ID and orientation) from a handle to a step on a path
+    handle_t get_handle_of_step(const step_handle_t& step_handle) const;
+
+    /// Returns a handle to the path that an step is on
+    path_handle_t get_path_handle_of_step(const step_handle_t& step_handle) const;
+
+    /// Get a handle to the first step, which will be an arbitrary step in a circular path that
+    /// we consider "first" based on our construction of the path. If the path is empty, then
+    /// the implementation must return the same value as path_end().
+    step_handle_t path_begin(const path_handle_t& path_handle) const;
+
+    /// Get a handle to a fictitious position past the end of a path. This position is
+    /// returned by get_next_step for the final step in a path in a non-circular path.
+    /// Note: get_next_step will *NEVER* return this value for a circular path.
+    step_handle_t path_end(const path_handle_t& path_handle) const;
+
+    /// Get a handle to the last step, which will be an arbitrary step in a circular path that
+    /// we consider "last" based on our construction of the path. If the path is empty
+    /// then the implementation must return the same value as path_front_end().
+    step_handle_t path_back(const path_handle_t& path_handle) const;
+
+    /// Get a handle to a fictitious position before the beginning of a path. This position is
+    /// return by get_previous_step for the first step in a path in a non-circular path.
+    /// Note: get_previous_step will *NEVER* return this value for a circular path.
+    step_handle_t path_front_end(const path_handle_t& path_handle) const;
+
+    /// Returns true if the step is not the last step in a non-circular path.
+    bool has_next_step(const step_handle_t& step_handle) const;
+
+    /// Returns true if the step is not the first step in a non-circular path.
+    bool has_previous_step(const step_handle_t& step_handle) const;
+
+    /// Returns a handle to the next step on the path. If the given step is the final step
+    /// of a non-circular path, returns the past-the-last step that is also returned by
+    /// path_end. In a circular path, the "last" step will loop around to the "first" (i.e.
+    /// the one returned by path_begin).
+    /// Note: to iterate over each step one time, even in a circular path, consider
+    /// for_each_step_in_path.
+    step_handle_t get_next_step(const step_handle_t& step_handle) const;
+
+    /// Returns a handle to the previous step on the path. If the given step is the first
+    /// step of a non-circular path, this method has undefined behavior. In a circular path,
+    /// it will loop around from the "first" step (i.e. the one returned by path_begin) to
+    /// the "last" step.
+    /// Note: to iterate over each step one time, even in a circular path, consider
+    /// for_each_step_in_path.
+    step_handle_t get_previous_step(const step_handle_t& step_handle) const;
+
+protected:
+
+    /// Execute a function on each path in the graph, in order of their names
+    bool for_each_path_handle_impl(const std::function<bool(const path_handle_t&)>& iteratee) const;
+
+    /// Calls the given function for each step of the given handle on a path.
+    bool for_each_step_on_handle_impl(const handle_t& handle,
+                                      const std::function<bool(const step_handle_t&)>& iteratee) const;
+
+public:
+
+    /// Reports the amount of memory consumed by this object in bytes.
+    size_t memory_usage() const;
+
+    /// Reports the memory consumed by each of the graph's members, as a tree.
+    MemoryReport memory_report() const;
+
+private:
+
+    /// Map a base to its 3-bit encoding
+    static uint64_t encode_base(char base);
+
+    /// Map a 3-bit encoding back to its base
+    static char decode_base(uint64_t encoded);
+
+    /// Get the rank of the node a handle is on, in the order of the nodes
+    inline size_t get_rank(const handle_t& handle) const;
+
+    /// Get the rank of the path with the given name, or the number of paths if
+    /// there is no such path
+    size_t find_path(const std::string& path_name) const;
+
+    /// Get the path that a step, given as an index into step_handles, is on
+    size_t get_path_of_step_index(size_t step_index) const;
+
+    /// Get the start and past-the-end indexes of a path in step_handles
+    inline void get_path_bounds(const path_handle_t& path_handle, uint64_t* bounds) const;
+
+    /// The smallest node ID
+    nid_t min_id = numeric_limits<nid_t>::max();
+
+    /// The largest node ID
+    nid_t max_id = 0;
+
+    /// The node ID minus min_id for each node, by rank, unless the IDs are
+    /// min_id, min_id + 1, ... in rank order, in which case this is empty
+    PackedVector<> node_ids;
+
+    /// The rank plus 1 for each node ID minus min_id, or 0 if there is no
+    /// node with that ID, unless node_ids is empty
+    PackedVector<> id_to_rank;
+
+    /// The number of nodes
+    size_t node_count = 0;
+
+    /// The encoded bases of all nodes' sequences, by rank
+    PackedVector<> bases;
+
+    /// The start of each node's sequence in bases, by rank, followed by the
+    /// total length
+    EliasFanoVector<> sequence_starts;
+
+    /// The handles reached by going right from each handle, grouped by the
+    /// integer value of the handle they leave from. Every edge is recorded
+    /// from both ends, except for an edge that reverses on a single side of a
+    /// node, which is its own reverse.
+    TunablePagedVector<> edge_targets;
+
+    /// The number of edges that reverse on a single side of a node, which
+    /// are recorded once in edge_targets instead of twice
+    size_t reversing_self_edges = 0;
+
+    /// The start of each handle's group in edge_targets, followed by the
+    /// total size
+    EliasFanoVector<> edge_starts;
+
+    /// The characters of the paths' names, by path rank
+    PackedVector<> path_names;
+
+    /// The start of each path's name in path_names, followed by the total
+    /// length
+    EliasFanoVector<> path_name_starts;
+
+    /// Whether each path is circular
+    PackedVector<> path_is_circular;
+
+    /// The handle visited by each step, grouped by path. Step handles hold the
+    /// path and an index in here.
+    TunablePagedVector<> step_handles;
+
+    /// The start of each path's steps in step_handles, followed by the total
+    /// number of steps
+    EliasFanoVector<> path_step_starts;
+
+    /// The index in step_handles of each step, grouped by the rank of the
+    /// node it visits
+    PackedVector<> node_visits;
+
+    /// The start of each node's group in node_visits, followed by the total
+    /// number of steps
+    EliasFanoVector<> node_visit_starts;
+};
+
+}
+
+#endif
@@ -11,7 +11,11 @@
 #include <handlegraph/mutable_path_deletable_handle_graph.hpp>
 #include <handlegraph/serializable_handle_graph.hpp>
 
+#include <memory>
+#include <type_traits>
+
 #include "bdsg/internal/hash_map.hpp"
+#include "bdsg/internal/packed_structs.hpp"
 #include "bdsg/internal/utility.hpp"
 #include "bdsg/internal/endianness.hpp"
 
@@ -28,14 +32,33 @@ using namespace handlegraph;
  *
  * HashGraph is a good choice when fast access to or modification of a graph is
  * required, but can use more memory than other graph implementations.
+ *
+ * To keep node records small, short adjacency lists are stored inside the
+ * records themselves, and node sequences are kept together in one arena. The
+ * arena can store a byte per base, or it can pack the bases into a few bits
+ * each when the graph is constructed with PACKED_SEQUENCES.
  */
 class HashGraph : public MutablePathDeletableHandleGraph, public SerializableHandleGraph {
         
 public:
     
+    /// Ways that a HashGraph can store node sequences
+    enum sequence_storage_t {
+        /// Store each base as a byte, exactly as it was given
+        BYTE_SEQUENCES,
+        /// Pack each base into a few bits. As in PackedGraph, bases are
+        /// upper-cased and anything other than A, C, G, or T becomes N.
+        PACKED_SEQUENCES
+    };
+    
     HashGraph();
+    /// Make an empty graph that stores its node sequences in the given way
+    HashGraph(sequence_storage_t sequence_storage);
     ~HashGraph();
     
+    /// Get the way that this graph stores its node sequences
+    sequence_storage_t get_sequence_storage() const;
+    
     ////////////////////////////////////////////////////////////////////////////
     // I/O methods
     ////////////////////////////////////////////////////////////////////////////
@@ -51,6 +74,25 @@ private:
     /// Read the graph from an in stream (called from the inherited 'deserialize'  method)
     void deserialize_members(istream& in);
     
+    /// Read the graph in the original, unsectioned layout, after the max ID has
+    /// already been read
+    void deserialize_unsectioned_members(istream& in);
+    
+    /// Read the node and path blocks of the sectioned layout from the body
+    /// that starts at the stream's position, given the offsets of the block
+    /// boundaries relative to the start of the body
+    void deserialize_blocks(istream& in, const vector<uint64_t>& offsets,
+                            size_t node_block_count, size_t node_count);
+    
+    /// The serialized layout starts with this in place of the max ID if it is
+    /// sectioned. The original layout has no version, and it is assumed that
+    /// no graph will contain this ID.
+    constexpr static int64_t SECTIONED_FORMAT_MARKER = numeric_limits<int64_t>::min();
+    /// The version of the sectioned layout that we write
+    constexpr static uint64_t SECTIONED_FORMAT_VERSION = 2;
+    /// Aim for this many nodes in each node block of the sectioned layout
+    constexpr static size_t NODES_PER_BLOCK = 1 << 16;
+    
 public:
     
     ////////////////////////////////////////////////////////////////////////////
@@ -349,6 +391,9 @@ public:
     
 private:
     
+    /// The number of hash table buckets each thread claims at a time in a
+    /// parallel for_each_handle
+    constexpr static size_t PARALLEL_BUCKET_BLOCK_SIZE = 1024;
     
     /*
      * A linked list record representing a single node in an embedded path
@@ -364,28 +409,303 @@ private:
     };
     
     /*
-     * A node object with the sequence and its edge lists
+     * A slab allocator for path_mapping_t records. Records are carved out of
+     * large blocks that are never moved or freed individually, so pointers to
+     * them stay valid for as long as the pool holds them. Freed records are
+     * kept on a free list for reuse, and all of the memory is released at once
+     * when the pool is cleared or destroyed.
+     */
+    class path_mapping_pool_t {
+    public:
+        
+        path_mapping_pool_t() = default;
+        
+        /// Move constructor, which keeps all records at the same addresses
+        path_mapping_pool_t(path_mapping_pool_t&& other);
+        
+        /// Move assignment, which keeps all records at the same addresses
+        path_mapping_pool_t& operator=(path_mapping_pool_t&& other);
+        
+        /// A record can only belong to one pool
+        path_mapping_pool_t(const path_mapping_pool_t& other) = delete;
+        path_mapping_pool_t& operator=(const path_mapping_pool_t& other) = delete;
+        
+        /// Get a new unlinked record
+        path_mapping_t* allocate(const handle_t& handle, const int64_t& path_id);
+        
+        /// Return a record to the pool for reuse
+        void deallocate(path_mapping_t* mapping);
+        
+        /// Release the memory of all records
+        void clear();
+        
+        /// Take ownership of all of the records in another pool, leaving them at
+        /// the same addresses. The other pool is left empty.
+        void absorb(path_mapping_pool_t& other);
+        
+    private:
+        
+        /// Uninitialized memory for one record
+        using slot_t = aligned_storage<sizeof(path_mapping_t), alignof(path_mapping_t)>::type;
+        
+        /// The number of records in the first slab
+        constexpr static size_t MIN_SLAB_SIZE = 256;
+        /// Slabs double in size up to this many records
+        constexpr static size_t MAX_SLAB_SIZE = 65536;
+        
+        /// The blocks that records are allocated from
+        vector<unique_ptr<slot_t[]>> slabs;
+        /// The size of the last slab
+        size_t last_slab_size = 0;
+        /// The number of records that have been handed out from the last slab
+        size_t last_slab_used = 0;
+        /// Freed records, linked through their next pointers
+        path_mapping_t* free_list = nullptr;
+    };
+    
+    /*
+     * A vector of trivially copyable items that keeps up to N of them inside
+     * the object itself, and only moves them to the heap once it grows past
+     * that. It holds no pointers into itself, so it can be relocated freely.
+     */
+    template<typename T, size_t N>
+    class inline_vector_t {
+    public:
+        
+        static_assert(is_trivially_copyable<T>::value, "inline_vector_t items must be trivially copyable");
+        
+        inline_vector_t() {}
+        inline_vector_t(const inline_vector_t& other) {
+            *this = other;
+        }
+        inline_vector_t(inline_vector_t&& other) {
+            *this = move(other);
+        }
+        ~inline_vector_t() {
+            if (on_heap()) {
+                delete[] heap_items;
+            }
+        }
+        
+        inline_vector_t& operator=(const inline_vector_t& other) {
+            if (this != &other) {
+                count = 0;
+                reserve(other.count);
+                std::copy(other.begin(), other.end(), begin());
+                count = other.count;
+            }
+            return *this;
+        }
+        inline_vector_t& operator=(inline_vector_t&& other) {
+            if (this != &other) {
+                if (other.on_heap()) {
+                    // take over the other heap buffer
+                    if (on_heap()) {
+                        delete[] heap_items;
+                    }
+                    heap_items = other.heap_items;
+                    capacity = other.capacity;
+                    count = other.count;
+                    other.capacity = N;
+                }
+                else {
+                    *this = other;
+                }
+                other.count = 0;
+            }
+            return *this;
+        }
+        
+        size_t size() const {
+            return count;
+        }
+        bool empty() const {
+            return count == 0;
+        }
+        
+        T* begin() {
+            return on_heap() ? heap_items : inline_items;
+        }
+        T* end() {
+            return begin() + count;
+        }
+        const T* begin() const {
+            return on_heap() ? heap_items : inline_items;
+        }
+        const T* end() const {
+            return begin() + count;
+        }
+        
+        T& operator[](size_t i) {
+            return begin()[i];
+        }
+        const T& operator[](size_t i) const {
+            return begin()[i];
+        }
+        T& back() {
+            return begin()[count - 1];
+        }
+        
+        void push_back(const T& item) {
+            if (count == capacity) {
+                reallocate(2 * capacity);
+            }
+            begin()[count++] = item;
+        }
+        void pop_back() {
+            --count;
+        }
+        void clear() {
+            count = 0;
+        }
+        void reserve(size_t future_size) {
+            if (future_size > capacity) {
+                reallocate(future_size);
+            }
+        }
+        void resize(size_t new_size) {
+            reserve(new_size);
+            if (new_size > count) {
+                std::fill(begin() + count, begin() + new_size, T());
+            }
+            count = new_size;
+        }
+        void shrink_to_fit() {
+            if (on_heap() && count < capacity) {
+                reallocate(count);
+            }
+        }
+        
+    private:
+        
+        bool on_heap() const {
+            return capacity > N;
+        }
+        
+        /// Move the items into storage with room for the given number of them,
+        /// which must be at least as many as there are items
+        void reallocate(size_t new_capacity) {
+            T* old_heap_items = on_heap() ? heap_items : nullptr;
+            if (new_capacity <= N) {
+                if (old_heap_items) {
+                    std::copy(old_heap_items, old_heap_items + count, inline_items);
+                }
+                capacity = N;
+            }
+            else {
+                T* new_items = new T[new_capacity];
+                std::copy(begin(), end(), new_items);
+                heap_items = new_items;
+                capacity = new_capacity;
+            }
+            delete[] old_heap_items;
+        }
+        
+        uint32_t count = 0;
+        uint32_t capacity = N;
+        union {
+            T inline_items[N];
+            T* heap_items;
+        };
+    };
+    
+    /// Adjacency lists, which usually only hold a couple of edges
+    using edge_list_t = inline_vector_t<handle_t, 2>;
+    /// The occurrences of a node on paths
+    using occurrence_list_t = inline_vector_t<path_mapping_t*, 1>;
+    
+    /*
+     * Holds the sequences of all of the nodes back to back, either as bytes
+     * or packed into a few bits per base. Space is handed out from the end,
+     * and space that is released is only reclaimed by compacting into a new
+     * arena.
+     */
+    class sequence_arena_t {
+    public:
+        
+        sequence_arena_t(bool packed = false);
+        
+        /// Does this arena pack its bases?
+        bool is_packed() const;
+        
+        /// Add a sequence to the end of the arena and return where it starts
+        size_t append(const string& sequence);
+        
+        /// Add all of another arena, which must use the same encoding, to the
+        /// end of this one and return where it starts
+        size_t append(const sequence_arena_t& other);
+        
+        /// Get the sequence of the given length that starts at the given position
+        string extract(size_t start, size_t length) const;
+        
+        /// Get the base at the given position
+        char get_base(size_t i) const;
+        
+        /// Overwrite a stretch of the arena with a sequence
+        void set(size_t start, const string& sequence);
+        
+        /// Record that a stretch of the given length is no longer used
+        void release(size_t length);
+        
+        /// Returns true if so much of the arena is unused that it should be compacted
+        bool is_fragmented() const;
+        
+        /// The total length of the arena, including unused space
+        size_t size() const;
+        
+        /// Free any capacity beyond the current size
+        void shrink_to_fit();
+        
+        /// Remove all sequences
+        void clear();
+        
+    private:
+        
+        /// Don't bother compacting until at least this many bases are unused
+        constexpr static size_t MIN_FRAGMENTED_SIZE = 1 << 16;
+        
+        /// Map a base to [0, 4]
+        static uint64_t encode_base(char base);
+        
+        bool packed;
+        /// The sequences, if they aren't packed
+        string bytes;
+        /// The sequences, if they are packed
+        PackedVector<> bases;
+        /// The number of bases that have been released
+        size_t unused = 0;
+    };
+    
+    /*
+     * A node object with the location of its sequence and its edge lists
      */
     struct node_t {
         node_t() {}
-        node_t(const string& sequence) : sequence(sequence) {}
-        string sequence;
+        node_t(size_t sequence_start, size_t sequence_length) : sequence_start(sequence_start), sequence_length(sequence_length) {}
+        /// Where the node's sequence starts in the sequence arena
+        size_t sequence_start = 0;
+        /// The length of the node's sequence
+        size_t sequence_length = 0;
         /// Adjacency list from the left side of the node
-        vector<handle_t> left_edges;
+        edge_list_t left_edges;
         /// Adjacency list from the right side of the node
-        vector<handle_t> right_edges;
+        edge_list_t right_edges;
         /// The occurrences of this node on paths;
-        vector<path_mapping_t*> occurrences;
+        occurrence_list_t occurrences;
         
-        /// Write the node to an out stream, applying the given ID offset to
-        /// nodes referenced by edges.
-        void serialize(ostream& out) const;
-        /// Read the node (in the format written by serialize()) from an in stream.
-        void deserialize(istream& in);
+        /// Write the node to an out stream, looking up its sequence in the arena.
+        void serialize(const sequence_arena_t& sequences, ostream& out) const;
+        /// Get the number of bytes that serialize() will write
+        size_t serialized_size() const;
+        /// Read the node (in the format written by serialize()) from an in
+        /// stream, adding its sequence to the arena.
+        void deserialize(sequence_arena_t& sequences, istream& in);
     };
     
     /*
-     * A simple linked list implementation of an embedded path
+     * A simple linked list implementation of an embedded path. The steps are
+     * owned by the graph's path_mapping_pool_t, so copying a path_t only
+     * copies the record, not the steps.
      */
     class path_t {
     public:
@@ -393,39 +713,32 @@ private:
         path_t();
         path_t(const string& name, const int64_t& path_id, bool is_circular = false);
         
-        /// Move constructor
-        path_t(path_t&& other);
-        
-        /// Move assignment
-        path_t& operator=(path_t&& other);
-        
-        /// Copy constructor
-        path_t(const path_t& other);
-        
-        /// Copy assignment
-        path_t& operator=(const path_t& other);
-        
-        ~path_t();
-        
         /// Add a node to the end of the path
-        path_mapping_t* push_back(const handle_t& handle);
+        path_mapping_t* push_back(path_mapping_pool_t& pool, const handle_t& handle);
         
         /// Add a node to the front of the path
-        path_mapping_t* push_front(const handle_t& handle);
+        path_mapping_t* push_front(path_mapping_pool_t& pool, const handle_t& handle);
         
-        /// Remove the mapping from the path and free its memory
-        void remove(path_mapping_t* mapping);
+        /// Remove the mapping from the path and return it to the pool
+        void remove(path_mapping_pool_t& pool, path_mapping_t* mapping);
         
         /// Insert a new node into the middle of the path. If the the provided node
         /// is null, inserts at the end.
-        path_mapping_t* insert_before(const handle_t& handle, path_mapping_t* mapping);
+        path_mapping_t* insert_before(path_mapping_pool_t& pool, const handle_t& handle, path_mapping_t* mapping);
+        
+        /// Return all of the steps to the pool, leaving the path empty
+        void release(path_mapping_pool_t& pool);
         
         /// Write the path to an out stream, applying the given offset to all
         /// node IDs referenced by the path.
         void serialize(ostream& out) const;
         
-        /// Read the path (in the format written by serialize()) from an in stream.
-        void deserialize(istream& in);
+        /// Get the number of bytes that serialize() will write
+        size_t serialized_size() const;
+        
+        /// Read the path (in the format written by serialize()) from an in stream,
+        /// allocating its steps from the pool.
+        void deserialize(path_mapping_pool_t& pool, istream& in);
         
         path_mapping_t* head = nullptr;
         path_mapping_t* tail = nullptr;
@@ -443,18 +756,33 @@ private:
     /// Encodes the graph topology
     hash_map<nid_t, node_t> graph;
     
+    /// Holds the sequences of all of the nodes
+    sequence_arena_t sequences;
+    
     /// Maps path names to path IDs
     string_hash_map<string, int64_t> path_id;
     
     /// Maps path IDs to the actual paths
     hash_map<int64_t, path_t> paths;
     
+    /// Holds the steps of all of the paths
+    path_mapping_pool_t path_mappings;
+    
     /// The next path ID we will assign to a new path
     int64_t next_path_id = 1;
     
     /// Replace the ID in a handle with a different number
     static handle_t set_id(const handle_t& internal, nid_t new_id);
     
+    /// Move the node sequences into a new arena with no unused space
+    void compact_sequences();
+    
+    /// Compact the sequences if enough of the arena has been released
+    void compact_sequences_if_fragmented();
+    
+    /// Record the steps of all paths in the occurrence lists of their nodes
+    void index_occurrences();
+    
 public:
     /// Move/copy constructors/assignment operators
     HashGraph(const HashGraph& other);
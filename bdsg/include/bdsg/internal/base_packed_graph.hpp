@@ -20,6 +20,11 @@
 #include "bdsg/graph_proxy.hpp"
 
 #include <arpa/inet.h>
+#include <exception>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 namespace bdsg {
@@ -36,7 +41,8 @@ using namespace handlegraph;
  * Since removals of elements can cause slots in the internal vectors to become
  * unused, the graph will occasionally defragment itself after some
  * modification operations, which involves copying its internal data
- * structures.
+ * structures. Alternatively, it can defragment itself incrementally, a few
+ * records at a time.
  *
  * This implementation is a good choice when working with very large graphs,
  * where the final memory usage of the constructed graph must be minimized. It
@@ -76,6 +82,31 @@ private:
     /// Read the graph from an in stream (called from the 'deserialize'  method)
     void deserialize_members(istream& in);
     
+    /// Read the members of the graph in the original, unsectioned layout, after
+    /// the max ID has already been read
+    void deserialize_unsectioned_members(istream& in);
+    
+    /// Read the members of the graph from the body of the sectioned layout that
+    /// starts at the stream's position, given the offsets of the section
+    /// boundaries relative to the start of the body
+    void deserialize_sections(istream& in, const vector<uint64_t>& offsets);
+    
+    /// Write one independent section of the sectioned layout
+    void serialize_section(size_t section, ostream& out) const;
+    
+    /// Read one independent section of the sectioned layout
+    void deserialize_section(size_t section, istream& in);
+    
+    /// The serialized layout starts with this in place of the max ID if it is
+    /// sectioned. The original layout has no version, and it is assumed that
+    /// no graph will contain this ID.
+    constexpr static int64_t SECTIONED_FORMAT_MARKER = std::numeric_limits<int64_t>::min();
+    /// The version of the sectioned layout that we write
+    constexpr static uint64_t SECTIONED_FORMAT_VERSION = 2;
+    /// The number of sections that precede the per-path sections: one for the
+    /// scalar members and one for each vector member
+    constexpr static size_t MEMBER_SECTION_COUNT = 19;
+    
 public:
     
     ////////////////////////////////////////////////////////////////////////////
@@ -132,6 +163,14 @@ public:
     /// handle's sequence, the return value is truncated to the sequence's end.
     std::string get_subsequence(const handle_t& handle, size_t index, size_t size) const;
     
+    /// Get the sequences of many handles at once, each in the orientation of
+    /// its handle. The sequences are concatenated into the sequences buffer,
+    /// and the sequence for handles[i] runs from offsets[i] to offsets[i + 1].
+    /// Both buffers are overwritten, but they keep their capacity, so reusing
+    /// them across calls avoids allocation. Faster than get_sequence() in a
+    /// loop because it decodes whole words of packed bases at a time.
+    void get_sequences(const vector<handle_t>& handles, string& sequences, vector<size_t>& offsets) const;
+    
     /// Get the locally forward version of a handle
     // TODO: This is concrete in the HandleGraph interface, and we duplicate it
     // here because some other methods need it. 
@@ -231,6 +270,34 @@ public:
     /// few graph modifications in the future.
     void optimize(bool allow_id_reassignment = true);
     
+    /// Choose whether optimize() also picks the page width of each of the graph's
+    /// page-compressed vectors from the spread of the values it holds, so as to
+    /// use the least memory. The widths are recorded when the graph is serialized.
+    /// Off by default.
+    void set_page_width_tuning(bool tune);
+    
+    /// Returns true if optimize() will tune the page widths of the graph's
+    /// page-compressed vectors
+    bool get_page_width_tuning() const;
+    
+    /// Choose whether the graph defragments itself incrementally. Normally, once
+    /// enough records have been deleted, a modification operation copies the
+    /// affected vectors without them, which stalls on a large graph and briefly
+    /// doubles the memory of those vectors. Incrementally, each modification
+    /// operation instead moves a bounded number of records into the gaps left by
+    /// deleted ones, and compact_step() can be called to do more. Off by default.
+    void set_incremental_defragmentation(bool incremental);
+    
+    /// Returns true if the graph defragments itself incrementally
+    bool get_incremental_defragmentation() const;
+    
+    /// Fill gaps left by deleted node, edge, and path membership records with
+    /// records from the ends of their vectors, and release the ends, examining
+    /// about the given number of records. Handles and step handles stay valid.
+    /// Deleted sequence is only released by optimize(). Returns true if there
+    /// are still deleted records to remove.
+    bool compact_step(size_t budget);
+    
     /// Reorder the graph's internal structure to match that given.
     /// This sets the order that is used for iteration in functions like for_each_handle.
     /// If compact_ids is true, may (but will not necessarily) compact the id space of the graph to match the ordering, from 1->|ordering|.
@@ -536,6 +603,28 @@ private:
     /// WARNING: invalidates step_handle_t's to this path.
     void defragment_path(const int64_t& path_idx, bool force = false);
     
+    /// Move records from the end of the node records into gaps, spending at
+    /// most the given budget. Returns the unspent budget.
+    size_t compact_node_records(size_t budget);
+    
+    /// Move records from the end of the edge records into gaps, spending at
+    /// most the given budget. Returns the unspent budget.
+    size_t compact_edge_records(size_t budget);
+    
+    /// Move records from the end of the path membership records into gaps,
+    /// spending at most the given budget. Returns the unspent budget.
+    size_t compact_membership_records(size_t budget);
+    
+    /// Get the ID of the node whose record has the given 1-based index, and
+    /// store it in node_id. If that takes a scan of the ID map, spend the budget
+    /// on it, and return false if the budget runs out first. The scan then
+    /// resumes where it left off on the next call.
+    bool get_node_record_id(size_t record, nid_t& node_id, size_t& budget);
+    
+    /// Mark every deleted record so that compaction can recognize it, in case
+    /// the graph was loaded from a file that didn't mark them
+    void mark_deleted_records();
+    
     /// Convert a path name into an integer vector, assigning new chars as necessary.
     PackedVector<> encode_and_assign_path_name(const string& path_name);
     
@@ -553,13 +642,37 @@ private:
     /// Extract the internal representation of a path name, but do not decode it.
     PackedVector<> extract_encoded_path_name(const int64_t& path_idx) const;
     
+    /// Choose the page width of each page-compressed vector according to its contents
+    void tune_page_widths();
+    
     /// Defragment data structures when the orphaned records are this fraction of the whole.
     const static double defrag_factor;
     
-    /// We use standard page widths for page-compressed vectors
+    /// We use standard page widths for page-compressed vectors, unless they are tuned
     constexpr static size_t NARROW_PAGE_WIDTH = 256;
     constexpr static size_t WIDE_PAGE_WIDTH = 1024;
     
+    /// Should optimize() tune the page widths?
+    bool page_width_tuning = false;
+    
+    /// Should deleted records be cleaned up incrementally?
+    bool incremental_defragmentation = false;
+    
+    /// How many records to compact after each modification when defragmenting
+    /// incrementally
+    const static size_t incremental_defrag_budget;
+    
+    /// The number of records at the start of the node, edge, and membership
+    /// vectors that are known not to be deleted, where compaction resumes its
+    /// search for gaps
+    size_t compacted_node_records = 0;
+    size_t compacted_edge_records = 0;
+    size_t compacted_membership_records = 0;
+    
+    /// The ID where the next scan of the ID map for the ID of a node record
+    /// starts, so that a scan can be spread over several compaction steps
+    nid_t record_id_scan_next = 0;
+    
     /// The maximum ID in the graph
     nid_t max_id = 0;
     /// The minimum ID in the graph
@@ -572,13 +685,13 @@ private:
     /// Encodes the topology of the graph. Consists of fixed width records that represent
     /// offsets in edge_lists_iv.
     /// {start edge list index, end edge list index}
-    PagedVector<NARROW_PAGE_WIDTH, Backend> graph_iv;
+    TunablePagedVector<Backend> graph_iv{NARROW_PAGE_WIDTH};
     const static size_t GRAPH_RECORD_SIZE;
     const static size_t GRAPH_START_EDGES_OFFSET;
     const static size_t GRAPH_END_EDGES_OFFSET;
     
     /// Encodes the start of a node's sequence in seq_iv. Matches the order of graph_iv.
-    PagedVector<NARROW_PAGE_WIDTH, Backend> seq_start_iv;
+    TunablePagedVector<Backend> seq_start_iv{NARROW_PAGE_WIDTH};
     const static size_t SEQ_START_RECORD_SIZE;
     
     /// Encodes the length of a node's sequence in seq_iv. Matches the order of graph_iv.
@@ -589,7 +702,7 @@ private:
     
     /// Encodes a series of edges lists of nodes.
     /// {ID|orientation (bit-packed), next edge index}
-    PagedVector<WIDE_PAGE_WIDTH, Backend> edge_lists_iv;
+    TunablePagedVector<Backend> edge_lists_iv{WIDE_PAGE_WIDTH};
     const static size_t EDGE_RECORD_SIZE;
     const static size_t EDGE_TRAV_OFFSET;
     const static size_t EDGE_NEXT_OFFSET;
@@ -609,19 +722,19 @@ private:
     /// Encodes the membership of a node in all paths. In the same order as graph_iv.
     /// Consists of 1-based offset to the corresponding heads of linked lists in
     /// path_membership_value_iv, which contains the actual pointers into the paths.
-    PagedVector<NARROW_PAGE_WIDTH, Backend> path_membership_node_iv;
+    TunablePagedVector<Backend> path_membership_node_iv{NARROW_PAGE_WIDTH};
     const static size_t NODE_MEMBER_RECORD_SIZE;
     
     /// Encodes a series of linked lists of the memberships within paths. The nodes
     /// in the linked list are split over three separate vectors, with the entry at
     /// the same index in each vector corresponding to the same linked list node.
     /// Path ID (0-based index)
-    PagedVector<WIDE_PAGE_WIDTH, Backend> path_membership_id_iv;
+    TunablePagedVector<Backend> path_membership_id_iv{WIDE_PAGE_WIDTH};
     /// 1-based offset of the occurrence of the node in the corresponding PackedPath vector.
-    PagedVector<NARROW_PAGE_WIDTH, Backend> path_membership_offset_iv;
+    TunablePagedVector<Backend> path_membership_offset_iv{NARROW_PAGE_WIDTH};
     /// 1-based offset of the next occurrence of this node on a path within this vector (or
     /// 0 if there is none)
-    PagedVector<NARROW_PAGE_WIDTH, Backend> path_membership_next_iv;
+    TunablePagedVector<Backend> path_membership_next_iv{NARROW_PAGE_WIDTH};
     const static size_t MEMBERSHIP_ID_RECORD_SIZE;
     const static size_t MEMBERSHIP_OFFSET_RECORD_SIZE;
     const static size_t MEMBERSHIP_NEXT_RECORD_SIZE;
@@ -637,7 +750,7 @@ private:
     
     /// The starting index of the path's name in path_names_iv for the path with the
     /// same index in paths
-    PagedVector<NARROW_PAGE_WIDTH, Backend> path_name_start_iv;
+    TunablePagedVector<Backend> path_name_start_iv{NARROW_PAGE_WIDTH};
     
     /// The length of the path's name for the path with the same index in paths
     PackedVector<Backend> path_name_length_iv;
@@ -650,11 +763,11 @@ private:
     
     /// The 1-based index of the head of the linked list in steps_iv of the path
     /// with the same index in paths
-    PagedVector<WIDE_PAGE_WIDTH, Backend> path_head_iv;
+    TunablePagedVector<Backend> path_head_iv{WIDE_PAGE_WIDTH};
     
     /// The 1-based index of the tail of the linked list in steps_iv of the path
     /// with the same index in paths
-    PagedVector<NARROW_PAGE_WIDTH, Backend> path_tail_iv;
+    TunablePagedVector<Backend> path_tail_iv{NARROW_PAGE_WIDTH};
     
     /// The number of steps that have have deleted from the path at the same index
     PackedVector<Backend> path_deleted_steps_iv;
@@ -697,6 +810,9 @@ private:
     inline char decode_nucleotide(const uint64_t& val) const;
     /// Complement nucleotide encoded as [0, 4]
     inline uint64_t complement_encoded_nucleotide(const uint64_t& val) const;
+    /// Decode the given interval of seq_iv into dest, reverse complementing
+    /// it if requested
+    inline void decode_sequence(size_t seq_start, size_t seq_len, bool reverse, char* dest) const;
     
     /// Get the integer assignment of a char, or numeric_limits<uint64_t>::max()
     /// if no assignment has been made
@@ -717,6 +833,11 @@ private:
     
     inline uint64_t get_next_edge_index(const uint64_t& edge_index) const;
     inline uint64_t get_edge_target(const uint64_t& edge_index) const;
+    /// Versions of the edge list accessors that read through a cursor, for loops
+    /// that visit many nearby records
+    using EdgeCursor = typename TunablePagedVector<Backend>::cursor;
+    inline uint64_t get_next_edge_index(EdgeCursor& edges, const uint64_t& edge_index) const;
+    inline uint64_t get_edge_target(EdgeCursor& edges, const uint64_t& edge_index) const;
     inline void set_edge_target(const uint64_t& edge_index, const handle_t& handle);
     
     inline uint64_t get_next_membership(const uint64_t& membership_index) const;
@@ -726,9 +847,25 @@ private:
     inline void set_membership_step(const uint64_t& membership_index, const uint64_t& step);
     inline void set_membership_path(const uint64_t& membership_index, const uint64_t& path);
     
+    /// Deleted records are marked so compaction can recognize them: a node
+    /// record gets the same nonzero value for both edge lists, which no live
+    /// node can have, and edge and membership records point to themselves as
+    /// the next in their lists.
+    inline void mark_deleted_node_record(const uint64_t& record);
+    inline void mark_deleted_edge_record(const uint64_t& edge_index);
+    inline void mark_deleted_membership_record(const uint64_t& membership_index);
+    inline bool is_deleted_node_record(const uint64_t& record) const;
+    inline bool is_deleted_edge_record(const uint64_t& edge_index) const;
+    inline bool is_deleted_membership_record(const uint64_t& membership_index) const;
+    
     inline uint64_t get_step_trav(const PackedPath& path, const uint64_t& step_index) const;
     inline uint64_t get_step_prev(const PackedPath& path, const uint64_t& step_index) const;
     inline uint64_t get_step_next(const PackedPath& path, const uint64_t& step_index) const;
+    /// Versions of the path accessors that read through cursors on steps_iv and
+    /// links_iv, for loops that walk along a path
+    using PathCursor = typename RobustPagedVector<NARROW_PAGE_WIDTH, Backend>::cursor;
+    inline uint64_t get_step_trav(PathCursor& steps, const uint64_t& step_index) const;
+    inline uint64_t get_step_next(PathCursor& links, const uint64_t& step_index) const;
     inline void set_step_trav(PackedPath& path, const uint64_t& step_index, const uint64_t& trav);
     inline void set_step_prev(PackedPath& path, const uint64_t& step_index, const uint64_t& prev_index);
     inline void set_step_next(PackedPath& path, const uint64_t& step_index, const uint64_t& next_index);
@@ -749,6 +886,12 @@ public:
     /// Debugging function, measures memory and prints a report to an ostream.
     /// Optionally reports memory usage for every path individually.
     void report_memory(ostream& out, bool individual_paths = false) const;
+    
+    /// Measures memory and returns it as a tree with a node for each member.
+    /// Records that have been deleted but not yet defragmented away are
+    /// counted in the root's counters. Optionally breaks the paths down
+    /// individually.
+    MemoryReport memory_report(bool individual_paths = false) const;
 };
     
 template<typename Backend>    
@@ -796,6 +939,37 @@ inline char BasePackedGraph<Backend>::decode_nucleotide(const uint64_t& val) con
     return alphabet[val];
 }
 
+template<typename Backend>
+inline void BasePackedGraph<Backend>::decode_sequence(size_t seq_start, size_t seq_len, bool reverse,
+                                                      char* dest) const {
+    static const char* alphabet = "ACGTN";
+    static const char* complement_alphabet = "TGCAN";
+    // how many bases we unpack from seq_iv at a time
+    static const size_t decode_chunk_size = 64;
+    
+    uint64_t chunk[decode_chunk_size];
+    if (reverse) {
+        // fill in the reverse complement from the back
+        dest += seq_len;
+        for (size_t i = 0; i < seq_len; i += decode_chunk_size) {
+            size_t chunk_len = min(decode_chunk_size, seq_len - i);
+            seq_iv.get_range(seq_start + i, chunk_len, chunk);
+            for (size_t j = 0; j < chunk_len; ++j) {
+                *(--dest) = complement_alphabet[chunk[j]];
+            }
+        }
+    }
+    else {
+        for (size_t i = 0; i < seq_len; i += decode_chunk_size) {
+            size_t chunk_len = min(decode_chunk_size, seq_len - i);
+            seq_iv.get_range(seq_start + i, chunk_len, chunk);
+            for (size_t j = 0; j < chunk_len; ++j) {
+                *(dest++) = alphabet[chunk[j]];
+            }
+        }
+    }
+}
+
 template<typename Backend>
 inline size_t BasePackedGraph<Backend>::graph_iv_index(const handle_t& handle) const {
     return (nid_to_graph_iv.get(get_id(handle) - min_id) - 1) * GRAPH_RECORD_SIZE;
@@ -836,6 +1010,16 @@ inline uint64_t BasePackedGraph<Backend>::get_edge_target(const uint64_t& edge_i
     return edge_lists_iv.get((edge_index - 1) * EDGE_RECORD_SIZE + EDGE_TRAV_OFFSET);
 }
 
+template<typename Backend>
+inline uint64_t BasePackedGraph<Backend>::get_next_edge_index(EdgeCursor& edges, const uint64_t& edge_index) const {
+    return edges.get((edge_index - 1) * EDGE_RECORD_SIZE + EDGE_NEXT_OFFSET);
+}
+
+template<typename Backend>
+inline uint64_t BasePackedGraph<Backend>::get_edge_target(EdgeCursor& edges, const uint64_t& edge_index) const {
+    return edges.get((edge_index - 1) * EDGE_RECORD_SIZE + EDGE_TRAV_OFFSET);
+}
+
 template<typename Backend>
 inline void BasePackedGraph<Backend>::set_edge_target(const uint64_t& edge_index, const handle_t& handle) {
     edge_lists_iv.set((edge_index - 1) * EDGE_RECORD_SIZE + EDGE_TRAV_OFFSET, encode_traversal(handle));
@@ -871,6 +1055,41 @@ inline void BasePackedGraph<Backend>::set_membership_path(const uint64_t& member
     path_membership_id_iv.set((membership_index - 1) * MEMBERSHIP_NEXT_RECORD_SIZE, path);
 }
 
+template<typename Backend>
+inline void BasePackedGraph<Backend>::mark_deleted_node_record(const uint64_t& record) {
+    graph_iv.set((record - 1) * GRAPH_RECORD_SIZE + GRAPH_START_EDGES_OFFSET, record);
+    graph_iv.set((record - 1) * GRAPH_RECORD_SIZE + GRAPH_END_EDGES_OFFSET, record);
+    compacted_node_records = std::min<size_t>(compacted_node_records, record - 1);
+}
+
+template<typename Backend>
+inline void BasePackedGraph<Backend>::mark_deleted_edge_record(const uint64_t& edge_index) {
+    edge_lists_iv.set((edge_index - 1) * EDGE_RECORD_SIZE + EDGE_NEXT_OFFSET, edge_index);
+    compacted_edge_records = std::min<size_t>(compacted_edge_records, edge_index - 1);
+}
+
+template<typename Backend>
+inline void BasePackedGraph<Backend>::mark_deleted_membership_record(const uint64_t& membership_index) {
+    set_next_membership(membership_index, membership_index);
+    compacted_membership_records = std::min<size_t>(compacted_membership_records, membership_index - 1);
+}
+
+template<typename Backend>
+inline bool BasePackedGraph<Backend>::is_deleted_node_record(const uint64_t& record) const {
+    uint64_t start = graph_iv.get((record - 1) * GRAPH_RECORD_SIZE + GRAPH_START_EDGES_OFFSET);
+    return start != 0 && start == graph_iv.get((record - 1) * GRAPH_RECORD_SIZE + GRAPH_END_EDGES_OFFSET);
+}
+
+template<typename Backend>
+inline bool BasePackedGraph<Backend>::is_deleted_edge_record(const uint64_t& edge_index) const {
+    return get_next_edge_index(edge_index) == edge_index;
+}
+
+template<typename Backend>
+inline bool BasePackedGraph<Backend>::is_deleted_membership_record(const uint64_t& membership_index) const {
+    return get_next_membership(membership_index) == membership_index;
+}
+
 template<typename Backend>
 inline uint64_t BasePackedGraph<Backend>::get_step_trav(const PackedPath& path, const uint64_t& step_index) const {
     return path.steps_iv.get((step_index - 1) * STEP_RECORD_SIZE);
@@ -886,6 +1105,16 @@ inline uint64_t BasePackedGraph<Backend>::get_step_next(const PackedPath& path,
     return path.links_iv.get((step_index - 1) * PATH_RECORD_SIZE + PATH_NEXT_OFFSET);
 }
 
+template<typename Backend>
+inline uint64_t BasePackedGraph<Backend>::get_step_trav(PathCursor& steps, const uint64_t& step_index) const {
+    return steps.get((step_index - 1) * STEP_RECORD_SIZE);
+}
+
+template<typename Backend>
+inline uint64_t BasePackedGraph<Backend>::get_step_next(PathCursor& links, const uint64_t& step_index) const {
+    return links.get((step_index - 1) * PATH_RECORD_SIZE + PATH_NEXT_OFFSET);
+}
+
 template<typename Backend>
 inline void BasePackedGraph<Backend>::set_step_trav(PackedPath& path, const uint64_t& step_index, const uint64_t& trav) {
     path.steps_iv.set((step_index - 1) * STEP_RECORD_SIZE, trav);
@@ -933,6 +1162,9 @@ inline char BasePackedGraph<Backend>::get_char(const uint64_t& assignment) const
 template<typename Backend>
 const double BasePackedGraph<Backend>::defrag_factor = .2;
 
+template<typename Backend>
+const size_t BasePackedGraph<Backend>::incremental_defrag_budget = 64;
+
 template<typename Backend>
 const size_t BasePackedGraph<Backend>::GRAPH_RECORD_SIZE = 2;
 template<typename Backend>
@@ -994,49 +1226,241 @@ BasePackedGraph<Backend>::~BasePackedGraph() {
 
 template<typename Backend>
 void BasePackedGraph<Backend>::serialize_members(ostream& out) const {
-    sdsl::write_member(max_id, out);
-    sdsl::write_member(min_id, out);
-    
-    graph_iv.serialize(out);
-    seq_start_iv.serialize(out);
-    seq_length_iv.serialize(out);
-    edge_lists_iv.serialize(out);
-    nid_to_graph_iv.serialize(out);
-    seq_iv.serialize(out);
-    
-    path_membership_node_iv.serialize(out);
-    path_membership_id_iv.serialize(out);
-    path_membership_offset_iv.serialize(out);
-    path_membership_next_iv.serialize(out);
-    
-    // it's sufficient to only serialize one direction of the mapping
-    sdsl::write_member(inverse_char_assignment, out);
-    
-    path_names_iv.serialize(out);
-    path_name_start_iv.serialize(out);
-    path_name_length_iv.serialize(out);
-    path_is_deleted_iv.serialize(out);
-    path_is_circular_iv.serialize(out);
-    path_head_iv.serialize(out);
-    path_tail_iv.serialize(out);
-    path_deleted_steps_iv.serialize(out);
-    
-    for (const PackedPath& path : paths) {
-        path.links_iv.serialize(out);
-        path.steps_iv.serialize(out);
-    }
-    // note: path_id can be reconstructed from the paths
-    sdsl::write_member(deleted_node_records, out);
-    sdsl::write_member(deleted_edge_records, out);
-    sdsl::write_member(deleted_membership_records, out);
-    sdsl::write_member(deleted_bases, out);
-    sdsl::write_member(reversing_self_edge_records, out);
-    sdsl::write_member(deleted_reversing_self_edge_records, out);
+    // The graph is split into sections that don't depend on each other, so that
+    // they can be encoded and decoded in parallel. A table of contents locates
+    // each section.
+    size_t section_count = MEMBER_SECTION_COUNT + paths.size();
+    // size the sections first, so that the table of contents can be written
+    // before them and they can be streamed out without holding onto them
+    vector<uint64_t> section_sizes(section_count);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < section_count; ++i) {
+        CountingStreamBuffer counter;
+        ostream strm(&counter);
+        serialize_section(i, strm);
+        section_sizes[i] = counter.count();
+    }
+    
+    int64_t marker = SECTIONED_FORMAT_MARKER;
+    uint64_t version = SECTIONED_FORMAT_VERSION;
+    uint64_t count = section_count;
+    sdsl::write_member(marker, out);
+    sdsl::write_member(version, out);
+    sdsl::write_member(count, out);
+    // offsets of the section boundaries relative to the start of the body
+    uint64_t offset = 0;
+    sdsl::write_member(offset, out);
+    for (uint64_t section_size : section_sizes) {
+        offset += section_size;
+        sdsl::write_member(offset, out);
+    }
+    for (size_t i = 0; i < section_count; ++i) {
+        serialize_section(i, out);
+    }
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::serialize_section(size_t section, ostream& out) const {
+    switch (section) {
+        case 0:
+            sdsl::write_member(max_id, out);
+            sdsl::write_member(min_id, out);
+            // it's sufficient to only serialize one direction of the mapping
+            sdsl::write_member(inverse_char_assignment, out);
+            sdsl::write_member(deleted_node_records, out);
+            sdsl::write_member(deleted_edge_records, out);
+            sdsl::write_member(deleted_membership_records, out);
+            sdsl::write_member(deleted_bases, out);
+            sdsl::write_member(reversing_self_edge_records, out);
+            sdsl::write_member(deleted_reversing_self_edge_records, out);
+            break;
+        case 1: graph_iv.serialize(out); break;
+        case 2: seq_start_iv.serialize(out); break;
+        case 3: seq_length_iv.serialize(out); break;
+        case 4: edge_lists_iv.serialize(out); break;
+        case 5: nid_to_graph_iv.serialize(out); break;
+        case 6: seq_iv.serialize(out); break;
+        case 7: path_membership_node_iv.serialize(out); break;
+        case 8: path_membership_id_iv.serialize(out); break;
+        case 9: path_membership_offset_iv.serialize(out); break;
+        case 10: path_membership_next_iv.serialize(out); break;
+        case 11: path_names_iv.serialize(out); break;
+        case 12: path_name_start_iv.serialize(out); break;
+        case 13: path_name_length_iv.serialize(out); break;
+        case 14: path_is_deleted_iv.serialize(out); break;
+        case 15: path_is_circular_iv.serialize(out); break;
+        case 16: path_head_iv.serialize(out); break;
+        case 17: path_tail_iv.serialize(out); break;
+        case 18: path_deleted_steps_iv.serialize(out); break;
+        default:
+        {
+            // note: path_id can be reconstructed from the paths
+            const PackedPath& path = paths.at(section - MEMBER_SECTION_COUNT);
+            path.links_iv.serialize(out);
+            path.steps_iv.serialize(out);
+            break;
+        }
+    }
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::deserialize_section(size_t section, istream& in) {
+    switch (section) {
+        case 0:
+            sdsl::read_member(max_id, in);
+            sdsl::read_member(min_id, in);
+            sdsl::read_member(inverse_char_assignment, in);
+            sdsl::read_member(deleted_node_records, in);
+            sdsl::read_member(deleted_edge_records, in);
+            sdsl::read_member(deleted_membership_records, in);
+            sdsl::read_member(deleted_bases, in);
+            sdsl::read_member(reversing_self_edge_records, in);
+            sdsl::read_member(deleted_reversing_self_edge_records, in);
+            break;
+        case 1: graph_iv.deserialize(in); break;
+        case 2: seq_start_iv.deserialize(in); break;
+        case 3: seq_length_iv.deserialize(in); break;
+        case 4: edge_lists_iv.deserialize(in); break;
+        case 5: nid_to_graph_iv.deserialize(in); break;
+        case 6: seq_iv.deserialize(in); break;
+        case 7: path_membership_node_iv.deserialize(in); break;
+        case 8: path_membership_id_iv.deserialize(in); break;
+        case 9: path_membership_offset_iv.deserialize(in); break;
+        case 10: path_membership_next_iv.deserialize(in); break;
+        case 11: path_names_iv.deserialize(in); break;
+        case 12: path_name_start_iv.deserialize(in); break;
+        case 13: path_name_length_iv.deserialize(in); break;
+        case 14: path_is_deleted_iv.deserialize(in); break;
+        case 15: path_is_circular_iv.deserialize(in); break;
+        case 16: path_head_iv.deserialize(in); break;
+        case 17: path_tail_iv.deserialize(in); break;
+        case 18: path_deleted_steps_iv.deserialize(in); break;
+        default:
+        {
+            PackedPath& path = paths[section - MEMBER_SECTION_COUNT];
+            path.links_iv.deserialize(in);
+            path.steps_iv.deserialize(in);
+            break;
+        }
+    }
 }
 
 template<typename Backend>
 void BasePackedGraph<Backend>::deserialize_members(istream& in) {
-    sdsl::read_member(max_id, in);
+    int64_t first;
+    sdsl::read_member(first, in);
+    if (first != SECTIONED_FORMAT_MARKER) {
+        // this is the original layout, which begins with the max ID
+        max_id = first;
+        deserialize_unsectioned_members(in);
+        mark_deleted_records();
+        return;
+    }
+    
+    uint64_t version;
+    sdsl::read_member(version, in);
+    if (version != SECTIONED_FORMAT_VERSION) {
+        throw std::runtime_error("error:[BasePackedGraph] cannot read serialized graph with unknown format version " + std::to_string(version));
+    }
+    uint64_t section_count;
+    sdsl::read_member(section_count, in);
+    if (section_count < MEMBER_SECTION_COUNT || !in) {
+        throw std::runtime_error("error:[BasePackedGraph] serialized graph has an invalid table of contents");
+    }
+    vector<uint64_t> offsets(section_count + 1);
+    in.read((char*) offsets.data(), offsets.size() * sizeof(uint64_t));
+    if (!in) {
+        throw std::runtime_error("error:[BasePackedGraph] serialized graph has an invalid table of contents");
+    }
+    
+    deserialize_sections(in, offsets);
+    mark_deleted_records();
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::deserialize_sections(istream& in, const vector<uint64_t>& offsets) {
+    size_t section_count = offsets.size() - 1;
+    for (size_t i = 0; i < section_count; ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            throw std::runtime_error("error:[BasePackedGraph] serialized graph has an invalid table of contents");
+        }
+    }
+    
+    paths.resize(section_count - MEMBER_SECTION_COUNT);
+    
+    // if the body is already in memory, we can decode it where it is, all at
+    // once. otherwise we read in a batch of sections at a time, one per thread,
+    // so that we never hold more than that much of the body in memory
+    const char* body = nullptr;
+    size_t batch_size = section_count;
+    vector<string> batch;
+    auto memory_buffer = dynamic_cast<MemoryStreamBuffer*>(in.rdbuf());
+    if (memory_buffer && memory_buffer->remaining() >= offsets.back()) {
+        body = memory_buffer->position();
+    }
+    else {
+        batch_size = get_thread_count();
+        batch.resize(batch_size);
+    }
+    
+    for (size_t batch_start = 0; batch_start < section_count; batch_start += batch_size) {
+        size_t batch_end = std::min(batch_start + batch_size, section_count);
+        if (!body) {
+            for (size_t i = batch_start; i < batch_end; ++i) {
+                string& section = batch[i - batch_start];
+                section.resize(offsets[i + 1] - offsets[i]);
+                in.read(&section[0], section.size());
+                if (!in) {
+                    throw std::runtime_error("error:[BasePackedGraph] serialized graph is truncated");
+                }
+            }
+        }
+        
+        // exceptions can't leave the parallel section, so we save the first one
+        std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = batch_start; i < batch_end; ++i) {
+            try {
+                MemoryStreamBuffer buffer(body ? body + offsets[i] : batch[i - batch_start].data(),
+                                          offsets[i + 1] - offsets[i]);
+                istream in(&buffer);
+                deserialize_section(i, in);
+            }
+            catch (...) {
+#pragma omp critical
+                {
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    if (body) {
+        memory_buffer->advance(offsets.back());
+    }
+    if (path_name_start_iv.size() != paths.size()) {
+        throw std::runtime_error("error:[BasePackedGraph] serialized graph has inconsistent path counts");
+    }
+    
+    // reconstruct the forward char assignments
+    for (size_t i = 0; i < inverse_char_assignment.size(); ++i) {
+        char_assignment[inverse_char_assignment[i]] = i;
+    }
+    
+    // reconstruct the path_id mapping
+    for (int64_t i = 0; i < paths.size(); i++) {
+        if (!path_is_deleted_iv.get(i)) {
+            path_id[extract_encoded_path_name(i)] = i;
+        }
+    }
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::deserialize_unsectioned_members(istream& in) {
     sdsl::read_member(min_id, in);
     
     graph_iv.deserialize(in);
@@ -1133,6 +1557,33 @@ template<typename Backend>
 void BasePackedGraph<Backend>::deserialize(const std::string& filename) {
     // TODO: we're duplicating code from libhandlegraph serialize here, because
     // we aren't allowed virtual methods.
+    
+    // try to map the file so that the sections can be decoded in place
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd != -1) {
+        struct stat file_stats;
+        void* mapping = MAP_FAILED;
+        size_t size = 0;
+        if (fstat(fd, &file_stats) == 0 && S_ISREG(file_stats.st_mode) && file_stats.st_size > 0) {
+            size = file_stats.st_size;
+            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (mapping != MAP_FAILED) {
+            try {
+                MemoryStreamBuffer buffer((const char*) mapping, size);
+                istream in(&buffer);
+                deserialize(in);
+            }
+            catch (...) {
+                munmap(mapping, size);
+                throw;
+            }
+            munmap(mapping, size);
+            return;
+        }
+    }
+    
     std::ifstream in(filename);
     deserialize(in);
 }
@@ -1297,10 +1748,8 @@ string BasePackedGraph<Backend>::get_sequence(const handle_t& handle) const {
     size_t seq_start = seq_start_iv.get(graph_index_to_seq_start_index(g_iv_index));
     size_t seq_len = seq_length_iv.get(graph_index_to_seq_len_index(g_iv_index));
     string seq(seq_len, 'N');
-    for (size_t i = 0; i < seq_len; i++) {
-        seq[i] = decode_nucleotide(seq_iv.get(seq_start + i));
-    }
-    return get_is_reverse(handle) ? reverse_complement(seq) : seq;
+    decode_sequence(seq_start, seq_len, get_is_reverse(handle), &seq[0]);
+    return seq;
 }
 
 template<typename Backend>
@@ -1428,6 +1877,26 @@ char BasePackedGraph<Backend>::get_base(const handle_t& handle, size_t index) co
     }
 }
 
+template<typename Backend>
+void BasePackedGraph<Backend>::get_sequences(const vector<handle_t>& handles, string& sequences,
+                                             vector<size_t>& offsets) const {
+    sequences.clear();
+    offsets.clear();
+    offsets.reserve(handles.size() + 1);
+    
+    for (const handle_t& handle : handles) {
+        size_t g_iv_index = graph_iv_index(handle);
+        size_t seq_start = seq_start_iv.get(graph_index_to_seq_start_index(g_iv_index));
+        size_t seq_len = seq_length_iv.get(graph_index_to_seq_len_index(g_iv_index));
+        
+        size_t begin = sequences.size();
+        offsets.push_back(begin);
+        sequences.resize(begin + seq_len);
+        decode_sequence(seq_start, seq_len, get_is_reverse(handle), &sequences[begin]);
+    }
+    offsets.push_back(sequences.size());
+}
+
 template<typename Backend>
 string BasePackedGraph<Backend>::get_subsequence(const handle_t& handle, size_t index, size_t size) const {
     size_t g_iv_index = graph_iv_index(handle);
@@ -1438,10 +1907,8 @@ string BasePackedGraph<Backend>::get_subsequence(const handle_t& handle, size_t
     size_t subseq_start = get_is_reverse(handle) ? seq_start + seq_len - size - index : seq_start + index;
     
     string subseq(size, 'N');
-    for (size_t i = 0; i < size; i++) {
-        subseq[i] = decode_nucleotide(seq_iv.get(subseq_start + i));
-    }
-    return get_is_reverse(handle) ? reverse_complement(subseq) : subseq;
+    decode_sequence(subseq_start, size, get_is_reverse(handle), &subseq[0]);
+    return subseq;
 }
 
 template<typename Backend>
@@ -1720,28 +2187,41 @@ void BasePackedGraph<Backend>::destroy_handle(const handle_t& handle) {
     
     deleted_bases += get_length(handle);
     
-    // remove the back-references to the edges
-    follow_edges(handle, false, [&](const handle_t& next) {
-        remove_edge_reference(flip(next), flip(handle));
-        
-        // we don't actually bother removing the reference, but we will also consider
-        // the edge on the deleting node to be deleted and hence count it up here
-        if (next != flip(handle)) {
-            ++deleted_edge_records;
+    // remove the back-references to the edges (collecting the neighbors first,
+    // since a reversing self edge is removed from the list we are following)
+    for (bool go_left : {false, true}) {
+        vector<handle_t> neighbors;
+        follow_edges(handle, go_left, [&](const handle_t& neighbor) {
+            neighbors.push_back(neighbor);
+            return true;
+        });
+        for (const handle_t& neighbor : neighbors) {
+            if (go_left) {
+                remove_edge_reference(neighbor, handle);
+            }
+            else {
+                remove_edge_reference(flip(neighbor), flip(handle));
+            }
+            
+            // we don't actually bother removing the reference, but we will also consider
+            // the edge on the deleting node to be deleted and hence count it up here
+            if (neighbor != flip(handle)) {
+                ++deleted_edge_records;
+            }
         }
-        return true;
-    });
-    follow_edges(handle, true, [&](const handle_t& prev) {
-        
-        remove_edge_reference(prev, handle);
-        
-        // we don't actually bother removing the reference, but we will also consider
-        // the edge on the deleting node to be deleted and hence count it up here
-        if (prev != flip(handle)) {
-            ++deleted_edge_records;
+    }
+    
+    // mark the records of the edges on the deleting node and the node itself as deleted
+    size_t g_iv_idx = graph_iv_index(handle);
+    for (size_t edge_list_offset : {GRAPH_START_EDGES_OFFSET, GRAPH_END_EDGES_OFFSET}) {
+        size_t edge_list_idx = graph_iv.get(g_iv_idx + edge_list_offset);
+        while (edge_list_idx) {
+            size_t next_edge_list_idx = get_next_edge_index(edge_list_idx);
+            mark_deleted_edge_record(edge_list_idx);
+            edge_list_idx = next_edge_list_idx;
         }
-        return true;
-    });
+    }
+    mark_deleted_node_record(g_iv_idx / GRAPH_RECORD_SIZE + 1);
             
     // remove the reference to the node
     nid_to_graph_iv.set(get_id(handle) - min_id, 0);
@@ -1793,6 +2273,7 @@ void BasePackedGraph<Backend>::remove_edge_reference(const handle_t& on, const h
         edge_lists_iv.set((prev_edge_list_idx - 1) * EDGE_RECORD_SIZE + EDGE_NEXT_OFFSET,
                           get_next_edge_index(edge_list_idx));
     }
+    mark_deleted_edge_record(edge_list_idx);
     ++deleted_edge_records;
     if (on == flip(to)) {
         ++deleted_reversing_self_edge_records;
@@ -1835,12 +2316,16 @@ void BasePackedGraph<Backend>::defragment_path(const int64_t& path_idx, bool for
             new_links_iv.reserve(path.links_iv.size() - path_deleted_steps_iv.get(path_idx) * PATH_RECORD_SIZE);
             new_steps_iv.reserve(path.steps_iv.size() - path_deleted_steps_iv.get(path_idx) * STEP_RECORD_SIZE);
             
+            // read the old records through cursors, since consecutive steps are usually nearby
+            auto steps = path.steps_iv.cursor_at();
+            auto links = path.links_iv.cursor_at();
+            
             bool first_iter = true;
             size_t copying_from = path_head_iv.get(path_idx);
             size_t prev = 0;
             while (copying_from != 0 && (first_iter || copying_from != path_head_iv.get(path_idx))) {
                 // make a new record
-                new_steps_iv.append(get_step_trav(path, copying_from));
+                new_steps_iv.append(get_step_trav(steps, copying_from));
                 new_links_iv.append(prev);
                 new_links_iv.append(0);
                 
@@ -1855,7 +2340,7 @@ void BasePackedGraph<Backend>::defragment_path(const int64_t& path_idx, bool for
                 }
                 
                 prev = here;
-                copying_from = get_step_next(path, copying_from);
+                copying_from = get_step_next(links, copying_from);
                 first_iter = false;
             }
             
@@ -1882,12 +2367,16 @@ void BasePackedGraph<Backend>::defragment_path(const int64_t& path_idx, bool for
             nid_translated.append_back(0);
             nid_t min_translated_id = get_id(decode_traversal(get_step_trav(path, path_head_iv.get(path_idx))));
             
+            // the new records are in order, so these cursors only ever decode each block once
+            steps = path.steps_iv.cursor_at();
+            links = path.links_iv.cursor_at();
+            
             first_iter = true;
             for (size_t here = path_head_iv.get(path_idx);
                  here != 0 && (here != path_head_iv.get(path_idx) || first_iter);
-                 here = get_step_next(path, here)) {
+                 here = get_step_next(links, here)) {
                 
-                handle_t handle = decode_traversal(get_step_trav(path, here));
+                handle_t handle = decode_traversal(get_step_trav(steps, here));
                 nid_t step_node_id = get_id(handle);
                 
                 // expand the bounds of the deque as necessary to be able to index by ID
@@ -2009,7 +2498,7 @@ void BasePackedGraph<Backend>::eject_deleted_paths() {
     
     // consolidate the vectors that share indexes with the paths vector (we do this to get them
     // to a tight allocation even if no paths have been deleted)
-    decltype(path_name_start_iv) new_path_name_start_iv;
+    decltype(path_name_start_iv) new_path_name_start_iv(path_name_start_iv.page_width());
     new_path_name_start_iv.reserve(paths.size());
     for (size_t i = 0; i < paths.size(); ++i) {
         new_path_name_start_iv.append(path_name_start_iv.get(i));
@@ -2037,14 +2526,14 @@ void BasePackedGraph<Backend>::eject_deleted_paths() {
     }
     path_is_circular_iv = move(new_path_is_circular_iv);
     
-    decltype(path_head_iv) new_path_head_iv;
+    decltype(path_head_iv) new_path_head_iv(path_head_iv.page_width());
     new_path_head_iv.reserve(paths.size());
     for (size_t i = 0; i < paths.size(); ++i) {
         new_path_head_iv.append(path_head_iv.get(i));
     }
     path_head_iv = move(new_path_head_iv);
     
-    decltype(path_tail_iv) new_path_tail_iv;
+    decltype(path_tail_iv) new_path_tail_iv(path_tail_iv.page_width());
     new_path_tail_iv.reserve(paths.size());
     for (size_t i = 0; i < paths.size(); ++i) {
         new_path_tail_iv.append(path_tail_iv.get(i));
@@ -2115,6 +2604,9 @@ void BasePackedGraph<Backend>::tighten() {
     // make a new seq_iv of exactly the right size
     PackedVector<> new_seq_iv;
     new_seq_iv.reserve(total_seq_len);
+    // we move sequence through a buffer to copy whole words at a time
+    static const size_t transfer_chunk_size = 256;
+    uint64_t buffer[transfer_chunk_size];
     static_assert(SEQ_START_RECORD_SIZE == SEQ_LENGTH_RECORD_SIZE,
                   "This loop will need to be rewritten if we change the record sizes");
     for (size_t i = 0; i < seq_start_iv.size(); i += SEQ_START_RECORD_SIZE) {
@@ -2124,8 +2616,10 @@ void BasePackedGraph<Backend>::tighten() {
         // switch the pointer to the new seq iv
         seq_start_iv.set(i, new_seq_iv.size());
         // transfer the actual sequence over
-        for (size_t j = begin; j < end; j++) {
-            new_seq_iv.append(seq_iv.get(j));
+        for (size_t j = begin; j < end; j += transfer_chunk_size) {
+            size_t count = min(transfer_chunk_size, end - j);
+            seq_iv.get_range(j, count, buffer);
+            new_seq_iv.append_range(count, buffer);
         }
     }
     // replace the old seq iv
@@ -2136,6 +2630,12 @@ void BasePackedGraph<Backend>::tighten() {
 template<typename Backend>
 void BasePackedGraph<Backend>::defragment(bool force) {
     
+    if (incremental_defragmentation && !force) {
+        // just make some progress
+        compact_step(incremental_defrag_budget);
+        return;
+    }
+    
     uint64_t num_nodes = graph_iv.size() / GRAPH_RECORD_SIZE - deleted_node_records;
     if (deleted_node_records > defrag_factor * (graph_iv.size() / GRAPH_RECORD_SIZE) || force) {
         // what's the real number of undeleted nodes in the graph?
@@ -2159,10 +2659,10 @@ void BasePackedGraph<Backend>::defragment(bool force) {
         }
         
         // initialize new vectors to construct defragged copies in
-        decltype(graph_iv) new_graph_iv;
+        decltype(graph_iv) new_graph_iv(graph_iv.page_width());
         PackedVector<> new_seq_length_iv;
-        decltype(seq_start_iv) new_seq_start_iv;
-        decltype(path_membership_node_iv) new_path_membership_node_iv;
+        decltype(seq_start_iv) new_seq_start_iv(seq_start_iv.page_width());
+        decltype(path_membership_node_iv) new_path_membership_node_iv(path_membership_node_iv.page_width());
         
         // expand them to the size we need to avoid reallocation and get optimal compression
         new_graph_iv.reserve(num_nodes * GRAPH_RECORD_SIZE);
@@ -2170,16 +2670,21 @@ void BasePackedGraph<Backend>::defragment(bool force) {
         new_seq_start_iv.reserve(num_nodes * SEQ_START_RECORD_SIZE);
         new_path_membership_node_iv.reserve(num_nodes * NODE_MEMBER_RECORD_SIZE);
         
+        // node records are usually visited in increasing order, so read them through cursors
+        auto graph_records = graph_iv.cursor_at();
+        auto seq_starts = seq_start_iv.cursor_at();
+        auto node_members = path_membership_node_iv.cursor_at();
+        
         for (size_t i = 0; i < nid_to_graph_iv.size(); i++) {
             size_t raw_g_iv_idx = nid_to_graph_iv.get(i);
             if (raw_g_iv_idx) {
                 size_t g_iv_idx = (raw_g_iv_idx - 1) * GRAPH_RECORD_SIZE;
                 // this node still exists, create a new copy
-                new_graph_iv.append(graph_iv.get(g_iv_idx + GRAPH_START_EDGES_OFFSET));
-                new_graph_iv.append(graph_iv.get(g_iv_idx + GRAPH_END_EDGES_OFFSET));
+                new_graph_iv.append(graph_records.get(g_iv_idx + GRAPH_START_EDGES_OFFSET));
+                new_graph_iv.append(graph_records.get(g_iv_idx + GRAPH_END_EDGES_OFFSET));
                 new_seq_length_iv.append(seq_length_iv.get(graph_index_to_seq_len_index(g_iv_idx)));
-                new_seq_start_iv.append(seq_start_iv.get(graph_index_to_seq_start_index(g_iv_idx)));
-                new_path_membership_node_iv.append(path_membership_node_iv.get(graph_index_to_node_member_index(g_iv_idx)));
+                new_seq_start_iv.append(seq_starts.get(graph_index_to_seq_start_index(g_iv_idx)));
+                new_path_membership_node_iv.append(node_members.get(graph_index_to_node_member_index(g_iv_idx)));
                 // update the pointer into graph_iv
                 nid_to_graph_iv.set(i, new_graph_iv.size() / GRAPH_RECORD_SIZE);
             }
@@ -2192,6 +2697,7 @@ void BasePackedGraph<Backend>::defragment(bool force) {
         path_membership_node_iv = std::move(new_path_membership_node_iv);
         
         deleted_node_records = 0;
+        compacted_node_records = graph_iv.size() / GRAPH_RECORD_SIZE;
     }
     
     // TODO: also defragment seq_iv?
@@ -2201,9 +2707,12 @@ void BasePackedGraph<Backend>::defragment(bool force) {
         
         uint64_t num_edge_records = edge_lists_iv.size() / EDGE_RECORD_SIZE - deleted_edge_records;
         
-        decltype(edge_lists_iv) new_edge_lists_iv;
+        decltype(edge_lists_iv) new_edge_lists_iv(edge_lists_iv.page_width());
         new_edge_lists_iv.reserve(num_edge_records * EDGE_RECORD_SIZE);
         
+        // the old edge lists aren't modified while we copy out of them
+        auto edges = edge_lists_iv.cursor_at();
+        
         for (size_t i = 0; i < nid_to_graph_iv.size(); i++) {
             size_t raw_g_iv_idx = nid_to_graph_iv.get(i);
             if (raw_g_iv_idx) {
@@ -2213,21 +2722,21 @@ void BasePackedGraph<Backend>::defragment(bool force) {
                     size_t edge_list_idx = graph_iv.get(g_iv_idx + edge_list_offset);
                     if (edge_list_idx) {
                         // add a new edge record
-                        new_edge_lists_iv.append(get_edge_target(edge_list_idx));
+                        new_edge_lists_iv.append(get_edge_target(edges, edge_list_idx));
                         new_edge_lists_iv.append(0);
                         // point the graph vector at this new edge list
                         graph_iv.set(g_iv_idx + edge_list_offset, new_edge_lists_iv.size() / EDGE_RECORD_SIZE);
                         
-                        edge_list_idx = get_next_edge_index(edge_list_idx);
+                        edge_list_idx = get_next_edge_index(edges, edge_list_idx);
                         while (edge_list_idx) {
                             // add a new edge record
-                            new_edge_lists_iv.append(get_edge_target(edge_list_idx));
+                            new_edge_lists_iv.append(get_edge_target(edges, edge_list_idx));
                             new_edge_lists_iv.append(0);
                             // point the previous link at this one
                             new_edge_lists_iv.set(new_edge_lists_iv.size() - 2 * EDGE_RECORD_SIZE + EDGE_NEXT_OFFSET,
                                                   new_edge_lists_iv.size() / EDGE_RECORD_SIZE);
                             
-                            edge_list_idx = get_next_edge_index(edge_list_idx);
+                            edge_list_idx = get_next_edge_index(edges, edge_list_idx);
                         }
                     }
                 }
@@ -2239,15 +2748,16 @@ void BasePackedGraph<Backend>::defragment(bool force) {
         deleted_edge_records = 0;
         reversing_self_edge_records -= deleted_reversing_self_edge_records;
         deleted_reversing_self_edge_records = 0;
+        compacted_edge_records = edge_lists_iv.size() / EDGE_RECORD_SIZE;
     }
     
     if (deleted_membership_records > defrag_factor * (path_membership_next_iv.size() / MEMBERSHIP_NEXT_RECORD_SIZE) || force) {
         
         uint64_t num_membership_records = path_membership_next_iv.size() / MEMBERSHIP_NEXT_RECORD_SIZE - deleted_membership_records;
         
-        decltype(path_membership_id_iv) new_path_membership_id_iv;
-        decltype(path_membership_offset_iv) new_path_membership_offset_iv;
-        decltype(path_membership_next_iv) new_path_membership_next_iv;
+        decltype(path_membership_id_iv) new_path_membership_id_iv(path_membership_id_iv.page_width());
+        decltype(path_membership_offset_iv) new_path_membership_offset_iv(path_membership_offset_iv.page_width());
+        decltype(path_membership_next_iv) new_path_membership_next_iv(path_membership_next_iv.page_width());
         
         new_path_membership_id_iv.reserve(num_membership_records * MEMBERSHIP_ID_RECORD_SIZE);
         new_path_membership_offset_iv.reserve(num_membership_records * MEMBERSHIP_OFFSET_RECORD_SIZE);
@@ -2291,6 +2801,361 @@ void BasePackedGraph<Backend>::defragment(bool force) {
         path_membership_next_iv = std::move(new_path_membership_next_iv);
         
         deleted_membership_records = 0;
+        compacted_membership_records = path_membership_next_iv.size() / MEMBERSHIP_NEXT_RECORD_SIZE;
+    }
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::set_incremental_defragmentation(bool incremental) {
+    incremental_defragmentation = incremental;
+}
+
+template<typename Backend>
+bool BasePackedGraph<Backend>::get_incremental_defragmentation() const {
+    return incremental_defragmentation;
+}
+
+template<typename Backend>
+bool BasePackedGraph<Backend>::compact_step(size_t budget) {
+    budget = compact_node_records(budget);
+    budget = compact_edge_records(budget);
+    budget = compact_membership_records(budget);
+    return deleted_node_records != 0 || deleted_edge_records != 0 || deleted_membership_records != 0;
+}
+
+template<typename Backend>
+size_t BasePackedGraph<Backend>::compact_node_records(size_t budget) {
+    
+    while (budget != 0 && deleted_node_records != 0) {
+        size_t last = graph_iv.size() / GRAPH_RECORD_SIZE;
+        if (last == 0) {
+            // the count of deleted records was wrong, and there is nothing to compact
+            deleted_node_records = 0;
+            break;
+        }
+        compacted_node_records = std::min(compacted_node_records, last - 1);
+        if (!is_deleted_node_record(last)) {
+            // find the first gap, which must come before the final record
+            while (budget != 0 && compacted_node_records + 1 < last
+                   && !is_deleted_node_record(compacted_node_records + 1)) {
+                ++compacted_node_records;
+                --budget;
+            }
+            if (budget == 0) {
+                break;
+            }
+            if (compacted_node_records + 1 == last) {
+                // the count of deleted records was wrong, and there is no gap to fill,
+                // so stop instead of dropping the live final record
+                deleted_node_records = 0;
+                break;
+            }
+            
+            nid_t node_id;
+            if (!get_node_record_id(last, node_id, budget)) {
+                break;
+            }
+            
+            // move the final record into the gap
+            size_t g_iv_idx = (last - 1) * GRAPH_RECORD_SIZE;
+            size_t gap_g_iv_idx = compacted_node_records * GRAPH_RECORD_SIZE;
+            graph_iv.set(gap_g_iv_idx + GRAPH_START_EDGES_OFFSET, graph_iv.get(g_iv_idx + GRAPH_START_EDGES_OFFSET));
+            graph_iv.set(gap_g_iv_idx + GRAPH_END_EDGES_OFFSET, graph_iv.get(g_iv_idx + GRAPH_END_EDGES_OFFSET));
+            seq_start_iv.set(graph_index_to_seq_start_index(gap_g_iv_idx),
+                             seq_start_iv.get(graph_index_to_seq_start_index(g_iv_idx)));
+            seq_length_iv.set(graph_index_to_seq_len_index(gap_g_iv_idx),
+                              seq_length_iv.get(graph_index_to_seq_len_index(g_iv_idx)));
+            path_membership_node_iv.set(graph_index_to_node_member_index(gap_g_iv_idx),
+                                        path_membership_node_iv.get(graph_index_to_node_member_index(g_iv_idx)));
+            nid_to_graph_iv.set(node_id - min_id, compacted_node_records + 1);
+            ++compacted_node_records;
+        }
+        
+        // the final record is no longer used
+        for (size_t i = 0; i < GRAPH_RECORD_SIZE; ++i) {
+            graph_iv.pop();
+        }
+        seq_start_iv.pop();
+        seq_length_iv.pop();
+        path_membership_node_iv.pop();
+        --deleted_node_records;
+        if (budget != 0) {
+            // finding the ID of the moved record can use up the budget
+            --budget;
+        }
+    }
+    
+    // drop unused IDs from the ends of the ID range
+    while (budget != 0 && !nid_to_graph_iv.empty() && nid_to_graph_iv.get(0) == 0) {
+        nid_to_graph_iv.pop_front();
+        min_id++;
+        --budget;
+    }
+    while (budget != 0 && !nid_to_graph_iv.empty() && nid_to_graph_iv.get(nid_to_graph_iv.size() - 1) == 0) {
+        nid_to_graph_iv.pop_back();
+        --budget;
+    }
+    if (nid_to_graph_iv.empty()) {
+        min_id = numeric_limits<nid_t>::max();
+        max_id = 0;
+    }
+    else {
+        max_id = min_id + nid_to_graph_iv.size() - 1;
+    }
+    
+    return budget;
+}
+
+template<typename Backend>
+bool BasePackedGraph<Backend>::get_node_record_id(size_t record, nid_t& node_id, size_t& budget) {
+    
+    size_t g_iv_idx = (record - 1) * GRAPH_RECORD_SIZE;
+    
+    // a step on a path records the ID
+    size_t member_idx = path_membership_node_iv.get(graph_index_to_node_member_index(g_iv_idx));
+    if (member_idx) {
+        const PackedPath& path = paths.at(get_membership_path(member_idx));
+        node_id = get_id(decode_traversal(get_step_trav(path, get_membership_step(member_idx))));
+        return true;
+    }
+    
+    // so does the reverse of any edge
+    for (size_t edge_list_offset : {GRAPH_START_EDGES_OFFSET, GRAPH_END_EDGES_OFFSET}) {
+        size_t edge_list_idx = graph_iv.get(g_iv_idx + edge_list_offset);
+        if (edge_list_idx) {
+            handle_t reverse_source = flip(decode_traversal(get_edge_target(edge_list_idx)));
+            bool found = !follow_edges(reverse_source, false, [&](const handle_t& next) {
+                if (graph_iv_index(next) == g_iv_idx) {
+                    node_id = get_id(next);
+                    return false;
+                }
+                return true;
+            });
+            if (found) {
+                return true;
+            }
+        }
+    }
+    
+    // otherwise, we have to look for it, going around the ID range from where
+    // the last scan stopped
+    size_t range = nid_to_graph_iv.size();
+    size_t i = 0;
+    if (record_id_scan_next >= min_id && record_id_scan_next - min_id < range) {
+        i = record_id_scan_next - min_id;
+    }
+    for (size_t checked = 0; checked < range; ++checked) {
+        if (budget == 0) {
+            record_id_scan_next = min_id + i;
+            return false;
+        }
+        --budget;
+        if (nid_to_graph_iv.get(i) == record) {
+            node_id = min_id + i;
+            record_id_scan_next = node_id;
+            return true;
+        }
+        i = (i + 1 == range) ? 0 : i + 1;
+    }
+    throw std::runtime_error("error:[BasePackedGraph] no node has record " + std::to_string(record));
+}
+
+template<typename Backend>
+size_t BasePackedGraph<Backend>::compact_edge_records(size_t budget) {
+    
+    while (budget != 0 && deleted_edge_records != 0) {
+        size_t last = edge_lists_iv.size() / EDGE_RECORD_SIZE;
+        if (last == 0) {
+            // the count of deleted records was wrong, and there is nothing to compact
+            deleted_edge_records = 0;
+            break;
+        }
+        compacted_edge_records = std::min(compacted_edge_records, last - 1);
+        if (!is_deleted_edge_record(last)) {
+            // find the first gap, which must come before the final record
+            while (budget != 0 && compacted_edge_records + 1 < last
+                   && !is_deleted_edge_record(compacted_edge_records + 1)) {
+                ++compacted_edge_records;
+                --budget;
+            }
+            if (budget == 0) {
+                break;
+            }
+            if (compacted_edge_records + 1 == last) {
+                // the count of deleted records was wrong, and there is no gap to fill,
+                // so stop instead of dropping the live final record
+                deleted_edge_records = 0;
+                break;
+            }
+            size_t gap = compacted_edge_records + 1;
+            
+            // find the list that the final record is in, which is the list of the
+            // reverse of one of the edges leaving the reverse of its target
+            handle_t target = decode_traversal(get_edge_target(last));
+            follow_edges(flip(target), false, [&](const handle_t& next) {
+                handle_t source = flip(next);
+                size_t g_iv_idx = graph_iv_index(source) + (get_is_reverse(source)
+                                                            ? GRAPH_START_EDGES_OFFSET
+                                                            : GRAPH_END_EDGES_OFFSET);
+                size_t edge_list_idx = graph_iv.get(g_iv_idx);
+                if (edge_list_idx == last) {
+                    graph_iv.set(g_iv_idx, gap);
+                    return false;
+                }
+                while (edge_list_idx) {
+                    size_t next_edge_list_idx = get_next_edge_index(edge_list_idx);
+                    if (next_edge_list_idx == last) {
+                        edge_lists_iv.set((edge_list_idx - 1) * EDGE_RECORD_SIZE + EDGE_NEXT_OFFSET, gap);
+                        return false;
+                    }
+                    edge_list_idx = next_edge_list_idx;
+                }
+                return true;
+            });
+            
+            // move the final record into the gap
+            edge_lists_iv.set((gap - 1) * EDGE_RECORD_SIZE + EDGE_TRAV_OFFSET, get_edge_target(last));
+            edge_lists_iv.set((gap - 1) * EDGE_RECORD_SIZE + EDGE_NEXT_OFFSET, get_next_edge_index(last));
+            ++compacted_edge_records;
+        }
+        
+        // the final record is no longer used
+        for (size_t i = 0; i < EDGE_RECORD_SIZE; ++i) {
+            edge_lists_iv.pop();
+        }
+        --deleted_edge_records;
+        --budget;
+    }
+    
+    if (deleted_edge_records == 0) {
+        // all of the deleted reversing self edges are gone too
+        reversing_self_edge_records -= deleted_reversing_self_edge_records;
+        deleted_reversing_self_edge_records = 0;
+    }
+    
+    return budget;
+}
+
+template<typename Backend>
+size_t BasePackedGraph<Backend>::compact_membership_records(size_t budget) {
+    
+    while (budget != 0 && deleted_membership_records != 0) {
+        size_t last = path_membership_next_iv.size() / MEMBERSHIP_NEXT_RECORD_SIZE;
+        if (last == 0) {
+            // the count of deleted records was wrong, and there is nothing to compact
+            deleted_membership_records = 0;
+            break;
+        }
+        compacted_membership_records = std::min(compacted_membership_records, last - 1);
+        if (!is_deleted_membership_record(last)) {
+            // find the first gap, which must come before the final record
+            while (budget != 0 && compacted_membership_records + 1 < last
+                   && !is_deleted_membership_record(compacted_membership_records + 1)) {
+                ++compacted_membership_records;
+                --budget;
+            }
+            if (budget == 0) {
+                break;
+            }
+            if (compacted_membership_records + 1 == last) {
+                // the count of deleted records was wrong, and there is no gap to fill,
+                // so stop instead of dropping the live final record
+                deleted_membership_records = 0;
+                break;
+            }
+            size_t gap = compacted_membership_records + 1;
+            
+            // the step that the final record points to is on the node whose list it is in
+            const PackedPath& path = paths.at(get_membership_path(last));
+            handle_t handle = decode_traversal(get_step_trav(path, get_membership_step(last)));
+            size_t node_member_idx = graph_index_to_node_member_index(graph_iv_index(handle));
+            size_t member_idx = path_membership_node_iv.get(node_member_idx);
+            if (member_idx == last) {
+                path_membership_node_iv.set(node_member_idx, gap);
+            }
+            else {
+                while (get_next_membership(member_idx) != last) {
+                    member_idx = get_next_membership(member_idx);
+                }
+                set_next_membership(member_idx, gap);
+            }
+            
+            // move the final record into the gap
+            set_membership_path(gap, get_membership_path(last));
+            set_membership_step(gap, get_membership_step(last));
+            set_next_membership(gap, get_next_membership(last));
+            ++compacted_membership_records;
+        }
+        
+        // the final record is no longer used
+        path_membership_id_iv.pop();
+        path_membership_offset_iv.pop();
+        path_membership_next_iv.pop();
+        --deleted_membership_records;
+        --budget;
+    }
+    
+    return budget;
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::mark_deleted_records() {
+    
+    compacted_node_records = 0;
+    compacted_edge_records = 0;
+    compacted_membership_records = 0;
+    if (deleted_node_records == 0 && deleted_edge_records == 0 && deleted_membership_records == 0) {
+        // nothing to mark
+        return;
+    }
+    
+    size_t node_records = graph_iv.size() / GRAPH_RECORD_SIZE;
+    size_t edge_records = edge_lists_iv.size() / EDGE_RECORD_SIZE;
+    size_t membership_records = path_membership_next_iv.size() / MEMBERSHIP_NEXT_RECORD_SIZE;
+    
+    // find the records that are still used
+    vector<bool> node_used(node_records + 1, false);
+    vector<bool> edge_used(edge_records + 1, false);
+    vector<bool> membership_used(membership_records + 1, false);
+    for (size_t i = 0; i < nid_to_graph_iv.size(); i++) {
+        size_t record = nid_to_graph_iv.get(i);
+        if (record) {
+            node_used[record] = true;
+            size_t g_iv_idx = (record - 1) * GRAPH_RECORD_SIZE;
+            for (size_t edge_list_offset : {GRAPH_START_EDGES_OFFSET, GRAPH_END_EDGES_OFFSET}) {
+                for (size_t edge_list_idx = graph_iv.get(g_iv_idx + edge_list_offset);
+                     edge_list_idx != 0; edge_list_idx = get_next_edge_index(edge_list_idx)) {
+                    edge_used[edge_list_idx] = true;
+                }
+            }
+            for (size_t member_idx = path_membership_node_iv.get(graph_index_to_node_member_index(g_iv_idx));
+                 member_idx != 0; member_idx = get_next_membership(member_idx)) {
+                membership_used[member_idx] = true;
+            }
+        }
+    }
+    
+    // and mark the rest, counting them again so that compaction can trust the counts
+    deleted_node_records = 0;
+    deleted_edge_records = 0;
+    deleted_membership_records = 0;
+    for (size_t i = 1; i <= node_records; ++i) {
+        if (!node_used[i]) {
+            mark_deleted_node_record(i);
+            ++deleted_node_records;
+        }
+    }
+    for (size_t i = 1; i <= edge_records; ++i) {
+        if (!edge_used[i]) {
+            mark_deleted_edge_record(i);
+            ++deleted_edge_records;
+        }
+    }
+    for (size_t i = 1; i <= membership_records; ++i) {
+        if (!membership_used[i]) {
+            mark_deleted_membership_record(i);
+            ++deleted_membership_records;
+        }
     }
 }
 
@@ -2332,6 +3197,34 @@ void BasePackedGraph<Backend>::optimize(bool allow_id_reassignment) {
     
     // tighten up vector allocations and straighten out the linked lists they contain
     tighten();
+    
+    if (page_width_tuning) {
+        tune_page_widths();
+    }
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::set_page_width_tuning(bool tune) {
+    page_width_tuning = tune;
+}
+
+template<typename Backend>
+bool BasePackedGraph<Backend>::get_page_width_tuning() const {
+    return page_width_tuning;
+}
+
+template<typename Backend>
+void BasePackedGraph<Backend>::tune_page_widths() {
+    graph_iv.tune_page_width();
+    seq_start_iv.tune_page_width();
+    edge_lists_iv.tune_page_width();
+    path_membership_node_iv.tune_page_width();
+    path_membership_id_iv.tune_page_width();
+    path_membership_offset_iv.tune_page_width();
+    path_membership_next_iv.tune_page_width();
+    path_name_start_iv.tune_page_width();
+    path_head_iv.tune_page_width();
+    path_tail_iv.tune_page_width();
 }
 
 template<typename Backend>
@@ -2367,6 +3260,10 @@ void BasePackedGraph<Backend>::clear(void) {
     deleted_bases = 0;
     reversing_self_edge_records = 0;
     deleted_reversing_self_edge_records = 0;
+    compacted_node_records = 0;
+    compacted_edge_records = 0;
+    compacted_membership_records = 0;
+    record_id_scan_next = 0;
 }
 
 template<typename Backend>
@@ -2627,12 +3524,14 @@ void BasePackedGraph<Backend>::destroy_paths(const std::vector<path_handle_t>& p
         PackedPath& packed_path = this->paths.at(as_integer(path));
         
         // remove node membership records corresponding to this path
+        auto steps = packed_path.steps_iv.cursor_at();
+        auto links = packed_path.links_iv.cursor_at();
         bool first_iter = true;
         for (uint64_t step_offset = path_head_iv.get(as_integer(path));
              step_offset != 0 && (step_offset != path_head_iv.get(as_integer(path)) || first_iter);
-             step_offset = get_step_next(packed_path, step_offset)) {
+             step_offset = get_step_next(links, step_offset)) {
             
-            uint64_t trav = get_step_trav(packed_path, step_offset);
+            uint64_t trav = get_step_trav(steps, step_offset);
             // if there are multiple paths, we check for whether we've gone over the same
             // node multiple times (which would be wasteful)
             if (paths.size() > 1) {
@@ -2661,13 +3560,15 @@ void BasePackedGraph<Backend>::destroy_paths(const std::vector<path_handle_t>& p
                         set_next_membership(prev, get_next_membership(here));
                     }
                     
+                    size_t next = get_next_membership(here);
+                    mark_deleted_membership_record(here);
                     ++deleted_membership_records;
+                    here = next;
                 }
                 else {
                     prev = here;
+                    here = get_next_membership(here);
                 }
-                
-                here = get_next_membership(here);
             }
             
             first_iter = false;
@@ -2856,6 +3757,7 @@ pair<step_handle_t, step_handle_t> BasePackedGraph<Backend>::rewrite_segment(con
             set_next_membership(prev, get_next_membership(here));
         }
         
+        mark_deleted_membership_record(here);
         ++deleted_membership_records;
         
         // get the adjacent nodes in the path
@@ -3472,6 +4374,112 @@ void BasePackedGraph<Backend>::report_memory(ostream& out, bool individual_paths
     out << "GRAND TOTAL: " << format_memory(grand_total) << endl;
 }
 
+template<typename Backend>
+MemoryReport BasePackedGraph<Backend>::memory_report(bool individual_paths) const {
+    MemoryReport report("graph", sizeof(max_id) + sizeof(min_id));
+    report.entries = get_node_count();
+    report.counters["deleted_node_records"] = deleted_node_records;
+    report.counters["deleted_edge_records"] = deleted_edge_records;
+    report.counters["deleted_membership_records"] = deleted_membership_records;
+    report.counters["deleted_bases"] = deleted_bases;
+    report.counters["reversing_self_edge_records"] = reversing_self_edge_records;
+    report.counters["deleted_reversing_self_edge_records"] = deleted_reversing_self_edge_records;
+    
+    report.add_child(graph_iv.memory_report("graph_iv"));
+    report.add_child(seq_start_iv.memory_report("seq_start_iv"));
+    report.add_child(seq_length_iv.memory_report("seq_length_iv"));
+    report.add_child(edge_lists_iv.memory_report("edge_lists_iv"));
+    report.add_child(nid_to_graph_iv.memory_report("nid_to_graph_iv"));
+    report.add_child(seq_iv.memory_report("seq_iv"));
+    report.add_child(path_membership_node_iv.memory_report("path_membership_node_iv"));
+    report.add_child(path_membership_id_iv.memory_report("path_membership_id_iv"));
+    report.add_child(path_membership_offset_iv.memory_report("path_membership_offset_iv"));
+    report.add_child(path_membership_next_iv.memory_report("path_membership_next_iv"));
+    
+    MemoryReport char_report("char_assignment",
+                             sizeof(inverse_char_assignment) + inverse_char_assignment.capacity() * sizeof(char)
+                             + sizeof(char_assignment)
+                             + char_assignment.bucket_count() * (sizeof(typename decltype(char_assignment)::value_type)
+                                                                 + sizeof(typename decltype(char_assignment)::key_type)));
+    char_report.entries = inverse_char_assignment.size();
+    report.add_child(char_report);
+    
+    report.add_child(path_names_iv.memory_report("path_names_iv"));
+    report.add_child(path_name_start_iv.memory_report("path_name_start_iv"));
+    report.add_child(path_name_length_iv.memory_report("path_name_length_iv"));
+    report.add_child(path_is_deleted_iv.memory_report("path_is_deleted_iv"));
+    report.add_child(path_is_circular_iv.memory_report("path_is_circular_iv"));
+    report.add_child(path_head_iv.memory_report("path_head_iv"));
+    report.add_child(path_tail_iv.memory_report("path_tail_iv"));
+    report.add_child(path_deleted_steps_iv.memory_report("path_deleted_steps_iv"));
+    
+    // The excess capacity of the path containers
+    size_t hash_table_excess = (path_id.bucket_count() - path_id.size()) * (sizeof(typename decltype(path_id)::key_type)
+                                                                            + sizeof(typename decltype(path_id)::value_type));
+    size_t vector_excess = (paths.capacity() - paths.size()) * sizeof(typename decltype(paths)::value_type);
+    MemoryReport paths_report("paths", sizeof(path_id) + sizeof(paths) + hash_table_excess + vector_excess,
+                              hash_table_excess + vector_excess);
+    paths_report.entries = path_id.size();
+    
+    // Either a node for each path, or nodes for each kind of path member
+    MemoryReport names_report("names");
+    MemoryReport links_report("links");
+    MemoryReport steps_report("steps");
+    vector<bool> path_is_live(paths.size(), false);
+    for (const auto& path_id_record : path_id) {
+        const auto& packed_path = paths.at(path_id_record.second);
+        path_is_live[path_id_record.second] = true;
+        
+        MemoryReport name_report("name", path_id_record.first.memory_usage() + sizeof(path_id_record.second));
+        MemoryReport path_links_report = packed_path.links_iv.memory_report("links");
+        MemoryReport path_steps_report = packed_path.steps_iv.memory_report("steps");
+        if (individual_paths) {
+            MemoryReport path_report(decode_path_name(path_id_record.second));
+            path_report.entries = packed_path.steps_iv.size();
+            path_report.add_child(name_report);
+            path_report.add_child(path_links_report);
+            path_report.add_child(path_steps_report);
+            paths_report.add_child(path_report);
+        }
+        else {
+            names_report.bytes += name_report.bytes;
+            names_report.entries++;
+            links_report.bytes += path_links_report.bytes;
+            links_report.slack_bytes += path_links_report.slack_bytes;
+            links_report.entries += path_links_report.entries;
+            steps_report.bytes += path_steps_report.bytes;
+            steps_report.slack_bytes += path_steps_report.slack_bytes;
+            steps_report.entries += path_steps_report.entries;
+        }
+    }
+    if (!individual_paths) {
+        paths_report.add_child(names_report);
+        paths_report.add_child(links_report);
+        paths_report.add_child(steps_report);
+    }
+    else {
+        // Order the paths by name, like report_memory does
+        sort(paths_report.children.begin(), paths_report.children.end(),
+             [](const MemoryReport& a, const MemoryReport& b) { return a.name < b.name; });
+    }
+    
+    // Deleted paths keep their records until the graph is defragmented, and
+    // all of their memory is unused
+    MemoryReport dead_report("deleted_paths");
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!path_is_live[i]) {
+            dead_report.bytes += paths.at(i).links_iv.memory_usage() + paths.at(i).steps_iv.memory_usage();
+            dead_report.entries++;
+        }
+    }
+    dead_report.slack_bytes = dead_report.bytes;
+    paths_report.add_child(dead_report);
+    
+    report.add_child(paths_report);
+    
+    return report;
+}
+
 } // end dankness
 
 #endif
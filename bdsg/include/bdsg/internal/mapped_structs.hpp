@@ -11,6 +11,7 @@
 #include <cstdint>
 #include <cassert>
 #include <climits>
+#include <algorithm>
 #include <iostream>
 #include <functional>
 #include <limits>
@@ -18,6 +19,7 @@
 #include <map>
 #include <unordered_map>
 #include <vector>
+#include <atomic>
 #include <shared_mutex>
 
 // TODO: We only target little-endian systems, like x86_64 and ARM64 Linux and
@@ -475,6 +477,14 @@ protected:
      */
     static shared_timed_mutex mutex;
     
+    /**
+     * Incremented whenever a link goes away, so that threads know to drop the
+     * copies of links they have cached for following pointers without
+     * locking. Links never change while they exist, so nothing needs to be
+     * dropped when links are added.
+     */
+    static atomic<uint64_t> link_generation;
+    
     /**
      * How big should a link be to start with.
      */
@@ -803,7 +813,7 @@ public:
      * Returns the total bytes, the number of free bytes, and the number of
      * free bytes reclaimable when closed as a mapped file. 
      */
-    std::tuple<size_t, size_t, size_t> get_usage();
+    std::tuple<size_t, size_t, size_t> get_usage() const;
     
     /**
      * Make sure that internal heap data structures are consistent with the
@@ -924,6 +934,23 @@ protected:
 template<typename T>
 using MappedVector = CompatVector<T, yomo::Allocator<T>>; 
 
+/**
+ * Read count consecutive width-bit integers, starting with integer number
+ * index, out of the given array of packed 64-bit words, and write them to out.
+ * Works a whole word at a time instead of doing a separate bit-field
+ * extraction per integer. Never reads a word that holds none of the requested
+ * bits.
+ */
+inline void unpack_int_range(const uint64_t* words, size_t width, size_t index, size_t count, uint64_t* out);
+
+/**
+ * Write count consecutive width-bit integers from in to the given array of
+ * packed 64-bit words, starting at integer number index. Bits outside the
+ * range are preserved. Values must already fit in width bits. Never touches a
+ * word that holds none of the written bits.
+ */
+inline void pack_int_range(uint64_t* words, size_t width, size_t index, size_t count, const uint64_t* in);
+
 /**
  * An int vector that is mostly API-compatible with SDSL's int vectors, but
  * which can exist in a memory mapping and uses the given allocator and its
@@ -1030,6 +1057,27 @@ public:
      */
     uint64_t unpack(size_t index, size_t width) const;
     
+    /**
+     * Get up to 64 bits starting at the given bit offset in the backing
+     * storage, like sdsl::int_vector::get_int(). The bits must all be within
+     * the vector's length.
+     */
+    uint64_t get_int(size_t bit_index, size_t len = 64) const;
+    
+    /**
+     * Read count consecutive entries, starting at the given index, into out.
+     * Much faster than reading the entries one at a time.
+     */
+    void get_range(size_t index, size_t count, uint64_t* out) const;
+    
+    /**
+     * Write count consecutive entries, starting at the given index, from in.
+     * Much faster than writing the entries one at a time.
+     *
+     * Throws if any of the values will not fit in the vector's width.
+     */
+    void set_range(size_t index, size_t count, const uint64_t* in);
+    
     /**
      * Proxy that acts as a mutable reference to an entry in the vector.
      */
@@ -1122,6 +1170,14 @@ public:
     void load(std::istream& in);
     
 protected:
+    /// How many entries we move at a time when working in bulk
+    static const size_t REPACK_CHUNK_SIZE = 256;
+    
+    /// Show consecutive chunks of the entries in the given range to the
+    /// iteratee, as (first index, count, values) triples.
+    template<typename Iteratee>
+    void for_each_range(size_t index, size_t count, const Iteratee& iteratee) const;
+    
     /// How many items are stored?
     size_t length = 0;
     /// How many bits are used to represent each item?
@@ -1620,6 +1676,70 @@ const T& CompatVector<T, Alloc>::operator[](size_t index) const {
 
 
 
+inline void unpack_int_range(const uint64_t* words, size_t width, size_t index, size_t count, uint64_t* out) {
+    if (count == 0) {
+        return;
+    }
+    if (width == std::numeric_limits<uint64_t>::digits) {
+        // Every entry is already a whole word
+        std::copy(words + index, words + index + count, out);
+        return;
+    }
+    
+    uint64_t mask = ~(std::numeric_limits<uint64_t>::max() << width);
+    size_t start_bit = index * width;
+    const uint64_t* word = words + (start_bit >> 6);
+    size_t offset = start_bit & 0x3F;
+    uint64_t current = *word;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = current >> offset;
+        offset += width;
+        if (offset >= std::numeric_limits<uint64_t>::digits) {
+            offset -= std::numeric_limits<uint64_t>::digits;
+            if (offset != 0) {
+                // The value continues into the next word
+                current = *(++word);
+                value |= current << (width - offset);
+            } else if (i + 1 < count) {
+                // The value ended exactly at the end of the word
+                current = *(++word);
+            }
+        }
+        out[i] = value & mask;
+    }
+}
+
+inline void pack_int_range(uint64_t* words, size_t width, size_t index, size_t count, const uint64_t* in) {
+    if (count == 0) {
+        return;
+    }
+    if (width == std::numeric_limits<uint64_t>::digits) {
+        // Every entry is already a whole word
+        std::copy(in, in + count, words + index);
+        return;
+    }
+    
+    size_t start_bit = index * width;
+    uint64_t* word = words + (start_bit >> 6);
+    size_t offset = start_bit & 0x3F;
+    // Keep whatever is before the range in the first word
+    uint64_t current = offset == 0 ? 0 : (*word & ~(std::numeric_limits<uint64_t>::max() << offset));
+    for (size_t i = 0; i < count; i++) {
+        current |= in[i] << offset;
+        offset += width;
+        if (offset >= std::numeric_limits<uint64_t>::digits) {
+            // This word is full
+            *(word++) = current;
+            offset -= std::numeric_limits<uint64_t>::digits;
+            current = offset == 0 ? 0 : in[i] >> (width - offset);
+        }
+    }
+    if (offset != 0) {
+        // Keep whatever is after the range in the last word
+        *word = (*word & (std::numeric_limits<uint64_t>::max() << offset)) | current;
+    }
+}
+
 template<typename Alloc>
 CompatIntVector<Alloc>::CompatIntVector(const CompatIntVector& other) :
     length(other.length), bit_width(other.bit_width), data(other.data) {
@@ -1666,10 +1786,11 @@ CompatIntVector<Alloc>& CompatIntVector<Alloc>::operator=(const OtherType& other
     clear();
     width(other.width());
     resize(other.size());
-    for (size_t i = 0; i < size(); i++) {
-        // Copy all the entries, repacking each.
-        // TODO: accelerate somehow if we can get direct access to bit-packed data.
-        (*this)[i] = other[i];
+    // We use the same bit layout as SDSL, so we can copy a word at a time.
+    size_t total_bits = size() * bit_width;
+    for (size_t bit = 0; bit < total_bits; bit += std::numeric_limits<uint64_t>::digits) {
+        data.get_first()[bit >> 6] = other.get_int(bit, std::min<size_t>(std::numeric_limits<uint64_t>::digits,
+                                                                          total_bits - bit));
     }
     return *this;
 }
@@ -1768,10 +1889,28 @@ void CompatIntVector<Alloc>::repack(size_t new_width, size_t new_size) {
     
     assert(new_width > 0);
     
+    if (new_width < old_width) {
+        // Make sure everything will fit before we start overwriting.
+        uint64_t all_bits = 0;
+        for_each_range(0, length, [&](size_t index, size_t count, const uint64_t* values) {
+            for (size_t i = 0; i < count; i++) {
+                all_bits |= values[i];
+            }
+        });
+        if (new_width < std::numeric_limits<uint64_t>::digits && (all_bits >> new_width)) {
+            throw std::invalid_argument("Need " + std::to_string(sdsl::bits::hi(all_bits) + 1) +
+                                        " bits to represent stored values but only have " + std::to_string(new_width));
+        }
+    }
+    
     // Work out how many slots we need in backing storage.
     size_t new_entries = (length * new_width + (std::numeric_limits<uint64_t>::digits - 1)) /
         std::numeric_limits<uint64_t>::digits;
     
+    // We move the entries through a buffer a chunk at a time. A whole chunk is
+    // read before any of it is written, and a chunk only ever overwrites bits
+    // belonging to itself or to chunks that were already moved.
+    uint64_t buffer[REPACK_CHUNK_SIZE];
     if (new_width > old_width) {
         // We can expand in place
         data.resize(new_entries);
@@ -1779,17 +1918,19 @@ void CompatIntVector<Alloc>::repack(size_t new_width, size_t new_size) {
         // Starting at the end, to avoid overwriting
         size_t i = length;
         while (i > 0) {
-            i--;
-            // Copy all the data to the new size
-            pack(i, unpack(i, old_width), new_width);
+            size_t count = std::min<size_t>(i, REPACK_CHUNK_SIZE);
+            i -= count;
+            unpack_int_range(data.get_first(), old_width, i, count, buffer);
+            pack_int_range(data.get_first(), new_width, i, count, buffer);
         }
     } else {
         // Must be shrinking
         
         // Starting at the beginning, to avoid overwriting
-        for (size_t i = 0; i < length; i++) {
-            // Copy all the data to the new size
-            pack(i, unpack(i, old_width), new_width);
+        for (size_t i = 0; i < length; i += REPACK_CHUNK_SIZE) {
+            size_t count = std::min<size_t>(length - i, REPACK_CHUNK_SIZE);
+            unpack_int_range(data.get_first(), old_width, i, count, buffer);
+            pack_int_range(data.get_first(), new_width, i, count, buffer);
         }
         
         // Now shrink down
@@ -1831,6 +1972,46 @@ uint64_t CompatIntVector<Alloc>::unpack(size_t index, size_t width) const {
     return sdsl::bits::read_int(data.get_first() + (start_bit >> 6), start_bit & 0x3F, width);
 }
 
+template<typename Alloc>
+uint64_t CompatIntVector<Alloc>::get_int(size_t bit_index, size_t len) const {
+    return sdsl::bits::read_int(data.get_first() + (bit_index >> 6), bit_index & 0x3F, len);
+}
+
+template<typename Alloc>
+const size_t CompatIntVector<Alloc>::REPACK_CHUNK_SIZE;
+
+template<typename Alloc>
+void CompatIntVector<Alloc>::get_range(size_t index, size_t count, uint64_t* out) const {
+    unpack_int_range(data.get_first(), bit_width, index, count, out);
+}
+
+template<typename Alloc>
+void CompatIntVector<Alloc>::set_range(size_t index, size_t count, const uint64_t* in) {
+    if (bit_width < std::numeric_limits<uint64_t>::digits) {
+        uint64_t all_bits = 0;
+        for (size_t i = 0; i < count; i++) {
+            all_bits |= in[i];
+        }
+        if (all_bits >> bit_width) {
+            // Some value will not fit.
+            throw std::invalid_argument("Need " + std::to_string(sdsl::bits::hi(all_bits) + 1) +
+                                        " bits to represent values but only have " + std::to_string(bit_width));
+        }
+    }
+    pack_int_range(data.get_first(), bit_width, index, count, in);
+}
+
+template<typename Alloc>
+template<typename Iteratee>
+void CompatIntVector<Alloc>::for_each_range(size_t index, size_t count, const Iteratee& iteratee) const {
+    uint64_t buffer[REPACK_CHUNK_SIZE];
+    for (size_t i = 0; i < count; i += REPACK_CHUNK_SIZE) {
+        size_t chunk = std::min<size_t>(count - i, REPACK_CHUNK_SIZE);
+        get_range(index + i, chunk, buffer);
+        iteratee(index + i, chunk, buffer);
+    }
+}
+
 template<typename Alloc>
 CompatIntVector<Alloc>::Proxy::Proxy(CompatIntVector& parent, size_t index) : parent(parent), index(index) {
     // Nothing to do!
@@ -2312,7 +2493,7 @@ void UniqueMappedPointer<T>::reset() {
 }
 
 template<typename T>
-std::tuple<size_t, size_t, size_t> UniqueMappedPointer<T>::get_usage() {
+std::tuple<size_t, size_t, size_t> UniqueMappedPointer<T>::get_usage() const {
     return Manager::get_usage(chain);
 }
 
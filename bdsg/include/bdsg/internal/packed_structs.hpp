@@ -12,11 +12,13 @@
 #include <cstdint>
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <random>
 #include <sdsl/int_vector.hpp>
 
 #include <bdsg/internal/mapped_structs.hpp>
+#include <bdsg/internal/utility.hpp>
 
 namespace bdsg {
     
@@ -27,6 +29,20 @@ using namespace std;
  */
 template<typename IntVector>
 inline void repack(IntVector& target, size_t new_width, size_t new_size); 
+
+/**
+ * Read a range of entries from an SDSL int vector, or any int vector that
+ * implements a get_range().
+ */
+template<typename IntVector>
+inline void get_range(const IntVector& source, size_t index, size_t count, uint64_t* out);
+
+/**
+ * Write a range of entries to an SDSL int vector, or any int vector that
+ * implements a set_range(). The values must fit in the vector's width.
+ */
+template<typename IntVector>
+inline void set_range(IntVector& target, size_t index, size_t count, const uint64_t* in);
     
 /*
  * A dynamic integer vector that maintains integers in bit-compressed form.
@@ -88,9 +104,22 @@ public:
         
     /// Returns the i-th value
     inline uint64_t get(const size_t& i) const;
+    
+    /// Writes the count values starting at index begin to out. Reads whole
+    /// words of the backing vector at a time, so it is much faster than
+    /// calling get() in a loop.
+    inline void get_range(const size_t& begin, const size_t& count, uint64_t* out) const;
+    
+    /// Sets the count values starting at index begin to the values in in.
+    /// Widens the vector at most once and writes whole words at a time, so it
+    /// is much faster than calling set() in a loop.
+    inline void set_range(const size_t& begin, const size_t& count, const uint64_t* in);
         
     /// Add a value to the end
     inline void append(const uint64_t& value);
+    
+    /// Add count values from in to the end
+    inline void append_range(const size_t& count, const uint64_t* in);
         
     /// Remove the last value
     inline void pop();
@@ -118,6 +147,10 @@ public:
     /// Reports the amount of memory consumed by this object in bytes.
     size_t memory_usage() const;
     
+    /// Reports the memory consumed by this object and its parts, under the
+    /// given name.
+    MemoryReport memory_report(const string& name) const;
+    
     /// Returns true if the contents are identical (but not necessarily storage
     /// parameters, such as pointer to data, capacity, bit width, etc.).
     inline bool operator==(const PackedVector& other) const;
@@ -216,11 +249,84 @@ public:
     /// Reports the amount of memory consumed by this object in bytes
     size_t memory_usage() const;
     
+    /// Reports the memory consumed by this object and its parts, under the
+    /// given name.
+    MemoryReport memory_report(const string& name) const;
+    
+    /// Forward declaration
+    class cursor;
+    
+    /// Get a cursor positioned at the i-th value
+    inline cursor cursor_at(const size_t& i = 0) const;
+    
+    /*
+     * A read-only cursor that decodes a block of a page into a local buffer the
+     * first time the block is read, so that scans and reads of nearby indexes
+     * only look up each page and its anchor once and unpack whole words at a
+     * time. Any modification of the vector invalidates the cursor.
+     */
+    class cursor {
+    public:
+        cursor(const cursor& other) = default;
+        cursor() = delete;
+        ~cursor() = default;
+        cursor& operator=(const cursor& other) = default;
+        
+        /// Returns the value at the current position
+        inline uint64_t operator*() const;
+        /// Move to the next position
+        inline cursor& operator++();
+        /// Move to the previous position
+        inline cursor& operator--();
+        /// Move to the i-th position
+        inline cursor& seek(const size_t& i);
+        /// Move to the i-th position and return the value there
+        inline uint64_t get(const size_t& i);
+        /// Returns the current position
+        inline size_t index() const;
+        
+    private:
+        
+        cursor(const PagedVector* iteratee, size_t i);
+        
+        /// The number of values that are decoded at a time, which is small
+        /// enough that reading a short linked list out of a wide page stays cheap
+        constexpr static size_t BLOCK_SIZE = page_size < 8 ? page_size : 8;
+        
+        /// Decode the block that contains the current position into the buffer
+        inline void decode_block() const;
+        
+        const PagedVector* iteratee;
+        
+        // the current position in the vector
+        size_t i = 0;
+        
+        // the page that the buffered block came from and its anchor
+        mutable size_t buffered_page = numeric_limits<size_t>::max();
+        mutable uint64_t buffered_anchor = 0;
+        
+        // the range of indexes in the buffer
+        mutable size_t buffer_begin = 0;
+        mutable size_t buffer_end = 0;
+        
+        // the decoded values of the buffered block
+        mutable uint64_t buffer[BLOCK_SIZE];
+        
+        friend class PagedVector;
+    };
+    
 private:
     
+    /// Load the pages from a stream, after the number of entries and the page
+    /// width have already been read from it
+    void deserialize_pages(istream& in, size_t stored_filled);
+    
     inline uint64_t to_diff(const uint64_t& value, const uint64_t& page) const;
     inline uint64_t from_diff(const uint64_t& diff, const uint64_t& page) const;
     
+    /// The TunablePagedVector reads our headers and measures our encoding
+    template<typename> friend class TunablePagedVector;
+    
     // The number of entries filled so far
     size_t filled = 0;
     
@@ -307,6 +413,55 @@ public:
     /// Reports the amount of memory consumed by this object in bytes
     size_t memory_usage() const;
     
+    /// Reports the memory consumed by this object and its parts, under the
+    /// given name.
+    MemoryReport memory_report(const string& name) const;
+    
+    /// Forward declaration
+    class cursor;
+    
+    /// Get a cursor positioned at the i-th value
+    inline cursor cursor_at(const size_t& i = 0) const;
+    
+    /*
+     * A read-only cursor with the same page caching as the PagedVector's
+     * cursor. Any modification of the vector invalidates the cursor.
+     */
+    class cursor {
+    public:
+        cursor(const cursor& other) = default;
+        cursor() = delete;
+        ~cursor() = default;
+        cursor& operator=(const cursor& other) = default;
+        
+        /// Returns the value at the current position
+        inline uint64_t operator*() const;
+        /// Move to the next position
+        inline cursor& operator++();
+        /// Move to the previous position
+        inline cursor& operator--();
+        /// Move to the i-th position
+        inline cursor& seek(const size_t& i);
+        /// Move to the i-th position and return the value there
+        inline uint64_t get(const size_t& i);
+        /// Returns the current position
+        inline size_t index() const;
+        
+    private:
+        
+        cursor(const RobustPagedVector* iteratee, size_t i);
+        
+        const RobustPagedVector* iteratee;
+        
+        // the current position in the vector
+        size_t i = 0;
+        
+        // reads from the latter pages
+        typename PagedVec::cursor latter_cursor;
+        
+        friend class RobustPagedVector;
+    };
+    
 private:
     
     /// The first page_size entries go in this vector
@@ -319,6 +474,180 @@ private:
 template<size_t page_size = 64>
 using MappedRobustPagedVector = RobustPagedVector<page_size, MappedBackend>;
 
+/*
+ * A PagedVector whose page width is chosen at run time from a small set of
+ * compiled widths. Narrow pages adapt their bit width to local variation in
+ * the values, while wide pages have less overhead per page. The width can be
+ * chosen from the data with tune_page_width().
+ */
+template<typename Backend = STLBackend>
+class TunablePagedVector {
+public:
+    
+    /// Construct (starts empty) with the given page width, which must be one
+    /// of the compiled page widths
+    explicit TunablePagedVector(size_t page_width = MEDIUM_PAGE_WIDTH);
+    
+    /// Construct from contents in a stream
+    TunablePagedVector(istream& in);
+    
+    /// Move constructor
+    TunablePagedVector(TunablePagedVector&& other) = default;
+    /// Move assignment operator
+    TunablePagedVector& operator=(TunablePagedVector&& other) = default;
+    
+    /// Copy constructor
+    TunablePagedVector(const TunablePagedVector& other) = default;
+    /// Copy assignment operator
+    TunablePagedVector& operator=(const TunablePagedVector& other) = default;
+    
+    // Destructor
+    ~TunablePagedVector() = default;
+    
+    /// Clear current contents and load from contents in a stream. Accepts the
+    /// serialization of a PagedVector of any of the compiled page widths, and
+    /// takes on its page width.
+    void deserialize(istream& in);
+    
+    /// Output contents to a stream, in the format of the PagedVector of the
+    /// current page width
+    void serialize(ostream& out) const;
+    
+    /// Set the i-th value
+    inline void set(const size_t& i, const uint64_t& value);
+    
+    /// Returns the i-th value
+    inline uint64_t get(const size_t& i) const;
+    
+    /// Add a value to the end
+    inline void append(const uint64_t& value);
+    
+    /// Remove the last value
+    inline void pop();
+    
+    /// Either shrink the vector or grow the vector to the new size. New
+    /// entries created by growing are filled with 0.
+    inline void resize(const size_t& new_size);
+    
+    /// If necessary, expand capacity so that the given number of entries can
+    /// be included in the vector without reallocating. Never shrinks capacity.
+    inline void reserve(const size_t& future_size);
+    
+    /// Reallocate smaller after having been resized down.
+    inline void shrink_to_fit();
+    
+    /// Returns the number of values
+    inline size_t size() const;
+    
+    /// Returns true if there are no entries and false otherwise
+    inline bool empty() const;
+    
+    /// Clears the backing vector. The page width is unchanged.
+    inline void clear();
+    
+    /// Returns the page width of the vector
+    inline size_t page_width() const;
+    
+    /// Re-encode the contents with the given page width, which must be one of
+    /// the compiled page widths
+    void set_page_width(size_t page_width);
+    
+    /// Estimate the number of bytes that the current contents would occupy
+    /// with the given page width, from the spread of the values in each page
+    size_t estimate_memory_usage(size_t page_width) const;
+    
+    /// Re-encode the contents with the compiled page width that is estimated
+    /// to use the least memory. Returns the chosen page width.
+    size_t tune_page_width();
+    
+    /// Reports the amount of memory consumed by this object in bytes
+    size_t memory_usage() const;
+    
+    /// Reports the memory consumed by this object and its parts, under the
+    /// given name.
+    MemoryReport memory_report(const string& name) const;
+    
+    /// The page widths that are compiled
+    constexpr static size_t NARROW_PAGE_WIDTH = 64;
+    constexpr static size_t MEDIUM_PAGE_WIDTH = 256;
+    constexpr static size_t WIDE_PAGE_WIDTH = 1024;
+    
+    /// Forward declaration
+    class cursor;
+    
+    /// Get a cursor positioned at the i-th value
+    inline cursor cursor_at(const size_t& i = 0) const;
+    
+    /*
+     * A read-only cursor with the same page caching as the PagedVector's
+     * cursor. Any modification of the vector invalidates the cursor.
+     */
+    class cursor {
+    public:
+        cursor(const cursor& other) = default;
+        cursor() = delete;
+        ~cursor() = default;
+        cursor& operator=(const cursor& other) = default;
+        
+        /// Returns the value at the current position
+        inline uint64_t operator*() const;
+        /// Move to the next position
+        inline cursor& operator++();
+        /// Move to the previous position
+        inline cursor& operator--();
+        /// Move to the i-th position
+        inline cursor& seek(const size_t& i);
+        /// Move to the i-th position and return the value there
+        inline uint64_t get(const size_t& i);
+        /// Returns the current position
+        inline size_t index() const;
+        
+    private:
+        
+        cursor(const TunablePagedVector* iteratee, size_t i);
+        
+        // the page width of the vector when the cursor was made
+        size_t width;
+        
+        // only the cursor for the current page width is used
+        typename PagedVector<NARROW_PAGE_WIDTH, Backend>::cursor narrow_cursor;
+        typename PagedVector<MEDIUM_PAGE_WIDTH, Backend>::cursor medium_cursor;
+        typename PagedVector<WIDE_PAGE_WIDTH, Backend>::cursor wide_cursor;
+        
+        friend class TunablePagedVector;
+    };
+    
+private:
+    
+    /// Throw an error if the page width is not one of the compiled widths
+    inline void check_page_width(size_t page_width) const;
+    
+    /// Estimate the memory usage of the contents if they were in a PagedVector
+    /// of the same type as the one given
+    template<size_t page_size>
+    size_t estimate_memory_usage_as(const PagedVector<page_size, Backend>& vec) const;
+    
+    /// Copy the contents into another paged vector, which must be empty
+    template<typename PagedVec>
+    void copy_into(PagedVec& vec) const;
+    
+    /// The page width in use
+    size_t width = MEDIUM_PAGE_WIDTH;
+    
+    /// Only the vector of the current page width has contents
+    PagedVector<NARROW_PAGE_WIDTH, Backend> narrow_pages;
+    PagedVector<MEDIUM_PAGE_WIDTH, Backend> medium_pages;
+    PagedVector<WIDE_PAGE_WIDTH, Backend> wide_pages;
+    
+    /// Call a function on the vector of the current page width
+    template<typename Function>
+    inline decltype(auto) apply(const Function& function) const;
+    template<typename Function>
+    inline decltype(auto) apply(const Function& function);
+};
+
+using MappedTunablePagedVector = TunablePagedVector<MappedBackend>;
+
 /*
  * A deque implementation that maintains integers in bit-compressed form, with the bit
  * width automatically adjusted to the entries.
@@ -386,6 +715,10 @@ public:
     /// Reports the amount of memory consumed by this object in bytes.
     size_t memory_usage() const;
     
+    /// Reports the memory consumed by this object and its parts, under the
+    /// given name.
+    MemoryReport memory_report(const string& name) const;
+    
 private:
     
     inline void contract();
@@ -434,6 +767,12 @@ public:
     /// Insert a value into the set. Has no effect if the value is already in the set.
     inline void insert(const uint64_t& value);
     
+    /// Insert all of the values in a range of forward iterators into the set,
+    /// resizing the table at most once. Has no effect for values that are
+    /// already in the set. Much faster than calling insert() in a loop.
+    template<typename Iterator>
+    inline void insert(Iterator begin, Iterator end);
+    
     /// Returns true if the value is in the set, else false.
     inline bool find(const uint64_t& value) const;
     
@@ -497,6 +836,14 @@ private:
     /// Move up or down to the next size in the size schedule and rehash entries
     void rehash(bool shrink);
     
+    /// Move to the given size in the size schedule and rehash entries,
+    /// encoding them relative to the given anchor
+    void rehash_to(size_t new_schedule_val, uint64_t new_anchor);
+    
+    /// Get the smallest and largest non-zero values in the table. Returns false
+    /// if there are none.
+    inline bool value_range(uint64_t& min_val, uint64_t& max_val) const;
+    
     /// Execute hash function for a given table
     inline size_t hash(const uint64_t& diff, const PackedVec& table) const;
     
@@ -530,11 +877,95 @@ private:
     /// Number of items in the set
     size_t num_items = 0;
     
+    /// The number of slots that locate() unpacks from the table at a time,
+    /// which is about a cache line at typical widths
+    constexpr static size_t PROBE_BLOCK_SIZE = 16;
+    
     /// Let the iterator access the internals
     friend class iterator;
 };
 
 using MappedPackedSet = PackedSet<MappedBackend>;
+
+/*
+ * A static vector of non-decreasing integers in Elias-Fano encoding. Each
+ * value is split into low bits, which are stored verbatim, and high bits,
+ * which are stored in unary as gaps in a bitvector, for a total of about
+ * 2 + log(max value / number of values) bits per value.
+ */
+template<typename Backend = STLBackend>
+class EliasFanoVector {
+public:
+    /// Constructor (starts empty)
+    EliasFanoVector() = default;
+    
+    /// Construct holding the given values, which must be non-decreasing
+    EliasFanoVector(const vector<uint64_t>& values);
+    
+    /// Construct from contents in a stream
+    EliasFanoVector(istream& in);
+    
+    /// Clear current contents and load from contents in a stream
+    void deserialize(istream& in);
+    
+    /// Output contents to a stream
+    void serialize(ostream& out) const;
+    
+    /// Returns the i-th value
+    inline uint64_t get(const size_t& i) const;
+    
+    /// Writes the count values starting at index begin to out. Only locates
+    /// the first of them in the high bits, so it is faster than calling get()
+    /// in a loop.
+    inline void get_range(const size_t& begin, const size_t& count, uint64_t* out) const;
+    
+    /// Returns the number of values.
+    inline size_t size() const;
+    
+    /// Returns true if there are no entries and false otherwise.
+    inline bool empty() const;
+    
+    /// Clears the contents.
+    inline void clear();
+    
+    /// Reports the amount of memory consumed by this object in bytes.
+    size_t memory_usage() const;
+    
+    /// Reports the memory consumed by this object and its parts, under the
+    /// given name.
+    MemoryReport memory_report(const string& name) const;
+    
+private:
+    
+    /// Returns the position in high_bits of the i-th set bit, and the word
+    /// that contains it with all earlier bits cleared
+    inline size_t select(const size_t& i, uint64_t& word) const;
+    
+    /// Record a select sample at every this many set bits
+    constexpr static size_t SAMPLE_RATE = 64;
+    
+    /// The number of bits in each word of high_bits, which is kept below 64
+    /// so that PackedVector can hold any word
+    constexpr static size_t WORD_WIDTH = 32;
+    
+    /// The number of values
+    size_t num_values = 0;
+    
+    /// The number of bits of each value that are stored in low_bits
+    size_t low_width = 0;
+    
+    /// The low bits of each value
+    PackedVector<Backend> low_bits;
+    
+    /// Words of a bitvector, with a set bit for the i-th value at its high
+    /// bits plus i
+    PackedVector<Backend> high_bits;
+    
+    /// The position in high_bits of every SAMPLE_RATE-th set bit
+    PackedVector<Backend> select_samples;
+};
+
+using MappedEliasFanoVector = EliasFanoVector<MappedBackend>;
     
 /// Inline and template functions
 
@@ -553,12 +984,38 @@ inline void repack<sdsl::int_vector<>>(sdsl::int_vector<>& target, size_t new_wi
     sdsl::int_vector<> tmp;
     tmp.width(new_width);
     tmp.resize(new_size);
-    for (size_t i = 0; i < new_size && i < target.size(); i++) {
-        tmp[i] = target[i];
+    // move the entries over through a buffer, a chunk at a time
+    static const size_t chunk_size = 256;
+    uint64_t buffer[chunk_size];
+    size_t to_copy = std::min<size_t>(new_size, target.size());
+    for (size_t i = 0; i < to_copy; i += chunk_size) {
+        size_t count = std::min<size_t>(to_copy - i, chunk_size);
+        unpack_int_range(target.data(), target.width(), i, count, buffer);
+        pack_int_range(tmp.data(), new_width, i, count, buffer);
     }
     target = std::move(tmp);
 }
 
+template<typename IntVector>
+inline void get_range(const IntVector& source, size_t index, size_t count, uint64_t* out) {
+    source.get_range(index, count, out);
+}
+
+template<>
+inline void get_range<sdsl::int_vector<>>(const sdsl::int_vector<>& source, size_t index, size_t count, uint64_t* out) {
+    unpack_int_range(source.data(), source.width(), index, count, out);
+}
+
+template<typename IntVector>
+inline void set_range(IntVector& target, size_t index, size_t count, const uint64_t* in) {
+    target.set_range(index, count, in);
+}
+
+template<>
+inline void set_range<sdsl::int_vector<>>(sdsl::int_vector<>& target, size_t index, size_t count, const uint64_t* in) {
+    pack_int_range(target.data(), target.width(), index, count, in);
+}
+
     
 /////////////////////
 /// PackedVector
@@ -591,6 +1048,41 @@ inline uint64_t PackedVector<Backend>::get(const size_t& i) const {
     return vec[i];
 }
 
+template<typename Backend>
+inline void PackedVector<Backend>::get_range(const size_t& begin, const size_t& count, uint64_t* out) const {
+    assert(begin + count <= filled);
+    bdsg::get_range(vec, begin, count, out);
+}
+
+template<typename Backend>
+inline void PackedVector<Backend>::set_range(const size_t& begin, const size_t& count, const uint64_t* in) {
+    assert(begin + count <= filled);
+    
+    // widen once for all the values, instead of once per value
+    uint64_t all_bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        all_bits |= in[i];
+    }
+    uint8_t width = vec.width();
+    uint64_t mask = std::numeric_limits<uint64_t>::max() << width;
+    while (mask & all_bits) {
+        width++;
+        mask = std::numeric_limits<uint64_t>::max() << width;
+    }
+    
+    if (width > vec.width()) {
+        repack(vec, width, vec.size());
+    }
+    
+    bdsg::set_range(vec, begin, count, in);
+}
+
+template<typename Backend>
+inline void PackedVector<Backend>::append_range(const size_t& count, const uint64_t* in) {
+    resize(filled + count);
+    set_range(filled - count, count, in);
+}
+
 template<typename Backend>
 inline void PackedVector<Backend>::append(const uint64_t& value) {
     resize(filled + 1);
@@ -713,6 +1205,15 @@ size_t PackedVector<Backend>::memory_usage() const {
     return sizeof(filled) + sizeof(vec) + vec.capacity() / 8;
 }
 
+template<typename Backend>
+MemoryReport PackedVector<Backend>::memory_report(const string& name) const {
+    // entries past the filled ones are there to grow into
+    MemoryReport report(name, memory_usage(), (vec.size() - filled) * vec.width() / 8);
+    report.entries = filled;
+    report.bit_width = vec.width();
+    return report;
+}
+
 /////////////////////
 /// PackedDeque
 /////////////////////
@@ -751,6 +1252,16 @@ size_t PackedDeque<Backend>::memory_usage() const {
     return sizeof(begin_idx) + sizeof(filled) + vec.memory_usage();
 }
 
+template<typename Backend>
+MemoryReport PackedDeque<Backend>::memory_report(const string& name) const {
+    MemoryReport report(name, sizeof(begin_idx) + sizeof(filled));
+    const MemoryReport& ring = report.add_child(vec.memory_report("ring"));
+    // the ring buffer is all filled as far as the vector knows
+    report.slack_bytes += (ring.entries - filled) * ring.bit_width / 8;
+    report.entries = filled;
+    return report;
+}
+
 template<typename Backend>
 inline size_t PackedDeque<Backend>::internal_index(const size_t& i) const {
     assert(i < filled);
@@ -902,6 +1413,12 @@ void PagedVector<page_size, Backend>::deserialize(istream& in) {
         throw std::runtime_error("Compiled with page size " + std::to_string(page_size) +
             " but loading vector with page size " + std::to_string(stored_page_size));
     }
+    deserialize_pages(in, filled);
+}
+
+template<size_t page_size, typename Backend>
+void PagedVector<page_size, Backend>::deserialize_pages(istream& in, size_t stored_filled) {
+    filled = stored_filled;
     anchors.deserialize(in);
     for (size_t i = 0; i < anchors.size(); i++) {
         pages.emplace_back(in);
@@ -930,6 +1447,35 @@ size_t PagedVector<page_size, Backend>::memory_usage() const {
     total += (pages.capacity() - pages.size()) * sizeof(typename decltype(pages)::value_type);
     return total;
 }
+
+template<size_t page_size, typename Backend>
+MemoryReport PagedVector<page_size, Backend>::memory_report(const string& name) const {
+    size_t excess_pages = (pages.capacity() - pages.size()) * sizeof(typename decltype(pages)::value_type);
+    MemoryReport report(name, sizeof(page_size) + sizeof(filled) + sizeof(pages) + excess_pages, excess_pages);
+    report.entries = filled;
+    report.counters["page_width"] = page_size;
+    report.add_child(anchors.memory_report("anchors"));
+    
+    // summarize the pages rather than listing them
+    MemoryReport pages_report("pages");
+    size_t max_bit_width = 0;
+    MemoryReport page_report;
+    for (const auto& page : pages) {
+        page_report = page.memory_report("page");
+        pages_report.bytes += page_report.bytes;
+        pages_report.slack_bytes += page_report.slack_bytes;
+        pages_report.entries += page_report.entries;
+        max_bit_width = std::max(max_bit_width, page_report.bit_width);
+    }
+    // the last page is allocated in full, but may not be filled (not all
+    // backends measure a page's full allocation, so don't exceed what it reports)
+    pages_report.slack_bytes += std::min((pages.size() * page_size - filled) * page_report.bit_width / 8,
+                                         page_report.bytes - page_report.slack_bytes);
+    pages_report.counters["pages"] = pages.size();
+    pages_report.counters["max_bit_width"] = max_bit_width;
+    report.add_child(pages_report);
+    return report;
+}
     
 template<size_t page_size, typename Backend>
 inline void PagedVector<page_size, Backend>::set(const size_t& i, const uint64_t& value) {
@@ -1039,26 +1585,96 @@ inline size_t PagedVector<page_size, Backend>::page_width() const {
 }
     
 template<size_t page_size, typename Backend>
-inline uint64_t PagedVector<page_size, Backend>::to_diff(const uint64_t& value, const uint64_t& anchor) const {
-    // leaves 0 unchanged, encodes other values as a difference from the anchor value
-    // with a reversible mapping into the positive integers as follows:
-    // difference  0  1  2  3 -1  4  5  6  7 -2  8  9 10 11 -3 ...
-    // integer     1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 ...
-    // the goal here is use smaller integers to maintain low bit-width, allowing 0 as
-    // a sentinel. the bijection is biased to encode positive differences as smaller bit-
-    // width integers since anchors are taken from the beginning of their page in the
-    // vector and we expect most vectors to be mostly increasing
-    
-    if (value == 0) {
-        return 0;
-    }
-    else if (value >= anchor) {
-        uint64_t raw_diff = value - anchor;
-        return raw_diff + raw_diff / 4 + 1;
-    }
-    else {
-        return 5 * (anchor - value);
-    }
+inline typename PagedVector<page_size, Backend>::cursor PagedVector<page_size, Backend>::cursor_at(const size_t& i) const {
+    return cursor(this, i);
+}
+
+template<size_t page_size, typename Backend>
+PagedVector<page_size, Backend>::cursor::cursor(const PagedVector* iteratee, size_t i) : iteratee(iteratee), i(i) {
+    // the buffer is filled lazily, since the cursor might never be read
+}
+
+template<size_t page_size, typename Backend>
+inline void PagedVector<page_size, Backend>::cursor::decode_block() const {
+    size_t page = i / page_size;
+    if (page != buffered_page) {
+        buffered_page = page;
+        buffered_anchor = iteratee->anchors.get(page);
+    }
+    // unpack the block at once and then undo the difference from the anchor
+    size_t page_begin = page * page_size;
+    size_t offset = ((i - page_begin) / BLOCK_SIZE) * BLOCK_SIZE;
+    buffer_begin = page_begin + offset;
+    size_t count = page_size - offset < BLOCK_SIZE ? page_size - offset : BLOCK_SIZE;
+    if (iteratee->filled - buffer_begin < count) {
+        count = iteratee->filled - buffer_begin;
+    }
+    buffer_end = buffer_begin + count;
+    iteratee->pages[page].get_range(offset, count, buffer);
+    for (size_t j = 0; j < count; ++j) {
+        buffer[j] = iteratee->from_diff(buffer[j], buffered_anchor);
+    }
+}
+
+template<size_t page_size, typename Backend>
+inline uint64_t PagedVector<page_size, Backend>::cursor::operator*() const {
+    assert(i < iteratee->filled);
+    if (i < buffer_begin || i >= buffer_end) {
+        decode_block();
+    }
+    return buffer[i - buffer_begin];
+}
+
+template<size_t page_size, typename Backend>
+inline typename PagedVector<page_size, Backend>::cursor& PagedVector<page_size, Backend>::cursor::operator++() {
+    ++i;
+    return *this;
+}
+
+template<size_t page_size, typename Backend>
+inline typename PagedVector<page_size, Backend>::cursor& PagedVector<page_size, Backend>::cursor::operator--() {
+    --i;
+    return *this;
+}
+
+template<size_t page_size, typename Backend>
+inline typename PagedVector<page_size, Backend>::cursor& PagedVector<page_size, Backend>::cursor::seek(const size_t& i) {
+    this->i = i;
+    return *this;
+}
+
+template<size_t page_size, typename Backend>
+inline uint64_t PagedVector<page_size, Backend>::cursor::get(const size_t& i) {
+    this->i = i;
+    return **this;
+}
+
+template<size_t page_size, typename Backend>
+inline size_t PagedVector<page_size, Backend>::cursor::index() const {
+    return i;
+}
+    
+template<size_t page_size, typename Backend>
+inline uint64_t PagedVector<page_size, Backend>::to_diff(const uint64_t& value, const uint64_t& anchor) const {
+    // leaves 0 unchanged, encodes other values as a difference from the anchor value
+    // with a reversible mapping into the positive integers as follows:
+    // difference  0  1  2  3 -1  4  5  6  7 -2  8  9 10 11 -3 ...
+    // integer     1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 ...
+    // the goal here is use smaller integers to maintain low bit-width, allowing 0 as
+    // a sentinel. the bijection is biased to encode positive differences as smaller bit-
+    // width integers since anchors are taken from the beginning of their page in the
+    // vector and we expect most vectors to be mostly increasing
+    
+    if (value == 0) {
+        return 0;
+    }
+    else if (value >= anchor) {
+        uint64_t raw_diff = value - anchor;
+        return raw_diff + raw_diff / 4 + 1;
+    }
+    else {
+        return 5 * (anchor - value);
+    }
 }
 
 template<size_t page_size, typename Backend>
@@ -1112,6 +1728,15 @@ size_t RobustPagedVector<page_size, Backend>::memory_usage() const {
     return first_page.memory_usage() + latter_pages.memory_usage();
 }
 
+template<size_t page_size, typename Backend>
+MemoryReport RobustPagedVector<page_size, Backend>::memory_report(const string& name) const {
+    MemoryReport report(name);
+    report.entries = size();
+    report.add_child(first_page.memory_report("first_page"));
+    report.add_child(latter_pages.memory_report("latter_pages"));
+    return report;
+}
+
 template<size_t page_size, typename Backend>
 inline void RobustPagedVector<page_size, Backend>::set(const size_t& i, const uint64_t& value) {
     if (i < latter_pages.page_width()) {
@@ -1202,6 +1827,386 @@ inline size_t RobustPagedVector<page_size, Backend>::page_width() const {
     return latter_pages.page_width();
 }
 
+template<size_t page_size, typename Backend>
+inline typename RobustPagedVector<page_size, Backend>::cursor RobustPagedVector<page_size, Backend>::cursor_at(const size_t& i) const {
+    return cursor(this, i);
+}
+
+template<size_t page_size, typename Backend>
+RobustPagedVector<page_size, Backend>::cursor::cursor(const RobustPagedVector* iteratee, size_t i) :
+    iteratee(iteratee), i(i), latter_cursor(iteratee->latter_pages.cursor_at(i < page_size ? 0 : i - page_size)) {
+    // nothing to do
+}
+
+template<size_t page_size, typename Backend>
+inline uint64_t RobustPagedVector<page_size, Backend>::cursor::operator*() const {
+    if (i < page_size) {
+        // the first page isn't difference-encoded, so there's nothing to cache
+        return iteratee->first_page.get(i);
+    }
+    else {
+        return *latter_cursor;
+    }
+}
+
+template<size_t page_size, typename Backend>
+inline typename RobustPagedVector<page_size, Backend>::cursor& RobustPagedVector<page_size, Backend>::cursor::operator++() {
+    return seek(i + 1);
+}
+
+template<size_t page_size, typename Backend>
+inline typename RobustPagedVector<page_size, Backend>::cursor& RobustPagedVector<page_size, Backend>::cursor::operator--() {
+    return seek(i - 1);
+}
+
+template<size_t page_size, typename Backend>
+inline typename RobustPagedVector<page_size, Backend>::cursor& RobustPagedVector<page_size, Backend>::cursor::seek(const size_t& i) {
+    this->i = i;
+    if (i >= page_size) {
+        latter_cursor.seek(i - page_size);
+    }
+    return *this;
+}
+
+template<size_t page_size, typename Backend>
+inline uint64_t RobustPagedVector<page_size, Backend>::cursor::get(const size_t& i) {
+    return *seek(i);
+}
+
+template<size_t page_size, typename Backend>
+inline size_t RobustPagedVector<page_size, Backend>::cursor::index() const {
+    return i;
+}
+
+/////////////////////
+/// TunablePagedVector
+/////////////////////
+
+template<typename Backend>
+TunablePagedVector<Backend>::TunablePagedVector(size_t page_width) : width(page_width) {
+    check_page_width(page_width);
+}
+
+template<typename Backend>
+TunablePagedVector<Backend>::TunablePagedVector(istream& in) {
+    deserialize(in);
+}
+
+template<typename Backend>
+void TunablePagedVector<Backend>::deserialize(istream& in) {
+    // the header of the PagedVector records its page width
+    size_t stored_filled;
+    size_t stored_page_size;
+    sdsl::read_member(stored_filled, in);
+    sdsl::read_member(stored_page_size, in);
+    check_page_width(stored_page_size);
+    clear();
+    width = stored_page_size;
+    apply([&](auto& vec) {
+        vec.deserialize_pages(in, stored_filled);
+    });
+}
+
+template<typename Backend>
+void TunablePagedVector<Backend>::serialize(ostream& out) const {
+    apply([&](const auto& vec) {
+        vec.serialize(out);
+    });
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::check_page_width(size_t page_width) const {
+    if (page_width != NARROW_PAGE_WIDTH && page_width != MEDIUM_PAGE_WIDTH && page_width != WIDE_PAGE_WIDTH) {
+        throw std::runtime_error("Page size " + std::to_string(page_width) + " is not one of the compiled page sizes");
+    }
+}
+
+template<typename Backend>
+template<typename Function>
+inline decltype(auto) TunablePagedVector<Backend>::apply(const Function& function) const {
+    switch (width) {
+        case NARROW_PAGE_WIDTH:
+            return function(narrow_pages);
+        case WIDE_PAGE_WIDTH:
+            return function(wide_pages);
+        default:
+            return function(medium_pages);
+    }
+}
+
+template<typename Backend>
+template<typename Function>
+inline decltype(auto) TunablePagedVector<Backend>::apply(const Function& function) {
+    switch (width) {
+        case NARROW_PAGE_WIDTH:
+            return function(narrow_pages);
+        case WIDE_PAGE_WIDTH:
+            return function(wide_pages);
+        default:
+            return function(medium_pages);
+    }
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::set(const size_t& i, const uint64_t& value) {
+    apply([&](auto& vec) {
+        vec.set(i, value);
+    });
+}
+
+template<typename Backend>
+inline uint64_t TunablePagedVector<Backend>::get(const size_t& i) const {
+    return apply([&](const auto& vec) {
+        return vec.get(i);
+    });
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::append(const uint64_t& value) {
+    apply([&](auto& vec) {
+        vec.append(value);
+    });
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::pop() {
+    apply([&](auto& vec) {
+        vec.pop();
+    });
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::resize(const size_t& new_size) {
+    apply([&](auto& vec) {
+        vec.resize(new_size);
+    });
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::reserve(const size_t& future_size) {
+    apply([&](auto& vec) {
+        vec.reserve(future_size);
+    });
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::shrink_to_fit() {
+    apply([&](auto& vec) {
+        vec.shrink_to_fit();
+    });
+}
+
+template<typename Backend>
+inline size_t TunablePagedVector<Backend>::size() const {
+    return apply([&](const auto& vec) {
+        return vec.size();
+    });
+}
+
+template<typename Backend>
+inline bool TunablePagedVector<Backend>::empty() const {
+    return size() == 0;
+}
+
+template<typename Backend>
+inline void TunablePagedVector<Backend>::clear() {
+    apply([&](auto& vec) {
+        vec.clear();
+    });
+}
+
+template<typename Backend>
+inline size_t TunablePagedVector<Backend>::page_width() const {
+    return width;
+}
+
+template<typename Backend>
+size_t TunablePagedVector<Backend>::memory_usage() const {
+    return sizeof(width) + narrow_pages.memory_usage() + medium_pages.memory_usage() + wide_pages.memory_usage();
+}
+
+template<typename Backend>
+MemoryReport TunablePagedVector<Backend>::memory_report(const string& name) const {
+    // only the vector of the current width holds anything, but the others
+    // still take up a little space
+    MemoryReport report(name, sizeof(width) + narrow_pages.memory_usage()
+                        + medium_pages.memory_usage() + wide_pages.memory_usage());
+    report.entries = size();
+    report.counters["page_width"] = width;
+    MemoryReport pages_report = apply([&](const auto& vec) {
+        return vec.memory_report("pages");
+    });
+    report.bytes -= pages_report.bytes;
+    report.add_child(pages_report);
+    return report;
+}
+
+template<typename Backend>
+template<typename PagedVec>
+void TunablePagedVector<Backend>::copy_into(PagedVec& vec) const {
+    vec.reserve(size());
+    auto values = cursor_at();
+    for (size_t i = 0; i < size(); ++i, ++values) {
+        vec.append(*values);
+    }
+}
+
+template<typename Backend>
+void TunablePagedVector<Backend>::set_page_width(size_t page_width) {
+    check_page_width(page_width);
+    if (page_width != width) {
+        TunablePagedVector repaged(page_width);
+        repaged.apply([&](auto& vec) {
+            copy_into(vec);
+        });
+        *this = std::move(repaged);
+    }
+}
+
+template<typename Backend>
+template<size_t page_size>
+size_t TunablePagedVector<Backend>::estimate_memory_usage_as(const PagedVector<page_size, Backend>& vec) const {
+    
+    auto bit_width = [](uint64_t value) {
+        // packed vectors are never narrower than 1 bit
+        size_t bits = 1;
+        while (bits < 64 && (value >> bits) != 0) {
+            ++bits;
+        }
+        return bits;
+    };
+    auto word_bytes = [](size_t bits) {
+        return sizeof(uint64_t) * ((bits + 63) / 64);
+    };
+    
+    // each page gets the bit width of its largest difference from its anchor,
+    // which is the first value that is set in it
+    size_t num_pages = 0;
+    size_t page_bytes = 0;
+    uint64_t max_anchor = 0;
+    uint64_t anchor = 0;
+    uint64_t max_diff = 0;
+    auto values = cursor_at();
+    for (size_t i = 0; i < size(); ++i, ++values) {
+        if (i % page_size == 0) {
+            if (i != 0) {
+                page_bytes += word_bytes(page_size * bit_width(max_diff));
+            }
+            ++num_pages;
+            anchor = 0;
+            max_diff = 0;
+        }
+        uint64_t value = *values;
+        if (anchor == 0) {
+            anchor = value;
+            max_anchor = max(max_anchor, anchor);
+        }
+        max_diff = max(max_diff, vec.to_diff(value, anchor));
+    }
+    if (num_pages != 0) {
+        page_bytes += word_bytes(page_size * bit_width(max_diff));
+    }
+    
+    // add the fixed overhead of the vectors and of each page
+    return sizeof(vec) + num_pages * sizeof(PackedVector<Backend>) + page_bytes + word_bytes(num_pages * bit_width(max_anchor));
+}
+
+template<typename Backend>
+size_t TunablePagedVector<Backend>::estimate_memory_usage(size_t page_width) const {
+    check_page_width(page_width);
+    switch (page_width) {
+        case NARROW_PAGE_WIDTH:
+            return estimate_memory_usage_as(narrow_pages);
+        case WIDE_PAGE_WIDTH:
+            return estimate_memory_usage_as(wide_pages);
+        default:
+            return estimate_memory_usage_as(medium_pages);
+    }
+}
+
+template<typename Backend>
+size_t TunablePagedVector<Backend>::tune_page_width() {
+    // prefer wider pages when it's a tie, since they have fewer pages to look up
+    size_t best_width = WIDE_PAGE_WIDTH;
+    size_t best_usage = estimate_memory_usage(WIDE_PAGE_WIDTH);
+    for (size_t page_width : {MEDIUM_PAGE_WIDTH, NARROW_PAGE_WIDTH}) {
+        size_t usage = estimate_memory_usage(page_width);
+        if (usage < best_usage) {
+            best_width = page_width;
+            best_usage = usage;
+        }
+    }
+    set_page_width(best_width);
+    return best_width;
+}
+
+template<typename Backend>
+inline typename TunablePagedVector<Backend>::cursor TunablePagedVector<Backend>::cursor_at(const size_t& i) const {
+    return cursor(this, i);
+}
+
+template<typename Backend>
+TunablePagedVector<Backend>::cursor::cursor(const TunablePagedVector* iteratee, size_t i) :
+    width(iteratee->width), narrow_cursor(iteratee->narrow_pages.cursor_at(i)),
+    medium_cursor(iteratee->medium_pages.cursor_at(i)), wide_cursor(iteratee->wide_pages.cursor_at(i)) {
+    // nothing to do
+}
+
+template<typename Backend>
+inline uint64_t TunablePagedVector<Backend>::cursor::operator*() const {
+    switch (width) {
+        case NARROW_PAGE_WIDTH:
+            return *narrow_cursor;
+        case WIDE_PAGE_WIDTH:
+            return *wide_cursor;
+        default:
+            return *medium_cursor;
+    }
+}
+
+template<typename Backend>
+inline typename TunablePagedVector<Backend>::cursor& TunablePagedVector<Backend>::cursor::operator++() {
+    return seek(index() + 1);
+}
+
+template<typename Backend>
+inline typename TunablePagedVector<Backend>::cursor& TunablePagedVector<Backend>::cursor::operator--() {
+    return seek(index() - 1);
+}
+
+template<typename Backend>
+inline typename TunablePagedVector<Backend>::cursor& TunablePagedVector<Backend>::cursor::seek(const size_t& i) {
+    switch (width) {
+        case NARROW_PAGE_WIDTH:
+            narrow_cursor.seek(i);
+            break;
+        case WIDE_PAGE_WIDTH:
+            wide_cursor.seek(i);
+            break;
+        default:
+            medium_cursor.seek(i);
+            break;
+    }
+    return *this;
+}
+
+template<typename Backend>
+inline uint64_t TunablePagedVector<Backend>::cursor::get(const size_t& i) {
+    return *seek(i);
+}
+
+template<typename Backend>
+inline size_t TunablePagedVector<Backend>::cursor::index() const {
+    switch (width) {
+        case NARROW_PAGE_WIDTH:
+            return narrow_cursor.index();
+        case WIDE_PAGE_WIDTH:
+            return wide_cursor.index();
+        default:
+            return medium_cursor.index();
+    }
+}
+
 /////////////////////
 /// PackedSet
 /////////////////////
@@ -1306,13 +2311,12 @@ bool PackedSet<Backend>::iterator::operator!=(const PackedSet<Backend>::iterator
 template<typename Backend>
 inline size_t PackedSet<Backend>::hash(const uint64_t& diff, const PackedVec& _table) const {
     // do a degree-4 mod polynomial with random coefficients, which is a 5-wise
-    // independent hash function
+    // independent hash function, evaluated by Horner's rule
     size_t p = _table.size();
-    size_t x = 1;
-    size_t hsh = 0;
-    for (size_t i = 0; i < 5; ++i) {
-        hsh = (hsh + ((coefs[i] * x) % p)) % p;
-        x = (x * diff) % p;
+    size_t x = diff % p;
+    size_t hsh = coefs[4];
+    for (size_t i = 4; i > 0; --i) {
+        hsh = (hsh * x + coefs[i - 1]) % p;
     }
     return hsh;
 }
@@ -1353,9 +2357,10 @@ inline uint64_t PackedSet<Backend>::from_diff(const uint64_t& diff, const uint64
 }
 
 template<typename Backend>
-inline uint64_t PackedSet<Backend>::optimal_anchor() const {
-    uint64_t min_val = numeric_limits<uint64_t>::max();
-    uint64_t max_val = numeric_limits<uint64_t>::min();
+inline bool PackedSet<Backend>::value_range(uint64_t& min_val, uint64_t& max_val) const {
+    min_val = numeric_limits<uint64_t>::max();
+    max_val = numeric_limits<uint64_t>::min();
+    bool found = false;
     for (size_t i = 0; i < table.size(); ++i) {
         uint64_t diff = table.get(i);
         if (diff >= 2) {
@@ -1363,9 +2368,16 @@ inline uint64_t PackedSet<Backend>::optimal_anchor() const {
             uint64_t val = from_diff(diff, anchor);
             min_val = min(min_val, val);
             max_val = max(max_val, val);
+            found = true;
         }
     }
-    return min_val == numeric_limits<uint64_t>::max() ? (uint64_t)anchor : (max_val + min_val) / 2;
+    return found;
+}
+
+template<typename Backend>
+inline uint64_t PackedSet<Backend>::optimal_anchor() const {
+    uint64_t min_val, max_val;
+    return value_range(min_val, max_val) ? min_val + (max_val - min_val) / 2 : (uint64_t)anchor;
 }
 
 template<typename Backend>
@@ -1383,7 +2395,13 @@ inline void PackedSet<Backend>::rehash(bool shrink) {
     }
     
     // find the value that will be the best anchor to the current entries
-    uint64_t new_anchor = optimal_anchor();
+    rehash_to(schedule_val, optimal_anchor());
+}
+
+template<typename Backend>
+inline void PackedSet<Backend>::rehash_to(size_t new_schedule_val, uint64_t new_anchor) {
+    
+    schedule_val = new_schedule_val;
     PackedVec new_table;
     new_table.resize(bdsg_packed_set_size_schedule[schedule_val]);
     
@@ -1412,13 +2430,22 @@ inline void PackedSet<Backend>::rehash(bool shrink) {
 
 template<typename Backend>
 inline size_t PackedSet<Backend>::locate(const uint64_t& diff, const PackedVec& _table) const {
-    // linear probing until finding the diff or a null sentinel
+    // linear probing until finding the diff or a null sentinel, unpacking a
+    // block of slots at a time instead of decoding each probe separately
     size_t p = _table.size();
     size_t i = hash(diff, _table);
-    while (_table.get(i) != 0 && _table.get(i) != diff) {
-        i = (i + 1) % p;
+    uint64_t slots[PROBE_BLOCK_SIZE];
+    while (true) {
+        size_t block_size = p - i < PROBE_BLOCK_SIZE ? p - i : PROBE_BLOCK_SIZE;
+        _table.get_range(i, block_size, slots);
+        for (size_t j = 0; j < block_size; ++j) {
+            if (slots[j] == 0 || slots[j] == diff) {
+                return i + j;
+            }
+        }
+        // wrap around to the start of the table if we ran off the end
+        i = (i + block_size) % p;
     }
-    return i;
 }
 
 template<typename Backend>
@@ -1448,6 +2475,66 @@ inline void PackedSet<Backend>::insert(const uint64_t& value) {
     }
 }
 
+template<typename Backend>
+template<typename Iterator>
+inline void PackedSet<Backend>::insert(Iterator begin, Iterator end) {
+    
+    // find the range of the new values and the most that we could add
+    size_t max_new_items = 0;
+    uint64_t min_val = numeric_limits<uint64_t>::max();
+    uint64_t max_val = numeric_limits<uint64_t>::min();
+    for (Iterator it = begin; it != end; ++it) {
+        ++max_new_items;
+        if (*it != 0) {
+            min_val = min<uint64_t>(min_val, *it);
+            max_val = max<uint64_t>(max_val, *it);
+        }
+    }
+    if (max_new_items == 0) {
+        return;
+    }
+    
+    // find the size that can hold all of the new values without exceeding the max load
+    size_t new_schedule_val = schedule_val;
+    while (num_items + max_new_items >= max_load * bdsg_packed_set_size_schedule[new_schedule_val]) {
+        ++new_schedule_val;
+    }
+    if (new_schedule_val != schedule_val) {
+        // jump straight to that size, anchoring at the middle of the combined values
+        uint64_t old_min_val, old_max_val;
+        if (value_range(old_min_val, old_max_val)) {
+            min_val = min(min_val, old_min_val);
+            max_val = max(max_val, old_max_val);
+        }
+        rehash_to(new_schedule_val, min_val <= max_val ? min_val + (max_val - min_val) / 2 : anchor);
+    }
+    else if (anchor == 0 && min_val <= max_val) {
+        // an anchor of 0 means that the table holds nothing that depends on it
+        anchor = min_val + (max_val - min_val) / 2;
+    }
+    
+    for (Iterator it = begin; it != end; ++it) {
+        uint64_t diff = to_diff(*it, anchor);
+        size_t i = locate(diff, table);
+        if (table.get(i) == 0) {
+            table.set(i, diff);
+            ++num_items;
+        }
+    }
+    
+    if (schedule_val != 0 && num_items <= min_load * table.size()) {
+        // there were enough duplicates that we overshot, so shrink back down to
+        // the smallest size that stays under the max load
+        new_schedule_val = 0;
+        while (num_items + 1 >= max_load * bdsg_packed_set_size_schedule[new_schedule_val]) {
+            ++new_schedule_val;
+        }
+        if (new_schedule_val < schedule_val) {
+            rehash_to(new_schedule_val, optimal_anchor());
+        }
+    }
+}
+
 template<typename Backend>
 inline bool PackedSet<Backend>::find(const uint64_t& value) const {
     return table.get(locate(to_diff(value, anchor), table)) != 0;
@@ -1541,6 +2628,155 @@ template<typename Backend>
 inline bool PackedSet<Backend>::empty() const {
     return num_items == 0;
 }
+
+/////////////////////
+/// EliasFanoVector
+/////////////////////
+
+template<typename Backend>
+EliasFanoVector<Backend>::EliasFanoVector(const vector<uint64_t>& values) : num_values(values.size()) {
+    if (values.empty()) {
+        return;
+    }
+    
+    // choose the split that minimizes the total size
+    uint64_t universe = values.back() + 1;
+    while ((universe >> (low_width + 1)) >= num_values) {
+        ++low_width;
+    }
+    
+    if (low_width != 0) {
+        uint64_t low_mask = std::numeric_limits<uint64_t>::max() >> (std::numeric_limits<uint64_t>::digits - low_width);
+        low_bits.resize(num_values);
+        for (size_t i = 0; i < num_values; ++i) {
+            low_bits.set(i, values[i] & low_mask);
+        }
+    }
+    
+    vector<uint64_t> words(((values.back() >> low_width) + num_values) / WORD_WIDTH + 1, 0);
+    select_samples.resize((num_values - 1) / SAMPLE_RATE + 1);
+    for (size_t i = 0; i < num_values; ++i) {
+        assert(i == 0 || values[i - 1] <= values[i]);
+        size_t pos = (values[i] >> low_width) + i;
+        words[pos / WORD_WIDTH] |= uint64_t(1) << (pos % WORD_WIDTH);
+        if (i % SAMPLE_RATE == 0) {
+            select_samples.set(i / SAMPLE_RATE, pos);
+        }
+    }
+    high_bits.append_range(words.size(), words.data());
+    
+    low_bits.shrink_to_fit();
+    high_bits.shrink_to_fit();
+    select_samples.shrink_to_fit();
+}
+
+template<typename Backend>
+EliasFanoVector<Backend>::EliasFanoVector(istream& in) {
+    deserialize(in);
+}
+
+template<typename Backend>
+void EliasFanoVector<Backend>::deserialize(istream& in) {
+    sdsl::read_member(num_values, in);
+    sdsl::read_member(low_width, in);
+    low_bits.deserialize(in);
+    high_bits.deserialize(in);
+    select_samples.deserialize(in);
+}
+
+template<typename Backend>
+void EliasFanoVector<Backend>::serialize(ostream& out) const {
+    sdsl::write_member(num_values, out);
+    sdsl::write_member(low_width, out);
+    low_bits.serialize(out);
+    high_bits.serialize(out);
+    select_samples.serialize(out);
+}
+
+template<typename Backend>
+inline size_t EliasFanoVector<Backend>::select(const size_t& i, uint64_t& word) const {
+    // jump to the nearest sample and count set bits forward from there
+    size_t pos = select_samples.get(i / SAMPLE_RATE);
+    size_t remaining = i % SAMPLE_RATE;
+    size_t w = pos / WORD_WIDTH;
+    word = high_bits.get(w) & (std::numeric_limits<uint64_t>::max() << (pos % WORD_WIDTH));
+    size_t count = __builtin_popcountll(word);
+    while (remaining >= count) {
+        remaining -= count;
+        word = high_bits.get(++w);
+        count = __builtin_popcountll(word);
+    }
+    for (; remaining > 0; --remaining) {
+        word &= word - 1;
+    }
+    return w * WORD_WIDTH + __builtin_ctzll(word);
+}
+
+template<typename Backend>
+inline uint64_t EliasFanoVector<Backend>::get(const size_t& i) const {
+    assert(i < num_values);
+    uint64_t word;
+    uint64_t high = select(i, word) - i;
+    return (high << low_width) | (low_width ? low_bits.get(i) : 0);
+}
+
+template<typename Backend>
+inline void EliasFanoVector<Backend>::get_range(const size_t& begin, const size_t& count, uint64_t* out) const {
+    assert(begin + count <= num_values);
+    if (count == 0) {
+        return;
+    }
+    uint64_t word;
+    size_t pos = select(begin, word);
+    size_t w = pos / WORD_WIDTH;
+    for (size_t i = 0; i < count; ++i) {
+        if (i != 0) {
+            // move to the next set bit
+            word &= word - 1;
+            while (word == 0) {
+                word = high_bits.get(++w);
+            }
+            pos = w * WORD_WIDTH + __builtin_ctzll(word);
+        }
+        out[i] = (uint64_t(pos - begin - i) << low_width) | (low_width ? low_bits.get(begin + i) : 0);
+    }
+}
+
+template<typename Backend>
+inline size_t EliasFanoVector<Backend>::size() const {
+    return num_values;
+}
+
+template<typename Backend>
+inline bool EliasFanoVector<Backend>::empty() const {
+    return num_values == 0;
+}
+
+template<typename Backend>
+inline void EliasFanoVector<Backend>::clear() {
+    num_values = 0;
+    low_width = 0;
+    low_bits.clear();
+    high_bits.clear();
+    select_samples.clear();
+}
+
+template<typename Backend>
+size_t EliasFanoVector<Backend>::memory_usage() const {
+    return sizeof(num_values) + sizeof(low_width) + low_bits.memory_usage()
+        + high_bits.memory_usage() + select_samples.memory_usage();
+}
+
+template<typename Backend>
+MemoryReport EliasFanoVector<Backend>::memory_report(const string& name) const {
+    MemoryReport report(name, sizeof(num_values) + sizeof(low_width));
+    report.entries = num_values;
+    report.counters["low_width"] = low_width;
+    report.add_child(low_bits.memory_report("low_bits"));
+    report.add_child(high_bits.memory_report("high_bits"));
+    report.add_child(select_samples.memory_report("select_samples"));
+    return report;
+}
     
 }
 
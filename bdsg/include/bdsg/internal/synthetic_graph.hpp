@@ -0,0 +1,63 @@
+#ifndef BDSG_SYNTHETIC_GRAPH_HPP_INCLUDED
+#define BDSG_SYNTHETIC_GRAPH_HPP_INCLUDED
+
+/**
+ * \file synthetic_graph.hpp
+ *
+ * Defines a seeded generator for synthetic pangenome graphs, for use in
+ * benchmarks and scaling tests.
+ */
+
+#include <handlegraph/mutable_path_mutable_handle_graph.hpp>
+
+#include <cstdint>
+
+namespace bdsg {
+
+using namespace std;
+using namespace handlegraph;
+
+/**
+ * Parameters that control the shape of a synthetic pangenome graph.
+ */
+struct SyntheticGraphParams {
+    /// Seed for all random choices. The same seed and parameters always
+    /// produce the same sequence of graph operations.
+    uint64_t seed = 1;
+    /// Stop extending the backbone once this many nodes have been made.
+    size_t node_count = 1000;
+    /// Probability that a backbone node is followed by a bubble, and the
+    /// probability of each additional nested bubble inside an allele.
+    double bubble_density = 0.3;
+    /// Maximum depth of nested bubbles. 0 makes a linear graph, 1 makes only
+    /// top-level bubbles.
+    size_t nesting_depth = 2;
+    /// Probability that a bubble also allows its first allele to be traversed
+    /// in reverse, creating reversing edges.
+    double inversion_rate = 0.05;
+    /// Number of alleles in each bubble.
+    size_t allele_count = 2;
+    /// Number of haplotype paths, which choose alleles at random.
+    size_t haplotype_count = 4;
+    /// Whether to also make a reference path that takes the first allele of
+    /// every bubble in the forward orientation.
+    bool include_reference = true;
+    /// Range of node sequence lengths.
+    size_t min_node_length = 1;
+    size_t max_node_length = 32;
+};
+
+/**
+ * Fill the given graph with a chain of (possibly nested and inverted) bubbles
+ * and thread haplotype paths through it, according to the given parameters.
+ * Works with any backend. Sites are generated and threaded one at a time, so
+ * memory use beyond the graph itself does not grow with the graph size.
+ *
+ * The reference path is named "ref" and the haplotype paths are named
+ * "haplotype0", "haplotype1", and so on.
+ */
+void generate_synthetic_graph(MutablePathMutableHandleGraph* graph, const SyntheticGraphParams& params);
+
+}
+
+#endif
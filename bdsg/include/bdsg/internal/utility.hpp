@@ -5,6 +5,10 @@
 #include <sstream>
 #include <iomanip>
 #include <functional>
+#include <streambuf>
+#include <map>
+#include <tuple>
+#include <vector>
 
 namespace bdsg {
 
@@ -56,10 +60,95 @@ inline char int_as_dna(int i) {
 // Convert a quantity in bytes to a human-friendly string
 string format_memory(size_t s);
 
+/**
+ * A tree of measurements of the memory used by a data structure. Each node
+ * describes one named member, and its children describe the members it is
+ * made of. The byte counts of a node include those of its children.
+ */
+struct MemoryReport {
+    
+    MemoryReport() = default;
+    MemoryReport(const string& name, size_t bytes = 0, size_t slack_bytes = 0);
+    
+    /// The name of the member
+    string name;
+    /// Bytes used, including allocated capacity that is not in use
+    size_t bytes = 0;
+    /// Bytes of allocated capacity that are not in use
+    size_t slack_bytes = 0;
+    /// The number of entries, if the member is a container
+    size_t entries = 0;
+    /// The width in bits of the entries, if they are bit-packed at a single
+    /// width, or else 0
+    size_t bit_width = 0;
+    /// Other measurements, such as counts of deleted records
+    map<string, size_t> counters;
+    /// The members this member is made of
+    vector<MemoryReport> children;
+    
+    /// Add a child, and add its bytes and slack to ours. Returns a reference
+    /// to the added child, which is invalidated by adding another.
+    MemoryReport& add_child(const MemoryReport& child);
+    
+    /// Record the usage of a chain of mapped memory, as returned by
+    /// yomo::Manager::get_usage(), in the counters
+    void add_mapped_usage(const tuple<size_t, size_t, size_t>& total_free_reclaimable);
+    
+    /// Find a descendant by the names on the path to it, separated by "/".
+    /// Returns nullptr if there is no such descendant.
+    const MemoryReport* find(const string& path) const;
+    
+    /// Call the iteratee with this node and each of its descendants, in
+    /// preorder, along with the "/"-separated names of the path to them
+    /// starting with this node's name
+    void for_each_node(const function<void(const string&, const MemoryReport&)>& iteratee) const;
+    
+    /// Print the tree, one member per line, indented by depth
+    void print(ostream& out, size_t depth = 0) const;
+};
+
 /// Return the number of threads that OMP will produce for a parallel section.
 /// TODO: Assumes that this is the same for every parallel section.
 int get_thread_count(void);
 
+/// A read-only stream buffer over a range of memory that is owned elsewhere.
+/// Lets serialized data that is already in memory (or memory-mapped) be read
+/// through an istream without copying it.
+class MemoryStreamBuffer : public std::streambuf {
+public:
+    MemoryStreamBuffer(const char* data, size_t size);
+    
+    /// Get the address of the next unread byte
+    const char* position() const;
+    /// Get the number of bytes that have not been read yet
+    size_t remaining() const;
+    /// Skip over the given number of unread bytes
+    void advance(size_t bytes);
+    
+protected:
+    pos_type seekoff(off_type off, ios_base::seekdir dir,
+                     ios_base::openmode which = ios_base::in) override;
+    pos_type seekpos(pos_type pos, ios_base::openmode which = ios_base::in) override;
+};
+
+/// A write-only stream buffer that throws away what is written to it and
+/// just counts the bytes. Lets the size of serialized data be found without
+/// holding onto it.
+class CountingStreamBuffer : public std::streambuf {
+public:
+    /// Get the number of bytes that have been written
+    size_t count() const;
+    
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize size) override;
+    pos_type seekoff(off_type off, ios_base::seekdir dir,
+                     ios_base::openmode which = ios_base::out) override;
+    
+private:
+    size_t written = 0;
+};
+
 }
 
 #endif
@@ -13,6 +13,7 @@
 #include <handlegraph/path_position_handle_graph.hpp>
 #include <handlegraph/expanding_overlay_graph.hpp>
 #include <handlegraph/util.hpp>
+#include <handlegraph/trivially_serializable.hpp>
 #include <BooPHF.h>
 
 #include "bdsg/internal/hash_map.hpp"
@@ -226,6 +227,14 @@ public:
      */
     handle_t get_underlying_handle(const handle_t& handle) const;
     
+    ////////////////////////////////////////////////////////////////////////////
+    // Instrumentation
+    ////////////////////////////////////////////////////////////////////////////
+    
+    /// Measure the memory used by the position indexes, as a tree with a node
+    /// for each index and its members
+    virtual MemoryReport memory_report() const;
+    
 protected:
     
     
@@ -293,6 +302,169 @@ protected:
     hash_map<int64_t, PathRange> path_range;
 };
 
+/*
+ * A PackedPositionOverlay that keeps its index in memory that can be mapped to
+ * and from a file, so the index can be built once, saved next to the graph,
+ * and loaded without any rebuilding.
+ *
+ * The saved index does not include the graph. After loading, set_graph() must
+ * be called with the graph the index was built on, and that graph's path and
+ * step handles must be the same as when the index was built. PackedGraph and
+ * MappedPackedGraph keep their handles through serialization; HashGraph does
+ * not.
+ */
+class MappedPackedPositionOverlay : public PackedPositionOverlay, public TriviallySerializable {
+        
+public:
+    
+    /// Make a new MappedPackedPositionOverlay, on the given graph. Glom short
+    /// paths together to make internal indexes each over at least the given
+    /// number of steps.
+    MappedPackedPositionOverlay(const PathHandleGraph* graph, size_t steps_per_index = 20000000);
+    
+    /// Make an empty MappedPackedPositionOverlay, to deserialize into.
+    MappedPackedPositionOverlay();
+    ~MappedPackedPositionOverlay() = default;
+    
+    MappedPackedPositionOverlay(const MappedPackedPositionOverlay& other);
+    MappedPackedPositionOverlay& operator=(const MappedPackedPositionOverlay& other);
+    
+    MappedPackedPositionOverlay(MappedPackedPositionOverlay&& other);
+    MappedPackedPositionOverlay& operator=(MappedPackedPositionOverlay&& other);
+    
+    // We need to say that TriviallySerializable's serialize and deserialize
+    // should still be available.
+    using TriviallySerializable::serialize;
+    using TriviallySerializable::deserialize;
+    
+    /// Set the graph to overlay, after loading the index. It must be the graph
+    /// that the index was built on.
+    void set_graph(const PathHandleGraph* graph);
+    
+    ////////////////////////////////////////////////////////////////////////////
+    // Path position interface
+    ////////////////////////////////////////////////////////////////////////////
+    
+    /// Returns the length of a path measured in bases of sequence.
+    size_t get_path_length(const path_handle_t& path_handle) const;
+    
+    /// Returns the position along the path of the beginning of this step measured in
+    /// bases of sequence. In a circular path, positions start at the step returned by
+    /// path_begin().
+    size_t get_position_of_step(const step_handle_t& step) const;
+    
+    /// Returns the step at this position, measured in bases of sequence starting at
+    /// the step returned by path_begin(). If the position is past the end of the
+    /// path, returns path_end().
+    step_handle_t get_step_at_position(const path_handle_t& path,
+                                       const size_t& position) const;
+    
+    /// Measure the memory used by the position indexes, as a tree. Also
+    /// reports the usage of the mapped memory chain.
+    virtual MemoryReport memory_report() const;
+    
+    ////////////////////////////////////////////////////////////////////////////
+    // Serialization interface
+    ////////////////////////////////////////////////////////////////////////////
+    
+    /**
+     * Cut the memory mapping connection to any backing file.
+     */
+    void dissociate();
+    
+    /**
+     * Serialize us as a series of in-memory blocks shown to the given finction.
+     * Backs const serialization to FDs, and serialization to streams.
+     */
+    void serialize(const std::function<void(const void*, size_t)>& iteratee) const;
+    
+    /**
+     * Serialize us to the given file descriptor and establish a write-back
+     * link.
+     */
+    void serialize(int fd);
+    
+    /**
+     * Deserialize us from the given file descriptor.
+     */
+    void deserialize(int fd);
+    
+    /**
+     * Serialize everything except the magic number to the given stream.
+     */
+    void serialize_members(std::ostream& out) const;
+    
+    /**
+     * Deserialize everything except the magic number from the given stream.
+     */
+    void deserialize_members(std::istream& in);
+    
+protected:
+    
+    /**
+     * Return the magic number to use at the start of files.
+     */
+    uint32_t get_magic_number() const;
+    
+    /**
+     * Return the magic number as a string representing the bytes it will be
+     * represented by on disk.
+     */
+    std::string get_prefix() const;
+    
+    /// Set the number of distinct indexes we will use.
+    virtual void set_index_count(size_t count);
+
+    /// Into index i, index the given range of paths, with the given total size in steps. Consumes and destroys any per-path user data.
+    virtual void index_paths(size_t index_num, const std::vector<path_handle_t>::const_iterator& begin_path, const std::vector<path_handle_t>::const_iterator& end_path, size_t cumul_path_size, void** user_data_base);
+    
+    /// The index info for a path (or collection of tiny paths), in mapped
+    /// memory. BBHash can't live in mapped memory, so instead of its perfect
+    /// hash we find steps with an open addressing hash table.
+    struct MappedPathIndex {
+        /// The first half of the steps
+        MappedPagedVector<> steps_0;
+        
+        /// The second half of the steps
+        MappedPagedVector<> steps_1;
+        
+        /// The positions of the steps
+        MappedPagedVector<> positions;
+        
+        /// Linear probing hash table, with a power of 2 number of slots,
+        /// holding 1 + the rank of each step in the vectors above, or 0 for
+        /// an empty slot.
+        MappedPackedVector step_slots;
+    };
+    
+    /// Where a path can be found, in mapped memory.
+    struct MappedPathRange {
+        /// The path handle, as an integer
+        int64_t path;
+        size_t index_number;
+        size_t start;
+        size_t end;
+    };
+    
+    /// Everything we keep in mapped memory.
+    struct MappedIndexes {
+        /// Indexes, each of which belongs to a path or collection of short paths.
+        MappedVector<MappedPathIndex> indexes;
+        /// Ranges for all the paths, sorted by path.
+        MappedVector<MappedPathRange> path_ranges;
+    };
+    
+    /// Get the range for the given path. Throws std::out_of_range if the path
+    /// is not indexed.
+    const MappedPathRange& get_range(const path_handle_t& path_handle) const;
+    
+    /// Get the rank of the given step in the given index.
+    size_t get_rank(const MappedPathIndex& index, const step_handle_t& step) const;
+    
+    /// The index data, in mapped memory.
+    yomo::UniqueMappedPointer<MappedIndexes> mapped_indexes;
+};
+
 /*
  * A wrapper for constructing the perfect minimal hash function that sequentially
  * returns all steps of a PathHandleGraph from an iterator struct
@@ -45,6 +45,10 @@ public:
 
     /// overload this to use the cache 
     virtual path_handle_t get_path_handle_of_step(const step_handle_t& step_handle) const;
+    
+    /// Measure the memory used by the position indexes and the node visit
+    /// indexes, as a tree
+    virtual MemoryReport memory_report() const;
 
 protected:
     
@@ -12,6 +12,7 @@
 #include <unordered_set>
 
 #include <handlegraph/path_position_handle_graph.hpp>
+#include <handlegraph/trivially_serializable.hpp>
 #include <sdsl/bit_vectors.hpp>
 
 #include "bdsg/internal/hash_map.hpp"
@@ -268,6 +269,164 @@ protected:
     sdsl::int_vector<> step_2;
 };
 
+/*
+ * A ReferencePathOverlay that keeps its index in memory that can be mapped to
+ * and from a file. A saved index can be loaded and queried straight from the
+ * mapped file, without building or copying anything.
+ *
+ * The saved index does not include the graph. After loading, set_graph() must
+ * be called with the graph the index was built on.
+ */
+class MappedReferencePathOverlay : public ReferencePathOverlay, public TriviallySerializable {
+        
+public:
+    
+    /// Create a MappedReferencePathOverlay indexing all non-hidden paths in
+    /// the backing graph (which show up in for_each_path_handle()). For path
+    /// names in extra_path_names, look them up and index them too, even if
+    /// they are hidden.
+    MappedReferencePathOverlay(const PathHandleGraph* graph, const std::unordered_set<std::string>& extra_path_names = {});
+    
+    /// Make an empty MappedReferencePathOverlay, to deserialize into.
+    MappedReferencePathOverlay();
+    ~MappedReferencePathOverlay() = default;
+    
+    MappedReferencePathOverlay(const MappedReferencePathOverlay& other);
+    MappedReferencePathOverlay& operator=(const MappedReferencePathOverlay& other);
+    
+    MappedReferencePathOverlay(MappedReferencePathOverlay&& other);
+    MappedReferencePathOverlay& operator=(MappedReferencePathOverlay&& other);
+    
+    // We need to say that TriviallySerializable's serialize and deserialize
+    // should still be available.
+    using TriviallySerializable::serialize;
+    using TriviallySerializable::deserialize;
+    
+    /// Set the graph to overlay, after loading the index. It must be the graph
+    /// that the index was built on.
+    void set_graph(const PathHandleGraph* graph);
+    
+    ////////////////////////////////////////////////////////////////////////////
+    // Path handle interface implementations
+    ////////////////////////////////////////////////////////////////////////////
+    
+    /// Returns the number of paths stored in the graph
+    size_t get_path_count() const;
+    
+    /// Returns the number of node steps in the path
+    size_t get_step_count(const path_handle_t& path_handle) const;
+    
+    /// Get a node handle (node ID and orientation) from a handle to an step on a path
+    handle_t get_handle_of_step(const step_handle_t& step_handle) const;
+    
+    ////////////////////////////////////////////////////////////////////////////
+    // PathPositionHandleGraph interface
+    ////////////////////////////////////////////////////////////////////////////
+    
+    /// Returns the length of a path measured in bases of sequence.
+    size_t get_path_length(const path_handle_t& path_handle) const;
+    
+    /// Returns the position along the path of the beginning of this step measured in
+    /// bases of sequence. In a circular path, positions start at the step returned by
+    /// path_begin().
+    size_t get_position_of_step(const step_handle_t& step) const;
+    
+    /// Returns the step at this position, measured in bases of sequence starting at
+    /// the step returned by path_begin(). If the position is past the end of the
+    /// path, returns path_end().
+    step_handle_t get_step_at_position(const path_handle_t& path,
+                                       const size_t& position) const;
+    
+    ////////////////////////////////////////////////////////////////////////////
+    // Serialization interface
+    ////////////////////////////////////////////////////////////////////////////
+    
+    /**
+     * Cut the memory mapping connection to any backing file.
+     */
+    void dissociate();
+    
+    /**
+     * Serialize us as a series of in-memory blocks shown to the given finction.
+     * Backs const serialization to FDs, and serialization to streams.
+     */
+    void serialize(const std::function<void(const void*, size_t)>& iteratee) const;
+    
+    /**
+     * Serialize us to the given file descriptor and establish a write-back
+     * link.
+     */
+    void serialize(int fd);
+    
+    /**
+     * Deserialize us from the given file descriptor.
+     */
+    void deserialize(int fd);
+    
+    /**
+     * Serialize everything except the magic number to the given stream.
+     */
+    void serialize_members(std::ostream& out) const;
+    
+    /**
+     * Deserialize everything except the magic number from the given stream.
+     */
+    void deserialize_members(std::istream& in);
+    
+protected:
+    
+    /**
+     * Return the magic number to use at the start of files.
+     */
+    uint32_t get_magic_number() const;
+    
+    /**
+     * Return the magic number as a string representing the bytes it will be
+     * represented by on disk.
+     */
+    std::string get_prefix() const;
+    
+    /// Execute a function on each indexed path.
+    bool for_each_path_handle_impl(const std::function<bool(const path_handle_t&)>& iteratee) const;
+    
+    /// Execute a function on each step of a handle in any indexed path.
+    bool for_each_step_on_handle_impl(const handle_t& handle,
+                                      const std::function<bool(const step_handle_t&)>& iteratee) const;
+    
+    /// A path's record, in mapped memory. Instead of a bit vector with rank
+    /// and select support, which can't be mapped, we keep the start position
+    /// of each step and a sampled index from positions to steps.
+    struct MappedPathRecord {
+        /// The path handle, as an integer
+        int64_t path;
+        /// The handles visited by the path, as integers
+        MappedPackedVector steps;
+        /// The position at which each step starts, followed by the length of
+        /// the path.
+        MappedIntVector step_starts;
+        /// For every 2^sample_shift bases, the step that the base is on.
+        MappedIntVector position_samples;
+        size_t sample_shift;
+    };
+    
+    /// Everything we keep in mapped memory.
+    struct MappedIndexes {
+        /// Records for all the paths, sorted by path.
+        MappedVector<MappedPathRecord> reference_paths;
+        // indexed by node ID, the index that the node's steps begin in the step vectors
+        MappedIntVector steps_begin;
+        MappedIntVector step_1;
+        MappedIntVector step_2;
+    };
+    
+    /// Get the record for the given path. Throws std::out_of_range if the path
+    /// is not indexed.
+    const MappedPathRecord& get_record(const path_handle_t& path_handle) const;
+    
+    /// The index data, in mapped memory.
+    yomo::UniqueMappedPointer<MappedIndexes> mapped_indexes;
+};
+
 }
 
 
@@ -25,6 +25,49 @@ using namespace handlegraph;
  * In-memory implementation of MutablePathDeletableHandleGraph
  */
 class PackedGraph : public GraphProxy<BasePackedGraph<>> {
+public:
+    /**
+     * Get the sequences of many handles at once, concatenated into one
+     * buffer. The sequence for handles[i] runs from offsets[i] to
+     * offsets[i + 1]. Reuse the buffers across calls to avoid allocation.
+     */
+    void get_sequences(const vector<handle_t>& handles, string& sequences, vector<size_t>& offsets) const;
+    
+    /**
+     * Choose whether optimize() also picks the page width of each of the
+     * graph's page-compressed vectors to use the least memory. Off by default.
+     */
+    void set_page_width_tuning(bool tune);
+    
+    /**
+     * Returns true if optimize() will tune the page widths of the graph's
+     * page-compressed vectors.
+     */
+    bool get_page_width_tuning() const;
+    
+    /**
+     * Choose whether the graph defragments itself a bounded number of records
+     * at a time, instead of copying whole vectors. Off by default.
+     */
+    void set_incremental_defragmentation(bool incremental);
+    
+    /**
+     * Returns true if the graph defragments itself incrementally.
+     */
+    bool get_incremental_defragmentation() const;
+    
+    /**
+     * Move about the given number of records to fill gaps left by deleted
+     * records. Returns true if there are still deleted records to remove.
+     */
+    bool compact_step(size_t budget);
+    
+    /**
+     * Measure the memory used by each of the graph's members, and optionally
+     * by each path, as a tree.
+     */
+    MemoryReport memory_report(bool individual_paths = false) const;
+    
 protected:
     /**
      * Get the object that actually provides the graph methods.
@@ -66,6 +109,49 @@ public:
     using TriviallySerializable::serialize;
     using TriviallySerializable::deserialize;
    
+    /**
+     * Get the sequences of many handles at once, concatenated into one
+     * buffer. The sequence for handles[i] runs from offsets[i] to
+     * offsets[i + 1]. Reuse the buffers across calls to avoid allocation.
+     */
+    void get_sequences(const vector<handle_t>& handles, string& sequences, vector<size_t>& offsets) const;
+    
+    /**
+     * Choose whether optimize() also picks the page width of each of the
+     * graph's page-compressed vectors to use the least memory. Off by default.
+     */
+    void set_page_width_tuning(bool tune);
+    
+    /**
+     * Returns true if optimize() will tune the page widths of the graph's
+     * page-compressed vectors.
+     */
+    bool get_page_width_tuning() const;
+    
+    /**
+     * Choose whether the graph defragments itself a bounded number of records
+     * at a time, instead of copying whole vectors. Off by default.
+     */
+    void set_incremental_defragmentation(bool incremental);
+    
+    /**
+     * Returns true if the graph defragments itself incrementally.
+     */
+    bool get_incremental_defragmentation() const;
+    
+    /**
+     * Move about the given number of records to fill gaps left by deleted
+     * records. Returns true if there are still deleted records to remove.
+     */
+    bool compact_step(size_t budget);
+    
+    /**
+     * Measure the memory used by each of the graph's members, and optionally
+     * by each path, as a tree. Also reports the usage of the mapped memory
+     * chain.
+     */
+    MemoryReport memory_report(bool individual_paths = false) const;
+    
     /**
      * Cut the memory mapping connection to any backing file.
      */
@@ -9,9 +9,11 @@
 #include <handlegraph/util.hpp>
 #include <handlegraph/trivially_serializable.hpp>
 #include <bdsg/internal/mapped_structs.hpp>
+#include <bdsg/internal/utility.hpp>
 #include <string>
 #include <numeric>
 #include <atomic>
+#include <array>
 #include <arpa/inet.h>
  /**
   * This defines the distance index, which also serves as a snarl tree that implements libhandlegraph's 
@@ -214,7 +216,23 @@ public:
     ///The hints will go up to the lowest common ancestor needed for finding the shortest distance, which may or may not be the LCA or the root.
     size_t minimum_distance(const handlegraph::nid_t id1, const bool rev1, const size_t offset1, const handlegraph::nid_t id2, 
                             const bool rev2, const size_t offset2, bool unoriented_distance = false, const HandleGraph* graph=nullptr, 
-                            pair<vector<tuple<net_handle_t, int32_t, int32_t>>, vector<tuple<net_handle_t, int32_t, int32_t>>>* distance_traceback=nullptr) const ;
+                            pair<vector<tuple<net_handle_t, int64_t, int64_t>>, vector<tuple<net_handle_t, int64_t, int64_t>>>* distance_traceback=nullptr) const ;
+
+    ///Get the minimum distance from one position to each of a list of positions, as minimum_distance()
+    ///would find them. Positions are (node ID, is reverse, offset) tuples.
+    ///The walk up the snarl tree from each position is only done once, so this is faster
+    ///than calling minimum_distance() for each pair.
+    vector<size_t> minimum_distances(const tuple<handlegraph::nid_t, bool, size_t>& position,
+                                     const vector<tuple<handlegraph::nid_t, bool, size_t>>& positions,
+                                     bool unoriented_distance = false, const HandleGraph* graph=nullptr) const;
+
+    ///Get the minimum distance from each of the first positions to each of the second positions, as
+    ///minimum_distance() would find them. The result is indexed by the first position and then the second.
+    ///The walk up the snarl tree from each position is only done once, so this is faster
+    ///than calling minimum_distance() for each pair.
+    vector<vector<size_t>> minimum_distances(const vector<tuple<handlegraph::nid_t, bool, size_t>>& positions1,
+                                             const vector<tuple<handlegraph::nid_t, bool, size_t>>& positions2,
+                                             bool unoriented_distance = false, const HandleGraph* graph=nullptr) const;
 
     ///Find an approximation of the maximum distance between two positions. 
     ///This isn't a true maximum- the only guarantee is that it's greater than or equal to the minimum distance.
@@ -536,14 +554,17 @@ public:
     net_handle_t get_parent_traversal(const net_handle_t& traversal_start, const net_handle_t& traversal_end) const;
 
 
-private:
-
     ///Function to walk through the shortest path between the two nodes+orientations. Orientation is the same as for minimum_distance - 
     ///traverses from the first node going forward to the second node going forward.
     ///Calls iteratee on each node of the shortest path between the nodes and the distance to the start of that node
+    ///from the end of the first node. iteratee isn't called on the two nodes themselves. If it returns false, the walk stops.
+    ///The path is found with the same distances as minimum_distance, so the graph is only searched in oversized snarls
+    ///without hub labels.
     void for_each_handle_in_shortest_path(const handlegraph::nid_t id1, const bool rev1, const handlegraph::nid_t id2, const bool rev2, 
                                           const HandleGraph* graph, const std::function<bool(const handlegraph::handle_t, size_t)>& iteratee) const;
 
+private:
+
     ///Helper function for recursively traversing the shortest path in a snarl.
     ///start and end must be children (or sentinels) of the snarl.
     ///The distance found will traverse start going forward and reach end going forward.
@@ -561,6 +582,42 @@ private:
                                           const std::function<bool(const handlegraph::handle_t, size_t)>& iteratee,
                                           vector<pair<net_handle_t, size_t>>* to_duplicate) const;
 
+    ///The walk from a position up the snarl tree, with everything about it that minimum_distance()
+    ///needs, so that it can be shared between many distance queries from the same position
+    struct AncestorWalk {
+        //The node, then each of its ancestors as start-end traversals, ending with the root
+        vector<net_handle_t> ancestors;
+        //The distances from the position to the start and end of each ancestor except the root
+        vector<pair<size_t, size_t>> distances;
+        //For each ancestor except the node and the root, the distances from it back to itself in its
+        //parent: start-start, start-end, end-start, end-end. These are only needed above where the
+        //walk meets another one, so they are filled in from the top down as they are needed
+        vector<std::array<size_t, 4>> loop_distances;
+        //The lowest level that loop_distances is filled in for
+        size_t loop_distances_from;
+        //The length of the node
+        size_t node_length;
+        //The record of the root's parent, to tell whether two walks are in the same connected component
+        size_t root_parent_offset;
+    };
+
+    ///Walk up the snarl tree from a position, for minimum_distances(). is_second is true if
+    ///the position is the second one of the pairs, which distances go towards
+    AncestorWalk get_ancestor_walk(const tuple<handlegraph::nid_t, bool, size_t>& position, bool is_second,
+                                   bool unoriented_distance, const HandleGraph* graph) const;
+
+    ///Update the distances from a position to the ends of net into distances to the ends of its parent.
+    ///This is the same as what minimum_distance() does going up the snarl tree, without the traceback
+    void update_distances_to_parent(const net_handle_t& net, const net_handle_t& parent,
+                                    size_t& dist_start, size_t& dist_end, const HandleGraph* graph) const;
+
+    ///Fill in the loop distances of the walk from the given level up
+    void fill_loop_distances(AncestorWalk& walk, size_t level, const HandleGraph* graph) const;
+
+    ///Get the minimum distance between the positions that two walks start from. The loop distances
+    ///of the first walk are filled in as far down as they are needed
+    size_t minimum_distance(AncestorWalk& walk1, const AncestorWalk& walk2, const HandleGraph* graph) const;
+
 
 ////////////////////////////// How to interpret net_handle_ts
 //
@@ -851,6 +908,16 @@ private:
      *   2rank+1 for the right side, and 0 for the start, 1 for the end, where we only keep the 
      *   inner node side of the start and end
      *   Node count is the number of nodes, not including boundary nodes
+     *   An oversized snarl has no distance vector. If the index was built with hub labels, it has 
+     *   a pointer to its hub labels instead, or 0 if it has none
+     *
+     *   The distance vector of a snarl in a chain can also be compact, with its own bit width:
+     *   [value width + (slot width << 7), # escapes, packed values, 
+     *      escaped matrix index x # escapes, escaped value x # escapes]
+     *   Each value takes value width bits, and they are packed into slot width bits of each slot.
+     *   A value of all ones is an escape, and the actual value is found with the escaped matrix
+     *   indexes, which are sorted. A snarl record has a compact distance vector if the size before 
+     *   it is smaller than the full size of the record
      */
     const static size_t SNARL_RECORD_SIZE = 8;
     const static size_t SNARL_NODE_COUNT_OFFSET = 1;
@@ -860,6 +927,7 @@ private:
     const static size_t SNARL_DISTANCE_START_START_OFFSET = 5;
     const static size_t SNARL_DISTANCE_END_END_OFFSET = 6;
     const static size_t SNARL_CHILD_RECORD_OFFSET = 7;
+    const static size_t SNARL_HUB_LABELS_OFFSET = 8;
 
     /*A simple snarl for bubbles with only nodes with two edges, one to each bound
      * [simple snarl tag, node count+length, parent, [node id, node length]xN
@@ -875,6 +943,15 @@ private:
      *   Each snarl will have a pointer into here, and will also know how many children it has
      */ 
 
+    /*Hub labels of an oversized snarl, which come after everything else
+     *   [start of label x (4 * # nodes + 1), [hub, distance] x M]
+     *   Each side of each child has a label for leaving it, with the distances to hubs, and one for
+     *   going into it, with the distances from hubs: 4*(rank-2) + 2*right_side + going_in. 
+     *   The starts count entries after the last start.
+     *   Each label is sorted by hub, and a distance is the smallest sum of the distances to and from
+     *   a hub that is in the leaving label of the first side and the going in label of the second
+     */
+
 private:
     /*Give each of the enum types a name for printing */
     vector<std::string> record_t_as_string = {"ROOT", "NODE", "DISTANCED_NODE", 
@@ -900,6 +977,14 @@ private:
     //the distances along top-level chains but don't store internal distances in snarls or in nested chains
     //This overrides snarl_size_limit
     bool only_top_level_chain_distances=false;
+
+    //If this is true, then oversized snarls get hub labels for the distances between their children,
+    //so that they don't have to be found by traversing the graph
+    bool oversized_snarl_hub_labels=false;
+
+    //If this is true, then the distance matrices of snarls in chains get packed with the fewest bits
+    //needed for most of their distances, instead of the bit width of the whole index
+    bool compact_snarl_distances=false;
     static const int max_num_size_limit_warnings = 100;
     std::atomic<int> size_limit_warnings{0};
     static const uint32_t magic_number = 1738636486;
@@ -907,6 +992,8 @@ private:
 public:
     void set_snarl_size_limit (size_t size) {snarl_size_limit=size;}
     void set_only_top_level_chain_distances (bool only_chain) {only_top_level_chain_distances=only_chain;}
+    void set_oversized_snarl_hub_labels (bool hub_labels) {oversized_snarl_hub_labels=hub_labels;}
+    void set_compact_snarl_distances (bool compact) {compact_snarl_distances=compact;}
 
 
 
@@ -1196,6 +1283,14 @@ private:
         static size_t record_size (record_t type, size_t node_count) ;
         size_t record_size() ;
 
+        //How big is a compact distance vector, given the bits per value, the bits used in each
+        //slot of the records, and the number of values that don't fit
+        static size_t compact_distance_vector_size(size_t node_count, size_t value_width, 
+                size_t slot_width, size_t escape_count);
+
+        //Is the distance vector packed with its own bit width
+        bool has_compact_distances() const;
+
         //Get the index into the distance vector for the calculating distance between the given node sides
         static size_t get_distance_vector_offset(size_t rank1, bool right_side1, size_t rank2, 
                 bool right_side2, size_t node_count, record_t type); 
@@ -1217,6 +1312,13 @@ private:
 
         bool for_each_child(const std::function<bool(const net_handle_t&)>& iteratee) const;
 
+        //Get the offset of the hub labels of an oversized snarl, or 0 if it doesn't have any
+        size_t get_hub_labels_offset() const;
+
+    protected:
+        //Get the stored value (distance+1 or 0 for inf) at an index in a compact distance vector
+        size_t get_compact_distance_value(size_t distance_vector_offset) const;
+
     };
 
     struct SnarlRecordWriter : SnarlRecord , SnarlTreeRecordWriter {
@@ -1227,7 +1329,10 @@ private:
 
         SnarlRecordWriter();
 
-        SnarlRecordWriter (size_t node_count, bdsg::yomo::UniqueMappedPointer<bdsg::MappedIntVector>* records, record_t type);
+        //If vector_size isn't 0, then the record gets a distance vector of that size instead of the
+        //one for its type: a compact distance vector, or the pointer to an oversized snarl's hub labels
+        SnarlRecordWriter (size_t node_count, bdsg::yomo::UniqueMappedPointer<bdsg::MappedIntVector>* records, record_t type,
+                           size_t vector_size = 0);
         SnarlRecordWriter(bdsg::yomo::UniqueMappedPointer<bdsg::MappedIntVector>* records, size_t pointer);
 
         void set_distance(size_t rank1, bool right_side1, size_t rank2, bool right_side2, size_t distance);
@@ -1240,6 +1345,12 @@ private:
 
         void set_child_record_pointer(size_t pointer) ;
 
+        void set_hub_labels_offset(size_t offset);
+
+        //Set up a compact distance vector before any distances are set. escaped_indexes are the
+        //sorted indexes in the distance vector of the values that won't fit in value_width bits
+        void set_compact_distance_encoding(size_t value_width, size_t slot_width, const vector<size_t>& escaped_indexes);
+
         //Add a reference to a child of this snarl. Assumes that the index is completed up
         //to here
         void add_child(size_t pointer);
@@ -1399,7 +1510,9 @@ private:
          */
 
         //Add a snarl to the end of the chain and return a SnarlRecordWriter pointing to it
-        SnarlRecordWriter add_snarl(size_t snarl_size, record_t type, size_t previous_child_offset); 
+        //If vector_size isn't 0, then the snarl gets a distance vector of that size instead of the one for its type
+        SnarlRecordWriter add_snarl(size_t snarl_size, record_t type, size_t previous_child_offset,
+                                    size_t vector_size = 0); 
         SimpleSnarlRecordWriter add_simple_snarl(size_t snarl_size, record_t type, size_t previous_child_offset); 
         //Add a node to the end of a chain and return the offset of the record it got added to
         //If new_record is true, make a new trivial snarl record for the node
@@ -1425,6 +1538,20 @@ private:
         return ChainRecord(get_record_offset(net_handle), &snarl_tree_records); 
     }
 
+    //Make the hub labels of an oversized snarl, laid out to be added to the end of the index
+    vector<size_t> make_hub_labels(const net_handle_t& snarl, const HandleGraph* graph) const;
+
+    //Find the distance from the end of one handle to the start of another without leaving an oversized
+    //snarl, searching the graph from both ends. Returns inf if it is greater than the distance limit.
+    //If path isn't null, fill it in with the handles walked between the two, not including them
+    static size_t distance_in_oversized_snarl(const SnarlRecord& snarl_record, const handle_t& from,
+            const handle_t& to, const HandleGraph* graph, size_t distance_limit,
+            vector<handle_t>* path = nullptr);
+
+    //Find the distance between two child node sides of an oversized snarl using its hub labels
+    size_t get_hub_label_distance(size_t hub_labels_offset, size_t node_count, 
+            size_t rank1, bool right_side1, size_t rank2, bool right_side2) const;
+
 public:
 
     //Return a string of what the handle is
@@ -1468,6 +1595,10 @@ public:
 
     std::tuple<size_t, size_t, size_t> get_usage() ;
 
+    //Measure the memory used by the index as a tree, with counts of the snarls,
+    //chains, and nodes in it and the usage of its mapped memory chain
+    MemoryReport memory_report() const;
+
 
 public:
 
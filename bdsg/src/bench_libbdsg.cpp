@@ -0,0 +1,338 @@
+//
+//  bench_libbdsg.cpp
+//
+// Throughput benchmarks for the HandleGraph backends in libbdsg, run on
+// synthetic pangenome graphs. Results are printed to standard output as JSON
+// so they can be compared across releases.
+//
+
+#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <limits>
+
+#include <getopt.h>
+#include <omp.h> // BINDER_IGNORE because Binder can't find this
+
+#include "bdsg/packed_graph.hpp"
+#include "bdsg/hash_graph.hpp"
+#include "bdsg/internal/synthetic_graph.hpp"
+
+using namespace bdsg;
+using namespace handlegraph;
+using namespace std;
+
+/// One timed measurement.
+struct BenchResult {
+    string backend;
+    string operation;
+    /// How many operations were performed
+    size_t count;
+    /// Wall clock time they took
+    double seconds;
+    /// A value derived from the results of the operations, so that backends
+    /// can be checked against each other and so the work is not optimized out.
+    size_t checksum;
+};
+
+/// Parameters for the benchmark run.
+struct BenchParams {
+    /// Shape of the graph to build
+    SyntheticGraphParams graph;
+    size_t repeats = 3;
+    
+    BenchParams() {
+        graph.node_count = 100000;
+    }
+};
+
+/// Time a function that does count operations and returns a checksum. Takes
+/// the best of the given number of repeats.
+BenchResult time_operation(const string& backend, const string& operation, size_t count, size_t repeats,
+                           const function<size_t(void)>& run) {
+    BenchResult result {backend, operation, count, numeric_limits<double>::max(), 0};
+    for (size_t i = 0; i < max<size_t>(repeats, 1); i++) {
+        auto start = chrono::steady_clock::now();
+        result.checksum = run();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        result.seconds = min(result.seconds, elapsed.count());
+    }
+    return result;
+}
+
+/// Time batch sequence extraction on a backend that supports it.
+template<typename Graph>
+void bench_get_sequences(const string& backend, const BenchParams& params, const Graph& graph,
+                         vector<BenchResult>& results) {
+    vector<handle_t> handles;
+    graph.for_each_handle([&](const handle_t& handle) {
+        handles.push_back(handle);
+        handles.push_back(graph.flip(handle));
+    });
+    string sequences;
+    vector<size_t> offsets;
+    results.push_back(time_operation(backend, "get_sequences", handles.size(), params.repeats, [&]() {
+        graph.get_sequences(handles, sequences, offsets);
+        size_t checksum = 0;
+        for (size_t i = 0; i + 1 < offsets.size(); i++) {
+            checksum += (offsets[i + 1] - offsets[i]) + sequences[offsets[i]];
+        }
+        return checksum;
+    }));
+}
+
+void bench_get_sequences(const string& backend, const BenchParams& params, const HashGraph& graph,
+                         vector<BenchResult>& results) {
+    // HashGraph has no batch sequence API.
+}
+
+/// Run all the benchmarks on one kind of graph.
+template<typename Graph>
+void bench_backend(const string& backend, const BenchParams& params, vector<BenchResult>& results) {
+    Graph graph;
+
+    auto start = chrono::steady_clock::now();
+    generate_synthetic_graph(&graph, params.graph);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    results.push_back({backend, "build", graph.get_node_count(), elapsed.count(), graph.get_edge_count()});
+
+    nid_t min_id = graph.min_node_id();
+    nid_t max_id = graph.max_node_id();
+    size_t node_count = graph.get_node_count();
+
+    results.push_back(time_operation(backend, "get_handle", max_id - min_id + 1, params.repeats, [&]() {
+        size_t checksum = 0;
+        for (nid_t id = min_id; id <= max_id; id++) {
+            checksum += graph.get_is_reverse(graph.get_handle(id, id & 1));
+        }
+        return checksum;
+    }));
+
+    results.push_back(time_operation(backend, "follow_edges", 2 * node_count, params.repeats, [&]() {
+        size_t checksum = 0;
+        for (nid_t id = min_id; id <= max_id; id++) {
+            handle_t handle = graph.get_handle(id);
+            for (bool go_left : {false, true}) {
+                graph.follow_edges(handle, go_left, [&](const handle_t& next) {
+                    checksum += graph.get_id(next);
+                });
+            }
+        }
+        return checksum;
+    }));
+
+    results.push_back(time_operation(backend, "get_sequence", 2 * node_count, params.repeats, [&]() {
+        size_t checksum = 0;
+        for (nid_t id = min_id; id <= max_id; id++) {
+            for (bool is_reverse : {false, true}) {
+                string sequence = graph.get_sequence(graph.get_handle(id, is_reverse));
+                checksum += sequence.size() + sequence.front();
+            }
+        }
+        return checksum;
+    }));
+
+    bench_get_sequences(backend, params, graph, results);
+
+    for (bool parallel : {false, true}) {
+        results.push_back(time_operation(backend, parallel ? "for_each_handle_parallel" : "for_each_handle",
+                                         node_count, params.repeats, [&]() {
+            atomic<size_t> checksum(0);
+            graph.for_each_handle([&](const handle_t& handle) {
+                checksum.fetch_add(graph.get_length(handle), memory_order_relaxed);
+            }, parallel);
+            return checksum.load();
+        }));
+    }
+
+    size_t step_count = 0;
+    graph.for_each_path_handle([&](const path_handle_t& path) {
+        step_count += graph.get_step_count(path);
+    });
+    results.push_back(time_operation(backend, "path_steps", step_count, params.repeats, [&]() {
+        size_t checksum = 0;
+        graph.for_each_path_handle([&](const path_handle_t& path) {
+            graph.for_each_step_in_path(path, [&](const step_handle_t& step) {
+                checksum += graph.get_id(graph.get_handle_of_step(step));
+            });
+        });
+        return checksum;
+    }));
+
+    // Make some new nodes hanging off the graph, and then take them away again.
+    size_t churn_count = max<size_t>(node_count / 10, 1);
+    vector<handle_t> created;
+    created.reserve(churn_count);
+    results.push_back(time_operation(backend, "create_handle_and_edge", churn_count, 1, [&]() {
+        size_t checksum = 0;
+        for (size_t i = 0; i < churn_count; i++) {
+            handle_t handle = graph.create_handle("GATTACA");
+            graph.create_edge(graph.get_handle(min_id + (i % node_count)), handle);
+            created.push_back(handle);
+            checksum += graph.get_id(handle);
+        }
+        return checksum;
+    }));
+    results.push_back(time_operation(backend, "destroy_handle", churn_count, 1, [&]() {
+        for (auto& handle : created) {
+            graph.destroy_handle(handle);
+        }
+        return graph.get_node_count();
+    }));
+
+    string serialized;
+    results.push_back(time_operation(backend, "serialize", node_count, params.repeats, [&]() {
+        stringstream out;
+        graph.serialize(out);
+        serialized = out.str();
+        return serialized.size();
+    }));
+    results.push_back(time_operation(backend, "deserialize", node_count, params.repeats, [&]() {
+        Graph loaded;
+        stringstream in(serialized);
+        loaded.deserialize(in);
+        return loaded.get_node_count();
+    }));
+}
+
+/// Escape a string for inclusion in JSON output.
+string json_string(const string& value) {
+    stringstream out;
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+void print_json(ostream& out, const BenchParams& params, const vector<BenchResult>& results) {
+    out << "{" << endl;
+    out << "  \"parameters\": {\"node_count\": " << params.graph.node_count
+        << ", \"bubble_density\": " << params.graph.bubble_density
+        << ", \"nesting_depth\": " << params.graph.nesting_depth
+        << ", \"inversion_rate\": " << params.graph.inversion_rate
+        << ", \"haplotype_count\": " << params.graph.haplotype_count
+        << ", \"seed\": " << params.graph.seed
+        << ", \"repeats\": " << params.repeats
+        << ", \"threads\": " << omp_get_max_threads() << "}," << endl;
+    out << "  \"results\": [" << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& result = results[i];
+        out << "    {\"backend\": " << json_string(result.backend)
+            << ", \"operation\": " << json_string(result.operation)
+            << ", \"count\": " << result.count
+            << ", \"seconds\": " << result.seconds
+            << ", \"per_second\": " << (result.seconds > 0 ? result.count / result.seconds : 0.0)
+            << ", \"checksum\": " << result.checksum << "}"
+            << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    out << "  ]" << endl;
+    out << "}" << endl;
+}
+
+void print_help(char** argv) {
+    cerr << "usage: " << argv[0] << " [options]" << endl
+         << "Benchmark libbdsg graph backends and print results as JSON." << endl
+         << endl
+         << "options:" << endl
+         << "  -n, --nodes N      approximate number of nodes to build [100000]" << endl
+         << "  -d, --density X    probability of a bubble after each backbone node [0.3]" << endl
+         << "  -D, --depth N      maximum nesting depth of bubbles [2]" << endl
+         << "  -i, --inversions X probability that a bubble contains an inversion [0.05]" << endl
+         << "  -p, --paths N      number of haplotype paths to thread through the graph [4]" << endl
+         << "  -s, --seed N       seed for the graph construction [1]" << endl
+         << "  -r, --repeats N    repeat each timed operation N times and keep the best [3]" << endl
+         << "  -b, --backend NAME only run the given backend (PackedGraph, HashGraph, MappedPackedGraph)" << endl
+         << "  -h, --help         print this help message" << endl;
+}
+
+int main(int argc, char** argv) {
+    BenchParams params;
+    string only_backend;
+
+    static struct option long_options[] = {
+        {"nodes", required_argument, 0, 'n'},
+        {"density", required_argument, 0, 'd'},
+        {"depth", required_argument, 0, 'D'},
+        {"inversions", required_argument, 0, 'i'},
+        {"paths", required_argument, 0, 'p'},
+        {"seed", required_argument, 0, 's'},
+        {"repeats", required_argument, 0, 'r'},
+        {"backend", required_argument, 0, 'b'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "n:d:D:i:p:s:r:b:h", long_options, nullptr)) != -1) {
+        try {
+            switch (c) {
+            case 'n':
+                params.graph.node_count = stoull(optarg);
+                if (params.graph.node_count == 0) {
+                    cerr << "error: the number of nodes must be at least 1" << endl;
+                    return 1;
+                }
+                break;
+            case 'd':
+                params.graph.bubble_density = stod(optarg);
+                break;
+            case 'D':
+                params.graph.nesting_depth = stoull(optarg);
+                break;
+            case 'i':
+                params.graph.inversion_rate = stod(optarg);
+                break;
+            case 'p':
+                params.graph.haplotype_count = stoull(optarg);
+                break;
+            case 's':
+                params.graph.seed = stoull(optarg);
+                break;
+            case 'r':
+                params.repeats = stoull(optarg);
+                break;
+            case 'b':
+                only_backend = optarg;
+                break;
+            case 'h':
+                print_help(argv);
+                return 0;
+            default:
+                print_help(argv);
+                return 1;
+            }
+        } catch (const std::invalid_argument& e) {
+            cerr << "error: option -" << (char) c << " needs a number, not " << optarg << endl;
+            print_help(argv);
+            return 1;
+        } catch (const std::out_of_range& e) {
+            cerr << "error: option -" << (char) c << " is out of range: " << optarg << endl;
+            print_help(argv);
+            return 1;
+        }
+    }
+
+    vector<BenchResult> results;
+    if (only_backend.empty() || only_backend == "PackedGraph") {
+        bench_backend<PackedGraph>("PackedGraph", params, results);
+    }
+    if (only_backend.empty() || only_backend == "HashGraph") {
+        bench_backend<HashGraph>("HashGraph", params, results);
+    }
+    if (only_backend.empty() || only_backend == "MappedPackedGraph") {
+        bench_backend<MappedPackedGraph>("MappedPackedGraph", params, results);
+    }
+
+    print_json(cout, params, results);
+    return 0;
+}
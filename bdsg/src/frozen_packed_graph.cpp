@@ -0,0 +1,554 @@
+//
+//  frozen_packed_graph.cpp
+//
+
+#include "bdsg/frozen_packed_graph.hpp"
+#include "bdsg/internal/utility.hpp"
+
+#include <handlegraph/util.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include <omp.h> // BINDER_IGNORE because Binder can't find this
+
+namespace bdsg {
+
+    using namespace handlegraph;
+
+    FrozenPackedGraph::FrozenPackedGraph(const PathHandleGraph* graph) {
+
+        // give the nodes ranks in the graph's iteration order
+        vector<nid_t> ids;
+        ids.reserve(graph->get_node_count());
+        graph->for_each_handle([&](const handle_t& handle) {
+            nid_t node_id = graph->get_id(handle);
+            ids.push_back(node_id);
+            min_id = std::min(min_id, node_id);
+            max_id = std::max(max_id, node_id);
+        });
+
+        node_count = ids.size();
+
+        // we only need to translate IDs if they aren't already ranks
+        bool ids_are_ranks = true;
+        for (size_t i = 0; i < ids.size() && ids_are_ranks; ++i) {
+            ids_are_ranks = (ids[i] == min_id + nid_t(i));
+        }
+        if (!ids_are_ranks) {
+            node_ids.resize(ids.size());
+            id_to_rank.resize(max_id - min_id + 1);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                node_ids.set(i, ids[i] - min_id);
+                id_to_rank.set(ids[i] - min_id, i + 1);
+            }
+        }
+
+        // copy the sequences
+        vector<uint64_t> starts;
+        starts.reserve(ids.size() + 1);
+        for (nid_t node_id : ids) {
+            starts.push_back(bases.size());
+            for (char base : graph->get_sequence(graph->get_handle(node_id))) {
+                bases.append(encode_base(base));
+            }
+        }
+        starts.push_back(bases.size());
+        sequence_starts = EliasFanoVector<>(starts);
+
+        // copy the edges out of each oriented node
+        starts.clear();
+        starts.reserve(2 * ids.size() + 1);
+        for (nid_t node_id : ids) {
+            for (bool is_reverse : {false, true}) {
+                starts.push_back(edge_targets.size());
+                handle_t handle = get_handle(node_id, is_reverse);
+                graph->follow_edges(graph->get_handle(node_id, is_reverse), false, [&](const handle_t& next) {
+                    handle_t frozen = get_handle(graph->get_id(next), graph->get_is_reverse(next));
+                    edge_targets.append(as_integer(frozen));
+                    if (frozen == flip(handle)) {
+                        ++reversing_self_edges;
+                    }
+                });
+            }
+        }
+        starts.push_back(edge_targets.size());
+        edge_starts = EliasFanoVector<>(starts);
+
+        // put the paths in order by name
+        vector<pair<string, path_handle_t>> paths;
+        paths.reserve(graph->get_path_count());
+        graph->for_each_path_handle([&](const path_handle_t& path_handle) {
+            paths.emplace_back(graph->get_path_name(path_handle), path_handle);
+        });
+        std::sort(paths.begin(), paths.end(), [](const pair<string, path_handle_t>& a,
+                                                 const pair<string, path_handle_t>& b) {
+            return a.first < b.first;
+        });
+
+        // copy the names and the steps, and count the visits to each node
+        vector<uint64_t> name_starts;
+        name_starts.reserve(paths.size() + 1);
+        starts.clear();
+        starts.reserve(paths.size() + 1);
+        vector<uint64_t> visit_starts(ids.size() + 1, 0);
+        path_is_circular.resize(paths.size());
+        for (size_t i = 0; i < paths.size(); ++i) {
+            name_starts.push_back(path_names.size());
+            for (char c : paths[i].first) {
+                path_names.append((unsigned char) c);
+            }
+            path_is_circular.set(i, graph->get_is_circular(paths[i].second));
+            starts.push_back(step_handles.size());
+            graph->for_each_step_in_path(paths[i].second, [&](const step_handle_t& step) {
+                handle_t handle = graph->get_handle_of_step(step);
+                handle_t frozen = get_handle(graph->get_id(handle), graph->get_is_reverse(handle));
+                step_handles.append(as_integer(frozen));
+                ++visit_starts[get_rank(frozen) + 1];
+            });
+        }
+        name_starts.push_back(path_names.size());
+        starts.push_back(step_handles.size());
+        path_name_starts = EliasFanoVector<>(name_starts);
+        path_step_starts = EliasFanoVector<>(starts);
+
+        // group the steps by the node they visit
+        for (size_t i = 1; i < visit_starts.size(); ++i) {
+            visit_starts[i] += visit_starts[i - 1];
+        }
+        vector<uint64_t> next_visit(visit_starts.begin(), visit_starts.end() - 1);
+        node_visits.resize(step_handles.size());
+        for (size_t i = 0; i < step_handles.size(); ++i) {
+            node_visits.set(next_visit[get_rank(as_handle(step_handles.get(i)))]++, i);
+        }
+        node_visit_starts = EliasFanoVector<>(visit_starts);
+
+        // choose the page widths that compress best
+        edge_targets.tune_page_width();
+        step_handles.tune_page_width();
+
+        // we won't grow any more, so we don't need the slack
+        node_ids.shrink_to_fit();
+        id_to_rank.shrink_to_fit();
+        bases.shrink_to_fit();
+        edge_targets.shrink_to_fit();
+        path_names.shrink_to_fit();
+        path_is_circular.shrink_to_fit();
+        step_handles.shrink_to_fit();
+        node_visits.shrink_to_fit();
+    }
+
+    FrozenPackedGraph::FrozenPackedGraph(istream& in) {
+        deserialize(in);
+    }
+
+    uint32_t FrozenPackedGraph::get_magic_number() const {
+        return 2309564178ul;
+    }
+
+    void FrozenPackedGraph::serialize_members(ostream& out) const {
+        sdsl::write_member(min_id, out);
+        sdsl::write_member(max_id, out);
+        sdsl::write_member(node_count, out);
+        node_ids.serialize(out);
+        id_to_rank.serialize(out);
+        bases.serialize(out);
+        sequence_starts.serialize(out);
+        edge_targets.serialize(out);
+        sdsl::write_member(reversing_self_edges, out);
+        edge_starts.serialize(out);
+        path_names.serialize(out);
+        path_name_starts.serialize(out);
+        path_is_circular.serialize(out);
+        step_handles.serialize(out);
+        path_step_starts.serialize(out);
+        node_visits.serialize(out);
+        node_visit_starts.serialize(out);
+    }
+
+    void FrozenPackedGraph::deserialize_members(istream& in) {
+        sdsl::read_member(min_id, in);
+        sdsl::read_member(max_id, in);
+        sdsl::read_member(node_count, in);
+        node_ids.deserialize(in);
+        id_to_rank.deserialize(in);
+        bases.deserialize(in);
+        sequence_starts.deserialize(in);
+        edge_targets.deserialize(in);
+        sdsl::read_member(reversing_self_edges, in);
+        edge_starts.deserialize(in);
+        path_names.deserialize(in);
+        path_name_starts.deserialize(in);
+        path_is_circular.deserialize(in);
+        step_handles.deserialize(in);
+        path_step_starts.deserialize(in);
+        node_visits.deserialize(in);
+        node_visit_starts.deserialize(in);
+    }
+
+    uint64_t FrozenPackedGraph::encode_base(char base) {
+        switch (base) {
+            case 'a':
+            case 'A':
+                return 0;
+            case 'c':
+            case 'C':
+                return 1;
+            case 'g':
+            case 'G':
+                return 2;
+            case 't':
+            case 'T':
+                return 3;
+            default:
+                return 4;
+        }
+    }
+
+    char FrozenPackedGraph::decode_base(uint64_t encoded) {
+        return "ACGTN"[encoded];
+    }
+
+    inline size_t FrozenPackedGraph::get_rank(const handle_t& handle) const {
+        return number_bool_packing::unpack_number(handle);
+    }
+
+    size_t FrozenPackedGraph::get_path_of_step_index(size_t step_index) const {
+        // find the last path that starts at or before the step, which skips
+        // any empty paths that start at the same place
+        size_t low = 0, high = get_path_count();
+        while (high - low > 1) {
+            size_t mid = (low + high) / 2;
+            if (path_step_starts.get(mid) <= step_index) {
+                low = mid;
+            }
+            else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    inline void FrozenPackedGraph::get_path_bounds(const path_handle_t& path_handle, uint64_t* bounds) const {
+        path_step_starts.get_range(as_integer(path_handle), 2, bounds);
+    }
+
+    bool FrozenPackedGraph::has_node(nid_t node_id) const {
+        return node_id >= min_id && node_id <= max_id && (node_ids.empty() || id_to_rank.get(node_id - min_id) != 0);
+    }
+
+    handle_t FrozenPackedGraph::get_handle(const nid_t& node_id, bool is_reverse) const {
+        size_t rank = node_ids.empty() ? node_id - min_id : id_to_rank.get(node_id - min_id) - 1;
+        return number_bool_packing::pack(rank, is_reverse);
+    }
+
+    nid_t FrozenPackedGraph::get_id(const handle_t& handle) const {
+        return (node_ids.empty() ? get_rank(handle) : node_ids.get(get_rank(handle))) + min_id;
+    }
+
+    bool FrozenPackedGraph::get_is_reverse(const handle_t& handle) const {
+        return number_bool_packing::unpack_bit(handle);
+    }
+
+    handle_t FrozenPackedGraph::flip(const handle_t& handle) const {
+        return number_bool_packing::toggle_bit(handle);
+    }
+
+    size_t FrozenPackedGraph::get_length(const handle_t& handle) const {
+        uint64_t bounds[2];
+        sequence_starts.get_range(get_rank(handle), 2, bounds);
+        return bounds[1] - bounds[0];
+    }
+
+    string FrozenPackedGraph::get_sequence(const handle_t& handle) const {
+        return get_subsequence(handle, 0, numeric_limits<size_t>::max());
+    }
+
+    char FrozenPackedGraph::get_base(const handle_t& handle, size_t index) const {
+        uint64_t bounds[2];
+        sequence_starts.get_range(get_rank(handle), 2, bounds);
+        if (get_is_reverse(handle)) {
+            return reverse_complement(decode_base(bases.get(bounds[1] - index - 1)));
+        }
+        else {
+            return decode_base(bases.get(bounds[0] + index));
+        }
+    }
+
+    string FrozenPackedGraph::get_subsequence(const handle_t& handle, size_t index, size_t size) const {
+        uint64_t bounds[2];
+        sequence_starts.get_range(get_rank(handle), 2, bounds);
+        size_t length = bounds[1] - bounds[0];
+        index = std::min(index, length);
+        size = std::min(size, length - index);
+
+        vector<uint64_t> encoded(size);
+        string subsequence(size, 'N');
+        if (get_is_reverse(handle)) {
+            bases.get_range(bounds[1] - index - size, size, encoded.data());
+            for (size_t i = 0; i < size; ++i) {
+                subsequence[i] = reverse_complement(decode_base(encoded[size - i - 1]));
+            }
+        }
+        else {
+            bases.get_range(bounds[0] + index, size, encoded.data());
+            for (size_t i = 0; i < size; ++i) {
+                subsequence[i] = decode_base(encoded[i]);
+            }
+        }
+        return subsequence;
+    }
+
+    bool FrozenPackedGraph::follow_edges_impl(const handle_t& handle, bool go_left,
+                                              const std::function<bool(const handle_t&)>& iteratee) const {
+        // going left is going right from the other orientation and flipping back
+        handle_t from = go_left ? flip(handle) : handle;
+        uint64_t bounds[2];
+        edge_starts.get_range(as_integer(from), 2, bounds);
+        for (uint64_t i = bounds[0]; i < bounds[1]; ++i) {
+            handle_t next = as_handle(edge_targets.get(i));
+            if (!iteratee(go_left ? flip(next) : next)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool FrozenPackedGraph::for_each_handle_impl(const std::function<bool(const handle_t&)>& iteratee,
+                                                 bool parallel) const {
+        if (parallel) {
+            atomic<bool> keep_going(true);
+#pragma omp parallel for
+            for (size_t i = 0; i < node_count; ++i) {
+                if (keep_going && !iteratee(number_bool_packing::pack(i, false))) {
+                    keep_going = false;
+                }
+            }
+            return keep_going;
+        }
+        else {
+            for (size_t i = 0; i < node_count; ++i) {
+                if (!iteratee(number_bool_packing::pack(i, false))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    size_t FrozenPackedGraph::get_degree(const handle_t& handle, bool go_left) const {
+        uint64_t bounds[2];
+        edge_starts.get_range(as_integer(go_left ? flip(handle) : handle), 2, bounds);
+        return bounds[1] - bounds[0];
+    }
+
+    size_t FrozenPackedGraph::get_edge_count() const {
+        return (edge_targets.size() + reversing_self_edges) / 2;
+    }
+
+    size_t FrozenPackedGraph::get_node_count(void) const {
+        return node_count;
+    }
+
+    nid_t FrozenPackedGraph::min_node_id(void) const {
+        return min_id;
+    }
+
+    nid_t FrozenPackedGraph::max_node_id(void) const {
+        return max_id;
+    }
+
+    size_t FrozenPackedGraph::get_total_length() const {
+        return bases.size();
+    }
+
+    size_t FrozenPackedGraph::get_path_count() const {
+        return path_is_circular.size();
+    }
+
+    size_t FrozenPackedGraph::find_path(const std::string& path_name) const {
+        // binary search for the first path that isn't before the name
+        size_t low = 0, high = get_path_count();
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (get_path_name(as_path_handle(mid)) < path_name) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        if (low < get_path_count() && get_path_name(as_path_handle(low)) == path_name) {
+            return low;
+        }
+        return get_path_count();
+    }
+
+    bool FrozenPackedGraph::has_path(const std::string& path_name) const {
+        return find_path(path_name) != get_path_count();
+    }
+
+    path_handle_t FrozenPackedGraph::get_path_handle(const std::string& path_name) const {
+        size_t path = find_path(path_name);
+        if (path == get_path_count()) {
+            throw std::runtime_error("No path named " + path_name + " in FrozenPackedGraph");
+        }
+        return as_path_handle(path);
+    }
+
+    std::string FrozenPackedGraph::get_path_name(const path_handle_t& path_handle) const {
+        uint64_t bounds[2];
+        path_name_starts.get_range(as_integer(path_handle), 2, bounds);
+        std::string name(bounds[1] - bounds[0], '\0');
+        for (size_t i = 0; i < name.size(); ++i) {
+            name[i] = (char) path_names.get(bounds[0] + i);
+        }
+        return name;
+    }
+
+    bool FrozenPackedGraph::get_is_circular(const path_handle_t& path_handle) const {
+        return path_is_circular.get(as_integer(path_handle));
+    }
+
+    size_t FrozenPackedGraph::get_step_count(const path_handle_t& path_handle) const {
+        uint64_t bounds[2];
+        get_path_bounds(path_handle, bounds);
+        return bounds[1] - bounds[0];
+    }
+
+    size_t FrozenPackedGraph::get_step_count(const handle_t& handle) const {
+        uint64_t bounds[2];
+        node_visit_starts.get_range(get_rank(handle), 2, bounds);
+        return bounds[1] - bounds[0];
+    }
+
+    handle_t FrozenPackedGraph::get_handle_of_step(const step_handle_t& step_handle) const {
+        return as_handle(step_handles.get(as_integers(step_handle)[1]));
+    }
+
+    path_handle_t FrozenPackedGraph::get_path_handle_of_step(const step_handle_t& step_handle) const {
+        return as_path_handle(as_integers(step_handle)[0]);
+    }
+
+    step_handle_t FrozenPackedGraph::path_begin(const path_handle_t& path_handle) const {
+        step_handle_t step;
+        as_integers(step)[0] = as_integer(path_handle);
+        as_integers(step)[1] = path_step_starts.get(as_integer(path_handle));
+        return step;
+    }
+
+    step_handle_t FrozenPackedGraph::path_end(const path_handle_t& path_handle) const {
+        step_handle_t step;
+        as_integers(step)[0] = as_integer(path_handle);
+        as_integers(step)[1] = path_step_starts.get(as_integer(path_handle) + 1);
+        return step;
+    }
+
+    step_handle_t FrozenPackedGraph::path_back(const path_handle_t& path_handle) const {
+        // for an empty path, this is the same as the front end
+        step_handle_t step = path_end(path_handle);
+        --as_integers(step)[1];
+        return step;
+    }
+
+    step_handle_t FrozenPackedGraph::path_front_end(const path_handle_t& path_handle) const {
+        step_handle_t step = path_begin(path_handle);
+        --as_integers(step)[1];
+        return step;
+    }
+
+    bool FrozenPackedGraph::has_next_step(const step_handle_t& step_handle) const {
+        path_handle_t path_handle = as_path_handle(as_integers(step_handle)[0]);
+        return get_is_circular(path_handle)
+            || as_integers(step_handle)[1] + 1 < as_integers(path_end(path_handle))[1];
+    }
+
+    bool FrozenPackedGraph::has_previous_step(const step_handle_t& step_handle) const {
+        path_handle_t path_handle = as_path_handle(as_integers(step_handle)[0]);
+        return get_is_circular(path_handle)
+            || as_integers(step_handle)[1] > as_integers(path_begin(path_handle))[1];
+    }
+
+    step_handle_t FrozenPackedGraph::get_next_step(const step_handle_t& step_handle) const {
+        step_handle_t next = step_handle;
+        ++as_integers(next)[1];
+        path_handle_t path_handle = as_path_handle(as_integers(step_handle)[0]);
+        // only circular paths need to know where they end
+        if (get_is_circular(path_handle)) {
+            uint64_t bounds[2];
+            get_path_bounds(path_handle, bounds);
+            if (as_integers(next)[1] == bounds[1]) {
+                as_integers(next)[1] = bounds[0];
+            }
+        }
+        return next;
+    }
+
+    step_handle_t FrozenPackedGraph::get_previous_step(const step_handle_t& step_handle) const {
+        step_handle_t prev = step_handle;
+        path_handle_t path_handle = as_path_handle(as_integers(step_handle)[0]);
+        if (get_is_circular(path_handle)) {
+            uint64_t bounds[2];
+            get_path_bounds(path_handle, bounds);
+            if (as_integers(prev)[1] == bounds[0]) {
+                as_integers(prev)[1] = bounds[1];
+            }
+        }
+        --as_integers(prev)[1];
+        return prev;
+    }
+
+    bool FrozenPackedGraph::for_each_path_handle_impl(const std::function<bool(const path_handle_t&)>& iteratee) const {
+        for (size_t i = 0; i < get_path_count(); ++i) {
+            if (!iteratee(as_path_handle(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool FrozenPackedGraph::for_each_step_on_handle_impl(const handle_t& handle,
+                                                         const std::function<bool(const step_handle_t&)>& iteratee) const {
+        uint64_t bounds[2];
+        node_visit_starts.get_range(get_rank(handle), 2, bounds);
+        for (uint64_t i = bounds[0]; i < bounds[1]; ++i) {
+            size_t step_index = node_visits.get(i);
+            step_handle_t step;
+            as_integers(step)[0] = get_path_of_step_index(step_index);
+            as_integers(step)[1] = step_index;
+            if (!iteratee(step)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t FrozenPackedGraph::memory_usage() const {
+        return sizeof(min_id) + sizeof(max_id) + sizeof(node_count) + node_ids.memory_usage() + id_to_rank.memory_usage()
+            + bases.memory_usage() + sequence_starts.memory_usage()
+            + edge_targets.memory_usage() + sizeof(reversing_self_edges) + edge_starts.memory_usage()
+            + path_names.memory_usage() + path_name_starts.memory_usage()
+            + path_is_circular.memory_usage() + step_handles.memory_usage()
+            + path_step_starts.memory_usage() + node_visits.memory_usage()
+            + node_visit_starts.memory_usage();
+    }
+    
+    MemoryReport FrozenPackedGraph::memory_report() const {
+        MemoryReport report("graph", sizeof(min_id) + sizeof(max_id) + sizeof(node_count) + sizeof(reversing_self_edges));
+        report.entries = node_count;
+        report.add_child(node_ids.memory_report("node_ids"));
+        report.add_child(id_to_rank.memory_report("id_to_rank"));
+        report.add_child(bases.memory_report("bases"));
+        report.add_child(sequence_starts.memory_report("sequence_starts"));
+        report.add_child(edge_targets.memory_report("edge_targets"));
+        report.add_child(edge_starts.memory_report("edge_starts"));
+        report.add_child(path_names.memory_report("path_names"));
+        report.add_child(path_name_starts.memory_report("path_name_starts"));
+        report.add_child(path_is_circular.memory_report("path_is_circular"));
+        report.add_child(step_handles.memory_report("step_handles"));
+        report.add_child(path_step_starts.memory_report("path_step_starts"));
+        report.add_child(node_visits.memory_report("node_visits"));
+        report.add_child(node_visit_starts.memory_report("node_visit_starts"));
+        return report;
+    }
+}
@@ -5,8 +5,14 @@
 #include "bdsg/hash_graph.hpp"
 
 #include <handlegraph/util.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <exception>
 #include <unordered_set>
 
+#include <omp.h> // BINDER_IGNORE because Binder can't find this
+
 namespace bdsg {
     
     using namespace handlegraph;
@@ -15,6 +21,10 @@ namespace bdsg {
         
     }
     
+    HashGraph::HashGraph(sequence_storage_t sequence_storage) : sequences(sequence_storage == PACKED_SEQUENCES) {
+        
+    }
+    
     HashGraph::~HashGraph() {
         
     }
@@ -28,11 +38,15 @@ namespace bdsg {
     }
 
     HashGraph& HashGraph::operator=(const HashGraph& other) {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        sequences = sequence_arena_t(other.sequences.is_packed());
         
         max_id = other.max_id;
         min_id = other.min_id;
         path_id = other.path_id;
-        paths = other.paths;
         next_path_id = other.next_path_id;
         
         // can't directly copy the nodes, because their pointers to path mappings
@@ -40,7 +54,11 @@ namespace bdsg {
         graph.reserve(other.graph.size());
         for (const auto& node_rec : other.graph) {
             
-            graph[node_rec.first] = node_t(node_rec.second.sequence);
+            // copy only the live parts of the sequence arena
+            const node_t& other_node = node_rec.second;
+            graph[node_rec.first] = node_t(sequences.append(other.sequences.extract(other_node.sequence_start,
+                                                                                    other_node.sequence_length)),
+                                           other_node.sequence_length);
             
             node_t& node = graph[node_rec.first];
             node.left_edges = node_rec.second.left_edges;
@@ -49,24 +67,41 @@ namespace bdsg {
             node.occurrences.reserve(node_rec.second.occurrences.size());
         }
         
-        // and rebuild the occurrence index for the new pointers
-        for_each_path_handle_impl([&](const path_handle_t& path) {
-            for_each_step_in_path(path, [&](const step_handle_t& step) {
-                path_mapping_t* mapping = (path_mapping_t*) intptr_t(as_integers(step)[1]);
-                graph[get_id(mapping->handle)].occurrences.push_back(mapping);
-            });
-            return true;
-        });
+        // copy the paths into our own pool and rebuild the occurrence index
+        // for the new pointers
+        paths.reserve(other.paths.size());
+        for (const pair<const int64_t, path_t>& path_record : other.paths) {
+            const path_t& other_path = path_record.second;
+            path_t& path = paths[path_record.first];
+            path = path_t(other_path.name, other_path.path_id, other_path.is_circular);
+            bool first_iter = true;
+            for (path_mapping_t* mapping = other_path.head;
+                 mapping != nullptr && (first_iter || mapping != other_path.head); // for circular paths
+                 mapping = mapping->next) {
+                
+                path_mapping_t* copied = path.push_back(path_mappings, mapping->handle);
+                graph[get_id(copied->handle)].occurrences.push_back(copied);
+                first_iter = false;
+            }
+        }
         return *this;
     }
 
     HashGraph& HashGraph::operator=(HashGraph&& other) {
+        if (this == &other) {
+            return *this;
+        }
         max_id = other.max_id;
         min_id = other.min_id;
         graph = move(other.graph);
+        sequences = move(other.sequences);
         path_id = move(other.path_id);
         paths = move(other.paths);
+        path_mappings = move(other.path_mappings);
         next_path_id = other.next_path_id;
+        // the other graph's paths no longer own any steps, so make sure it
+        // doesn't hold on to any of them
+        other.clear();
         return *this;
     }
     
@@ -83,7 +118,7 @@ namespace bdsg {
        
         // TODO: We can't actually ban empty nodes yet. vg::algorithms::extract_extending_graph needs them.
         // Maybe define a tag interface for graphs that can have them?
-        graph[id] = node_t(sequence);
+        graph[id] = node_t(sequences.append(sequence), sequence.size());
         max_id = max(max_id, id);
         min_id = min(min_id, id);
         return get_handle(id, false);
@@ -140,13 +175,18 @@ namespace bdsg {
         return handlegraph::number_bool_packing::toggle_bit(handle);
     }
     
+    HashGraph::sequence_storage_t HashGraph::get_sequence_storage() const {
+        return sequences.is_packed() ? PACKED_SEQUENCES : BYTE_SEQUENCES;
+    }
+    
     size_t HashGraph::get_length(const handle_t& handle) const {
-        return graph.at(get_id(handle)).sequence.size();
+        return graph.at(get_id(handle)).sequence_length;
     }
     
     string HashGraph::get_sequence(const handle_t& handle) const {
-        return get_is_reverse(handle) ? reverse_complement(graph.at(get_id(handle)).sequence)
-                                      : graph.at(get_id(handle)).sequence;
+        const node_t& node = graph.at(get_id(handle));
+        string seq = sequences.extract(node.sequence_start, node.sequence_length);
+        return get_is_reverse(handle) ? reverse_complement(seq) : seq;
     }
     
     bool HashGraph::follow_edges_impl(const handle_t& handle, bool go_left,
@@ -181,41 +221,53 @@ namespace bdsg {
     }
     
     char HashGraph::get_base(const handle_t& handle, size_t index) const {
-        const string& seq = graph.at(get_id(handle)).sequence;
-        return get_is_reverse(handle) ? reverse_complement(seq.at(seq.size() - index - 1)) : seq.at(index);
+        const node_t& node = graph.at(get_id(handle));
+        if (index >= node.sequence_length) {
+            throw out_of_range("error:[HashGraph] base index " + to_string(index) + " is past the end of node " + to_string(get_id(handle)));
+        }
+        return get_is_reverse(handle) ? reverse_complement(sequences.get_base(node.sequence_start + node.sequence_length - index - 1))
+                                      : sequences.get_base(node.sequence_start + index);
     }
     
     string HashGraph::get_subsequence(const handle_t& handle, size_t index, size_t size) const {
-        const string& seq = graph.at(get_id(handle)).sequence;
-        size = min(size, seq.size() - index);
-        return get_is_reverse(handle) ? reverse_complement(seq.substr(seq.size() - index - size, size)) : seq.substr(index, size);
+        const node_t& node = graph.at(get_id(handle));
+        if (index > node.sequence_length) {
+            throw out_of_range("error:[HashGraph] subsequence index " + to_string(index) + " is past the end of node " + to_string(get_id(handle)));
+        }
+        size = min(size, node.sequence_length - index);
+        return get_is_reverse(handle) ? reverse_complement(sequences.extract(node.sequence_start + node.sequence_length - index - size, size))
+                                      : sequences.extract(node.sequence_start + index, size);
     }
     
     bool HashGraph::for_each_handle_impl(const std::function<bool(const handle_t&)>& iteratee,
                                          bool parallel) const {
         
-        bool keep_going = true;
         if (parallel) {
-#pragma omp parallel shared(keep_going)
-            {
-#pragma omp single
-                {
-                    for (auto it = graph.begin(); it != graph.end() && keep_going; it++) {
-#pragma omp task
-                        {
-                            bool thread_keep_going = iteratee(get_handle(it->first));
-#pragma omp atomic
-                            keep_going = keep_going & thread_keep_going; // OMP only likes bitwise AND
+            // Hand out contiguous blocks of hash table buckets to the threads, so that
+            // scheduling costs are paid once per block rather than once per node. Dynamic
+            // scheduling lets threads that finish early pick up the remaining blocks.
+            std::atomic<bool> keep_going(true);
+            size_t bucket_count = graph.bucket_count();
+#pragma omp parallel for schedule(dynamic, 1)
+            for (size_t block_start = 0; block_start < bucket_count; block_start += PARALLEL_BUCKET_BLOCK_SIZE) {
+                size_t block_end = block_start + PARALLEL_BUCKET_BLOCK_SIZE < bucket_count ?
+                                   block_start + PARALLEL_BUCKET_BLOCK_SIZE : bucket_count;
+                for (size_t i = block_start; i < block_end && keep_going.load(std::memory_order_relaxed); ++i) {
+                    for (auto it = graph.begin(i); it != graph.end(i); ++it) {
+                        if (!iteratee(get_handle(it->first))) {
+                            // other threads only need to notice this eventually
+                            keep_going.store(false, std::memory_order_relaxed);
+                            break;
                         }
                     }
                 }
             }
-            
+            return keep_going.load();
         }
-        else {
-            for (auto it = graph.begin(); it != graph.end() && keep_going; it++) {
-                keep_going = iteratee(get_handle(it->first));
-            }
+        
+        bool keep_going = true;
+        for (auto it = graph.begin(); it != graph.end() && keep_going; it++) {
+            keep_going = iteratee(get_handle(it->first));
         }
         
         return keep_going;
@@ -230,10 +282,10 @@ namespace bdsg {
         
         // reverse the sequence
         node_t& node = graph[get_id(handle)];
-        node.sequence = reverse_complement(node.sequence);
+        sequences.set(node.sequence_start, reverse_complement(sequences.extract(node.sequence_start, node.sequence_length)));
         
         // reverse the orientation of the handle in the edge lists
-        for (vector<handle_t>* edge_list : {&node.left_edges, &node.right_edges}) {
+        for (edge_list_t* edge_list : {&node.left_edges, &node.right_edges}) {
             for (const handle_t& target : *edge_list) {
                 node_t& other_node = graph[get_id(target)];
                 auto& bwd_edge_list = get_is_reverse(target) ? other_node.right_edges : other_node.left_edges;
@@ -286,9 +338,12 @@ namespace bdsg {
         // divvy up the sequence onto separate nodes
         for (size_t i = 0; i < forward_offsets.size(); i++) {
             size_t length = (i + 1 < forward_offsets.size() ? forward_offsets[i + 1] : node_length) - forward_offsets[i];
-            return_val.push_back(create_handle(graph[get_id(handle)].sequence.substr(forward_offsets[i], length)));
+            return_val.push_back(create_handle(sequences.extract(graph[get_id(handle)].sequence_start + forward_offsets[i], length)));
         }
-        graph[get_id(handle)].sequence = graph[get_id(handle)].sequence.substr(0, forward_offsets.front());
+        // the original node keeps the prefix
+        node_t& prefix_node = graph[get_id(handle)];
+        sequences.release(prefix_node.sequence_length - forward_offsets.front());
+        prefix_node.sequence_length = forward_offsets.front();
         
         // move the edges out the end of the node to the final one
         node_t& final_node = graph[get_id(return_val.back())];
@@ -323,14 +378,14 @@ namespace bdsg {
             path_t& path = paths[mapping->path_id];
             if (get_is_reverse(mapping->handle)) {
                 for (size_t i = return_val.size() - 1; i > 0; i--) {
-                    path_mapping_t* new_mapping = path.insert_before(flip(return_val[i]), mapping);
+                    path_mapping_t* new_mapping = path.insert_before(path_mappings, flip(return_val[i]), mapping);
                     graph[get_id(return_val[i])].occurrences.push_back(new_mapping);
                 }
             }
             else {
                 mapping = mapping->next;
                 for (size_t i = 1; i < return_val.size(); i++) {
-                    path_mapping_t* new_mapping = path.insert_before(return_val[i], mapping);
+                    path_mapping_t* new_mapping = path.insert_before(path_mappings, return_val[i], mapping);
                     graph[get_id(return_val[i])].occurrences.push_back(new_mapping);
                 }
             }
@@ -344,17 +399,19 @@ namespace bdsg {
             }
         }
         
+        compact_sequences_if_fragmented();
+        
         return return_val;
     }
     
     void HashGraph::optimize(bool allow_id_reassignment) {
         /// tighten up the memory allocated to the vectors in the data structure
         for (pair<const nid_t, node_t>& node_record : graph) {
-            node_record.second.sequence.shrink_to_fit();
             node_record.second.left_edges.shrink_to_fit();
             node_record.second.right_edges.shrink_to_fit();
             node_record.second.occurrences.shrink_to_fit();
         }
+        compact_sequences();
         // reassign hash tables to the midpoint of their max and min load factors
         // TODO: is this a good way to choose load factor?
         graph.rehash(graph.size() * 0.5 * (graph.min_load_factor() + graph.max_load_factor()));
@@ -382,7 +439,7 @@ namespace bdsg {
         
         // remove backwards references from edges on other nodes
         node_t& node = graph[get_id(handle)];
-        for (vector<handle_t>* edge_list : {&node.left_edges, &node.right_edges}) {
+        for (edge_list_t* edge_list : {&node.left_edges, &node.right_edges}) {
             for (const handle_t& next : *edge_list) {
                 auto& bwd_edge_list = get_is_reverse(next) ? graph[get_id(next)].right_edges : graph[get_id(next)].left_edges;
                 for (handle_t& bwd_target : bwd_edge_list) {
@@ -396,7 +453,10 @@ namespace bdsg {
         }
         
         // remove this node from the relevant indexes
+        sequences.release(node.sequence_length);
         graph.erase(get_id(handle));
+        
+        compact_sequences_if_fragmented();
     }
     
     void HashGraph::destroy_edge(const handle_t& left, const handle_t& right) {
@@ -453,7 +513,9 @@ namespace bdsg {
             }
             // remove references on this node
             node.left_edges.clear();
-            node.sequence = node.sequence.substr(offset, string::npos);
+            sequences.release(offset);
+            node.sequence_start += offset;
+            node.sequence_length -= offset;
         }
         else {
             // remove references on the other nodes
@@ -474,9 +536,12 @@ namespace bdsg {
             }
             // remove references on this node
             node.right_edges.clear();
-            node.sequence.resize(offset);
+            sequences.release(node.sequence_length - offset);
+            node.sequence_length = offset;
         }
         
+        compact_sequences_if_fragmented();
+        
         return handle;
     }
     
@@ -485,8 +550,10 @@ namespace bdsg {
         min_id = numeric_limits<nid_t>::max();
         next_path_id = 1;
         graph.clear();
+        sequences.clear();
         path_id.clear();
         paths.clear();
+        path_mappings.clear();
     }
     
     size_t HashGraph::get_path_count() const {
@@ -620,7 +687,7 @@ namespace bdsg {
                         return;
                     }
                 }
-                vector<path_mapping_t*>& node_occs = graph[get_id(mapping->handle)].occurrences;
+                occurrence_list_t& node_occs = graph[get_id(mapping->handle)].occurrences;
                 for (size_t i = 0; i < node_occs.size(); ) {
                     if (first_path != -1 ? node_occs[i]->path_id == first_path : path_ids.count(node_occs[i]->path_id)) {
                         node_occs[i] = node_occs.back();
@@ -633,7 +700,9 @@ namespace bdsg {
             });
             
             // erase the path itself
-            path_id.erase(this->paths[as_integer(path)].name);
+            path_t& path_list = this->paths[as_integer(path)];
+            path_list.release(path_mappings);
+            path_id.erase(path_list.name);
             this->paths.erase(as_integer(path));
         }
     }
@@ -648,7 +717,7 @@ namespace bdsg {
     step_handle_t HashGraph::append_step(const path_handle_t& path, const handle_t& to_append) {
         
         path_t& path_list = paths[as_integer(path)];
-        path_mapping_t* mapping = path_list.push_back(to_append);
+        path_mapping_t* mapping = path_list.push_back(path_mappings, to_append);
         graph[get_id(to_append)].occurrences.push_back(mapping);
         
         step_handle_t step;
@@ -660,7 +729,7 @@ namespace bdsg {
     step_handle_t HashGraph::prepend_step(const path_handle_t& path, const handle_t& to_prepend) {
         
         path_t& path_list = paths[as_integer(path)];
-        path_mapping_t* mapping = path_list.push_front(to_prepend);
+        path_mapping_t* mapping = path_list.push_front(path_mappings, to_prepend);
         graph[get_id(to_prepend)].occurrences.push_back(mapping);
         
         step_handle_t step;
@@ -698,7 +767,7 @@ namespace bdsg {
             path_mapping_t* next = mapping->next;
             
             // remove the step from the path
-            path_list.remove(mapping);
+            path_list.remove(path_mappings, mapping);
             
             mapping = next;
         }
@@ -710,7 +779,7 @@ namespace bdsg {
         bool first_iter = true;
         for (const handle_t& handle : new_segment) {
             
-            path_mapping_t* mapping = path_list.insert_before(handle, end);
+            path_mapping_t* mapping = path_list.insert_before(path_mappings, handle, end);
             graph[get_id(handle)].occurrences.push_back(mapping);
             
             if (first_iter) {
@@ -769,15 +838,17 @@ namespace bdsg {
             auto& new_record = new_graph[new_id];
             
             // Move and copy to fill it
-            new_record.sequence = std::move(record.sequence);
+            new_record.sequence_start = record.sequence_start;
+            new_record.sequence_length = record.sequence_length;
             new_record.left_edges.reserve(record.left_edges.size());
             for (const handle_t& old_handle : record.left_edges) {
                 // Transform the IDs in all the handles for left edges
-                new_record.left_edges.emplace_back(set_id(old_handle, get_new_id(get_id(old_handle))));
+                new_record.left_edges.push_back(set_id(old_handle, get_new_id(get_id(old_handle))));
             }
+            new_record.right_edges.reserve(record.right_edges.size());
             for (const handle_t& old_handle : record.right_edges) {
                 // Transform the IDs in all the handles for right edges
-                new_record.right_edges.emplace_back(set_id(old_handle, get_new_id(get_id(old_handle))));
+                new_record.right_edges.push_back(set_id(old_handle, get_new_id(get_id(old_handle))));
             }
             new_record.occurrences = std::move(record.occurrences);
         
@@ -815,132 +886,15 @@ namespace bdsg {
         
     }
     
-    HashGraph::path_t::path_t(path_t&& other) : head(other.head), tail(other.tail), path_id(other.path_id), count(other.count), name(move(other.name)), is_circular(other.is_circular) {
-        // we grabbed the data in the initializer, now make sure the other one is in a valid state
-        other.head = nullptr;
-        other.tail = nullptr;
-        other.path_id = 0;
-        other.count = 0;
+    HashGraph::path_mapping_t* HashGraph::path_t::push_back(path_mapping_pool_t& pool, const handle_t& handle) {
+        return insert_before(pool, handle, nullptr);
     }
     
-    HashGraph::path_t& HashGraph::path_t::operator=(path_t&& other) {
-        if (this != &other) {
-            // free existing list
-            this->~path_t();
-            
-            // steal other list
-            head = other.head;
-            tail = other.tail;
-            other.head = nullptr;
-            other.tail = nullptr;
-            
-            name = move(other.name);
-            
-            is_circular = other.is_circular;
-            
-            path_id = other.path_id;
-            other.path_id = 0;
-            
-            count = other.count;
-            other.count = 0;
-        }
-        return *this;
-    }
-    
-    HashGraph::path_t::path_t(const path_t& other) : path_id(other.path_id), count(other.count), name(other.name), is_circular(other.is_circular) {
-        
-        path_mapping_t* prev = nullptr;
-        bool first_iter = true;
-        for (path_mapping_t* mapping = other.head;
-             mapping != nullptr && (first_iter || mapping != other.head); // in case we loop around a circular path
-             mapping = mapping->next) {
-            
-            path_mapping_t* copied = new path_mapping_t(mapping->handle, mapping->path_id);
-            
-            if (!head) {
-                head = copied;
-            }
-            if (prev) {
-                prev->next = copied;
-                copied->prev = prev;
-            }
-            prev = copied;
-            first_iter = false;
-        }
-        tail = prev;
-        
-        // we only loop over each mapping one time, so we may need to add in the last connection
-        // in a circular path
-        if (is_circular) {
-            tail->next = head;
-            head->prev = tail;
-        }
+    HashGraph::path_mapping_t* HashGraph::path_t::push_front(path_mapping_pool_t& pool, const handle_t& handle) {
+        return insert_before(pool, handle, head);
     }
     
-    HashGraph::path_t& HashGraph::path_t::operator=(const path_t& other) {
-        if (this != &other) {
-            // free existing list
-            this->~path_t();
-            
-            // copy the other list
-            path_mapping_t* prev = nullptr;
-            bool first_iter = true;
-            for (path_mapping_t* mapping = other.head;
-                 mapping != nullptr && (first_iter || mapping != other.head); // in case we loop around a circular path
-                 mapping = mapping->next) {
-                
-                path_mapping_t* copied = new path_mapping_t(mapping->handle, mapping->path_id);
-                
-                if (!head) {
-                    head = copied;
-                }
-                if (prev) {
-                    prev->next = copied;
-                    copied->prev = prev;
-                }
-                prev = copied;
-                first_iter = false;
-            }
-            tail = prev;
-            
-            // copy the rest of the info
-            path_id = other.path_id;
-            name = other.name;
-            count = other.count;
-            is_circular = other.is_circular;
-            
-            // we only loop over each mapping one time, so we may need to add in the last connection
-            // in a circular path
-            if (is_circular) {
-                tail->next = head;
-                head->prev = tail;
-            }
-        }
-        return *this;
-    }
-    
-    HashGraph::path_t::~path_t() {
-        bool first_iter = true;
-        for (path_mapping_t* mapping = head;
-             mapping != nullptr && (first_iter || mapping != head);) { // for circular paths
-            
-            path_mapping_t* next = mapping->next;
-            delete mapping;
-            mapping = next;
-            
-            first_iter = false;
-        }
-    }
-    
-    HashGraph::path_mapping_t* HashGraph::path_t::push_back(const handle_t& handle) {
-        return insert_before(handle, nullptr);
-    }
-    
-    HashGraph::path_mapping_t* HashGraph::path_t::push_front(const handle_t& handle) {
-        return insert_before(handle, head);
-    }
-    
-    void HashGraph::path_t::remove(path_mapping_t* mapping) {
+    void HashGraph::path_t::remove(path_mapping_pool_t& pool, path_mapping_t* mapping) {
         if (mapping == head) {
             head = mapping->next != mapping ? mapping->next : nullptr;
         }
@@ -954,12 +908,13 @@ namespace bdsg {
             mapping->prev->next = mapping->next;
         }
         count--;
-        delete mapping;
+        pool.deallocate(mapping);
     }
     
-    HashGraph::path_mapping_t* HashGraph::path_t::insert_before(const handle_t& handle, path_mapping_t* mapping) {
+    HashGraph::path_mapping_t* HashGraph::path_t::insert_before(path_mapping_pool_t& pool, const handle_t& handle,
+                                                                path_mapping_t* mapping) {
         
-        path_mapping_t* inserting = new path_mapping_t(handle, path_id);
+        path_mapping_t* inserting = pool.allocate(handle, path_id);
         
         if (mapping) {
             inserting->prev = mapping->prev;
@@ -1000,6 +955,22 @@ namespace bdsg {
         return inserting;
     }
     
+    void HashGraph::path_t::release(path_mapping_pool_t& pool) {
+        bool first_iter = true;
+        for (path_mapping_t* mapping = head;
+             mapping != nullptr && (first_iter || mapping != head);) { // for circular paths
+            
+            path_mapping_t* next = mapping->next;
+            pool.deallocate(mapping);
+            mapping = next;
+            
+            first_iter = false;
+        }
+        head = nullptr;
+        tail = nullptr;
+        count = 0;
+    }
+    
     void HashGraph::path_t::serialize(ostream& out) const {
         
         out.write((const char*) &is_circular, sizeof(is_circular) / sizeof(char));
@@ -1027,9 +998,14 @@ namespace bdsg {
         }
     }
     
-    void HashGraph::path_t::deserialize(istream& in) {
+    size_t HashGraph::path_t::serialized_size() const {
+        return sizeof(is_circular) + sizeof(int64_t) + sizeof(uint64_t) + name.size()
+            + sizeof(uint64_t) + count * sizeof(int64_t);
+    }
+    
+    void HashGraph::path_t::deserialize(path_mapping_pool_t& pool, istream& in) {
         // free the current path if it exists
-        this->~path_t();
+        release(pool);
         in.read((char*) &is_circular, sizeof(is_circular) / sizeof(char));
         
         int64_t path_id_in;
@@ -1055,12 +1031,90 @@ namespace bdsg {
             int64_t step_in;
             in.read((char*) &step_in, sizeof(step_in) / sizeof(char));
             int64_t step = endianness<int64_t>::from_big_endian(step_in);
-            push_back(as_handle(step));
+            push_back(pool, as_handle(step));
         }
     }
     
-    void HashGraph::node_t::serialize(ostream& out) const {
+    HashGraph::path_mapping_pool_t::path_mapping_pool_t(path_mapping_pool_t&& other) :
+        slabs(move(other.slabs)), last_slab_size(other.last_slab_size),
+        last_slab_used(other.last_slab_used), free_list(other.free_list) {
         
+        // the slabs came along with the vector, so leave the other one empty
+        other.clear();
+    }
+    
+    HashGraph::path_mapping_pool_t& HashGraph::path_mapping_pool_t::operator=(path_mapping_pool_t&& other) {
+        if (this != &other) {
+            slabs = move(other.slabs);
+            last_slab_size = other.last_slab_size;
+            last_slab_used = other.last_slab_used;
+            free_list = other.free_list;
+            other.clear();
+        }
+        return *this;
+    }
+    
+    HashGraph::path_mapping_t* HashGraph::path_mapping_pool_t::allocate(const handle_t& handle,
+                                                                        const int64_t& path_id) {
+        void* slot;
+        if (free_list) {
+            // reuse a record that was freed earlier
+            slot = free_list;
+            free_list = free_list->next;
+        }
+        else {
+            if (last_slab_used == last_slab_size) {
+                // the last slab is full, add a bigger one
+                last_slab_size = last_slab_size == 0 ? MIN_SLAB_SIZE :
+                                 last_slab_size < MAX_SLAB_SIZE ? 2 * last_slab_size : last_slab_size;
+                slabs.emplace_back(new slot_t[last_slab_size]);
+                last_slab_used = 0;
+            }
+            slot = &slabs.back()[last_slab_used++];
+        }
+        return new (slot) path_mapping_t(handle, path_id);
+    }
+    
+    void HashGraph::path_mapping_pool_t::deallocate(path_mapping_t* mapping) {
+        // records are trivially destructible, so we can just thread them onto the
+        // free list through their next pointers
+        mapping->next = free_list;
+        free_list = mapping;
+    }
+    
+    void HashGraph::path_mapping_pool_t::clear() {
+        slabs.clear();
+        slabs.shrink_to_fit();
+        last_slab_size = 0;
+        last_slab_used = 0;
+        free_list = nullptr;
+    }
+    
+    void HashGraph::path_mapping_pool_t::absorb(path_mapping_pool_t& other) {
+        if (other.slabs.empty()) {
+            return;
+        }
+        if (slabs.empty()) {
+            *this = move(other);
+            return;
+        }
+        // keep allocating from our own last slab, and give up on whatever room
+        // is left in the other one
+        slabs.insert(slabs.end() - 1, make_move_iterator(other.slabs.begin()), make_move_iterator(other.slabs.end()));
+        if (other.free_list) {
+            path_mapping_t* free_tail = other.free_list;
+            while (free_tail->next) {
+                free_tail = free_tail->next;
+            }
+            free_tail->next = free_list;
+            free_list = other.free_list;
+        }
+        other.clear();
+    }
+    
+    void HashGraph::node_t::serialize(const sequence_arena_t& sequences, ostream& out) const {
+        
+        string sequence = sequences.extract(sequence_start, sequence_length);
         uint64_t seq_size_out = endianness<uint64_t>::to_big_endian( sequence.size());
         out.write((const char*) &seq_size_out, sizeof(seq_size_out) / sizeof(char));
         out.write(sequence.c_str(), sequence.size());
@@ -1083,15 +1137,23 @@ namespace bdsg {
         // path and the value requires an in memory representation of the paths
     }
     
-    void HashGraph::node_t::deserialize(istream& in) {
+    size_t HashGraph::node_t::serialized_size() const {
+        return sizeof(uint64_t) + sequence_length
+            + sizeof(uint64_t) + left_edges.size() * sizeof(int64_t)
+            + sizeof(uint64_t) + right_edges.size() * sizeof(int64_t);
+    }
+    
+    void HashGraph::node_t::deserialize(sequence_arena_t& sequences, istream& in) {
         
         uint64_t seq_size_in;
         in.read((char*) &seq_size_in, sizeof(seq_size_in) / sizeof(char));
         uint64_t seq_size = endianness<uint64_t>::from_big_endian(seq_size_in);
-        sequence.resize(seq_size);
+        string sequence(seq_size, '\0');
         for (size_t i = 0; i < sequence.size(); i++) {
             in.read((char*) &sequence[i], sizeof(char));
         }
+        sequence_start = sequences.append(sequence);
+        sequence_length = sequence.size();
         
         uint64_t num_left_edges_in;
         in.read((char*) &num_left_edges_in, sizeof(num_left_edges_in) / sizeof(char));
@@ -1116,38 +1178,262 @@ namespace bdsg {
         }
     }
     
+    /// Write an integer to a stream in big-endian order
+    template<typename IntType>
+    static void write_big_endian(IntType value, ostream& out) {
+        IntType value_out = endianness<IntType>::to_big_endian(value);
+        out.write((const char*) &value_out, sizeof(value_out) / sizeof(char));
+    }
+    
+    /// Read an integer in big-endian order from a stream
+    template<typename IntType>
+    static IntType read_big_endian(istream& in) {
+        IntType value_in = 0;
+        in.read((char*) &value_in, sizeof(value_in) / sizeof(char));
+        return endianness<IntType>::from_big_endian(value_in);
+    }
+    
     void HashGraph::serialize_members(ostream& out) const {
-        nid_t max_id_out = endianness<nid_t>::to_big_endian(max_id);
-        out.write((const char*) &max_id_out, sizeof(max_id_out) / sizeof(char));
-        
-        nid_t min_id_out = endianness<nid_t>::to_big_endian(min_id);
-        out.write((const char*) &min_id_out, sizeof(min_id_out) / sizeof(char));
-        
-        int64_t next_path_id_out = endianness<int64_t>::to_big_endian(next_path_id);
-        out.write((const char*) &next_path_id_out, sizeof(next_path_id_out) / sizeof(char));
+        // The nodes are split into blocks by ID range, and each path gets a
+        // block of its own, so that the blocks can be encoded and decoded in
+        // parallel. A table of contents locates each block.
+        size_t node_block_count = (graph.size() + NODES_PER_BLOCK - 1) / NODES_PER_BLOCK;
+        vector<vector<pair<nid_t, const node_t*>>> node_blocks(node_block_count);
+        if (node_block_count != 0) {
+            uint64_t block_width = ((uint64_t) max_id - (uint64_t) min_id) / node_block_count + 1;
+            for (const pair<const nid_t, node_t>& node_record : graph) {
+                uint64_t block = ((uint64_t) node_record.first - (uint64_t) min_id) / block_width;
+                node_blocks[min<uint64_t>(block, node_block_count - 1)].emplace_back(node_record.first,
+                                                                                   &node_record.second);
+            }
+        }
+        vector<const path_t*> path_blocks;
+        path_blocks.reserve(paths.size());
+        for (const pair<const int64_t, path_t>& path_record : paths) {
+            path_blocks.push_back(&path_record.second);
+        }
         
-        uint64_t graph_size_out = endianness<uint64_t>::to_big_endian(graph.size());
-        out.write((const char*) &graph_size_out, sizeof(graph_size_out) / sizeof(char));
+        // size the blocks first, so that the table of contents can be written
+        // before them and they can be streamed out without keeping them all
+        size_t block_count = node_block_count + path_blocks.size();
+        vector<uint64_t> block_sizes(block_count);
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0; i < block_count; ++i) {
+            if (i < node_block_count) {
+                // write the nodes in ID order so the output doesn't depend on the hash table
+                auto& node_block = node_blocks[i];
+                sort(node_block.begin(), node_block.end());
+                block_sizes[i] = sizeof(uint64_t);
+                for (const pair<nid_t, const node_t*>& node_record : node_block) {
+                    block_sizes[i] += sizeof(nid_t) + node_record.second->serialized_size();
+                }
+            }
+            else {
+                block_sizes[i] = path_blocks[i - node_block_count]->serialized_size();
+            }
+        }
         
-        for (const pair<nid_t, node_t>& node_record : graph) {
-            nid_t node_id_out = endianness<nid_t>::to_big_endian(node_record.first);
-            out.write((const char*) &node_id_out, sizeof(node_id_out) / sizeof(char));
-            node_record.second.serialize(out);
+        write_big_endian<int64_t>(SECTIONED_FORMAT_MARKER, out);
+        write_big_endian<uint64_t>(SECTIONED_FORMAT_VERSION, out);
+        write_big_endian<nid_t>(max_id, out);
+        write_big_endian<nid_t>(min_id, out);
+        write_big_endian<int64_t>(next_path_id, out);
+        write_big_endian<uint64_t>(graph.size(), out);
+        write_big_endian<uint64_t>(node_block_count, out);
+        write_big_endian<uint64_t>(path_blocks.size(), out);
+        // offsets of the block boundaries relative to the start of the body
+        uint64_t offset = 0;
+        write_big_endian<uint64_t>(offset, out);
+        for (uint64_t block_size : block_sizes) {
+            offset += block_size;
+            write_big_endian<uint64_t>(offset, out);
         }
         
-        uint64_t paths_size_out = endianness<uint64_t>::to_big_endian(paths.size());
-        out.write((const char*) &paths_size_out, sizeof(paths_size_out) / sizeof(char));
-        for (const pair<int64_t, path_t>& path_record : paths) {
-            path_record.second.serialize(out);
+        // encode the blocks a batch at a time, one per thread, so that only
+        // that many of them are ever held in memory
+        size_t batch_size = omp_get_max_threads();
+        vector<string> batch(batch_size);
+        for (size_t batch_start = 0; batch_start < block_count; batch_start += batch_size) {
+            size_t batch_end = min(batch_start + batch_size, block_count);
+#pragma omp parallel for schedule(dynamic, 1)
+            for (size_t i = batch_start; i < batch_end; ++i) {
+                stringstream strm;
+                if (i < node_block_count) {
+                    auto& node_block = node_blocks[i];
+                    write_big_endian<uint64_t>(node_block.size(), strm);
+                    for (const pair<nid_t, const node_t*>& node_record : node_block) {
+                        write_big_endian<nid_t>(node_record.first, strm);
+                        node_record.second->serialize(sequences, strm);
+                    }
+                }
+                else {
+                    path_blocks[i - node_block_count]->serialize(strm);
+                }
+                batch[i - batch_start] = strm.str();
+                assert(batch[i - batch_start].size() == block_sizes[i]);
+            }
+            for (size_t i = batch_start; i < batch_end; ++i) {
+                out.write(batch[i - batch_start].data(), batch[i - batch_start].size());
+            }
         }
     }
     
     void HashGraph::deserialize_members(istream& in) {
         clear();
         
-        nid_t max_id_in;
-        in.read((char*) &max_id_in, sizeof(max_id_in) / sizeof(char));
-        max_id = endianness<nid_t>::from_big_endian(max_id_in);
+        int64_t first = read_big_endian<int64_t>(in);
+        if (first != SECTIONED_FORMAT_MARKER) {
+            // this is the original layout, which begins with the max ID
+            max_id = first;
+            deserialize_unsectioned_members(in);
+            return;
+        }
+        
+        uint64_t version = read_big_endian<uint64_t>(in);
+        if (version != SECTIONED_FORMAT_VERSION) {
+            throw runtime_error("error:[HashGraph] cannot read serialized graph with unknown format version " + to_string(version));
+        }
+        max_id = read_big_endian<nid_t>(in);
+        min_id = read_big_endian<nid_t>(in);
+        next_path_id = read_big_endian<int64_t>(in);
+        uint64_t node_count = read_big_endian<uint64_t>(in);
+        uint64_t node_block_count = read_big_endian<uint64_t>(in);
+        uint64_t path_block_count = read_big_endian<uint64_t>(in);
+        if (!in) {
+            throw runtime_error("error:[HashGraph] serialized graph has an invalid table of contents");
+        }
+        vector<uint64_t> offsets(node_block_count + path_block_count + 1);
+        for (uint64_t& offset : offsets) {
+            offset = read_big_endian<uint64_t>(in);
+        }
+        if (!in) {
+            throw runtime_error("error:[HashGraph] serialized graph has an invalid table of contents");
+        }
+        
+        deserialize_blocks(in, offsets, node_block_count, node_count);
+    }
+    
+    void HashGraph::deserialize_blocks(istream& in, const vector<uint64_t>& offsets,
+                                       size_t node_block_count, size_t node_count) {
+        size_t block_count = offsets.size() - 1;
+        for (size_t i = 0; i < block_count; ++i) {
+            if (offsets[i] > offsets[i + 1]) {
+                throw runtime_error("error:[HashGraph] serialized graph has an invalid table of contents");
+            }
+        }
+        
+        // the hash tables and the step pool can't be filled concurrently, so
+        // we decode into separate pieces and then combine them
+        vector<vector<pair<nid_t, node_t>>> decoded_nodes(node_block_count);
+        vector<sequence_arena_t> decoded_sequences(node_block_count, sequence_arena_t(sequences.is_packed()));
+        vector<path_t> decoded_paths(block_count - node_block_count);
+        vector<path_mapping_pool_t> thread_path_mappings(omp_get_max_threads());
+        
+        // if the body is already in memory, we can decode it where it is, all at
+        // once. otherwise we read in a batch of blocks at a time, one per thread,
+        // so that we never hold more than that much of the body in memory
+        const char* body = nullptr;
+        size_t batch_size = block_count;
+        vector<string> batch;
+        auto memory_buffer = dynamic_cast<MemoryStreamBuffer*>(in.rdbuf());
+        if (memory_buffer && memory_buffer->remaining() >= offsets.back()) {
+            body = memory_buffer->position();
+        }
+        else {
+            batch_size = omp_get_max_threads();
+            batch.resize(batch_size);
+        }
+        
+        for (size_t batch_start = 0; batch_start < block_count; batch_start += batch_size) {
+            size_t batch_end = min(batch_start + batch_size, block_count);
+            if (!body) {
+                for (size_t i = batch_start; i < batch_end; ++i) {
+                    string& block = batch[i - batch_start];
+                    block.resize(offsets[i + 1] - offsets[i]);
+                    in.read(&block[0], block.size());
+                    if (!in) {
+                        throw runtime_error("error:[HashGraph] serialized graph is truncated");
+                    }
+                }
+            }
+            
+            // exceptions can't leave the parallel section, so we save the first one
+            exception_ptr error;
+#pragma omp parallel for schedule(dynamic, 1)
+            for (size_t i = batch_start; i < batch_end; ++i) {
+                try {
+                    MemoryStreamBuffer buffer(body ? body + offsets[i] : batch[i - batch_start].data(),
+                                              offsets[i + 1] - offsets[i]);
+                    istream in(&buffer);
+                    if (i < node_block_count) {
+                        uint64_t block_size = read_big_endian<uint64_t>(in);
+                        if (!in || block_size > offsets[i + 1] - offsets[i]) {
+                            throw runtime_error("error:[HashGraph] serialized graph has an invalid node block");
+                        }
+                        auto& nodes = decoded_nodes[i];
+                        nodes.resize(block_size);
+                        for (pair<nid_t, node_t>& node_record : nodes) {
+                            node_record.first = read_big_endian<nid_t>(in);
+                            node_record.second.deserialize(decoded_sequences[i], in);
+                        }
+                    }
+                    else {
+                        decoded_paths[i - node_block_count].deserialize(thread_path_mappings[omp_get_thread_num()], in);
+                    }
+                    if (!in) {
+                        throw runtime_error("error:[HashGraph] serialized graph is truncated");
+                    }
+                }
+                catch (...) {
+#pragma omp critical
+                    {
+                        if (!error) {
+                            error = current_exception();
+                        }
+                    }
+                }
+            }
+            if (error) {
+                rethrow_exception(error);
+            }
+        }
+        if (body) {
+            memory_buffer->advance(offsets.back());
+        }
+        batch.clear();
+        batch.shrink_to_fit();
+        
+        // move the nodes into the graph, relocating their sequences into our arena
+        graph.reserve(node_count);
+        for (size_t i = 0; i < node_block_count; ++i) {
+            size_t sequence_shift = sequences.append(decoded_sequences[i]);
+            decoded_sequences[i].clear();
+            for (pair<nid_t, node_t>& node_record : decoded_nodes[i]) {
+                node_record.second.sequence_start += sequence_shift;
+                graph[node_record.first] = move(node_record.second);
+            }
+            decoded_nodes[i].clear();
+            decoded_nodes[i].shrink_to_fit();
+        }
+        if (graph.size() != node_count) {
+            throw runtime_error("error:[HashGraph] serialized graph has inconsistent node counts");
+        }
+        
+        // take over the steps and then the paths that use them
+        for (path_mapping_pool_t& pool : thread_path_mappings) {
+            path_mappings.absorb(pool);
+        }
+        paths.reserve(decoded_paths.size());
+        path_id.reserve(decoded_paths.size());
+        for (path_t& path : decoded_paths) {
+            path_id[path.name] = path.path_id;
+            paths[path.path_id] = move(path);
+        }
+        
+        index_occurrences();
+    }
+    
+    void HashGraph::deserialize_unsectioned_members(istream& in) {
         
         nid_t min_id_in;
         in.read((char*) &min_id_in, sizeof(min_id_in) / sizeof(char));
@@ -1166,7 +1452,7 @@ namespace bdsg {
             nid_t node_id_in;
             in.read((char*) &node_id_in, sizeof(node_id_in) / sizeof(char));
             nid_t node_id = endianness<nid_t>::from_big_endian(node_id_in);
-            graph[node_id].deserialize(in);
+            graph[node_id].deserialize(sequences, in);
         }
         
         uint64_t num_paths_in;
@@ -1177,13 +1463,15 @@ namespace bdsg {
         path_id.reserve(num_paths);
         for (size_t i = 0; i < num_paths; i++) {
             path_t path;
-            path.deserialize(in);
+            path.deserialize(path_mappings, in);
             path_id[path.name] = path.path_id;
             paths[path.path_id] = move(path);
         }
         
-        // we need to rebuild the occurrences of node mapping, which is not
-        // part of the serialized format
+        index_occurrences();
+    }
+    
+    void HashGraph::index_occurrences() {
         for (pair<const int64_t, path_t>& path_record : paths) {
             path_t& path = path_record.second;
             bool first_iter = true;
@@ -1206,4 +1494,138 @@ namespace bdsg {
         return handlegraph::number_bool_packing::pack(new_id, is_reverse);
     }
     
+    void HashGraph::compact_sequences() {
+        sequence_arena_t compacted(sequences.is_packed());
+        for (pair<const nid_t, node_t>& node_record : graph) {
+            node_t& node = node_record.second;
+            node.sequence_start = compacted.append(sequences.extract(node.sequence_start, node.sequence_length));
+        }
+        compacted.shrink_to_fit();
+        sequences = move(compacted);
+    }
+    
+    void HashGraph::compact_sequences_if_fragmented() {
+        if (sequences.is_fragmented()) {
+            compact_sequences();
+        }
+    }
+    
+    HashGraph::sequence_arena_t::sequence_arena_t(bool packed) : packed(packed) {
+        
+    }
+    
+    bool HashGraph::sequence_arena_t::is_packed() const {
+        return packed;
+    }
+    
+    uint64_t HashGraph::sequence_arena_t::encode_base(char base) {
+        switch (base) {
+            case 'a':
+            case 'A':
+                return 0;
+            case 'c':
+            case 'C':
+                return 1;
+            case 'g':
+            case 'G':
+                return 2;
+            case 't':
+            case 'T':
+                return 3;
+            default:
+                return 4;
+        }
+    }
+    
+    size_t HashGraph::sequence_arena_t::append(const string& sequence) {
+        size_t start = size();
+        if (packed) {
+            for (char base : sequence) {
+                bases.append(encode_base(base));
+            }
+        }
+        else {
+            bytes.append(sequence);
+        }
+        return start;
+    }
+    
+    size_t HashGraph::sequence_arena_t::append(const sequence_arena_t& other) {
+        assert(packed == other.packed);
+        size_t start = size();
+        if (packed) {
+            // copy the encoded bases over in chunks
+            static const size_t copy_chunk_size = 64;
+            uint64_t chunk[copy_chunk_size];
+            for (size_t i = 0; i < other.bases.size(); i += copy_chunk_size) {
+                size_t chunk_length = min(copy_chunk_size, other.bases.size() - i);
+                other.bases.get_range(i, chunk_length, chunk);
+                bases.append_range(chunk_length, chunk);
+            }
+        }
+        else {
+            bytes.append(other.bytes);
+        }
+        unused += other.unused;
+        return start;
+    }
+    
+    string HashGraph::sequence_arena_t::extract(size_t start, size_t length) const {
+        if (!packed) {
+            return bytes.substr(start, length);
+        }
+        static const char* alphabet = "ACGTN";
+        // how many bases we unpack at a time
+        static const size_t decode_chunk_size = 64;
+        string sequence(length, 'N');
+        uint64_t chunk[decode_chunk_size];
+        for (size_t i = 0; i < length; i += decode_chunk_size) {
+            size_t chunk_length = min(decode_chunk_size, length - i);
+            bases.get_range(start + i, chunk_length, chunk);
+            for (size_t j = 0; j < chunk_length; ++j) {
+                sequence[i + j] = alphabet[chunk[j]];
+            }
+        }
+        return sequence;
+    }
+    
+    char HashGraph::sequence_arena_t::get_base(size_t i) const {
+        return packed ? "ACGTN"[bases.get(i)] : bytes[i];
+    }
+    
+    void HashGraph::sequence_arena_t::set(size_t start, const string& sequence) {
+        if (packed) {
+            for (size_t i = 0; i < sequence.size(); ++i) {
+                bases.set(start + i, encode_base(sequence[i]));
+            }
+        }
+        else {
+            bytes.replace(start, sequence.size(), sequence);
+        }
+    }
+    
+    void HashGraph::sequence_arena_t::release(size_t length) {
+        unused += length;
+    }
+    
+    bool HashGraph::sequence_arena_t::is_fragmented() const {
+        return unused >= MIN_FRAGMENTED_SIZE && unused > size() / 2;
+    }
+    
+    size_t HashGraph::sequence_arena_t::size() const {
+        return packed ? bases.size() : bytes.size();
+    }
+    
+    void HashGraph::sequence_arena_t::shrink_to_fit() {
+        bytes.shrink_to_fit();
+        bases.shrink_to_fit();
+    }
+    
+    void HashGraph::sequence_arena_t::clear() {
+        bytes.clear();
+        bytes.shrink_to_fit();
+        bases.clear();
+        unused = 0;
+    }
+    
 }
@@ -139,6 +139,93 @@ public:
 std::unordered_map<Manager::chainid_t, std::map<size_t, intptr_t>> Manager::chain_space_index;
 std::map<intptr_t, Manager::LinkRecord> Manager::address_space_index;
 std::shared_timed_mutex Manager::mutex;
+std::atomic<uint64_t> Manager::link_generation(0);
+
+namespace {
+
+/**
+ * A copy of the parts of a link record that never change while the link
+ * exists, so that a thread can use it without taking the manager lock.
+ */
+struct CachedLink {
+    /// Address the link is mapped at
+    intptr_t address = 0;
+    /// Number of bytes in the link, or 0 if this is an empty cache slot
+    size_t length = 0;
+    /// Chain the link belongs to
+    Manager::chainid_t chain = Manager::NO_CHAIN;
+    /// Offset of the start of the link in the chain
+    size_t offset = 0;
+    /// True if the link's memory can be written
+    bool writable = false;
+};
+
+/**
+ * A small per-thread cache of the links a thread has used recently. Following
+ * a Pointer that crosses links is otherwise a trip through the manager's
+ * shared lock and two map lookups, and the lock's cache line bounces between
+ * every core doing it.
+ */
+struct LinkCache {
+    static const size_t SIZE = 8;
+    
+    /// The value of Manager::link_generation when the links were cached
+    uint64_t generation = 0;
+    /// The cached links
+    CachedLink links[SIZE];
+    /// Slot to overwrite next
+    size_t next_slot = 0;
+    
+    /// Drop all the cached links if links have been removed since they were
+    /// cached.
+    inline void validate(uint64_t current_generation) {
+        if (generation != current_generation) {
+            for (auto& link : links) {
+                link.length = 0;
+            }
+            generation = current_generation;
+        }
+    }
+    
+    /// Find the cached link containing the given address, or null.
+    inline const CachedLink* find_address(intptr_t address) const {
+        for (auto& link : links) {
+            if (link.address <= address && address - link.address < (intptr_t) link.length) {
+                return &link;
+            }
+        }
+        return nullptr;
+    }
+    
+    /// Find the cached link containing the given position in the given
+    /// chain, or null.
+    inline const CachedLink* find_position(Manager::chainid_t chain, size_t position) const {
+        for (auto& link : links) {
+            if (link.chain == chain && link.offset <= position && position - link.offset < link.length) {
+                return &link;
+            }
+        }
+        return nullptr;
+    }
+    
+    /// Remember a link, if it isn't already cached.
+    inline void remember(intptr_t address, size_t length, Manager::chainid_t chain, size_t offset, bool writable) {
+        if (find_address(address)) {
+            return;
+        }
+        CachedLink& slot = links[next_slot];
+        slot.address = address;
+        slot.length = length;
+        slot.chain = chain;
+        slot.offset = offset;
+        slot.writable = writable;
+        next_slot = (next_slot + 1) % SIZE;
+    }
+};
+
+thread_local LinkCache link_cache;
+
+}
 
 Manager::chainid_t Manager::create_chain(const std::string& prefix) {
     if (prefix.size() > MAX_PREFIX_SIZE) {
@@ -396,6 +483,9 @@ void Manager::destroy_chain(chainid_t chain) {
         
         // Also clean up the chain position index
         Manager::chain_space_index.erase(chain);
+        
+        // Make every thread forget about the links we removed.
+        Manager::link_generation.fetch_add(1, std::memory_order_release);
     }
     
     // Now that we aren't holding locks, free the memory
@@ -595,6 +685,18 @@ std::pair<int64_t, bool> Manager::get_offset_in_same_chain(const void* here, con
     
     // Compute tha address offset
     int64_t in_memory_offset = (intptr_t) address - (intptr_t) here;
+    
+    // Try to answer from the links this thread has used recently.
+    LinkCache& cache = link_cache;
+    cache.validate(Manager::link_generation.load(std::memory_order_acquire));
+    const CachedLink* cached_here = cache.find_address((intptr_t) here);
+    const CachedLink* cached_there = cached_here ? cache.find_address((intptr_t) address) : nullptr;
+    if (cached_here && cached_there && cached_here->chain == cached_there->chain) {
+        // Same computation as below.
+        int64_t correction = (cached_there->address - cached_here->address) -
+            ((int64_t) cached_there->offset - (int64_t) cached_here->offset);
+        return std::make_pair(in_memory_offset - correction, correction == 0);
+    }
 
     // Get read access to manager data structures
     std::shared_lock<std::shared_timed_mutex> lock(Manager::mutex);
@@ -603,6 +705,13 @@ std::pair<int64_t, bool> Manager::get_offset_in_same_chain(const void* here, con
     auto here_link = find_link(lock, here);
     auto there_link = find_link(lock, address);
     
+    for (auto& link : {here_link, there_link}) {
+        if (link != Manager::address_space_index.end()) {
+            cache.remember(link->first, link->second.length, (chainid_t) link->second.first,
+                           link->second.offset, link->second.is_writable());
+        }
+    }
+    
     if (here_link == there_link) {
         // Same link (possibly no link).
         // Just do a straight offset.
@@ -637,12 +746,36 @@ std::pair<void*, bool> Manager::follow_offset_in_same_chain(const void* here, in
     // Determine where we would be if we just applied the offset directly to the address
     void* applied_local = (void*)((intptr_t) here + offset);
     
+    // Try to answer from the links this thread has used recently, which
+    // doesn't need the lock.
+    LinkCache& cache = link_cache;
+    cache.validate(Manager::link_generation.load(std::memory_order_acquire));
+    const CachedLink* cached = cache.find_address((intptr_t) here);
+    if (cached) {
+        // Same computation as below.
+        if (cached->address <= (intptr_t) here + offset &&
+            (intptr_t) cached->length > (intptr_t) here - cached->address + offset) {
+            return std::make_pair(applied_local, cached->writable);
+        }
+        size_t position = cached->offset + ((intptr_t) here - cached->address) + offset;
+        const CachedLink* cached_target = cache.find_position(cached->chain, position);
+        if (cached_target) {
+            void* applied_chain = (void*)(cached_target->address + (position - cached_target->offset));
+            return std::make_pair(applied_chain, applied_chain == applied_local && cached->writable);
+        }
+    }
+    
     // Get read access to manager data structures
     std::shared_lock<std::shared_timed_mutex> lock(Manager::mutex);
     
     // Find the link we are starting in.
     auto link = find_link(lock, here);
     
+    if (link != Manager::address_space_index.end()) {
+        cache.remember(link->first, link->second.length, (chainid_t) link->second.first,
+                       link->second.offset, link->second.is_writable());
+    }
+    
     if (link == Manager::address_space_index.end() ||
         (link->first <= (intptr_t) here + offset &&
         link->second.length > (intptr_t) here - link->first + offset)) {
@@ -672,6 +805,10 @@ std::pair<void*, bool> Manager::follow_offset_in_same_chain(const void* here, in
         // Work out where we are going: that offset in the found link along the chain.
         void* applied_chain = (void*)(found->second + (position - found->first));
         
+        // Remember the link we went to as well
+        auto& target_link = Manager::address_space_index.at(found->second);
+        cache.remember(found->second, target_link.length, chain, target_link.offset, target_link.is_writable());
+        
         // Return the result, and check if it's actually the same as the local
         // offset and where *we* are is writable, so we can just do that in the future.
         return std::make_pair(applied_chain, applied_chain == applied_local && link->second.is_writable());
@@ -1531,7 +1668,7 @@ std::pair<Manager::chainid_t, bool> Manager::open_chain(int fd, size_t start_siz
         
         if (!link_data) {
             // Allocate our own link
-            link_data = malloc(start_size);
+            link_data = calloc(start_size, 1);
         }
         if (!link_data) {
             throw std::runtime_error("Could not allocate initial " + std::to_string(start_size) + " bytes");
@@ -1664,7 +1801,7 @@ Manager::LinkRecord& Manager::add_link(LinkRecord& head, size_t new_bytes, void*
     } else {
         if (!link_data) {
             // Allocate our own link
-            link_data = malloc(new_bytes);
+            link_data = calloc(new_bytes, 1);
         }
         if (!link_data) {
             throw std::runtime_error("Could not allocate an additional " + std::to_string(new_bytes) + " bytes");
@@ -27,6 +27,64 @@ namespace bdsg {
         return implementation.get();
     }
     
+    void PackedGraph::get_sequences(const vector<handle_t>& handles, string& sequences, vector<size_t>& offsets) const {
+        get()->get_sequences(handles, sequences, offsets);
+    }
+    
+    void PackedGraph::set_page_width_tuning(bool tune) {
+        get()->set_page_width_tuning(tune);
+    }
+    
+    bool PackedGraph::get_page_width_tuning() const {
+        return get()->get_page_width_tuning();
+    }
+    
+    void PackedGraph::set_incremental_defragmentation(bool incremental) {
+        get()->set_incremental_defragmentation(incremental);
+    }
+    
+    bool PackedGraph::get_incremental_defragmentation() const {
+        return get()->get_incremental_defragmentation();
+    }
+    
+    bool PackedGraph::compact_step(size_t budget) {
+        return get()->compact_step(budget);
+    }
+    
+    MemoryReport PackedGraph::memory_report(bool individual_paths) const {
+        return get()->memory_report(individual_paths);
+    }
+    
+    void MappedPackedGraph::get_sequences(const vector<handle_t>& handles, string& sequences, vector<size_t>& offsets) const {
+        get()->get_sequences(handles, sequences, offsets);
+    }
+    
+    void MappedPackedGraph::set_page_width_tuning(bool tune) {
+        get()->set_page_width_tuning(tune);
+    }
+    
+    bool MappedPackedGraph::get_page_width_tuning() const {
+        return get()->get_page_width_tuning();
+    }
+    
+    void MappedPackedGraph::set_incremental_defragmentation(bool incremental) {
+        get()->set_incremental_defragmentation(incremental);
+    }
+    
+    bool MappedPackedGraph::get_incremental_defragmentation() const {
+        return get()->get_incremental_defragmentation();
+    }
+    
+    bool MappedPackedGraph::compact_step(size_t budget) {
+        return get()->compact_step(budget);
+    }
+    
+    MemoryReport MappedPackedGraph::memory_report(bool individual_paths) const {
+        MemoryReport report = get()->memory_report(individual_paths);
+        report.add_mapped_usage(implementation.get_usage());
+        return report;
+    }
+    
     MappedPackedGraph::MappedPackedGraph() {
         // Make sure our implementation pointer is never null.
         implementation.construct(get_prefix());
@@ -85,7 +143,11 @@ namespace bdsg {
     
     uint32_t MappedPackedGraph::get_magic_number() const {
         // Chosen by fair dice roll, guaranteed to be magic.
-        return 672226447;
+        // The file is a raw image of the graph's memory, so this has to change
+        // whenever the layout of BasePackedGraph<MappedBackend> does. Images
+        // with the old number (672226447) are from before the graph gained its
+        // page width tuning and defragmentation state, and are refused.
+        return 672226448;
     }
     
     std::string MappedPackedGraph::get_prefix() const {
@@ -1,6 +1,8 @@
 #include "bdsg/overlays/packed_path_position_overlay.hpp"
 #include "bdsg/internal/utility.hpp"
 
+#include <algorithm>
+#include <arpa/inet.h>
 #include <omp.h> // BINDER_IGNORE because Binder can't find this
 
 //#define debug
@@ -209,6 +211,40 @@ handle_t PackedPositionOverlay::get_underlying_handle(const handle_t& handle) co
     return handle;
 }
 
+MemoryReport PackedPositionOverlay::memory_report() const {
+    MemoryReport report("position_overlay", sizeof(*this));
+    
+    MemoryReport indexes_report("indexes", (indexes.capacity() - indexes.size()) * sizeof(PathIndex),
+                                (indexes.capacity() - indexes.size()) * sizeof(PathIndex));
+    indexes_report.entries = indexes.size();
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        const PathIndex& index = indexes[i];
+        MemoryReport index_report(to_string(i));
+        index_report.entries = index.steps_0.size();
+        index_report.add_child(index.steps_0.memory_report("steps_0"));
+        index_report.add_child(index.steps_1.memory_report("steps_1"));
+        index_report.add_child(index.positions.memory_report("positions"));
+        MemoryReport hash_report("step_hash");
+        for (const auto& step_hash : index.step_hash) {
+            // BBHash doesn't mark its size query as const
+            hash_report.bytes += const_cast<boomphf::mphf<step_handle_t, StepHash>&>(step_hash).totalBitSize() / 8;
+        }
+        index_report.add_child(hash_report);
+        index_report.add_child(index.step_positions.memory_report("step_positions"));
+        indexes_report.add_child(index_report);
+    }
+    report.add_child(indexes_report);
+    
+    // Estimate the hash table as dense
+    size_t path_range_slack = (path_range.bucket_count() - path_range.size()) * sizeof(decltype(path_range)::value_type);
+    MemoryReport path_range_report("path_range", path_range.bucket_count() * sizeof(decltype(path_range)::value_type),
+                                   path_range_slack);
+    path_range_report.entries = path_range.size();
+    report.add_child(path_range_report);
+    
+    return report;
+}
+
 void PackedPositionOverlay::index_path_positions() {
     
     // I'm not sure how to pass handles to OMP tasks by value, when we'd return
@@ -378,6 +414,273 @@ void PackedPositionOverlay::index_paths(size_t index_num, const std::vector<path
     }
 }
 
+MappedPackedPositionOverlay::MappedPackedPositionOverlay(const PathHandleGraph* graph, size_t steps_per_index) {
+    // We can't use the base class constructor, because it would index before
+    // our index-building overrides exist.
+    this->graph = graph;
+    this->steps_per_index = steps_per_index;
+    mapped_indexes.construct(get_prefix());
+    index_path_positions();
+    
+    // Put the path ranges in order so we can find them by bisection.
+    std::sort(mapped_indexes->path_ranges.begin(), mapped_indexes->path_ranges.end(),
+              [](const MappedPathRange& a, const MappedPathRange& b) {
+        return a.path < b.path;
+    });
+}
+
+MappedPackedPositionOverlay::MappedPackedPositionOverlay() {
+    // Make sure our index pointer is never null.
+    mapped_indexes.construct(get_prefix());
+}
+
+MappedPackedPositionOverlay::MappedPackedPositionOverlay(const MappedPackedPositionOverlay& other) : PackedPositionOverlay(other) {
+    mapped_indexes.construct(get_prefix(), *other.mapped_indexes);
+}
+
+MappedPackedPositionOverlay& MappedPackedPositionOverlay::operator=(const MappedPackedPositionOverlay& other) {
+    if (this != &other) {
+        PackedPositionOverlay::operator=(other);
+        mapped_indexes.construct(get_prefix(), *other.mapped_indexes);
+    }
+    return *this;
+}
+
+MappedPackedPositionOverlay::MappedPackedPositionOverlay(MappedPackedPositionOverlay&& other) : PackedPositionOverlay(std::move(other)) {
+    mapped_indexes.construct(get_prefix(), std::move(*other.mapped_indexes));
+}
+
+MappedPackedPositionOverlay& MappedPackedPositionOverlay::operator=(MappedPackedPositionOverlay&& other) {
+    if (this != &other) {
+        PackedPositionOverlay::operator=(std::move(other));
+        mapped_indexes.construct(get_prefix(), std::move(*other.mapped_indexes));
+    }
+    return *this;
+}
+
+void MappedPackedPositionOverlay::set_graph(const PathHandleGraph* graph) {
+    if (graph->get_path_count() != mapped_indexes->path_ranges.size()) {
+        throw std::runtime_error("error:[MappedPackedPositionOverlay] graph has " + std::to_string(graph->get_path_count()) +
+                                 " paths but index has " + std::to_string(mapped_indexes->path_ranges.size()));
+    }
+    this->graph = graph;
+}
+
+size_t MappedPackedPositionOverlay::get_path_length(const path_handle_t& path_handle) const {
+    const auto& range = get_range(path_handle);
+    if (range.start == range.end) {
+        return 0;
+    }
+    const auto& index = mapped_indexes->indexes[range.index_number];
+    step_handle_t step;
+    as_integers(step)[0] = index.steps_0.get(range.end - 1);
+    as_integers(step)[1] = index.steps_1.get(range.end - 1);
+    return index.positions.get(range.end - 1) + get_length(get_handle_of_step(step));
+}
+
+size_t MappedPackedPositionOverlay::get_position_of_step(const step_handle_t& step) const {
+    auto path = get_path_handle_of_step(step); 
+    if (step == path_end(path)) {
+        return get_path_length(path);
+    }
+    else {
+        const auto& index = mapped_indexes->indexes[get_range(path).index_number];
+        return index.positions.get(get_rank(index, step));
+    }
+}
+
+step_handle_t MappedPackedPositionOverlay::get_step_at_position(const path_handle_t& path,
+                                                                const size_t& position) const {
+    
+    const auto& range = get_range(path);
+    
+    // check if position it outside the range (handles edge case of an empty path too)
+    if (position >= get_path_length(path)) {
+        return path_end(path);
+    }
+    
+    const auto& index = mapped_indexes->indexes[range.index_number];
+    
+    // bisect search within the range to find the index with the steps
+    size_t low = range.start;
+    size_t hi = range.end;
+    while (hi > low + 1) {
+        size_t mid = (hi + low) / 2;
+        if (position < index.positions.get(mid)) {
+            hi = mid;
+        }
+        else {
+            low = mid;
+        }
+    }
+    
+    // unpack the integers at the same index into a step
+    step_handle_t step;
+    as_integers(step)[0] = index.steps_0.get(low);
+    as_integers(step)[1] = index.steps_1.get(low);
+    return step;
+}
+
+MemoryReport MappedPackedPositionOverlay::memory_report() const {
+    MemoryReport report("position_overlay", sizeof(*this));
+    
+    const MappedIndexes& mapped = *mapped_indexes;
+    MemoryReport indexes_report("indexes", sizeof(MappedIndexes) + (mapped.indexes.capacity() - mapped.indexes.size()) * sizeof(MappedPathIndex),
+                                (mapped.indexes.capacity() - mapped.indexes.size()) * sizeof(MappedPathIndex));
+    indexes_report.entries = mapped.indexes.size();
+    for (size_t i = 0; i < mapped.indexes.size(); ++i) {
+        const MappedPathIndex& index = mapped.indexes[i];
+        MemoryReport index_report(to_string(i));
+        index_report.entries = index.steps_0.size();
+        index_report.add_child(index.steps_0.memory_report("steps_0"));
+        index_report.add_child(index.steps_1.memory_report("steps_1"));
+        index_report.add_child(index.positions.memory_report("positions"));
+        index_report.add_child(index.step_slots.memory_report("step_slots"));
+        indexes_report.add_child(index_report);
+    }
+    report.add_child(indexes_report);
+    
+    MemoryReport path_ranges_report("path_ranges", mapped.path_ranges.capacity() * sizeof(MappedPathRange),
+                                    (mapped.path_ranges.capacity() - mapped.path_ranges.size()) * sizeof(MappedPathRange));
+    path_ranges_report.entries = mapped.path_ranges.size();
+    report.add_child(path_ranges_report);
+    
+    report.add_mapped_usage(mapped_indexes.get_usage());
+    
+    return report;
+}
+
+void MappedPackedPositionOverlay::dissociate() {
+    mapped_indexes.dissociate();
+}
+
+void MappedPackedPositionOverlay::serialize(const std::function<void(const void*, size_t)>& iteratee) const {
+    mapped_indexes.save(iteratee);
+}
+
+void MappedPackedPositionOverlay::serialize(int fd) {
+    mapped_indexes.save(fd);
+}
+
+void MappedPackedPositionOverlay::deserialize(int fd) {
+    mapped_indexes.load(fd, get_prefix());
+}
+
+void MappedPackedPositionOverlay::serialize_members(std::ostream& out) const {
+    // libhandlegraph already wrote our magic number prefix.
+    mapped_indexes.save_after_prefix(out, get_prefix());
+}
+
+void MappedPackedPositionOverlay::deserialize_members(std::istream& in) {
+    // libhandlegraph stole our magic number, and checked it.
+    mapped_indexes.load_after_prefix(in, get_prefix());
+}
+
+uint32_t MappedPackedPositionOverlay::get_magic_number() const {
+    return 1359024917ul;
+}
+
+std::string MappedPackedPositionOverlay::get_prefix() const {
+    // Put into network byte order
+    uint32_t magic_number = htonl(get_magic_number());
+    // Then convert to a string, bounding length because it is not null terminated.
+    return std::string((char*) &magic_number, sizeof(magic_number) / sizeof(char));
+}
+
+void MappedPackedPositionOverlay::set_index_count(size_t count) {
+    mapped_indexes->indexes.resize(count);
+}
+
+void MappedPackedPositionOverlay::index_paths(size_t index_num, const std::vector<path_handle_t>::const_iterator& begin_path, const std::vector<path_handle_t>::const_iterator& end_path, size_t cumul_path_size, void** user_data_base) {
+    // Grab the index we are building into
+    auto& index = mapped_indexes->indexes[index_num];
+    
+    // resize the vectors to the number of step handles
+    index.steps_0.resize(cumul_path_size);
+    index.steps_1.resize(cumul_path_size);
+    index.positions.resize(cumul_path_size);
+    
+    // Walk a cursor through steps among the path set
+    size_t step_overall = 0;
+    for (size_t j = 0; j < end_path - begin_path; j++) {
+        // For each path we are indexing
+        auto& path_handle = *(begin_path + j);
+        // And its user data
+        void* user_data = *(user_data_base + j);
+
+        // Make sure there's no user data
+        assert(user_data == nullptr);
+        
+        MappedPathRange range;
+        range.path = as_integer(path_handle);
+        range.index_number = index_num;
+        range.start = step_overall;
+        // And walk a base position cursor along the path
+        size_t position = 0;
+        for_each_step_in_path(path_handle, [&](const step_handle_t& step) {
+            index.steps_0.set(step_overall, as_integers(step)[0]);
+            index.steps_1.set(step_overall, as_integers(step)[1]);
+            index.positions.set(step_overall, position);
+            
+            position += get_length(get_handle_of_step(step));
+            ++step_overall;
+        });
+        range.end = step_overall;
+        
+        #pragma omp critical (path_range)
+        mapped_indexes->path_ranges.emplace_back(range);
+    }
+    
+    // Size the hash table to be at most 3/4 full
+    size_t slot_count = 1;
+    while (slot_count < cumul_path_size + cumul_path_size / 3 + 1) {
+        slot_count *= 2;
+    }
+    index.step_slots.resize(slot_count);
+    size_t mask = slot_count - 1;
+    
+    // Fill it in
+    for (size_t rank = 0; rank < step_overall; rank++) {
+        step_handle_t step;
+        as_integers(step)[0] = index.steps_0.get(rank);
+        as_integers(step)[1] = index.steps_1.get(rank);
+        size_t slot = StepHash()(step) & mask;
+        while (index.step_slots.get(slot) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        index.step_slots.set(slot, rank + 1);
+    }
+}
+
+const MappedPackedPositionOverlay::MappedPathRange& MappedPackedPositionOverlay::get_range(const path_handle_t& path_handle) const {
+    const auto& path_ranges = mapped_indexes->path_ranges;
+    int64_t path = as_integer(path_handle);
+    auto found = std::lower_bound(path_ranges.begin(), path_ranges.end(), path,
+                                  [](const MappedPathRange& range, int64_t path) {
+        return range.path < path;
+    });
+    if (found == path_ranges.end() || found->path != path) {
+        throw std::out_of_range("error:[MappedPackedPositionOverlay] path is not indexed");
+    }
+    return *found;
+}
+
+size_t MappedPackedPositionOverlay::get_rank(const MappedPathIndex& index, const step_handle_t& step) const {
+    size_t mask = index.step_slots.size() - 1;
+    size_t slot = StepHash()(step) & mask;
+    while (true) {
+        uint64_t entry = index.step_slots.get(slot);
+        if (entry == 0) {
+            throw std::out_of_range("error:[MappedPackedPositionOverlay] step is not indexed");
+        }
+        if (index.steps_0.get(entry - 1) == (uint64_t) as_integers(step)[0] &&
+            index.steps_1.get(entry - 1) == (uint64_t) as_integers(step)[1]) {
+            return entry - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
 uint64_t PackedPositionOverlay::StepHash::operator()(const step_handle_t& step, uint64_t seed) const {
     const int64_t* int_step = as_integers(step);
     uint64_t hsh1 = boomphf::SingleHashFunctor<int64_t>()(int_step[0], seed);
@@ -51,6 +51,42 @@ path_handle_t PackedReferencePathOverlay::get_path_handle_of_step(const step_han
     return this->graph->get_path_handle_of_step(step_handle);
 }
 
+MemoryReport PackedReferencePathOverlay::memory_report() const {
+    MemoryReport report = PackedPositionOverlay::memory_report();
+    report.name = "reference_path_overlay";
+    report.bytes += sizeof(*this) - sizeof(PackedPositionOverlay);
+    report.bytes += last_step_to_path_idx.capacity() * sizeof(size_t);
+    
+    MemoryReport visit_indexes_report("visit_indexes", (visit_indexes.capacity() - visit_indexes.size()) * sizeof(PathVisitIndex),
+                                      (visit_indexes.capacity() - visit_indexes.size()) * sizeof(PathVisitIndex));
+    visit_indexes_report.entries = visit_indexes.size();
+    for (size_t i = 0; i < visit_indexes.size(); ++i) {
+        const PathVisitIndex& visit_index = visit_indexes[i];
+        MemoryReport index_report(to_string(i));
+        MemoryReport node_hash_report("node_hash");
+        for (const auto& node_hash : visit_index.node_hash) {
+            // BBHash doesn't mark its size query as const
+            node_hash_report.bytes += const_cast<boomphf::mphf<nid_t, boomphf::SingleHashFunctor<nid_t>>&>(node_hash).totalBitSize() / 8;
+        }
+        index_report.add_child(node_hash_report);
+        index_report.add_child(visit_index.visit_ranks.memory_report("visit_ranks"));
+        index_report.add_child(visit_index.visit_ranks_start.memory_report("visit_ranks_start"));
+        index_report.add_child(visit_index.visit_ranks_length.memory_report("visit_ranks_length"));
+        MemoryReport step_hash_report("step_hash");
+        for (const auto& step_hash : visit_index.step_hash) {
+            step_hash_report.bytes += const_cast<boomphf::mphf<step_handle_t, StepHash>&>(step_hash).totalBitSize() / 8;
+        }
+        index_report.add_child(step_hash_report);
+        index_report.add_child(visit_index.step_to_path.memory_report("step_to_path"));
+        index_report.add_child(visit_index.step_to_step1.memory_report("step_to_step1"));
+        index_report.add_child(visit_index.step_to_step2.memory_report("step_to_step2"));
+        visit_indexes_report.add_child(index_report);
+    }
+    report.add_child(visit_indexes_report);
+    
+    return report;
+}
+
 bool PackedReferencePathOverlay::for_each_step_on_handle_impl(const handle_t& handle,
                                                               const function<bool(const step_handle_t&)>& iteratee) const {
 
@@ -28,6 +28,18 @@ void PackedSubgraphOverlay::add_node(const handle_t& handle) {
     subgraph_handles.insert(handlegraph::as_integer(graph->forward(handle)));
 }
 
+void PackedSubgraphOverlay::add_nodes(const vector<handle_t>& handles) {
+    vector<uint64_t> values;
+    values.reserve(handles.size());
+    for (const handle_t& handle : handles) {
+        nid_t node_id = graph->get_id(handle);
+        max_id = max(node_id, max_id);
+        min_id = min(node_id, min_id);
+        values.push_back(handlegraph::as_integer(graph->forward(handle)));
+    }
+    subgraph_handles.insert(values.begin(), values.end());
+}
+
 void PackedSubgraphOverlay::remove_node(const handle_t& handle) {
     subgraph_handles.remove(handlegraph::as_integer(graph->forward(handle)));
 }
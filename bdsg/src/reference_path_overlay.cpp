@@ -3,6 +3,7 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <arpa/inet.h>
 #include <omp.h>
 
 #include <handlegraph/util.hpp>
@@ -297,8 +298,8 @@ ReferencePathOverlay::ReferencePathOverlay(const PathHandleGraph* graph, const s
                     
                     // advance to the next step
                     ++step_idx;
-                    if (step_idx == path_record->steps.size()) {
-                        // roll over to the next path
+                    while (step_idx == path_record->steps.size()) {
+                        // roll over to the next path, skipping any empty ones
                         ++path_idx;
                         step_idx = 0;
                         if (path_idx == path_handles.size()) {
@@ -306,6 +307,9 @@ ReferencePathOverlay::ReferencePathOverlay(const PathHandleGraph* graph, const s
                         }
                         path_record = &reference_paths[path_handles[path_idx]];
                     }
+                    if (path_idx == path_handles.size()) {
+                        break;
+                    }
                 }
             }
         });
@@ -528,4 +532,237 @@ bool ReferencePathOverlay::for_each_step_on_handle_impl(const handle_t& handle,
     return true;
 }
 
+MappedReferencePathOverlay::MappedReferencePathOverlay(const PathHandleGraph* graph, const std::unordered_set<std::string>& extra_path_names) :
+    ReferencePathOverlay(graph, extra_path_names) {
+    
+    // The base class has built everything in normal memory, so now we move
+    // it over into mapped memory.
+    mapped_indexes.construct(get_prefix());
+    
+    // Put the paths in order so we can find them by bisection.
+    std::vector<path_handle_t> path_handles;
+    path_handles.reserve(reference_paths.size());
+    for (auto& path_and_record : reference_paths) {
+        path_handles.push_back(path_and_record.first);
+    }
+    std::sort(path_handles.begin(), path_handles.end(), [](const path_handle_t& a, const path_handle_t& b) {
+        return handlegraph::as_integer(a) < handlegraph::as_integer(b);
+    });
+    
+    auto& mapped_paths = mapped_indexes->reference_paths;
+    mapped_paths.resize(path_handles.size());
+    
+#pragma omp parallel for schedule(dynamic,1)
+    for (size_t i = 0; i < path_handles.size(); ++i) {
+        auto& path_record = reference_paths.at(path_handles[i]);
+        auto& mapped_record = mapped_paths[i];
+        
+        mapped_record.path = handlegraph::as_integer(path_handles[i]);
+        mapped_record.steps = path_record.steps;
+        
+        size_t step_count = path_record.steps.size();
+        size_t path_length = path_record.offsets.size();
+        
+        // Space the samples about one step apart.
+        mapped_record.sample_shift = 0;
+        while (step_count > 0 && (size_t(2) << mapped_record.sample_shift) * step_count <= path_length) {
+            ++mapped_record.sample_shift;
+        }
+        size_t sample_spacing = size_t(1) << mapped_record.sample_shift;
+        
+        mapped_record.step_starts.width(sdsl::bits::length(path_length));
+        mapped_record.step_starts.resize(step_count + 1);
+        mapped_record.position_samples.width(sdsl::bits::length(step_count));
+        mapped_record.position_samples.resize((path_length + sample_spacing - 1) / sample_spacing + 1);
+        
+        size_t step_start = 0;
+        size_t next_sample = 0;
+        for (size_t j = 0; j < step_count; ++j) {
+            mapped_record.step_starts[j] = step_start;
+            step_start += graph->get_length(handlegraph::as_handle(path_record.steps.get(j)));
+            for (; next_sample * sample_spacing < step_start; ++next_sample) {
+                mapped_record.position_samples[next_sample] = j;
+            }
+        }
+        mapped_record.step_starts[step_count] = step_start;
+        // The last sample is past the end of the path.
+        mapped_record.position_samples[next_sample] = step_count;
+        
+        // Free the unmapped copy.
+        path_record = PathRecord();
+    }
+    reference_paths.clear();
+    
+    mapped_indexes->steps_begin = steps_begin;
+    mapped_indexes->step_1 = step_1;
+    mapped_indexes->step_2 = step_2;
+    steps_begin = sdsl::int_vector<>();
+    step_1 = sdsl::int_vector<>();
+    step_2 = sdsl::int_vector<>();
+}
+
+MappedReferencePathOverlay::MappedReferencePathOverlay() {
+    // Make sure our index pointer is never null.
+    mapped_indexes.construct(get_prefix());
+}
+
+MappedReferencePathOverlay::MappedReferencePathOverlay(const MappedReferencePathOverlay& other) : ReferencePathOverlay(other) {
+    mapped_indexes.construct(get_prefix(), *other.mapped_indexes);
+}
+
+MappedReferencePathOverlay& MappedReferencePathOverlay::operator=(const MappedReferencePathOverlay& other) {
+    if (this != &other) {
+        ReferencePathOverlay::operator=(other);
+        mapped_indexes.construct(get_prefix(), *other.mapped_indexes);
+    }
+    return *this;
+}
+
+MappedReferencePathOverlay::MappedReferencePathOverlay(MappedReferencePathOverlay&& other) : ReferencePathOverlay(std::move(other)) {
+    mapped_indexes.construct(get_prefix(), std::move(*other.mapped_indexes));
+}
+
+MappedReferencePathOverlay& MappedReferencePathOverlay::operator=(MappedReferencePathOverlay&& other) {
+    if (this != &other) {
+        ReferencePathOverlay::operator=(std::move(other));
+        mapped_indexes.construct(get_prefix(), std::move(*other.mapped_indexes));
+    }
+    return *this;
+}
+
+void MappedReferencePathOverlay::set_graph(const PathHandleGraph* graph) {
+    if (graph->max_node_id() + 2 != mapped_indexes->steps_begin.size()) {
+        throw std::runtime_error("error:[MappedReferencePathOverlay] graph has max node ID " + std::to_string(graph->max_node_id()) +
+                                 " but index is for max node ID " + std::to_string((int64_t) mapped_indexes->steps_begin.size() - 2));
+    }
+    this->graph = graph;
+}
+
+size_t MappedReferencePathOverlay::get_path_count() const {
+    return mapped_indexes->reference_paths.size();
+}
+
+size_t MappedReferencePathOverlay::get_step_count(const path_handle_t& path_handle) const {
+    return get_record(path_handle).steps.size();
+}
+
+handle_t MappedReferencePathOverlay::get_handle_of_step(const step_handle_t& step_handle) const {
+    const auto& path_record = get_record(get_path_handle_of_step(step_handle));
+    return handlegraph::as_handle(path_record.steps.get(handlegraph::as_integers(step_handle)[1]));
+}
+
+size_t MappedReferencePathOverlay::get_path_length(const path_handle_t& path_handle) const {
+    const auto& path_record = get_record(path_handle);
+    return path_record.step_starts[path_record.step_starts.size() - 1];
+}
+
+size_t MappedReferencePathOverlay::get_position_of_step(const step_handle_t& step) const {
+    return get_record(get_path_handle_of_step(step)).step_starts[handlegraph::as_integers(step)[1]];
+}
+
+step_handle_t MappedReferencePathOverlay::get_step_at_position(const path_handle_t& path,
+                                                               const size_t& position) const {
+    const auto& path_record = get_record(path);
+    size_t step_count = path_record.steps.size();
+    
+    step_handle_t step;
+    handlegraph::as_integers(step)[0] = handlegraph::as_integer(path);
+    if (position >= path_record.step_starts[step_count]) {
+        handlegraph::as_integers(step)[1] = step_count;
+        return step;
+    }
+    
+    // The samples on either side of the position bound the steps it can be on
+    size_t sample = position >> path_record.sample_shift;
+    size_t low = path_record.position_samples[sample];
+    size_t hi = std::min<size_t>(path_record.position_samples[sample + 1] + 1, step_count);
+    // bisect to find the last step starting at or before the position
+    while (hi > low + 1) {
+        size_t mid = (hi + low) / 2;
+        if (position < path_record.step_starts[mid]) {
+            hi = mid;
+        }
+        else {
+            low = mid;
+        }
+    }
+    handlegraph::as_integers(step)[1] = low;
+    return step;
+}
+
+void MappedReferencePathOverlay::dissociate() {
+    mapped_indexes.dissociate();
+}
+
+void MappedReferencePathOverlay::serialize(const std::function<void(const void*, size_t)>& iteratee) const {
+    mapped_indexes.save(iteratee);
+}
+
+void MappedReferencePathOverlay::serialize(int fd) {
+    mapped_indexes.save(fd);
+}
+
+void MappedReferencePathOverlay::deserialize(int fd) {
+    mapped_indexes.load(fd, get_prefix());
+}
+
+void MappedReferencePathOverlay::serialize_members(std::ostream& out) const {
+    // libhandlegraph already wrote our magic number prefix.
+    mapped_indexes.save_after_prefix(out, get_prefix());
+}
+
+void MappedReferencePathOverlay::deserialize_members(std::istream& in) {
+    // libhandlegraph stole our magic number, and checked it.
+    mapped_indexes.load_after_prefix(in, get_prefix());
+}
+
+uint32_t MappedReferencePathOverlay::get_magic_number() const {
+    return 1493285614ul;
+}
+
+std::string MappedReferencePathOverlay::get_prefix() const {
+    // Put into network byte order
+    uint32_t magic_number = htonl(get_magic_number());
+    // Then convert to a string, bounding length because it is not null terminated.
+    return std::string((char*) &magic_number, sizeof(magic_number) / sizeof(char));
+}
+
+bool MappedReferencePathOverlay::for_each_path_handle_impl(const std::function<bool(const path_handle_t&)>& iteratee) const {
+    for (const auto& path_record : mapped_indexes->reference_paths) {
+        if (!iteratee(handlegraph::as_path_handle(path_record.path))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MappedReferencePathOverlay::for_each_step_on_handle_impl(const handle_t& handle,
+                                                              const std::function<bool(const step_handle_t&)>& iteratee) const {
+    
+    const auto& indexes = *mapped_indexes;
+    nid_t node_id = get_id(handle);
+    for (size_t i = indexes.steps_begin[node_id], n = indexes.steps_begin[node_id + 1]; i < n; ++i) {
+        step_handle_t step;
+        handlegraph::as_integers(step)[0] = indexes.step_1[i];
+        handlegraph::as_integers(step)[1] = indexes.step_2[i];
+        if (!iteratee(step)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const MappedReferencePathOverlay::MappedPathRecord& MappedReferencePathOverlay::get_record(const path_handle_t& path_handle) const {
+    const auto& reference_paths = mapped_indexes->reference_paths;
+    int64_t path = handlegraph::as_integer(path_handle);
+    auto found = std::lower_bound(reference_paths.begin(), reference_paths.end(), path,
+                                  [](const MappedPathRecord& record, int64_t path) {
+        return record.path < path;
+    });
+    if (found == reference_paths.end() || found->path != path) {
+        throw std::out_of_range("error:[MappedReferencePathOverlay] path is not indexed");
+    }
+    return *found;
+}
+
 }
@@ -6,6 +6,8 @@
 #include "bdsg/snarl_distance_index.hpp"
 #include <jansson.h>
 #include <arpa/inet.h>
+#include <exception>
+#include <queue>
 
 using namespace std;
 using namespace handlegraph;
@@ -1216,7 +1218,12 @@ size_t SnarlDistanceIndex::distance_in_parent(const net_handle_t& parent,
         } else if (get_record_type(snarl_tree_records->at(get_record_offset(parent))) == OVERSIZED_SNARL 
             && !(rank1 == 0 || rank1 == 1 || rank2 == 0 || rank2 == 1) ) {
             //If this is an oversized snarl and we're looking for internal distances, then we didn't store the
-            //distance and we have to find it using dijkstra's algorithm
+            //distance and we have to find it from the hub labels or using dijkstra's algorithm
+            SnarlRecord snarl_record(parent, &snarl_tree_records);
+            size_t hub_labels_offset = snarl_record.get_hub_labels_offset();
+            if (hub_labels_offset != 0) {
+                return get_hub_label_distance(hub_labels_offset, snarl_record.get_node_count(), rank1, rev1, rank2, rev2);
+            }
             if (graph == nullptr) {
                 if (size_limit_warnings.load() < max_num_size_limit_warnings) {
                     int warning_num = const_cast<SnarlDistanceIndex*>(this)->size_limit_warnings++;
@@ -1234,18 +1241,7 @@ size_t SnarlDistanceIndex::distance_in_parent(const net_handle_t& parent,
             handle_t handle2 = is_node(child2) ? get_handle(child2, graph) : get_handle(get_bound(child2, !child_ends_at_start2, false), graph);
             handle2 = graph->flip(handle2);
 
-            size_t distance = std::numeric_limits<size_t>::max();
-            handlegraph::algorithms::dijkstra(graph, handle1, [&](const handle_t& reached, size_t dist) {
-                if (reached == handle2) {
-                    distance = dist;
-                    return false;
-                } else if (dist > distance_limit) {
-                    distance = std::numeric_limits<size_t>::max();
-                    return false;
-                }
-                return true;
-            }, false);
-            return distance;
+            return distance_in_oversized_snarl(snarl_record, handle1, handle2, graph, distance_limit);
 
             
         } else if (rank1 == 0 && rank2 == 0 && !snarl_is_root) {
@@ -1312,7 +1308,13 @@ size_t SnarlDistanceIndex::distance_in_snarl(const net_handle_t& parent,
     } else if (get_record_type(snarl_tree_records->at(get_record_offset(parent))) == OVERSIZED_SNARL 
         && !(rank1 == 0 || rank1 == 1 || rank2 == 0 || rank2 == 1) ) {
         //If this is an oversized snarl and we're looking for internal distances, then we didn't store the
-        //distance and we have to find it using dijkstra's algorithm
+        //distance and we have to find it from the hub labels or using dijkstra's algorithm
+        SnarlRecord snarl_record(parent, &snarl_tree_records);
+        size_t hub_labels_offset = snarl_record.get_hub_labels_offset();
+        if (hub_labels_offset != 0) {
+            return get_hub_label_distance(hub_labels_offset, snarl_record.get_node_count(), 
+                                          rank1, right_side1, rank2, right_side2);
+        }
         if (graph == nullptr) {
             if (size_limit_warnings.load() < max_num_size_limit_warnings) {
                 int warning_num = const_cast<SnarlDistanceIndex*>(this)->size_limit_warnings++;
@@ -1334,21 +1336,11 @@ size_t SnarlDistanceIndex::distance_in_snarl(const net_handle_t& parent,
             if (right_side2) {
                 net2 = flip(net2);
             }
-            handle_t handle1 = get_handle(net1, graph); 
-            handle_t handle2 = get_handle(net2, graph);
+            //For a child chain, leave through the bound on the first side and arrive through the bound on the second
+            handle_t handle1 = is_trivial_chain(net1) ? get_handle(net1, graph) : get_handle(get_bound(net1, right_side1, false), graph); 
+            handle_t handle2 = is_trivial_chain(net2) ? get_handle(net2, graph) : get_handle(get_bound(net2, right_side2, true), graph);
 
-            size_t distance = std::numeric_limits<size_t>::max();
-            handlegraph::algorithms::dijkstra(graph, handle1, [&](const handle_t& reached, size_t dist) {
-                if (reached == handle2) {
-                    distance = dist;
-                    return false;
-                } else if (dist > distance_limit) {
-                    distance = std::numeric_limits<size_t>::max();
-                    return false;
-                }
-                return true;
-            }, false);
-            return distance;
+            return distance_in_oversized_snarl(snarl_record, handle1, handle2, graph, distance_limit);
         }
         
     } else if (rank1 == 0 && rank2 == 0 && !snarl_is_root) {
@@ -1402,6 +1394,362 @@ size_t SnarlDistanceIndex::distance_in_snarl(const net_handle_t& parent,
     }
 
 }
+size_t SnarlDistanceIndex::get_hub_label_distance(size_t hub_labels_offset, size_t node_count, 
+        size_t rank1, bool right_side1, size_t rank2, bool right_side2) const {
+    //Leave the first side and go into the second
+    size_t label1 = 4 * (rank1 - 2) + 2 * (right_side1 ? 1 : 0);
+    size_t label2 = 4 * (rank2 - 2) + 2 * (right_side2 ? 1 : 0) + 1;
+    size_t entries_offset = hub_labels_offset + 4 * node_count + 1;
+    size_t i = entries_offset + 2 * snarl_tree_records->at(hub_labels_offset + label1);
+    size_t end1 = entries_offset + 2 * snarl_tree_records->at(hub_labels_offset + label1 + 1);
+    size_t j = entries_offset + 2 * snarl_tree_records->at(hub_labels_offset + label2);
+    size_t end2 = entries_offset + 2 * snarl_tree_records->at(hub_labels_offset + label2 + 1);
+
+    size_t distance = std::numeric_limits<size_t>::max();
+    while (i < end1 && j < end2) {
+        size_t hub1 = snarl_tree_records->at(i);
+        size_t hub2 = snarl_tree_records->at(j);
+        if (hub1 < hub2) {
+            i += 2;
+        } else if (hub2 < hub1) {
+            j += 2;
+        } else {
+            distance = std::min(distance, (size_t) (snarl_tree_records->at(i + 1) + snarl_tree_records->at(j + 1)));
+            i += 2;
+            j += 2;
+        }
+    }
+    return distance;
+}
+
+size_t SnarlDistanceIndex::distance_in_oversized_snarl(const SnarlRecord& snarl_record, const handle_t& from,
+        const handle_t& to, const HandleGraph* graph, size_t distance_limit, vector<handle_t>* path) {
+
+    //Search forward from the end of from and backward from the start of to, at once. Each search
+    //keeps the distance to the start of each handle it reaches, not counting the length of from.
+    //The scratch space is reused by each thread, since this gets called a lot
+    typedef pair<size_t, handle_t> queue_item_t;
+    struct SearchScratch {
+        vector<queue_item_t> queues[2];
+        unordered_map<handle_t, size_t> distances[2];
+        //The handle each handle was reached from, only if we want the path
+        unordered_map<handle_t, handle_t> previous[2];
+        //The handles the last search put in distances and previous. Clearing a map costs as much as its
+        //bucket count, which stays as big as the biggest search, so only these get erased
+        vector<handle_t> reached[2];
+    };
+    static thread_local SearchScratch scratch;
+    for (size_t i = 0 ; i < 2 ; i++) {
+        scratch.queues[i].clear();
+        for (const handle_t& handle : scratch.reached[i]) {
+            scratch.distances[i].erase(handle);
+            scratch.previous[i].erase(handle);
+        }
+        scratch.reached[i].clear();
+    }
+    auto queue_order = [](const queue_item_t& a, const queue_item_t& b) {
+        return a.first > b.first;
+    };
+
+    //Don't leave the snarl through its boundaries
+    handlegraph::nid_t start_id = snarl_record.get_start_id();
+    handlegraph::nid_t end_id = snarl_record.get_end_id();
+
+    //The backward search looks at from and to in reverse, so both searches go right
+    const handle_t starts[2] = {from, graph->flip(to)};
+    for (size_t i = 0 ; i < 2 ; i++) {
+        scratch.distances[i][starts[i]] = 0;
+        scratch.reached[i].push_back(starts[i]);
+        scratch.queues[i].emplace_back(0, starts[i]);
+    }
+    size_t best = std::numeric_limits<size_t>::max();
+    //Where the searches met for the best walk, as the handle in the forward search
+    handle_t best_meeting;
+    //If the best walk is a search getting back to where it started, which search and the handle it
+    //came back from, or 2 if the best walk is a meeting
+    size_t best_loop_search = 2;
+    handle_t best_loop_previous;
+    //If the other search has reached the end of a handle that search i reached the start of, 
+    //then we have a walk through it
+    auto check_meeting = [&](size_t i, const handle_t& here, size_t distance) {
+        handle_t reverse = graph->flip(here);
+        auto other = scratch.distances[1 - i].find(reverse);
+        //If from and to are the same handle, then the two searches start at its two ends, which doesn't make a walk
+        if (other != scratch.distances[1 - i].end() && !(here == starts[i] && reverse == starts[1 - i])) {
+            bool is_endpoint = here == starts[i] || reverse == starts[1 - i];
+            size_t walk_distance = distance + other->second + (is_endpoint ? 0 : graph->get_length(here));
+            if (walk_distance < best) {
+                best = walk_distance;
+                best_meeting = i == 0 ? here : reverse;
+                best_loop_search = 2;
+            }
+        }
+    };
+    //If from and to are the same handle, then search i getting back to its start is a walk from one to the
+    //other. check_meeting can't see it, since the start is never improved on and is where the searches begin
+    auto check_loop = [&](size_t i, const handle_t& previous, size_t distance) {
+        if (from == to && distance < best) {
+            best = distance;
+            best_loop_search = i;
+            best_loop_previous = previous;
+        }
+    };
+    while (!scratch.queues[0].empty() || !scratch.queues[1].empty()) {
+        //Once the closest handles in the two searches are too far apart, nothing better can be found.
+        //A search that has run out has already reached everything it can
+        size_t front[2];
+        for (size_t i = 0 ; i < 2 ; i++) {
+            front[i] = scratch.queues[i].empty() ? 0 : scratch.queues[i].front().first;
+        }
+        if (front[0] + front[1] >= best) {
+            break;
+        }
+        //Move the search with the closer frontier
+        size_t i = scratch.queues[1].empty() || (!scratch.queues[0].empty() && front[0] <= front[1]) ? 0 : 1;
+        vector<queue_item_t>& queue = scratch.queues[i];
+        std::pop_heap(queue.begin(), queue.end(), queue_order);
+        queue_item_t current = queue.back();
+        queue.pop_back();
+        if (current.first > scratch.distances[i][current.second]) {
+            continue;
+        }
+        check_meeting(i, current.second, current.first);
+
+        size_t next_distance = current.second == starts[i] ? 0 : current.first + graph->get_length(current.second);
+        if (next_distance > distance_limit) {
+            continue;
+        }
+        graph->follow_edges(current.second, false, [&](const handle_t& next) {
+            handlegraph::nid_t next_id = graph->get_id(next);
+            if (next_id == start_id || next_id == end_id) {
+                return;
+            }
+            if (next == starts[i]) {
+                //There's no need to search from the start again
+                check_loop(i, current.second, next_distance);
+                return;
+            }
+            auto found = scratch.distances[i].find(next);
+            if (found == scratch.distances[i].end()) {
+                scratch.reached[i].push_back(next);
+            }
+            if (found == scratch.distances[i].end() || next_distance < found->second) {
+                scratch.distances[i][next] = next_distance;
+                if (path != nullptr) {
+                    scratch.previous[i][next] = current.second;
+                }
+                queue.emplace_back(next_distance, next);
+                std::push_heap(queue.begin(), queue.end(), queue_order);
+                //Check for meeting the other search as soon as we get here, since the other search
+                //may already be done
+                check_meeting(i, next, next_distance);
+            }
+        });
+    }
+    if (best > distance_limit) {
+        return std::numeric_limits<size_t>::max();
+    }
+    if (path != nullptr) {
+        path->clear();
+        if (best_loop_search == 0) {
+            //The forward search went from from around to itself
+            for (handle_t here = best_loop_previous ; here != from ; here = scratch.previous[0].at(here)) {
+                path->push_back(here);
+            }
+            std::reverse(path->begin(), path->end());
+            return best;
+        } else if (best_loop_search == 1) {
+            //The backward search did, so its handles are already in order from from
+            for (handle_t here = best_loop_previous ; here != starts[1] ; here = scratch.previous[1].at(here)) {
+                path->push_back(graph->flip(here));
+            }
+            return best;
+        }
+        //Walk back from the meeting handle to from, then forward from it to to, leaving out from and to
+        for (handle_t here = best_meeting ; here != from ; here = scratch.previous[0].at(here)) {
+            if (here != to) {
+                path->push_back(here);
+            }
+        }
+        std::reverse(path->begin(), path->end());
+        for (handle_t here = graph->flip(best_meeting) ; here != starts[1] ; here = scratch.previous[1].at(here)) {
+            if (here != graph->flip(best_meeting)) {
+                path->push_back(graph->flip(here));
+            }
+        }
+    }
+    return best;
+}
+
+vector<size_t> SnarlDistanceIndex::make_hub_labels(const net_handle_t& snarl, const HandleGraph* graph) const {
+    SnarlRecord snarl_record(snarl, &snarl_tree_records);
+    size_t node_count = snarl_record.get_node_count();
+    handlegraph::nid_t start_id = snarl_record.get_start_id();
+    handlegraph::nid_t end_id = snarl_record.get_end_id();
+
+    //Find the nodes inside the snarl, starting from the children and stopping at the boundaries
+    unordered_map<handlegraph::nid_t, size_t> node_to_index;
+    vector<handle_t> nodes;
+    auto add_node = [&](handlegraph::nid_t id) {
+        if (id != start_id && id != end_id && !node_to_index.count(id)) {
+            node_to_index.emplace(id, nodes.size());
+            nodes.push_back(graph->get_handle(id));
+        }
+    };
+    vector<handle_t> child_exits;
+    child_exits.reserve(2 * node_count);
+    for (size_t rank = 2 ; rank < node_count + 2 ; rank++) {
+        net_handle_t child = get_snarl_child_from_rank(snarl, rank);
+        for (bool right_side : {false, true}) {
+            handle_t exit = is_node(child) ? get_handle(right_side ? child : flip(child), graph)
+                                           : get_handle(get_bound(child, right_side, false), graph);
+            child_exits.push_back(exit);
+            add_node(graph->get_id(exit));
+        }
+    }
+    for (size_t i = 0 ; i < nodes.size() ; i++) {
+        for (bool go_left : {false, true}) {
+            graph->follow_edges(nodes[i], go_left, [&](const handle_t& next) {
+                add_node(graph->get_id(next));
+            });
+        }
+    }
+
+    //Each orientation of each node is split into a vertex for going into it and one for leaving it,
+    //so that the walks between child sides are walks from a leaving vertex to an entering one.
+    //Vertex 4*node + 2*reverse + leaving. The reverse of a vertex is the vertex ^ 3
+    vector<size_t> node_lengths(nodes.size());
+    vector<vector<size_t>> entered(2 * nodes.size());
+    for (size_t i = 0 ; i < nodes.size() ; i++) {
+        node_lengths[i] = graph->get_length(nodes[i]);
+        for (bool rev : {false, true}) {
+            graph->follow_edges(graph->get_handle(graph->get_id(nodes[i]), rev), false, [&](const handle_t& next) {
+                auto found = node_to_index.find(graph->get_id(next));
+                if (found != node_to_index.end()) {
+                    entered[2 * i + rev].push_back(4 * found->second + 2 * graph->get_is_reverse(next));
+                }
+            });
+        }
+    }
+
+    //Use the nodes with the most edges as hubs first
+    vector<size_t> node_order(nodes.size());
+    std::iota(node_order.begin(), node_order.end(), 0);
+    std::stable_sort(node_order.begin(), node_order.end(), [&](size_t a, size_t b) {
+        return entered[2 * a].size() + entered[2 * a + 1].size() > entered[2 * b].size() + entered[2 * b + 1].size();
+    });
+    vector<size_t> rank_vertices;
+    rank_vertices.reserve(4 * nodes.size());
+    for (size_t i : node_order) {
+        for (size_t vertex = 4 * i ; vertex < 4 * i + 4 ; vertex++) {
+            rank_vertices.push_back(vertex);
+        }
+    }
+
+    //Each vertex has a label with the distances from it to hubs and one with the distances to it from
+    //hubs, sorted by the rank of the hub. These aren't shared between a vertex and its reverse, because
+    //a walk that goes through both orientations of a node can be pruned from both of their searches
+    vector<vector<pair<size_t, size_t>>> to_hub_labels(4 * nodes.size());
+    vector<vector<pair<size_t, size_t>>> from_hub_labels(4 * nodes.size());
+    auto query = [&](const vector<pair<size_t, size_t>>& to_hub, const vector<pair<size_t, size_t>>& from_hub) {
+        size_t distance = std::numeric_limits<size_t>::max();
+        for (size_t i = 0, j = 0 ; i < to_hub.size() && j < from_hub.size() ; ) {
+            if (to_hub[i].first < from_hub[j].first) {
+                i++;
+            } else if (from_hub[j].first < to_hub[i].first) {
+                j++;
+            } else {
+                distance = std::min(distance, to_hub[i].second + from_hub[j].second);
+                i++;
+                j++;
+            }
+        }
+        return distance;
+    };
+
+    //Pruned landmark labeling: search backward and forward from each hub, and stop wherever the labels
+    //so far already give the distance. Searching backward from a hub is searching forward from its
+    //reverse and taking the reverse of each vertex reached
+    vector<size_t> distances(4 * nodes.size(), std::numeric_limits<size_t>::max());
+    vector<size_t> reached;
+    for (size_t hub_rank = 0 ; hub_rank < rank_vertices.size() ; hub_rank++) {
+        size_t hub = rank_vertices[hub_rank];
+        for (bool backward : {true, false}) {
+            size_t start = backward ? hub ^ 3 : hub;
+            std::priority_queue<pair<size_t, size_t>, vector<pair<size_t, size_t>>, std::greater<pair<size_t, size_t>>> queue;
+            distances[start] = 0;
+            reached.push_back(start);
+            queue.emplace(0, start);
+            while (!queue.empty()) {
+                size_t distance = queue.top().first;
+                size_t vertex = queue.top().second;
+                queue.pop();
+                if (distance > distances[vertex]) {
+                    continue;
+                }
+                if (backward) {
+                    vector<pair<size_t, size_t>>& label = to_hub_labels[vertex ^ 3];
+                    if (query(label, from_hub_labels[hub]) <= distance) {
+                        continue;
+                    }
+                    label.emplace_back(hub_rank, distance);
+                } else {
+                    vector<pair<size_t, size_t>>& label = from_hub_labels[vertex];
+                    if (query(to_hub_labels[hub], label) <= distance) {
+                        continue;
+                    }
+                    label.emplace_back(hub_rank, distance);
+                }
+                auto relax = [&](size_t next, size_t next_distance) {
+                    if (next_distance < distances[next]) {
+                        if (distances[next] == std::numeric_limits<size_t>::max()) {
+                            reached.push_back(next);
+                        }
+                        distances[next] = next_distance;
+                        queue.emplace(next_distance, next);
+                    }
+                };
+                if (vertex & 1) {
+                    for (size_t next : entered[vertex >> 1]) {
+                        relax(next, distance);
+                    }
+                } else {
+                    relax(vertex + 1, distance + node_lengths[vertex >> 2]);
+                }
+            }
+            for (size_t vertex : reached) {
+                distances[vertex] = std::numeric_limits<size_t>::max();
+            }
+            reached.clear();
+        }
+    }
+
+    //Lay out the labels for leaving and going into the sides of the children. Going into a side is
+    //the reverse of leaving it
+    vector<const vector<pair<size_t, size_t>>*> child_labels;
+    child_labels.reserve(2 * child_exits.size());
+    for (const handle_t& exit : child_exits) {
+        size_t leaving = 4 * node_to_index.at(graph->get_id(exit)) + 2 * graph->get_is_reverse(exit) + 1;
+        child_labels.push_back(&to_hub_labels[leaving]);
+        child_labels.push_back(&from_hub_labels[leaving ^ 3]);
+    }
+    vector<size_t> hub_labels;
+    hub_labels.reserve(child_labels.size() + 1);
+    size_t entry_count = 0;
+    for (auto label : child_labels) {
+        hub_labels.push_back(entry_count);
+        entry_count += label->size();
+    }
+    hub_labels.push_back(entry_count);
+    for (auto label : child_labels) {
+        for (auto& entry : *label) {
+            hub_labels.push_back(entry.first);
+            hub_labels.push_back(entry.second);
+        }
+    }
+    return hub_labels;
+}
+
 size_t SnarlDistanceIndex::max_distance_in_parent(const net_handle_t& parent, 
         const net_handle_t& child1, const net_handle_t& child2, const HandleGraph* graph, size_t distance_limit) const {
 
@@ -1721,7 +2069,7 @@ pair<net_handle_t, bool> SnarlDistanceIndex::lowest_common_ancestor(const net_ha
 size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const bool rev1, const size_t offset1, 
                                             const handlegraph::nid_t id2, const bool rev2, const size_t offset2, 
                                             bool unoriented_distance, const HandleGraph* graph, 
-                                            pair<vector<tuple<net_handle_t, int32_t, int32_t>>, vector<tuple<net_handle_t, int32_t, int32_t>>>* distance_traceback) const {
+                                            pair<vector<tuple<net_handle_t, int64_t, int64_t>>, vector<tuple<net_handle_t, int64_t, int64_t>>>* distance_traceback) const {
     RootRecord root_record (get_root(), &snarl_tree_records);
     size_t max_node_id = root_record.get_min_node_id() + root_record.get_node_count();
     if (id1 < root_record.get_min_node_id() || id2 < root_record.get_min_node_id() ||
@@ -1764,12 +2112,12 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
 
             if (distance_traceback != nullptr) {
                 //Add an entry for this node
-                tuple<net_handle_t, int32_t, int32_t>* current_traceback;
+                tuple<net_handle_t, int64_t, int64_t>* current_traceback;
                 if (first_node) {
-                    distance_traceback->first.emplace_back(parent, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max());
+                    distance_traceback->first.emplace_back(parent, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
                     current_traceback = &distance_traceback->first.back();
                 } else {
-                    distance_traceback->second.emplace_back(parent, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max());
+                    distance_traceback->second.emplace_back(parent, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
                     current_traceback = &distance_traceback->second.back();
                 }
 
@@ -1777,9 +2125,9 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
                 //If we're keeping track of the traceback, then remember the distance to the start/end of the parent
                 if (is_reversed_in_parent(net)) {
                     std::get<1>(*current_traceback) = 0; 
-                    std::get<2>(*current_traceback) = std::numeric_limits<int32_t>::min();
+                    std::get<2>(*current_traceback) = std::numeric_limits<int64_t>::min();
                 } else {
-                    std::get<1>(*current_traceback) = std::numeric_limits<int32_t>::min();
+                    std::get<1>(*current_traceback) = std::numeric_limits<int64_t>::min();
                     std::get<2>(*current_traceback) = 0;
                 }
             }
@@ -1810,12 +2158,12 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
 
         if (distance_traceback != nullptr) {
             //Add an entry for this node
-            tuple<net_handle_t, int32_t, int32_t>* current_traceback;
+            tuple<net_handle_t, int64_t, int64_t>* current_traceback;
             if (first_node) {
-                distance_traceback->first.emplace_back(parent, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max());
+                distance_traceback->first.emplace_back(parent, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
                 current_traceback = &distance_traceback->first.back();
             } else {
-                distance_traceback->second.emplace_back(parent, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max());
+                distance_traceback->second.emplace_back(parent, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
                 current_traceback = &distance_traceback->second.back();
             }
 
@@ -1825,7 +2173,7 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
             if (sum(distance_start_start, distance_start) != std::numeric_limits<size_t>::max() &&
                 sum(distance_start_start, distance_start) < sum(distance_start_end , distance_end) ) {
                 //If the distance to the start of the parent comes form the start of the node
-                std::get<1>(*current_traceback) = distance_start_start == 0 ? std::numeric_limits<int32_t>::min() : -distance_start_start; 
+                std::get<1>(*current_traceback) = distance_start_start == 0 ? std::numeric_limits<int64_t>::min() : -distance_start_start; 
             } else if (sum(distance_start_end , distance_end) != std::numeric_limits<size_t>::max()) {
                 //If the distance to the start of the parent comes from the end of the node
                 std::get<1>(*current_traceback) = distance_start_end; 
@@ -1835,7 +2183,7 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
             if (sum(distance_end_start , distance_start) != std::numeric_limits<size_t>::max() &&
                 sum(distance_end_start , distance_start) < sum(distance_end_end , distance_end)) {
                 //If the distance to the end of the parent comes from the distance to the start of the node
-                std::get<2>(*current_traceback) = distance_end_start == 0 ? std::numeric_limits<int32_t>::min() : -distance_end_start;
+                std::get<2>(*current_traceback) = distance_end_start == 0 ? std::numeric_limits<int64_t>::min() : -distance_end_start;
             } else if (sum(distance_end_end , distance_end)) {
                 //If the distance to the end of the parent comes from the distance to the end of the node
                 std::get<2>(*current_traceback) = distance_end_end;
@@ -1931,11 +2279,11 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
         if (distance_traceback != nullptr) {
             //If we're recording the traceback, add the nodes
             distance_traceback->first.emplace_back(net1, 
-                                                   distance_to_start1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_start1, 
-                                                   distance_to_end1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_end1);
+                                                   distance_to_start1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_start1, 
+                                                   distance_to_end1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_end1);
             distance_traceback->second.emplace_back(net2, 
-                                                   distance_to_start2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_start2, 
-                                                   distance_to_end2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_end2);        
+                                                   distance_to_start2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_start2, 
+                                                   distance_to_end2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_end2);        
         }
         common_ancestor = start_end_traversal_of(get_parent(net1));
     } else {
@@ -1947,11 +2295,11 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
         if (distance_traceback != nullptr) {
             //Start the traceback with the nodes themselves and their offsets
             distance_traceback->first.emplace_back(net1, 
-                                                   distance_to_start1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_start1, 
-                                                   distance_to_end1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_end1);
+                                                   distance_to_start1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_start1, 
+                                                   distance_to_end1 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_end1);
             distance_traceback->second.emplace_back(net2, 
-                                                   distance_to_start2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_start2, 
-                                                   distance_to_end2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int32_t>::max() : distance_to_end2);        
+                                                   distance_to_start2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_start2, 
+                                                   distance_to_end2 == std::numeric_limits<size_t>::max() ? std::numeric_limits<int64_t>::max() : distance_to_end2);        
         }
         while (start_end_traversal_of(get_parent(net1)) != common_ancestor && !is_root(get_parent(net1))) {
             net_handle_t parent = start_end_traversal_of(get_parent(net1));
@@ -2039,8 +2387,8 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
             //Just update this one to break out of the loop
             net1 = common_ancestor;
             if (distance_traceback != nullptr) {
-                distance_traceback->first.emplace_back(common_ancestor, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max());
-                distance_traceback->second.emplace_back(common_ancestor, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max());
+                distance_traceback->first.emplace_back(common_ancestor, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
+                distance_traceback->second.emplace_back(common_ancestor, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
             }
 
         }
@@ -2062,7 +2410,7 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
             //Otherwise, do the traceback
 
             for ( bool first_node : {true, false}) {
-                vector<tuple<net_handle_t, int32_t, int32_t>>& current_vector = first_node ? distance_traceback->first : distance_traceback->second;
+                vector<tuple<net_handle_t, int64_t, int64_t>>& current_vector = first_node ? distance_traceback->first : distance_traceback->second;
                 //Cut back the traceback to the common ancestor where the children were connected
                 while (std::get<0>(current_vector.back()) != std::get<0>(common_ancestor_connectivity)) {
                     current_vector.pop_back();
@@ -2083,13 +2431,13 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
                 bool to_start = (first_node && get_end_endpoint(std::get<2>(common_ancestor_connectivity)) == START) ||
                                   (!first_node && get_start_endpoint(std::get<2>(common_ancestor_connectivity)) == START);
                 if (to_start) { 
-                    std::get<1>(current_vector.back()) = from_start ? (std::get<1>(common_ancestor_connectivity) == 0 ? std::numeric_limits<int32_t>::min()
+                    std::get<1>(current_vector.back()) = from_start ? (std::get<1>(common_ancestor_connectivity) == 0 ? std::numeric_limits<int64_t>::min()
                                                                                                                       : -std::get<1>(common_ancestor_connectivity))
                                                                     : std::get<1>(common_ancestor_connectivity);
-                    std::get<2>(current_vector.back()) = std::numeric_limits<int32_t>::max();
+                    std::get<2>(current_vector.back()) = std::numeric_limits<int64_t>::max();
                 } else {
-                    std::get<1>(current_vector.back()) = std::numeric_limits<int32_t>::max();
-                    std::get<2>(current_vector.back()) = from_start ? (std::get<1>(common_ancestor_connectivity) == 0 ? std::numeric_limits<int32_t>::min()
+                    std::get<1>(current_vector.back()) = std::numeric_limits<int64_t>::max();
+                    std::get<2>(current_vector.back()) = from_start ? (std::get<1>(common_ancestor_connectivity) == 0 ? std::numeric_limits<int64_t>::min()
                                                                                                                       : -std::get<1>(common_ancestor_connectivity))
                                                                     : std::get<1>(common_ancestor_connectivity);
                 }
@@ -2101,23 +2449,23 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
                     assert(i >= 0 && i < current_vector.size());
                     if (from_start) {
                         //If the parent of the current child has distance out the start, clear the distance to this child's parent's end
-                        std::get<2>(current_vector[i]) = std::numeric_limits<int32_t>::max();
+                        std::get<2>(current_vector[i]) = std::numeric_limits<int64_t>::max();
 
                         //If the current child's distance to it's parent's start is negative, then it's distance went out the start so
                         //we will want it's child distance to the start
                         from_start = std::get<1>(current_vector[i]) < 0;
 #ifdef debug_distances
-                        assert(std::get<1>(current_vector[i]) != std::numeric_limits<int32_t>::max());
+                        assert(std::get<1>(current_vector[i]) != std::numeric_limits<int64_t>::max());
 #endif
                     } else {
                         //If the parent of the current child has distance out the end, clear the distance to this child's parent's start
-                        std::get<1>(current_vector[i]) = std::numeric_limits<int32_t>::max();
+                        std::get<1>(current_vector[i]) = std::numeric_limits<int64_t>::max();
 
                         //If the current child's distance to it's parent's end is negative, then it's distance went out the start so
                         //we will want it's child distance to the start
                         from_start = std::get<2>(current_vector[i]) < 0;
 #ifdef debug_distances
-                        assert(std::get<2>(current_vector[i]) != std::numeric_limits<int32_t>::max());
+                        assert(std::get<2>(current_vector[i]) != std::numeric_limits<int64_t>::max());
 #endif
                     }
                 }
@@ -2142,6 +2490,225 @@ size_t SnarlDistanceIndex::minimum_distance(const handlegraph::nid_t id1, const
 
 
 
+}
+
+vector<size_t> SnarlDistanceIndex::minimum_distances(const tuple<handlegraph::nid_t, bool, size_t>& position,
+                                                     const vector<tuple<handlegraph::nid_t, bool, size_t>>& positions,
+                                                     bool unoriented_distance, const HandleGraph* graph) const {
+    AncestorWalk walk = get_ancestor_walk(position, false, unoriented_distance, graph);
+    vector<size_t> distances;
+    distances.reserve(positions.size());
+    for (const tuple<handlegraph::nid_t, bool, size_t>& other : positions) {
+        distances.push_back(minimum_distance(walk, get_ancestor_walk(other, true, unoriented_distance, graph), graph));
+    }
+    return distances;
+}
+
+vector<vector<size_t>> SnarlDistanceIndex::minimum_distances(const vector<tuple<handlegraph::nid_t, bool, size_t>>& positions1,
+                                                             const vector<tuple<handlegraph::nid_t, bool, size_t>>& positions2,
+                                                             bool unoriented_distance, const HandleGraph* graph) const {
+    //Walk up the snarl tree once for each position
+    vector<AncestorWalk> walks2;
+    walks2.reserve(positions2.size());
+    for (const tuple<handlegraph::nid_t, bool, size_t>& position : positions2) {
+        walks2.emplace_back(get_ancestor_walk(position, true, unoriented_distance, graph));
+    }
+    vector<vector<size_t>> distances;
+    distances.reserve(positions1.size());
+    for (const tuple<handlegraph::nid_t, bool, size_t>& position : positions1) {
+        AncestorWalk walk1 = get_ancestor_walk(position, false, unoriented_distance, graph);
+        distances.emplace_back();
+        distances.back().reserve(walks2.size());
+        for (const AncestorWalk& walk2 : walks2) {
+            distances.back().push_back(minimum_distance(walk1, walk2, graph));
+        }
+    }
+    return distances;
+}
+
+SnarlDistanceIndex::AncestorWalk SnarlDistanceIndex::get_ancestor_walk(const tuple<handlegraph::nid_t, bool, size_t>& position, bool is_second,
+                                                                       bool unoriented_distance, const HandleGraph* graph) const {
+    handlegraph::nid_t id = std::get<0>(position);
+    bool rev = std::get<1>(position);
+    size_t offset = std::get<2>(position);
+
+    RootRecord root_record (get_root(), &snarl_tree_records);
+    size_t max_node_id = root_record.get_min_node_id() + root_record.get_node_count();
+    if (id < root_record.get_min_node_id() || id > max_node_id) {
+        throw runtime_error("error: Looking for the minimum distance of a node that does not exist");
+    }
+
+    AncestorWalk walk;
+    net_handle_t net = get_node_net_handle(id);
+    walk.node_length = node_length(net);
+
+    //These are the distances to the ends of the node, including the position
+    size_t distance_to_start = rev ? walk.node_length - offset : offset + 1;
+    size_t distance_to_end = rev ? offset + 1 : walk.node_length - offset;
+    if (!unoriented_distance) {
+        //If we care about the oriented distance, one of the distances will be infinite.
+        //The first position is left going forward and the second is reached going forward
+        if (rev != is_second) {
+            distance_to_end = std::numeric_limits<size_t>::max();
+        } else {
+            distance_to_start = std::numeric_limits<size_t>::max();
+        }
+    }
+    walk.ancestors.push_back(net);
+    walk.distances.emplace_back(distance_to_start, distance_to_end);
+
+    //Walk up to the root, keeping track of the distances to the ends of each ancestor
+    net_handle_t parent = get_parent(net);
+    while (!is_root(parent)) {
+        parent = start_end_traversal_of(parent);
+        update_distances_to_parent(net, parent, distance_to_start, distance_to_end, graph);
+        net = parent;
+        walk.ancestors.push_back(net);
+        walk.distances.emplace_back(distance_to_start, distance_to_end);
+        parent = get_parent(net);
+    }
+    walk.root_parent_offset = SnarlTreeRecord(parent, &snarl_tree_records).get_parent_record_offset();
+    walk.ancestors.push_back(start_end_traversal_of(parent));
+
+    //None of the loop distances are known yet
+    walk.loop_distances.resize(walk.distances.size());
+    walk.loop_distances_from = walk.distances.size();
+    return walk;
+}
+
+void SnarlDistanceIndex::fill_loop_distances(AncestorWalk& walk, size_t level, const HandleGraph* graph) const {
+    //Once the walks of two positions meet, both of them are at the same ancestor, so the
+    //distances between the positions in the ancestors above that are loops through each ancestor
+    for ( ; walk.loop_distances_from > level ; walk.loop_distances_from--) {
+        const net_handle_t& child = walk.ancestors[walk.loop_distances_from-1];
+        const net_handle_t& ancestor = walk.ancestors[walk.loop_distances_from];
+        walk.loop_distances[walk.loop_distances_from-1] = {{distance_in_parent(ancestor, flip(child), flip(child), graph),
+                                                            distance_in_parent(ancestor, flip(child), child, graph),
+                                                            distance_in_parent(ancestor, child, flip(child), graph),
+                                                            distance_in_parent(ancestor, child, child, graph)}};
+    }
+}
+
+void SnarlDistanceIndex::update_distances_to_parent(const net_handle_t& net, const net_handle_t& parent,
+                                                    size_t& dist_start, size_t& dist_end, const HandleGraph* graph) const {
+    if (is_trivial_chain(parent)) {
+        //Don't update distances for the trivial chain
+        return;
+    } else if (is_simple_snarl(parent)) {
+        //If it's a simple snarl just check if they should be reversed
+        if (is_reversed_in_parent (net)) {
+            std::swap(dist_start, dist_end);
+        }
+        return;
+    }
+
+    net_handle_t start_bound = get_bound(parent, false, true);
+    net_handle_t end_bound = get_bound(parent, true, true);
+
+    //The lengths of the start and end nodes of net
+    //This is only needed if net is a snarl, since the boundary nodes are not technically part of the snarl
+    size_t start_length = is_chain(parent) ? node_length(start_bound) : 0;
+    size_t end_length = is_chain(parent) ? node_length(end_bound) : 0;
+
+    //Get the distances from the bounds of the parent to the node we're looking at
+    size_t distance_start_start = start_bound == net ? 0
+            : sum(start_length, distance_in_parent(parent, start_bound, flip(net), graph));
+    size_t distance_start_end = start_bound == flip(net) ? 0
+            : sum(start_length, distance_in_parent(parent, start_bound, net, graph));
+    size_t distance_end_start = end_bound == net ? 0
+            : sum(end_length, distance_in_parent(parent, end_bound, flip(net), graph));
+    size_t distance_end_end = end_bound == flip(net) ? 0
+            : sum(end_length, distance_in_parent(parent, end_bound, net, graph));
+
+    size_t distance_start = dist_start;
+    size_t distance_end = dist_end;
+    dist_start = std::min(sum(distance_start_start, distance_start),
+                          sum(distance_start_end , distance_end));
+    dist_end = std::min(sum(distance_end_start , distance_start),
+                        sum(distance_end_end , distance_end));
+}
+
+size_t SnarlDistanceIndex::minimum_distance(AncestorWalk& walk1, const AncestorWalk& walk2, const HandleGraph* graph) const {
+
+    size_t minimum_distance = std::numeric_limits<size_t>::max();
+
+    //Find the children of the lowest common ancestor in each walk
+    size_t child1 = 0;
+    size_t child2 = 0;
+    if (start_end_traversal_of(walk1.ancestors.front()) == start_end_traversal_of(walk2.ancestors.front())) {
+        //If the positions are on the same node and are pointing towards each other, then
+        //check the distance between them in the node
+        size_t distance_to_start1 = walk1.distances.front().first;
+        size_t distance_to_end1 = walk1.distances.front().second;
+        size_t distance_to_start2 = walk2.distances.front().first;
+        size_t distance_to_end2 = walk2.distances.front().second;
+        if (sum(distance_to_end1 , distance_to_start2) > walk1.node_length &&
+            sum(distance_to_end1 , distance_to_start2) != std::numeric_limits<size_t>::max()) {
+            minimum_distance = minus(sum(distance_to_end1 , distance_to_start2), walk1.node_length);
+        }
+        if (sum(distance_to_start1 , distance_to_end2) > walk1.node_length &&
+            sum(distance_to_start1 , distance_to_end2) != std::numeric_limits<size_t>::max()) {
+            minimum_distance = std::min(minus(sum(distance_to_start1 , distance_to_end2), walk1.node_length), minimum_distance);
+        }
+    } else {
+        //The walks are the same from the root down to the lowest common ancestor, so go down
+        //from the top until they differ
+        child1 = walk1.distances.size() - 1;
+        child2 = walk2.distances.size() - 1;
+        if (walk1.ancestors[child1] != walk2.ancestors[child2]) {
+            //The lowest common ancestor is the root
+            if (walk1.root_parent_offset != walk2.root_parent_offset) {
+                //If these are not in the same connected component
+                return std::numeric_limits<size_t>::max();
+            }
+        } else {
+            while (child1 > 0 && child2 > 0 && walk1.ancestors[child1-1] == walk2.ancestors[child2-1]) {
+                child1--;
+                child2--;
+            }
+            //Only the same node can be the lowest common ancestor
+            assert(child1 > 0 && child2 > 0);
+            child1--;
+            child2--;
+        }
+    }
+
+    /*
+     * Walk up to the root and check for distances between the positions within each
+     * ancestor, starting from the lowest common ancestor
+     */
+    fill_loop_distances(walk1, child1 + 1, graph);
+    for (size_t level1 = child1, level2 = child2 ; level1 < walk1.distances.size() ; level1++, level2++) {
+        const net_handle_t& common_ancestor = walk1.ancestors[level1+1];
+        size_t distance_to_start1 = walk1.distances[level1].first;
+        size_t distance_to_end1 = walk1.distances[level1].second;
+        size_t distance_to_start2 = walk2.distances[level2].first;
+        size_t distance_to_end2 = walk2.distances[level2].second;
+
+        //Find the minimum distance between the two children
+        std::array<size_t, 4> distances_between;
+        if (level1 == child1) {
+            const net_handle_t& net1 = walk1.ancestors[level1];
+            const net_handle_t& net2 = walk2.ancestors[level2];
+            distances_between = {{distance_in_parent(common_ancestor, flip(net1), flip(net2), graph),
+                                  distance_in_parent(common_ancestor, flip(net1), net2, graph),
+                                  distance_in_parent(common_ancestor, net1, flip(net2), graph),
+                                  distance_in_parent(common_ancestor, net1, net2, graph)}};
+        } else {
+            //Above the lowest common ancestor, both children are the same
+            distances_between = walk1.loop_distances[level1];
+        }
+
+        //And add those to the distances we've found to get the minimum distance between the positions
+        minimum_distance = std::min(minimum_distance,
+                           std::min(sum(sum(distances_between[0] , distance_to_start1), distance_to_start2),
+                           std::min(sum(sum(distances_between[1] , distance_to_start1), distance_to_end2),
+                           std::min(sum(sum(distances_between[2] , distance_to_end1), distance_to_start2),
+                                    sum(sum(distances_between[3] , distance_to_end1), distance_to_end2)))));
+    }
+
+    //minimum distance currently includes both positions
+    return minimum_distance == std::numeric_limits<size_t>::max() ? std::numeric_limits<size_t>::max() : minimum_distance-1;
 }
 size_t SnarlDistanceIndex::maximum_distance(const handlegraph::nid_t id1, const bool rev1, const size_t offset1, 
                                             const handlegraph::nid_t id2, const bool rev2, const size_t offset2, 
@@ -2393,9 +2960,6 @@ size_t SnarlDistanceIndex::maximum_distance(const handlegraph::nid_t id1, const
 }
 void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid_t id1, const bool rev1, const handlegraph::nid_t id2, const bool rev2, 
                                       const HandleGraph* graph, const std::function<bool(const handlegraph::handle_t, size_t)>& iteratee) const {
-    cerr << "This isn't working, use handlegraph::algorithms::for_each_handle_in_shortest_path instead until I fix it" << endl;
-    return;
-
     /* First, run minimum distance to get the traceback.
      * The traceback will be a list of ancestors for each node. They will take the format 
         <net_handle, distance from last child to to start of net, distance to end of net>
@@ -2403,7 +2967,7 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
        The last entry in both lists will be for the lowest common ancestor that must be traversed to find the minimum distance (not
        necessarily the actual lowest common ancestor), and the distances will be from either end of the 
     */
-    pair<vector<tuple<net_handle_t, int32_t, int32_t>>, vector<tuple<net_handle_t, int32_t, int32_t>>> distance_traceback;
+    pair<vector<tuple<net_handle_t, int64_t, int64_t>>, vector<tuple<net_handle_t, int64_t, int64_t>>> distance_traceback;
     size_t distance = minimum_distance(id1, rev1, 0, id2, rev2, 0, false,graph, &distance_traceback);
 #ifdef debug_distance_paths
     cerr << endl << "Find the minimum distance path between " << id1 << (rev1 ? "rev" : "fd") << " and " << id2 << (rev2 ? "rev" : "fd")
@@ -2444,9 +3008,19 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
      * to get from the boundary nodes to each child
     */
 
-    // Start with the first node
-    net_handle_t& current_node = std::get<0>(distance_traceback.first[0]);
-    net_handle_t& current_parent = std::get<0>(distance_traceback.first[1]);
+    //Once iteratee returns false, stop calling it and stop walking. The helpers don't stop on their own
+    //in the middle of a snarl or chain, so they get this wrapper instead of the iteratee
+    bool keep_going = true;
+    std::function<bool(const handlegraph::handle_t, size_t)> iteratee_until_false = [&](const handlegraph::handle_t handle, size_t distance) {
+        if (keep_going) {
+            keep_going = iteratee(handle, distance);
+        }
+        return keep_going;
+    };
+
+    // Start with the first node. These are copies, since the traceback has to stay intact while we walk it
+    net_handle_t current_node = std::get<0>(distance_traceback.first[0]);
+    net_handle_t current_parent = std::get<0>(distance_traceback.first[1]);
 
     size_t distance_traversed = 0;
 
@@ -2463,16 +3037,16 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
 #endif
 
         //The (signed) distance from the current node to the end of the current parent
-        int32_t distance_to_traverse = std::get<2>(distance_traceback.first[i]) == std::numeric_limits<int32_t>::max() 
+        int64_t distance_to_traverse = std::get<2>(distance_traceback.first[i]) == std::numeric_limits<int64_t>::max() 
                             ? std::get<1>(distance_traceback.first[i])
                             :  std::get<2>(distance_traceback.first[i]);
 #ifdef debug_distance_paths
-        assert(distance_to_traverse != std::numeric_limits<int32_t>::max());                                
+        assert(distance_to_traverse != std::numeric_limits<int64_t>::max());                                
 #endif
 
         //The boundary node/sentinel of the parent pointing out of the parent
         net_handle_t boundary;
-        if (std::get<1>(distance_traceback.first[i]) == std::numeric_limits<int32_t>::max()) {
+        if (std::get<1>(distance_traceback.first[i]) == std::numeric_limits<int64_t>::max()) {
             //If we're traversing to the end of the parent
             boundary = get_bound(current_parent, true, false);
         } else {
@@ -2486,21 +3060,24 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
             current_node = flip(current_node);
         }
         //We don't care about the orientation for the distance anymore so get the actual value
-        distance_to_traverse = distance_to_traverse == std::numeric_limits<int32_t>::min() ? 0 : std::abs(distance_to_traverse);
+        distance_to_traverse = distance_to_traverse == std::numeric_limits<int64_t>::min() ? 0 : std::abs(distance_to_traverse);
 
 
         if (is_chain(current_parent)) {
             if (current_node != boundary) {
                 //Go from current node to boundary, not including the length of boundary in the distance_to_traverse
-                for_each_handle_in_shortest_path_in_chain(current_parent, current_node, boundary, distance_to_traverse - node_length(boundary), distance_traversed, graph, iteratee, nullptr);
+                for_each_handle_in_shortest_path_in_chain(current_parent, current_node, boundary, distance_to_traverse - node_length(boundary), distance_traversed, graph, iteratee_until_false, nullptr);
 
                 //Now iteratee() on boundary
-                iteratee(get_handle(boundary, graph), distance_traversed);
+                iteratee_until_false(get_handle(boundary, graph), distance_traversed);
                 distance_traversed += minimum_length(boundary);
                 distance_to_traverse -= minimum_length(boundary);
             }
         } else {
-            for_each_handle_in_shortest_path_in_snarl(current_parent, current_node, boundary, distance_to_traverse, distance_traversed, graph, iteratee, nullptr);
+            for_each_handle_in_shortest_path_in_snarl(current_parent, current_node, boundary, distance_to_traverse, distance_traversed, graph, iteratee_until_false, nullptr);
+        }
+        if (!keep_going) {
+            return;
         }
         current_node = current_parent;
         current_parent = std::get<0>(distance_traceback.first[i+1]);
@@ -2512,7 +3089,7 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
     assert(current_parent == std::get<0>(distance_traceback.second.back()));
 #endif
 
-    int32_t distance_between = std::get<1>(distance_traceback.first[distance_traceback.first.size()-1]) == std::numeric_limits<int32_t>::max() 
+    int64_t distance_between = std::get<1>(distance_traceback.first[distance_traceback.first.size()-1]) == std::numeric_limits<int64_t>::max() 
                              ? std::get<2>(distance_traceback.first[distance_traceback.first.size()-1])
                              : std::get<1>(distance_traceback.first[distance_traceback.first.size()-1]);
 
@@ -2534,12 +3111,12 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
         || (ends_at(current_node) == START && distance_between > 0)) {
         current_node = flip(current_node);
     } 
-    distance_between = distance_between == std::numeric_limits<int32_t>::min() ? 0 : std::abs(distance_between);
+    distance_between = distance_between == std::numeric_limits<int64_t>::min() ? 0 : std::abs(distance_between);
 
     //And the next node. Based on the last entry in the first node's traceback. The second or third value will 
     //be inf depending on whether the second node's ancestor is traversed forward or backwards 
-    if ((ends_at(next_node) != START && std::get<1>(distance_traceback.first.back()) == std::numeric_limits<int32_t>::max()) 
-        || (ends_at(next_node) == START && std::get<2>(distance_traceback.first.back()) == std::numeric_limits<int32_t>::max())) {
+    if ((ends_at(next_node) != START && std::get<1>(distance_traceback.first.back()) == std::numeric_limits<int64_t>::max()) 
+        || (ends_at(next_node) == START && std::get<2>(distance_traceback.first.back()) == std::numeric_limits<int64_t>::max())) {
 #ifdef debug_distance_paths
         cerr << "Flip next node which is currently: " << net_handle_as_string(next_node) << " because the last traceback for the first node is " 
              << net_handle_as_string(std::get<0>(distance_traceback.first.back())) << " " 
@@ -2550,9 +3127,12 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
     }
 
     if (is_chain(current_parent)) {
-        for_each_handle_in_shortest_path_in_chain(current_parent, current_node, next_node, distance_between, distance_traversed, graph, iteratee, nullptr);
+        for_each_handle_in_shortest_path_in_chain(current_parent, current_node, next_node, distance_between, distance_traversed, graph, iteratee_until_false, nullptr);
     } else {
-        for_each_handle_in_shortest_path_in_snarl(current_parent, current_node, next_node, distance_between, distance_traversed, graph, iteratee, nullptr);
+        for_each_handle_in_shortest_path_in_snarl(current_parent, current_node, next_node, distance_between, distance_traversed, graph, iteratee_until_false, nullptr);
+    }
+    if (!keep_going) {
+        return;
     }
 
     /* Now walk down the snarl tree for the second node, finding the distance_to_traverse from the bound of each parent to its child
@@ -2581,13 +3161,13 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
 #endif
 
         //The (signed) distance_to_traverse from the current node to the end of the current parent
-        int32_t distance_to_traverse = std::get<2>(distance_traceback.second[i]) == std::numeric_limits<int32_t>::max() 
+        int64_t distance_to_traverse = std::get<2>(distance_traceback.second[i]) == std::numeric_limits<int64_t>::max() 
                             ? std::get<1>(distance_traceback.second[i])
                             :  std::get<2>(distance_traceback.second[i]);
 
         //The boundary node/sentinel of the parent pointing into the parent
         net_handle_t boundary;
-        if (std::get<1>(distance_traceback.second[i]) == std::numeric_limits<int32_t>::max()) {
+        if (std::get<1>(distance_traceback.second[i]) == std::numeric_limits<int64_t>::max()) {
             //If we're traversing to the end of the parent
             boundary = get_bound(current_parent, true, true);
         } else {
@@ -2602,20 +3182,23 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path(const handlegraph::nid
         } 
 
         //We don't care about the orientation for the distance anymore so get the actual value
-        distance_to_traverse = distance_to_traverse == std::numeric_limits<int32_t>::min() ? 0 : std::abs(distance_to_traverse);
+        distance_to_traverse = distance_to_traverse == std::numeric_limits<int64_t>::min() ? 0 : std::abs(distance_to_traverse);
 
 
         if (is_chain(current_parent)) {
 
             if (next_node != boundary) {
-                iteratee(get_handle(boundary, graph), distance_traversed);
+                iteratee_until_false(get_handle(boundary, graph), distance_traversed);
                 distance_traversed += minimum_length(boundary);
                 distance_to_traverse -= minimum_length(boundary);
 
-                for_each_handle_in_shortest_path_in_chain(current_parent, boundary, next_node, distance_to_traverse, distance_traversed, graph, iteratee, nullptr);
+                for_each_handle_in_shortest_path_in_chain(current_parent, boundary, next_node, distance_to_traverse, distance_traversed, graph, iteratee_until_false, nullptr);
             }
         } else {
-            for_each_handle_in_shortest_path_in_snarl(current_parent, boundary, next_node, distance_to_traverse, distance_traversed, graph, iteratee, nullptr);
+            for_each_handle_in_shortest_path_in_snarl(current_parent, boundary, next_node, distance_to_traverse, distance_traversed, graph, iteratee_until_false, nullptr);
+        }
+        if (!keep_going) {
+            return;
         }
 
     }
@@ -2641,9 +3224,9 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path_in_snarl(const net_han
     */
 
     SnarlRecord snarl_record (snarl_handle, &snarl_tree_records);
-    if (snarl_record.get_record_type() == OVERSIZED_SNARL) {
-        //IF this is an oversized snarl, then we don't have any distance information so use the handlgraph algorithm
-        //for traversing the shortest path
+    if (snarl_record.get_record_type() == OVERSIZED_SNARL && snarl_record.get_hub_labels_offset() == 0) {
+        //If this is an oversized snarl without hub labels, then we don't have any distance information so 
+        //search the graph in the snarl for the shortest path
 
         //Get the start going out of the child chain (or just the node)
         handlegraph::handle_t start_handle = (is_trivial_chain(start) || is_sentinel(start)) ? get_handle(start, graph) :
@@ -2657,16 +3240,19 @@ void SnarlDistanceIndex::for_each_handle_in_shortest_path_in_snarl(const net_han
 #endif
 
         //Add distance traversed through the snarl to distance_traversed
-        size_t distance_to_add = 0;
-        handlegraph::algorithms::for_each_handle_in_shortest_path(graph, start_handle, end_handle, [&](handlegraph::handle_t next_handle, size_t distance) {
-            distance_to_add += graph->get_length(next_handle);
+        vector<handlegraph::handle_t> path;
+        distance_in_oversized_snarl(snarl_record, start_handle, end_handle, graph, distance_to_traverse, &path);
+        for (const handlegraph::handle_t& next_handle : path) {
             if (to_duplicate != nullptr) {
                 net_handle_t duplicated_node = get_net(next_handle, graph);
                 to_duplicate->emplace_back(flip(duplicated_node), minimum_length(duplicated_node));
             }
-            return iteratee(next_handle, distance + distance_traversed);
-        });
-        distance_traversed += distance_to_add;
+            if (!iteratee(next_handle, distance_traversed)) {
+                //The caller wants us to stop
+                return;
+            }
+            distance_traversed += graph->get_length(next_handle);
+        }
 #ifdef debug_distance_paths
         cerr << "Finished traversing oversized snarl, we've now traversed " << distance_traversed << endl;
 #endif
@@ -4094,7 +4680,8 @@ size_t SnarlDistanceIndex::SnarlRecord::distance_vector_size(record_t type, size
         size_t vector_size =  (((node_side_count+1)*node_side_count) / 2);
         return vector_size;
     } else if (type ==  OVERSIZED_SNARL){
-        //For a large min_distance snarl, all distances get stored in the children
+        //For a large min_distance snarl, all distances get stored in the children. The pointer
+        //to the hub labels, if there is one, is added when the record is made
         return 0;
     } else {
         throw runtime_error ("error: this is not a snarl");
@@ -4106,7 +4693,63 @@ size_t SnarlDistanceIndex::SnarlRecord::record_size (record_t type, size_t node_
 }
 size_t SnarlDistanceIndex::SnarlRecord::record_size() {
     record_t type = get_record_type();
-   return record_size(type, get_node_count());
+    //Oversized snarls may have a pointer to hub labels, and they are always in chains, so their size is stored
+   return type == OVERSIZED_SNARL || has_compact_distances() ? (*records)->at(record_offset - 1) : record_size(type, get_node_count());
+}
+
+size_t SnarlDistanceIndex::SnarlRecord::compact_distance_vector_size(size_t node_count, size_t value_width,
+        size_t slot_width, size_t escape_count) {
+    //The widths and escape count, the packed values, and the escapes
+    size_t value_count = distance_vector_size(DISTANCED_SNARL, node_count);
+    return 2 + ((value_count * value_width) + slot_width - 1) / slot_width + (2 * escape_count);
+}
+
+bool SnarlDistanceIndex::SnarlRecord::has_compact_distances() const {
+    //Only snarls in chains have their size stored before them, and a compact distance vector
+    //is always smaller than the full one
+    return get_record_type() == DISTANCED_SNARL && 
+           (*records)->at(record_offset - 1) < record_size(DISTANCED_SNARL, get_node_count());
+}
+
+size_t SnarlDistanceIndex::SnarlRecord::get_compact_distance_value(size_t distance_vector_offset) const {
+    size_t vector_start = record_offset + SNARL_RECORD_SIZE;
+    size_t widths = (*records)->at(vector_start);
+    size_t value_width = widths & 127;
+    size_t slot_width = widths >> 7;
+    size_t escape_code = value_width == 64 ? std::numeric_limits<size_t>::max() : ((size_t)1 << value_width) - 1;
+
+    //Get the value from the slot it starts in, and the next slot if it runs over
+    size_t bit_offset = distance_vector_offset * value_width;
+    size_t slot = vector_start + 2 + (bit_offset / slot_width);
+    size_t shift = bit_offset % slot_width;
+    size_t value = (*records)->at(slot) >> shift;
+    if (shift + value_width > slot_width) {
+        value |= (*records)->at(slot + 1) << (slot_width - shift);
+    }
+    value &= escape_code;
+    if (value != escape_code) {
+        return value;
+    }
+
+    //If it didn't fit, then look for it in the escapes
+    size_t escape_count = (*records)->at(vector_start + 1);
+    size_t value_count = distance_vector_size(DISTANCED_SNARL, get_node_count());
+    size_t escapes_start = vector_start + 2 + ((value_count * value_width) + slot_width - 1) / slot_width;
+    size_t low = 0;
+    size_t high = escape_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if ((*records)->at(escapes_start + middle) < distance_vector_offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+#ifdef debug_distances
+    assert(low < escape_count);
+    assert((*records)->at(escapes_start + low) == distance_vector_offset);
+#endif
+    return (*records)->at(escapes_start + escape_count + low);
 }
 
 size_t SnarlDistanceIndex::SnarlRecord::get_distance_start_start() const {
@@ -4124,7 +4767,8 @@ size_t SnarlDistanceIndex::SnarlRecord::get_distance_end_end() const {
     return stored_value == 0 ? std::numeric_limits<size_t>::max() : stored_value - 1;
 }
 
-SnarlDistanceIndex::SnarlRecordWriter::SnarlRecordWriter (size_t node_count, bdsg::yomo::UniqueMappedPointer<bdsg::MappedIntVector>* records, record_t type){
+SnarlDistanceIndex::SnarlRecordWriter::SnarlRecordWriter (size_t node_count, bdsg::yomo::UniqueMappedPointer<bdsg::MappedIntVector>* records, record_t type,
+                                                           size_t vector_size){
     //Constructor for making a new record, including allocating memory.
     //Assumes that this is the latest record being made, so pointer will be the end of
     //the array and we need to allocate extra memory past it
@@ -4136,7 +4780,7 @@ SnarlDistanceIndex::SnarlRecordWriter::SnarlRecordWriter (size_t node_count, bds
     SnarlRecord::record_offset = (*records)->size();
     SnarlRecord::records = records;
     
-    size_t extra_size = record_size(type, node_count);
+    size_t extra_size = vector_size == 0 ? record_size(type, node_count) : SNARL_RECORD_SIZE + vector_size;
 #ifdef debug_distance_indexing
     if (type == OVERSIZED_SNARL) {
             cerr << "oversized" << endl;
@@ -4258,7 +4902,67 @@ void SnarlDistanceIndex::SnarlRecordWriter::set_distance(size_t rank1, bool righ
     //Value we actually want to save
     size_t val = distance == std::numeric_limits<size_t>::max() ? 0 : distance+1;
 
-    (*records)->at(distance_vector_offset+record_offset+SNARL_RECORD_SIZE) = val;
+    if (!has_compact_distances()) {
+        (*records)->at(distance_vector_offset+record_offset+SNARL_RECORD_SIZE) = val;
+        return;
+    }
+
+    size_t vector_start = record_offset + SNARL_RECORD_SIZE;
+    size_t widths = (*records)->at(vector_start);
+    size_t value_width = widths & 127;
+    size_t slot_width = widths >> 7;
+    size_t escape_code = value_width == 64 ? std::numeric_limits<size_t>::max() : ((size_t)1 << value_width) - 1;
+    size_t slot_mask = slot_width == 64 ? std::numeric_limits<size_t>::max() : ((size_t)1 << slot_width) - 1;
+    size_t packed_value = std::min(val, escape_code);
+
+    //Write the value into the slot it starts in, and the next slot if it runs over
+    size_t bit_offset = distance_vector_offset * value_width;
+    size_t slot = vector_start + 2 + (bit_offset / slot_width);
+    size_t shift = bit_offset % slot_width;
+    size_t old_value = (*records)->at(slot);
+    (*records)->at(slot) = ((old_value & ~(escape_code << shift)) | (packed_value << shift)) & slot_mask;
+    if (shift + value_width > slot_width) {
+        size_t written_width = slot_width - shift;
+        old_value = (*records)->at(slot + 1);
+        (*records)->at(slot + 1) = (old_value & ~(escape_code >> written_width)) | (packed_value >> written_width);
+    }
+
+    if (packed_value == escape_code) {
+        //If it didn't fit, then put it with its index in the escapes
+        size_t escape_count = (*records)->at(vector_start + 1);
+        size_t value_count = distance_vector_size(DISTANCED_SNARL, get_node_count());
+        size_t escapes_start = vector_start + 2 + ((value_count * value_width) + slot_width - 1) / slot_width;
+        size_t low = 0;
+        size_t high = escape_count;
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if ((*records)->at(escapes_start + middle) < distance_vector_offset) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == escape_count || (*records)->at(escapes_start + low) != distance_vector_offset) {
+            throw runtime_error("error: distance doesn't fit in the compact distance vector of a snarl");
+        }
+        (*records)->at(escapes_start + escape_count + low) = val;
+    }
+}
+
+void SnarlDistanceIndex::SnarlRecordWriter::set_compact_distance_encoding(size_t value_width, size_t slot_width,
+        const vector<size_t>& escaped_indexes) {
+#ifdef debug_distance_indexing
+    assert(get_record_type() == DISTANCED_SNARL);
+    assert(value_width > 0 && value_width <= slot_width && slot_width <= (*records)->width());
+#endif
+    size_t vector_start = record_offset + SNARL_RECORD_SIZE;
+    (*records)->at(vector_start) = value_width | (slot_width << 7);
+    (*records)->at(vector_start + 1) = escaped_indexes.size();
+    size_t value_count = distance_vector_size(DISTANCED_SNARL, get_node_count());
+    size_t escapes_start = vector_start + 2 + ((value_count * value_width) + slot_width - 1) / slot_width;
+    for (size_t i = 0 ; i < escaped_indexes.size() ; i++) {
+        (*records)->at(escapes_start + i) = escaped_indexes[i];
+    }
 }
 
 size_t SnarlDistanceIndex::SnarlRecord::get_distance(size_t rank1, bool right_side1, size_t rank2, bool right_side2) const {
@@ -4272,7 +4976,8 @@ size_t SnarlDistanceIndex::SnarlRecord::get_distance(size_t rank1, bool right_si
     //Offset of this particular distance in the distance vector
     size_t distance_vector_offset = get_distance_vector_offset(rank1, right_side1, rank2, right_side2);
 
-    size_t val = (*records)->at(distance_vector_offset+record_offset+SNARL_RECORD_SIZE);
+    size_t val = has_compact_distances() ? get_compact_distance_value(distance_vector_offset)
+                                         : (*records)->at(distance_vector_offset+record_offset+SNARL_RECORD_SIZE);
 
     return  val == 0 ? std::numeric_limits<size_t>::max() : val-1;
 
@@ -4292,6 +4997,22 @@ void SnarlDistanceIndex::SnarlRecordWriter::set_node_count(size_t node_count) {
     (*records)->at(record_offset + SNARL_NODE_COUNT_OFFSET) = node_count;
 }
 
+size_t SnarlDistanceIndex::SnarlRecord::get_hub_labels_offset() const {
+    if (get_record_type() != OVERSIZED_SNARL || (*records)->at(record_offset - 1) <= SNARL_RECORD_SIZE) {
+        //Only oversized snarls have hub labels, and only indexes built with them have room for them
+        return 0;
+    }
+    return (*records)->at(record_offset + SNARL_HUB_LABELS_OFFSET);
+}
+
+void SnarlDistanceIndex::SnarlRecordWriter::set_hub_labels_offset(size_t offset) {
+#ifdef debug_distance_indexing
+    assert(get_record_type() == OVERSIZED_SNARL);
+    assert((*records)->at(record_offset + SNARL_HUB_LABELS_OFFSET) == 0);
+#endif
+    (*records)->at(record_offset + SNARL_HUB_LABELS_OFFSET) = offset;
+}
+
 size_t SnarlDistanceIndex::SnarlRecord::get_child_record_pointer() const {
     return (*records)->at(record_offset+SNARL_CHILD_RECORD_OFFSET) ;
 }
@@ -5453,9 +6174,11 @@ void SnarlDistanceIndex::ChainRecordWriter::set_distance_right_end(size_t distan
 }
 
 //Add a snarl to the end of the chain and return a SnarlRecordWriter pointing to it
-SnarlDistanceIndex::SnarlRecordWriter SnarlDistanceIndex::ChainRecordWriter::add_snarl(size_t snarl_size, record_t type, size_t previous_child_offset) {
+SnarlDistanceIndex::SnarlRecordWriter SnarlDistanceIndex::ChainRecordWriter::add_snarl(size_t snarl_size, record_t type, size_t previous_child_offset,
+                                                                                         size_t vector_size) {
 
-    size_t snarl_record_size = SnarlRecord::record_size(type, snarl_size);
+    size_t snarl_record_size = vector_size == 0 ? SnarlRecord::record_size(type, snarl_size) 
+                                                : SNARL_RECORD_SIZE + vector_size;
 #ifdef debug_distance_indexing
     cerr << (*records)->size() << " Adding child snarl length to the end of the array " << endl;
     cerr << "Previous child was at " << previous_child_offset << endl;
@@ -5473,7 +6196,7 @@ SnarlDistanceIndex::SnarlRecordWriter SnarlDistanceIndex::ChainRecordWriter::add
     (*records)->resize(start_i+1);
     (*records)->at(start_i) = snarl_record_size;
     (*records)->reserve(start_i + snarl_record_size);
-    SnarlRecordWriter snarl_record(snarl_size, records, type);
+    SnarlRecordWriter snarl_record(snarl_size, records, type, vector_size);
     snarl_record.set_parent_record_offset(get_offset());
 #ifdef debug_distance_indexing
     cerr << (*records)->size() << " Adding child snarl length to the end of the array " << endl;
@@ -6048,6 +6771,40 @@ std::tuple<size_t, size_t, size_t> SnarlDistanceIndex::get_usage() {
     return snarl_tree_records.get_usage();
 }
 
+MemoryReport SnarlDistanceIndex::memory_report() const {
+    MemoryReport report("distance_index", sizeof(*this));
+
+    const MappedIntVector& records = *snarl_tree_records;
+    MemoryReport records_report("snarl_tree_records",
+                                sizeof(MappedIntVector) + records.capacity() * records.width() / 8,
+                                (records.capacity() - records.size()) * records.width() / 8);
+    records_report.entries = records.size();
+    records_report.bit_width = records.width();
+    report.add_child(records_report);
+
+    //Count the records of each kind, if the index has been built
+    size_t snarl_count = 0, chain_count = 0, node_count = 0;
+    if (records.size() != 0) {
+        traverse_decomposition([&](const net_handle_t&) {
+            snarl_count++;
+            return true;
+        }, [&](const net_handle_t&) {
+            chain_count++;
+            return true;
+        }, [&](const net_handle_t&) {
+            node_count++;
+            return true;
+        });
+    }
+    report.counters["snarls"] = snarl_count;
+    report.counters["chains"] = chain_count;
+    report.counters["nodes"] = node_count;
+
+    report.add_mapped_usage(snarl_tree_records.get_usage());
+
+    return report;
+}
+
 
 void SnarlDistanceIndex::get_snarl_tree_records(const vector<const TemporaryDistanceIndex*>& temporary_indexes, const HandleGraph* graph) {
 
@@ -6110,6 +6867,99 @@ void SnarlDistanceIndex::get_snarl_tree_records(const vector<const TemporaryDist
      */
     // maps <index into temporary_indexes, <record type, index into chain/snarl/node records>> to new offset
     unordered_map<std::pair<size_t, std::pair<temp_record_t, size_t>>, size_t> record_to_offset;
+
+    //Filling in the distance matrices of snarls dominates the time, so the records are laid out
+    //first and the matrices get filled in afterwards, in parallel
+    struct DistanceMatrixFill {
+        const TemporaryDistanceIndex::TemporarySnarlRecord* temp_snarl_record;
+        size_t record_offset;
+        //Do we need to check for distances between tips (for snarls in chains)
+        bool check_tips;
+    };
+    vector<DistanceMatrixFill> distance_matrix_fills;
+    //Oversized snarls that need hub labels, which also get made at the end
+    vector<size_t> hub_label_snarls;
+
+    /* If the distance matrices of snarls in chains are compact, pick the bit width of each one 
+     * before laying out the records, since it decides the size of the record. This means going 
+     * through all the distances, so it's done in parallel
+     */
+    struct CompactDistanceEncoding {
+        //The bits for each value, or 0 to keep the full matrix
+        size_t value_width = 0;
+        //The indexes in the distance vector of the values that don't fit, in order
+        vector<size_t> escaped_indexes;
+    };
+    //The encodings of the temporary snarl records of each temporary index
+    vector<vector<CompactDistanceEncoding>> compact_encodings (temporary_indexes.size());
+    size_t compact_slot_width = snarl_tree_records->width();
+    if (compact_snarl_distances && snarl_size_limit != 0 && !only_top_level_chain_distances) {
+        vector<pair<size_t, size_t>> compact_snarls;
+        for (size_t temp_index_i = 0 ; temp_index_i < temporary_indexes.size() ; temp_index_i++) {
+            const TemporaryDistanceIndex* temp_index = temporary_indexes[temp_index_i];
+            compact_encodings[temp_index_i].resize(temp_index->temp_snarl_records.size());
+            for (size_t snarl_i = 0 ; snarl_i < temp_index->temp_snarl_records.size() ; snarl_i++) {
+                const TemporaryDistanceIndex::TemporarySnarlRecord& temp_snarl_record = temp_index->temp_snarl_records[snarl_i];
+                if (!temp_snarl_record.is_trivial && !temp_snarl_record.is_simple && 
+                    temp_snarl_record.parent.first != TEMP_ROOT && temp_snarl_record.node_count < snarl_size_limit) {
+                    compact_snarls.emplace_back(temp_index_i, snarl_i);
+                }
+            }
+        }
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0 ; i < compact_snarls.size() ; i++) {
+            const TemporaryDistanceIndex::TemporarySnarlRecord& temp_snarl_record = 
+                temporary_indexes[compact_snarls[i].first]->temp_snarl_records[compact_snarls[i].second];
+            CompactDistanceEncoding& encoding = compact_encodings[compact_snarls[i].first][compact_snarls[i].second];
+            size_t value_count = SnarlRecord::distance_vector_size(DISTANCED_SNARL, temp_snarl_record.node_count);
+
+            //Count the stored values by bit width, and how many of each width are all ones
+            vector<size_t> width_counts (65, 0);
+            vector<size_t> all_ones_counts (65, 0);
+            for (const auto& it : temp_snarl_record.distances) {
+                size_t value = it.second == std::numeric_limits<size_t>::max() ? 0 : it.second + 1;
+                size_t width = bit_width(value);
+                width_counts[width]++;
+                if (value != 0 && (value & (value + 1)) == 0) {
+                    all_ones_counts[width]++;
+                }
+            }
+            //Use the width that takes the fewest bits, where each value that doesn't fit also
+            //takes a slot for its index and one for its value
+            size_t best_bits = std::numeric_limits<size_t>::max();
+            size_t escape_count = 0;
+            for (size_t width = 64 ; width > compact_slot_width ; width--) {
+                escape_count += width_counts[width];
+            }
+            for (size_t width = compact_slot_width ; width > 0 ; width--) {
+                size_t bits = (value_count * width) + ((escape_count + all_ones_counts[width]) * 2 * compact_slot_width);
+                if (bits < best_bits) {
+                    best_bits = bits;
+                    encoding.value_width = width;
+                }
+                escape_count += width_counts[width];
+            }
+            size_t escape_code = encoding.value_width == 64 ? std::numeric_limits<size_t>::max() 
+                                                            : ((size_t)1 << encoding.value_width) - 1;
+            for (const auto& it : temp_snarl_record.distances) {
+                size_t value = it.second == std::numeric_limits<size_t>::max() ? 0 : it.second + 1;
+                if (value >= escape_code) {
+                    encoding.escaped_indexes.push_back(SnarlRecord::get_distance_vector_offset(
+                        it.first.first.first, it.first.first.second, it.first.second.first, it.first.second.second,
+                        temp_snarl_record.node_count, DISTANCED_SNARL));
+                }
+            }
+            std::sort(encoding.escaped_indexes.begin(), encoding.escaped_indexes.end());
+            encoding.escaped_indexes.erase(std::unique(encoding.escaped_indexes.begin(), encoding.escaped_indexes.end()),
+                                           encoding.escaped_indexes.end());
+            if (SnarlRecord::compact_distance_vector_size(temp_snarl_record.node_count, encoding.value_width,
+                    compact_slot_width, encoding.escaped_indexes.size()) >= value_count) {
+                //If it isn't any smaller, then keep the full matrix
+                encoding.value_width = 0;
+                encoding.escaped_indexes.clear();
+            }
+        }
+    }
     //Set the root index
     for (size_t temp_index_i = 0 ; temp_index_i < temporary_indexes.size() ; temp_index_i++) {
         //Any root will point to the same root
@@ -6274,8 +7124,23 @@ void SnarlDistanceIndex::get_snarl_tree_records(const vector<const TemporaryDist
 
                                 record_t record_type = ignore_distances ? SNARL :
                                     (temp_snarl_record.node_count < snarl_size_limit ? DISTANCED_SNARL : OVERSIZED_SNARL);
+                                CompactDistanceEncoding* compact_encoding = record_type == DISTANCED_SNARL && !compact_encodings[temp_index_i].empty()
+                                    && compact_encodings[temp_index_i][child_record_index.second].value_width != 0
+                                    ? &compact_encodings[temp_index_i][child_record_index.second] : nullptr;
+                                //Only make room for a pointer to hub labels if we are making them
+                                bool has_hub_labels = record_type == OVERSIZED_SNARL && oversized_snarl_hub_labels && graph != nullptr;
                                 SnarlRecordWriter snarl_record_constructor =
-                                    chain_record_constructor.add_snarl(temp_snarl_record.node_count, record_type, last_child_offset.first);
+                                    chain_record_constructor.add_snarl(temp_snarl_record.node_count, record_type, last_child_offset.first,
+                                        compact_encoding != nullptr ? 
+                                            SnarlRecord::compact_distance_vector_size(temp_snarl_record.node_count, compact_encoding->value_width,
+                                                compact_slot_width, compact_encoding->escaped_indexes.size())
+                                        : (has_hub_labels ? 1 : 0));
+                                if (compact_encoding != nullptr) {
+                                    snarl_record_constructor.set_compact_distance_encoding(compact_encoding->value_width, compact_slot_width,
+                                                                                           compact_encoding->escaped_indexes);
+                                    compact_encoding->escaped_indexes.clear();
+                                    compact_encoding->escaped_indexes.shrink_to_fit();
+                                }
 
                                 //Record how to find the new snarl record
                                 record_to_offset.emplace(make_pair(temp_index_i, child_record_index), snarl_record_constructor.record_offset);
@@ -6288,28 +7153,12 @@ void SnarlDistanceIndex::get_snarl_tree_records(const vector<const TemporaryDist
                                 snarl_record_constructor.set_distance_start_start(temp_snarl_record.distance_start_start);
                                 snarl_record_constructor.set_distance_end_end(temp_snarl_record.distance_end_end);
 
-                                //Add distances and record connectivity
-                                for (const auto& it : temp_snarl_record.distances) {
-                                    pair<size_t, size_t> node_rank1 = it.first.first;
-                                    pair<size_t, size_t> node_rank2 = it.first.second;
-                                    const size_t distance = it.second;
-
-                                    if (!ignore_distances) {
-                                        //If we are keeping track of distances
-                                        //If the distance exceeded the limit, then it wasn't found in the first place
-                                        snarl_record_constructor.set_distance(node_rank1.first, node_rank1.second,
-                                            node_rank2.first, node_rank2.second, distance);
-
-                                        if (temp_snarl_record.tippy_child_ranks.count(node_rank1.first)
-                                            && temp_snarl_record.tippy_child_ranks.count(node_rank2.first)) {
-                                            snarl_record_constructor.set_tip_tip_connected();
-                                        }
-#ifdef debug_distance_indexing
-                                        assert(distance <= temp_snarl_record.max_distance);
-                                        assert(snarl_record_constructor.get_distance(node_rank1.first, node_rank1.second,
-                                               node_rank2.first, node_rank2.second) ==  distance);
-#endif
-                                    }
+                                //Add distances and record connectivity once everything is laid out
+                                if (!ignore_distances) {
+                                    distance_matrix_fills.push_back({&temp_snarl_record, snarl_record_constructor.record_offset, true});
+                                }
+                                if (has_hub_labels) {
+                                    hub_label_snarls.push_back(snarl_record_constructor.record_offset);
                                 }
                                 //Now set the connectivity of this snarl
                                 if (temp_snarl_record.distance_start_start != std::numeric_limits<size_t>::max()) {
@@ -6471,29 +7320,9 @@ void SnarlDistanceIndex::get_snarl_tree_records(const vector<const TemporaryDist
                 //Fill in snarl info
                 snarl_record_constructor.set_parent_record_offset(0);
 
-                //Add distances and record connectivity
-
-                if (!ignore_distances ) {
-
-
-                    for (const auto& it : temp_snarl_record.distances) {
-                        const pair<size_t, bool> node_rank1 = it.first.first;
-                        const pair<size_t, bool> node_rank2 = it.first.second;
-                        const size_t distance = it.second;
-                        //If we are keeping track of distances and either this is a small enough snarl,
-                        //or the snarl is too big but we are looking at the boundaries
-#ifdef debug_distance_indexing
-                        assert(distance <= temp_snarl_record.max_distance);
-#endif
-                        if ((temp_snarl_record.node_count < snarl_size_limit)) {
-                            snarl_record_constructor.set_distance(node_rank1.first, node_rank1.second,
-                             node_rank2.first, node_rank2.second, distance);
-#ifdef debug_distance_indexing
-                            assert(snarl_record_constructor.get_distance(node_rank1.first, node_rank1.second,
-                                    node_rank2.first, node_rank2.second) == distance);
-#endif
-                        }
-                    }
+                //Add distances once everything is laid out, if this is a small enough snarl
+                if (!ignore_distances && temp_snarl_record.node_count < snarl_size_limit) {
+                    distance_matrix_fills.push_back({&temp_snarl_record, snarl_record_constructor.record_offset, false});
                 }
 
 #ifdef debug_distance_indexing
@@ -6645,6 +7474,99 @@ void SnarlDistanceIndex::get_snarl_tree_records(const vector<const TemporaryDist
             }
         }
     }
+#ifdef debug_distance_indexing
+    cerr << "Filling in distances of " << distance_matrix_fills.size() << " snarls" << endl;
+#endif
+
+    /* Now that nothing else will be added, fill in the distance matrices of the snarls.
+     * Each matrix is its own range of the vector and the ranges are separated by at least
+     * a snarl record header, so no two threads write to the same word of the packed vector.
+     * Anything else about the snarl records gets written after the threads are done.
+     */
+    vector<char> tip_tip_connected(distance_matrix_fills.size(), false);
+    //Exceptions can't leave the parallel section, so we save the first one
+    std::exception_ptr fill_error;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t fill_i = 0 ; fill_i < distance_matrix_fills.size() ; fill_i++) {
+        const DistanceMatrixFill& fill = distance_matrix_fills[fill_i];
+        const TemporaryDistanceIndex::TemporarySnarlRecord& temp_snarl_record = *fill.temp_snarl_record;
+        try {
+            SnarlRecordWriter snarl_record_constructor (&snarl_tree_records, fill.record_offset);
+            for (const auto& it : temp_snarl_record.distances) {
+                const pair<size_t, bool> node_rank1 = it.first.first;
+                const pair<size_t, bool> node_rank2 = it.first.second;
+                const size_t distance = it.second;
+
+                snarl_record_constructor.set_distance(node_rank1.first, node_rank1.second,
+                    node_rank2.first, node_rank2.second, distance);
+
+                if (fill.check_tips && temp_snarl_record.tippy_child_ranks.count(node_rank1.first)
+                    && temp_snarl_record.tippy_child_ranks.count(node_rank2.first)) {
+                    tip_tip_connected[fill_i] = true;
+                }
+#ifdef debug_distance_indexing
+                assert(distance <= temp_snarl_record.max_distance);
+                assert(snarl_record_constructor.get_distance(node_rank1.first, node_rank1.second,
+                       node_rank2.first, node_rank2.second) ==  distance);
+#endif
+            }
+        } catch (...) {
+#pragma omp critical
+            {
+                if (!fill_error) {
+                    fill_error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (fill_error) {
+        std::rethrow_exception(fill_error);
+    }
+    for (size_t fill_i = 0 ; fill_i < distance_matrix_fills.size() ; fill_i++) {
+        if (tip_tip_connected[fill_i]) {
+            SnarlRecordWriter (&snarl_tree_records, distance_matrix_fills[fill_i].record_offset).set_tip_tip_connected();
+        }
+    }
+
+    /* Make the hub labels of the oversized snarls in parallel, from the finished records, and then
+     * add them to the end of the index
+     */
+    vector<vector<size_t>> hub_labels(hub_label_snarls.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t snarl_i = 0 ; snarl_i < hub_label_snarls.size() ; snarl_i++) {
+        try {
+            hub_labels[snarl_i] = make_hub_labels(get_net_handle_from_values(hub_label_snarls[snarl_i], START_END, SNARL_HANDLE), graph);
+        } catch (...) {
+#pragma omp critical
+            {
+                if (!fill_error) {
+                    fill_error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (fill_error) {
+        std::rethrow_exception(fill_error);
+    }
+    for (size_t snarl_i = 0 ; snarl_i < hub_label_snarls.size() ; snarl_i++) {
+        size_t hub_labels_offset = snarl_tree_records->size();
+        size_t max_value = hub_labels_offset;
+        for (size_t value : hub_labels[snarl_i]) {
+            max_value = std::max(max_value, value);
+        }
+        if (bit_width(max_value) > snarl_tree_records->width()) {
+            //Widen the values already in the index too, instead of just reading their bits differently
+            snarl_tree_records->repack(bit_width(max_value), snarl_tree_records->size());
+        }
+        snarl_tree_records->resize(hub_labels_offset + hub_labels[snarl_i].size());
+        for (size_t i = 0 ; i < hub_labels[snarl_i].size() ; i++) {
+            snarl_tree_records->at(hub_labels_offset + i) = hub_labels[snarl_i][i];
+        }
+        SnarlRecordWriter (&snarl_tree_records, hub_label_snarls[snarl_i]).set_hub_labels_offset(hub_labels_offset);
+        hub_labels[snarl_i].clear();
+        hub_labels[snarl_i].shrink_to_fit();
+    }
+
 #ifdef debug_distance_indexing
     //Repack the vector to use fewer bits
     //This doesn't actually get used anymore but keep it around in case I change things and can't
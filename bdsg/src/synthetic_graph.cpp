@@ -0,0 +1,211 @@
+/**
+ * \file synthetic_graph.cpp
+ *
+ * Defines the seeded synthetic pangenome graph generator.
+ */
+
+#include "bdsg/internal/synthetic_graph.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bdsg {
+
+using namespace std;
+using namespace handlegraph;
+
+namespace {
+
+/// How many nested bubbles we will put in one allele, at most, so that a
+/// bubble density of 1 still terminates.
+const size_t MAX_NESTED_BUBBLES = 4;
+
+/// A chain of nodes inside a site, alternating with nested bubbles.
+struct SiteChain {
+    vector<handle_t> nodes;
+    /// Bubble i sits between nodes[i] and nodes[i + 1]. Indexes into the
+    /// site's bubbles.
+    vector<size_t> bubbles;
+};
+
+/// A bubble inside a site.
+struct SiteBubble {
+    /// Indexes into the site's chains.
+    vector<size_t> alleles;
+    /// True if the first allele can also be traversed in reverse.
+    bool inverted = false;
+};
+
+/// The nested structure hanging off one backbone node. We keep it only long
+/// enough to thread the paths through it.
+struct Site {
+    vector<SiteChain> chains;
+    vector<SiteBubble> bubbles;
+};
+
+class SyntheticGraphGenerator {
+public:
+    SyntheticGraphGenerator(MutablePathMutableHandleGraph* graph, const SyntheticGraphParams& params) :
+        graph(graph), params(params), generator(params.seed) {
+        // Nothing to do!
+    }
+
+    void generate() {
+        if (params.include_reference) {
+            paths.push_back(graph->create_path_handle("ref"));
+        }
+        for (size_t i = 0; i < params.haplotype_count; i++) {
+            paths.push_back(graph->create_path_handle("haplotype" + to_string(i)));
+        }
+
+        vector<handle_t> frontier;
+        while (true) {
+            handle_t backbone = make_node(frontier);
+            for (auto& path : paths) {
+                graph->append_step(path, backbone);
+            }
+            if (nodes_made >= params.node_count) {
+                // Always end on a backbone node.
+                break;
+            }
+            if (params.nesting_depth > 0 && chance(params.bubble_density)) {
+                Site site;
+                size_t bubble = make_bubble(site, 1, frontier);
+                for (size_t i = 0; i < paths.size(); i++) {
+                    walk_bubble(site, bubble, false, paths[i], params.include_reference && i == 0);
+                }
+            }
+        }
+    }
+
+protected:
+
+    MutablePathMutableHandleGraph* graph;
+    const SyntheticGraphParams& params;
+    /// We draw integers straight from the engine instead of using the standard
+    /// distributions, which are allowed to differ between standard libraries.
+    mt19937_64 generator;
+    vector<path_handle_t> paths;
+    size_t nodes_made = 0;
+
+    /// Get a random integer in [0, bound).
+    size_t uniform(size_t bound) {
+        return bound == 0 ? 0 : generator() % bound;
+    }
+
+    /// Return true with the given probability.
+    bool chance(double probability) {
+        // Use the top 53 bits to make a double in [0, 1).
+        return (generator() >> 11) / 9007199254740992.0 < probability;
+    }
+
+    /// Make a node with a random sequence, attached to all the handles in the
+    /// frontier, and make it the new frontier.
+    handle_t make_node(vector<handle_t>& frontier) {
+        static const char* BASES = "ACGT";
+        size_t min_length = max<size_t>(params.min_node_length, 1);
+        size_t length = min_length + uniform(max(params.max_node_length, min_length) - min_length + 1);
+        string sequence(length, 'N');
+        for (auto& base : sequence) {
+            base = BASES[uniform(4)];
+        }
+
+        handle_t node = graph->create_handle(sequence);
+        nodes_made++;
+        for (auto& prev : frontier) {
+            graph->create_edge(prev, node);
+        }
+        frontier.clear();
+        frontier.push_back(node);
+        return node;
+    }
+
+    /// Make a chain attached to the frontier and return its index in the site.
+    /// Leaves the frontier at the end of the chain.
+    size_t make_chain(Site& site, size_t depth, vector<handle_t>& frontier) {
+        size_t chain = site.chains.size();
+        site.chains.emplace_back();
+        handle_t node = make_node(frontier);
+        site.chains[chain].nodes.push_back(node);
+        while (depth < params.nesting_depth && site.chains[chain].bubbles.size() < MAX_NESTED_BUBBLES &&
+               chance(params.bubble_density)) {
+            size_t bubble = make_bubble(site, depth + 1, frontier);
+            site.chains[chain].bubbles.push_back(bubble);
+            node = make_node(frontier);
+            site.chains[chain].nodes.push_back(node);
+        }
+        return chain;
+    }
+
+    /// Make a bubble at the given nesting depth attached to the frontier and
+    /// return its index in the site. Leaves the frontier at the ends of all the
+    /// alleles.
+    size_t make_bubble(Site& site, size_t depth, vector<handle_t>& frontier) {
+        size_t bubble = site.bubbles.size();
+        site.bubbles.emplace_back();
+
+        vector<handle_t> entry = frontier;
+        vector<handle_t> exits;
+        for (size_t i = 0; i < max<size_t>(params.allele_count, 1); i++) {
+            vector<handle_t> allele_frontier = entry;
+            size_t allele = make_chain(site, depth, allele_frontier);
+            site.bubbles[bubble].alleles.push_back(allele);
+            exits.insert(exits.end(), allele_frontier.begin(), allele_frontier.end());
+        }
+
+        if (chance(params.inversion_rate)) {
+            // Also let the first allele be read backward.
+            site.bubbles[bubble].inverted = true;
+            const SiteChain& first = site.chains[site.bubbles[bubble].alleles.front()];
+            for (auto& prev : entry) {
+                graph->create_edge(prev, graph->flip(first.nodes.back()));
+            }
+            exits.push_back(graph->flip(first.nodes.front()));
+        }
+
+        frontier = move(exits);
+        return bubble;
+    }
+
+    /// Add steps for a traversal of the given chain to the path.
+    void walk_chain(const Site& site, size_t chain, bool reverse, const path_handle_t& path, bool reference) {
+        const SiteChain& here = site.chains[chain];
+        if (!reverse) {
+            for (size_t i = 0; i < here.nodes.size(); i++) {
+                graph->append_step(path, here.nodes[i]);
+                if (i < here.bubbles.size()) {
+                    walk_bubble(site, here.bubbles[i], false, path, reference);
+                }
+            }
+        } else {
+            for (size_t i = here.nodes.size(); i > 0; i--) {
+                graph->append_step(path, graph->flip(here.nodes[i - 1]));
+                if (i > 1) {
+                    walk_bubble(site, here.bubbles[i - 2], true, path, reference);
+                }
+            }
+        }
+    }
+
+    /// Add steps for a traversal of some allele of the given bubble to the
+    /// path. The reference always takes the first allele forward.
+    void walk_bubble(const Site& site, size_t bubble, bool reverse, const path_handle_t& path, bool reference) {
+        const SiteBubble& here = site.bubbles[bubble];
+        size_t option = reference ? 0 : uniform(here.alleles.size() + (here.inverted ? 1 : 0));
+        if (option < here.alleles.size()) {
+            walk_chain(site, here.alleles[option], reverse, path, reference);
+        } else {
+            // Take the inversion of the first allele.
+            walk_chain(site, here.alleles.front(), !reverse, path, reference);
+        }
+    }
+};
+
+}
+
+void generate_synthetic_graph(MutablePathMutableHandleGraph* graph, const SyntheticGraphParams& params) {
+    SyntheticGraphGenerator(graph, params).generate();
+}
+
+}
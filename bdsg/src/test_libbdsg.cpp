@@ -13,19 +13,25 @@
 #include <sstream>
 #include <thread>
 #include <deque>
+#include <queue>
 #include <functional>
+#include <atomic>
 #include <stdexcept>
 
 #include <omp.h> // BINDER_IGNORE because Binder can't find this
 
 #include <sys/stat.h>
+#include <arpa/inet.h>
 #include <handlegraph/algorithms/are_equivalent.hpp>
+#include <handlegraph/algorithms/dijkstra.hpp>
 
 #include "bdsg/packed_graph.hpp"
 #include "bdsg/hash_graph.hpp"
+#include "bdsg/frozen_packed_graph.hpp"
 #include "bdsg/snarl_distance_index.hpp"
 #include "bdsg/internal/packed_structs.hpp"
 #include "bdsg/internal/mapped_structs.hpp"
+#include "bdsg/internal/synthetic_graph.hpp"
 #include "bdsg/overlays/path_position_overlays.hpp"
 #include "bdsg/overlays/packed_path_position_overlay.hpp"
 #include "bdsg/overlays/packed_reference_path_overlay.hpp"
@@ -543,6 +549,28 @@ void test_mapped_structs() {
     assert(yomo::Manager::count_chains() == 0);
     assert(yomo::Manager::count_links() == 0);
     
+    for (int64_t round = 0; round < 3; round++) {
+        // Make sure pointers across links can be followed from several
+        // threads, including after other chains have come and gone at the
+        // same addresses.
+        bdsg::yomo::UniqueMappedPointer<MappedVector<int64_t>> numbers_holder;
+        numbers_holder.construct("GATTACA");
+        for (size_t size = 10; size <= 100000; size *= 10) {
+            // Grow so the data ends up in a later link than the vector
+            numbers_holder->resize(size);
+        }
+        assert(yomo::Manager::count_links() > 1);
+        fill_to(*numbers_holder, 100000, round);
+        
+#pragma omp parallel for num_threads(4)
+        for (size_t i = 0; i < 8; i++) {
+            verify_to(*numbers_holder, 100000, round);
+        }
+    }
+    
+    assert(yomo::Manager::count_chains() == 0);
+    assert(yomo::Manager::count_links() == 0);
+    
     cerr << "Mapped Structs tests successful!" << endl;
 }
         
@@ -640,6 +668,107 @@ void test_int_vector() {
     unlink("test.dat");
     cerr << "Int Vector tests successful!" << endl;
 }
+
+void test_int_vector_ranges() {
+    
+    random_device rd;
+    default_random_engine prng(rd());
+    
+    for (size_t width = 1; width <= 64; width++) {
+        uint64_t mask = width == 64 ? numeric_limits<uint64_t>::max() : ~(numeric_limits<uint64_t>::max() << width);
+        size_t size = 500 + prng() % 500;
+        
+        vector<uint64_t> truth(size);
+        for (auto& value : truth) {
+            value = prng() & mask;
+        }
+        
+        CompatIntVector<> compat;
+        compat.width(width);
+        compat.resize(size);
+        sdsl::int_vector<> sdsl_iv;
+        sdsl_iv.width(width);
+        sdsl_iv.resize(size);
+        
+        // fill in with a few overlapping ranges
+        for (size_t begin = 0; begin < size; begin += 97) {
+            size_t count = min<size_t>(size - begin, 150);
+            compat.set_range(begin, count, truth.data() + begin);
+            bdsg::set_range(sdsl_iv, begin, count, truth.data() + begin);
+        }
+        for (size_t i = 0; i < size; i++) {
+            assert(compat[i] == truth[i]);
+            assert(sdsl_iv[i] == truth[i]);
+        }
+        
+        // read random ranges back out
+        for (size_t trial = 0; trial < 20; trial++) {
+            size_t begin = prng() % size;
+            size_t count = prng() % (size - begin + 1);
+            vector<uint64_t> compat_range(count), sdsl_range(count);
+            compat.get_range(begin, count, compat_range.data());
+            bdsg::get_range(sdsl_iv, begin, count, sdsl_range.data());
+            for (size_t i = 0; i < count; i++) {
+                assert(compat_range[i] == truth[begin + i]);
+                assert(sdsl_range[i] == truth[begin + i]);
+            }
+        }
+        
+        // copying across types should keep the contents
+        CompatIntVector<> copied(sdsl_iv);
+        assert(copied.width() == width);
+        assert(copied.size() == size);
+        for (size_t i = 0; i < size; i++) {
+            assert(copied[i] == truth[i]);
+        }
+        
+        // repacking wider and back should keep the contents
+        if (width < 64) {
+            compat.repack(width + 1 + prng() % (64 - width), size);
+            bdsg::repack(sdsl_iv, compat.width(), size);
+            for (size_t i = 0; i < size; i++) {
+                assert(compat[i] == truth[i]);
+                assert(sdsl_iv[i] == truth[i]);
+            }
+            compat.repack(width, size);
+            bdsg::repack(sdsl_iv, width, size);
+            for (size_t i = 0; i < size; i++) {
+                assert(compat[i] == truth[i]);
+                assert(sdsl_iv[i] == truth[i]);
+            }
+        }
+        
+        // values that don't fit should be rejected
+        if (width < 64) {
+            uint64_t too_big = mask + 1;
+            bool caught = false;
+            try {
+                compat.set_range(0, 1, &too_big);
+            }
+            catch (std::invalid_argument& e) {
+                caught = true;
+            }
+            assert(caught);
+            
+            if (width > 1) {
+                caught = false;
+                try {
+                    compat.repack(1, size);
+                }
+                catch (std::invalid_argument& e) {
+                    caught = true;
+                }
+                // a random vector this big will have something that needs more than 1 bit
+                assert(caught);
+                for (size_t i = 0; i < size; i++) {
+                    assert(compat[i] == truth[i]);
+                }
+            }
+        }
+    }
+    
+    cerr << "Int vector range tests successful!" << endl;
+}
         
 
 void test_serializable_handle_graphs() {
@@ -2775,11 +2904,11 @@ void test_mutable_path_handle_graphs() {
 
 template<typename PackedVectorImpl>
 void test_packed_vector() {
-    enum vec_op_t {SET = 0, GET = 1, APPEND = 2, POP = 3, SERIALIZE = 4};
+    enum vec_op_t {SET = 0, GET = 1, APPEND = 2, POP = 3, SERIALIZE = 4, GET_RANGE = 5, SET_RANGE = 6};
     
     random_device rd;
     default_random_engine prng(rd());
-    uniform_int_distribution<int> op_distr(0, 4);
+    uniform_int_distribution<int> op_distr(0, 6);
     
     int num_runs = 1000;
     int num_ops = 200;
@@ -2856,6 +2985,34 @@ void test_packed_vector() {
                     break;
                 }
                     
+                case GET_RANGE:
+                    if (!std_vec.empty()) {
+                        size_t begin = prng() % dyn_vec.size();
+                        size_t count = prng() % (dyn_vec.size() - begin + 1);
+                        vector<uint64_t> range(count);
+                        dyn_vec.get_range(begin, count, range.data());
+                        for (size_t k = 0; k < count; k++) {
+                            assert(range[k] == std_vec[begin + k]);
+                        }
+                    }
+                    
+                    break;
+                    
+                case SET_RANGE:
+                    if (!std_vec.empty()) {
+                        size_t begin = prng() % dyn_vec.size();
+                        size_t count = prng() % (dyn_vec.size() - begin + 1);
+                        vector<uint64_t> range(count);
+                        for (size_t k = 0; k < count; k++) {
+                            range[k] = next_val;
+                            std_vec[begin + k] = next_val;
+                            next_val++;
+                        }
+                        dyn_vec.set_range(begin, count, range.data());
+                    }
+                    
+                    break;
+                    
                 default:
                     break;
             }
@@ -2961,6 +3118,174 @@ void test_paged_vector() {
     cerr << "PagedVector (" << typeid(PagedVectorImpl).name() << ") tests successful!" << endl;
 }
 
+template<typename PagedVectorImpl>
+void test_paged_vector_cursor() {
+    std::random_device rd;
+    std::default_random_engine prng(rd());
+    
+    for (size_t i = 0; i < 100; i++) {
+        
+        // values that vary around a trend, with some 0s mixed in
+        size_t size = prng() % 300;
+        std::vector<uint64_t> std_vec;
+        PagedVectorImpl dyn_vec;
+        for (size_t j = 0; j < size; j++) {
+            uint64_t val = prng() % 5 == 0 ? 0 : 1000 + 10 * j - (prng() % 50);
+            std_vec.push_back(val);
+            dyn_vec.append(val);
+        }
+        
+        // scan forward
+        auto cursor = dyn_vec.cursor_at();
+        for (size_t j = 0; j < size; j++, ++cursor) {
+            assert(cursor.index() == j);
+            assert(*cursor == std_vec[j]);
+        }
+        
+        // scan backward
+        if (size != 0) {
+            cursor.seek(size - 1);
+            for (size_t j = size; j > 0; j--, --cursor) {
+                assert(cursor.index() == j - 1);
+                assert(*cursor == std_vec[j - 1]);
+            }
+        }
+        
+        // jump around
+        for (size_t j = 0; j < 100 && size != 0; j++) {
+            size_t idx = prng() % size;
+            assert(cursor.get(idx) == std_vec[idx]);
+            assert(cursor.index() == idx);
+            assert(*dyn_vec.cursor_at(idx) == std_vec[idx]);
+        }
+        
+        // a new cursor sees modifications
+        for (size_t j = 0; j < 10 && size != 0; j++) {
+            size_t idx = prng() % size;
+            std_vec[idx] = prng() % 100000;
+            dyn_vec.set(idx, std_vec[idx]);
+        }
+        cursor = dyn_vec.cursor_at();
+        for (size_t j = 0; j < size; j++) {
+            assert(cursor.get(j) == std_vec[j]);
+        }
+    }
+    cerr << "PagedVector cursor (" << typeid(PagedVectorImpl).name() << ") tests successful!" << endl;
+}
+
+template<typename Backend>
+void test_tunable_paged_vector() {
+    std::random_device rd;
+    std::default_random_engine prng(rd());
+    
+    vector<size_t> page_widths {
+        TunablePagedVector<Backend>::NARROW_PAGE_WIDTH,
+        TunablePagedVector<Backend>::MEDIUM_PAGE_WIDTH,
+        TunablePagedVector<Backend>::WIDE_PAGE_WIDTH
+    };
+    
+    for (size_t i = 0; i < 20; i++) {
+        
+        // values with runs of very different spread
+        std::vector<uint64_t> std_vec;
+        TunablePagedVector<Backend> dyn_vec(page_widths[i % page_widths.size()]);
+        size_t size = prng() % 5000;
+        uint64_t spread = 1;
+        for (size_t j = 0; j < size; j++) {
+            if (j % 700 == 0) {
+                spread = 1 + prng() % 100000;
+            }
+            uint64_t val = prng() % 10 == 0 ? 0 : 1000000 + j + prng() % spread;
+            std_vec.push_back(val);
+            dyn_vec.append(val);
+        }
+        for (size_t j = 0; j < 20 && size != 0; j++) {
+            size_t idx = prng() % size;
+            std_vec[idx] = prng() % 2000000;
+            dyn_vec.set(idx, std_vec[idx]);
+        }
+        
+        auto check = [&](const TunablePagedVector<Backend>& vec) {
+            assert(vec.size() == std_vec.size());
+            assert(vec.empty() == std_vec.empty());
+            auto cursor = vec.cursor_at();
+            for (size_t j = 0; j < std_vec.size(); j++, ++cursor) {
+                assert(vec.get(j) == std_vec[j]);
+                assert(*cursor == std_vec[j]);
+            }
+        };
+        check(dyn_vec);
+        
+        // re-encode with every width
+        for (size_t page_width : page_widths) {
+            dyn_vec.set_page_width(page_width);
+            assert(dyn_vec.page_width() == page_width);
+            check(dyn_vec);
+        }
+        
+        // tuning should choose the width with the smallest estimate
+        size_t tuned_width = dyn_vec.tune_page_width();
+        assert(dyn_vec.page_width() == tuned_width);
+        for (size_t page_width : page_widths) {
+            assert(dyn_vec.estimate_memory_usage(tuned_width) <= dyn_vec.estimate_memory_usage(page_width));
+        }
+        check(dyn_vec);
+        
+        // the width should survive serialization
+        stringstream strm;
+        dyn_vec.serialize(strm);
+        strm.seekg(0);
+        TunablePagedVector<Backend> copy_vec(strm);
+        assert(copy_vec.page_width() == tuned_width);
+        check(copy_vec);
+        
+        // and we should still be able to edit
+        dyn_vec.append(17);
+        std_vec.push_back(17);
+        if (size != 0) {
+            dyn_vec.pop();
+            std_vec.pop_back();
+            dyn_vec.pop();
+            std_vec.pop_back();
+        }
+        check(dyn_vec);
+    }
+    
+    {
+        // a plain PagedVector of a compiled width can be loaded
+        PagedVector<TunablePagedVector<Backend>::NARROW_PAGE_WIDTH, Backend> paged;
+        for (size_t j = 0; j < 300; j++) {
+            paged.append(j * j);
+        }
+        stringstream strm;
+        paged.serialize(strm);
+        strm.seekg(0);
+        TunablePagedVector<Backend> loaded(strm);
+        assert(loaded.page_width() == TunablePagedVector<Backend>::NARROW_PAGE_WIDTH);
+        for (size_t j = 0; j < 300; j++) {
+            assert(loaded.get(j) == j * j);
+        }
+    }
+    
+    {
+        // but not one of another width
+        PagedVector<5, Backend> paged;
+        paged.append(1);
+        stringstream strm;
+        paged.serialize(strm);
+        strm.seekg(0);
+        bool caught = false;
+        try {
+            TunablePagedVector<Backend> loaded(strm);
+        } catch (std::runtime_error& e) {
+            caught = true;
+        }
+        assert(caught);
+    }
+    
+    cerr << "TunablePagedVector (" << typeid(Backend).name() << ") tests successful!" << endl;
+}
+
 void test_packed_deque() {
     enum deque_op_t {SET = 0, GET = 1, APPEND_LEFT = 2, POP_LEFT = 3, APPEND_RIGHT = 4, POP_RIGHT = 5, SERIALIZE = 6};
     std::random_device rd;
@@ -3068,6 +3393,62 @@ void test_packed_deque() {
     cerr << "PackedDeque tests successful!" << endl;
 }
 
+void test_elias_fano_vector() {
+    std::random_device rd;
+    std::default_random_engine prng(rd());
+    
+    {
+        EliasFanoVector<> empty(vector<uint64_t>{});
+        assert(empty.size() == 0);
+        assert(empty.empty());
+    }
+    
+    for (size_t i = 0; i < 100; i++) {
+        // values with a mix of small and large gaps, and repeats
+        vector<uint64_t> values;
+        size_t size = 1 + prng() % 3000;
+        uint64_t max_gap = uint64_t(1) << (prng() % 40);
+        uint64_t value = prng() % 10;
+        for (size_t j = 0; j < size; j++) {
+            if (prng() % 3 != 0) {
+                value += prng() % (max_gap + 1);
+            }
+            values.push_back(value);
+        }
+        
+        EliasFanoVector<> ef(values);
+        assert(ef.size() == values.size());
+        assert(!ef.empty());
+        for (size_t j = 0; j < values.size(); j++) {
+            assert(ef.get(j) == values[j]);
+        }
+        
+        vector<uint64_t> range(values.size());
+        for (size_t j = 0; j < 20; j++) {
+            size_t begin = prng() % values.size();
+            size_t count = prng() % (values.size() - begin + 1);
+            ef.get_range(begin, count, range.data());
+            for (size_t k = 0; k < count; k++) {
+                assert(range[k] == values[begin + k]);
+            }
+        }
+        
+        stringstream strm;
+        ef.serialize(strm);
+        strm.seekg(0);
+        EliasFanoVector<> loaded(strm);
+        assert(loaded.size() == values.size());
+        for (size_t j = 0; j < values.size(); j++) {
+            assert(loaded.get(j) == values[j]);
+        }
+        
+        ef.clear();
+        assert(ef.empty());
+    }
+    
+    cerr << "EliasFanoVector tests successful!" << endl;
+}
+
 void test_packed_set() {
     enum set_op_t {INSERT = 0, REMOVE = 1, FIND = 2};
     
@@ -3163,6 +3544,52 @@ void test_packed_set() {
             assert(std_set.size() == packed_set.size());
         }
     }
+    
+    // bulk insertion, including duplicates and values straddling the anchor
+    for (size_t i = 0; i < 200; i++) {
+        PackedSet<> packed_set;
+        unordered_set<uint64_t> std_set;
+        
+        uniform_int_distribution<uint64_t> val_distr(0, 1 + (prng() % 100000));
+        uniform_int_distribution<size_t> batch_distr(0, 2000);
+        for (size_t j = 0; j < 4; j++) {
+            vector<uint64_t> batch(batch_distr(prng));
+            for (auto& val : batch) {
+                val = val_distr(prng);
+            }
+            if (!batch.empty()) {
+                // include some duplicates within the batch
+                batch.push_back(batch.front());
+            }
+            packed_set.insert(batch.begin(), batch.end());
+            std_set.insert(batch.begin(), batch.end());
+            
+            assert(packed_set.size() == std_set.size());
+            for (auto val : batch) {
+                assert(packed_set.find(val));
+            }
+            for (size_t k = 0; k < 100; k++) {
+                uint64_t val = val_distr(prng);
+                assert(packed_set.find(val) == (bool) std_set.count(val));
+            }
+            
+            // a handful of single operations between batches
+            for (size_t k = 0; k < 20 && !batch.empty(); k++) {
+                uint64_t val = batch[prng() % batch.size()];
+                packed_set.remove(val);
+                std_set.erase(val);
+                assert(!packed_set.find(val));
+            }
+            assert(packed_set.size() == std_set.size());
+        }
+        
+        size_t num_iterated = 0;
+        for (auto it = packed_set.begin(); it != packed_set.end(); ++it) {
+            assert(std_set.count(*it));
+            ++num_iterated;
+        }
+        assert(num_iterated == std_set.size());
+    }
     cerr << "PackedSet tests successful!" << endl;
 }
 
@@ -3619,83 +4046,745 @@ void test_packed_graph() {
         check_flips(graph, p1, {h1, h3, h5});
     }
     
+    // batch sequence extraction
+    {
+        PackedGraph pg;
+        MappedPackedGraph mpg;
+        
+        SyntheticGraphParams params;
+        params.node_count = 200;
+        params.max_node_length = 150;
+        generate_synthetic_graph(&pg, params);
+        generate_synthetic_graph(&mpg, params);
+        pg.create_handle("ANNGCTNA");
+        mpg.create_handle("ANNGCTNA");
+        pg.create_handle("");
+        mpg.create_handle("");
+        
+        auto check_batch = [](const auto& graph) {
+            vector<handle_t> handles;
+            graph.for_each_handle([&](const handle_t& h) {
+                handles.push_back(h);
+                handles.push_back(graph.flip(h));
+            });
+            
+            string sequences = "leftover";
+            vector<size_t> offsets(5, 10);
+            graph.get_sequences(handles, sequences, offsets);
+            assert(offsets.size() == handles.size() + 1);
+            assert(offsets.front() == 0);
+            assert(offsets.back() == sequences.size());
+            for (size_t i = 0; i < handles.size(); i++) {
+                assert(sequences.substr(offsets[i], offsets[i + 1] - offsets[i]) == graph.get_sequence(handles[i]));
+            }
+            
+            graph.get_sequences(vector<handle_t>(), sequences, offsets);
+            assert(sequences.empty());
+            assert(offsets.size() == 1 && offsets.front() == 0);
+        };
+        check_batch(pg);
+        check_batch(mpg);
+    }
+    
     cerr << "PackedGraph tests successful!" << endl;
 }
 
-void test_multithreaded_overlay_construction() {
-    HashGraph graph;
-    
-    std::string node_content = "GATTACACATTAG";
-    size_t node_count = 1000;
-    size_t true_path_length = node_count * node_content.size();
-    size_t path_count = 10;
-    // We should coalesce 2 paths into each index.
-    size_t steps_per_index = node_count * 2;
+void test_packed_graph_serialization() {
+    SyntheticGraphParams params;
+    params.seed = 12;
+    params.node_count = 3000;
+    params.haplotype_count = 8;
     
-    // Make a long linear graph
-    std::vector<handle_t> nodes;
-    for (size_t i = 0; i < node_count; i++) {
-        nodes.push_back(graph.create_handle(node_content));
-        if (nodes.size() > 1) {
-            graph.create_edge(nodes[nodes.size() - 2], nodes[nodes.size() - 1]);
+    PackedGraph graph;
+    generate_synthetic_graph(&graph, params);
+    // Leave holes from deleted paths and nodes, and have some unusual paths
+    graph.destroy_path(graph.get_path_handle("haplotype3"));
+    for (nid_t id = 200; id < 220; id++) {
+        if (graph.has_node(id)) {
+            graph.destroy_handle(graph.get_handle(id));
         }
     }
+    graph.create_path_handle("empty");
+    path_handle_t circle = graph.create_path_handle("circle", true);
+    graph.append_step(circle, graph.get_handle(5));
+    graph.append_step(circle, graph.flip(graph.get_handle(6)));
     
-    // Make a bunch of paths and keep their names
-    std::vector<string> paths;
-    for (size_t i = 0; i < path_count; i++) {
-        string path_name = "path" + std::to_string(i);
-        paths.push_back(path_name);
-        path_handle_t path_handle = graph.create_path_handle(path_name);
-        for (auto& visit : nodes) {
-            graph.append_step(path_handle, visit);
-        }
-    }
+    auto check_graph = [&](PackedGraph& loaded) {
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &loaded, true));
+        assert(loaded.get_is_circular(loaded.get_path_handle("circle")));
+        assert(!loaded.has_path("haplotype3"));
+        assert(loaded.min_node_id() == graph.min_node_id());
+        assert(loaded.max_node_id() == graph.max_node_id());
+        // The loaded graph should still be editable
+        path_handle_t added = loaded.create_path_handle("added");
+        loaded.append_step(added, loaded.get_handle(graph.min_node_id()));
+        assert(loaded.get_step_count(added) == 1);
+        handle_t h = loaded.create_handle("GATTACA");
+        loaded.create_edge(loaded.get_handle(graph.max_node_id()), h);
+        assert(loaded.get_sequence(h) == "GATTACA");
+    };
     
     // Back up the thread count we have been using.
     int backup_thread_count = omp_get_max_threads();
-    for (int thread_count = 1; thread_count <= 4; thread_count++) {
-        // Try this number of threads
+    string reference;
+    for (int thread_count = 1; thread_count <= 4; thread_count *= 2) {
         omp_set_num_threads(thread_count);
         
-        // Make an overlay with this many threads for construction
-        PackedPositionOverlay overlay(&graph, steps_per_index);
+        stringstream strm;
+        graph.serialize(strm);
+        string serialized = strm.str();
+        // The layout shouldn't depend on the thread count
+        if (reference.empty()) {
+            reference = serialized;
+        }
+        assert(serialized == reference);
         
-        // Make sure it is right
-        for (auto& path_name : paths) {
-            assert(overlay.has_path(path_name));
-            path_handle_t path_handle = overlay.get_path_handle(path_name);
-            // Make sure they have the right name and length.
-            assert(overlay.get_path_name(path_handle) == path_name);
-            assert(overlay.get_path_length(path_handle) == true_path_length);
-            for (size_t i = 0; i < true_path_length; i++) {
-                // For each position
-                // Figure out what node and orientation it should have.
-                handle_t true_underlying_handle = nodes.at(i / node_content.size());
-                // Find its step
-                step_handle_t seen_step = overlay.get_step_at_position(path_handle, i);
-                // Make sure it is on the right path
-                assert(overlay.get_path_handle_of_step(seen_step) == path_handle);
-                // Make sure it is the right node
-                handle_t observed_handle = overlay.get_handle_of_step(seen_step);
-                assert(overlay.get_underlying_handle(observed_handle) == true_underlying_handle);
-                // Make sure the step is at the right place
-                size_t true_step_start = i - (i % node_content.size());
-                assert(overlay.get_position_of_step(seen_step) == true_step_start);
-            }
+        {
+            // Load it from a stream
+            PackedGraph loaded;
+            loaded.deserialize(strm);
+            check_graph(loaded);
+        }
+        
+        char filename[] = "tmpXXXXXX";
+        int fd = mkstemp(filename);
+        assert(fd != -1);
+        assert(close(fd) == 0);
+        {
+            // Load it from a file
+            graph.serialize(string(filename));
+            PackedGraph loaded;
+            loaded.deserialize(string(filename));
+            check_graph(loaded);
+
         }
+        unlink(filename);
         
+        {
+            // Truncated data should be rejected
+            stringstream truncated(serialized.substr(0, serialized.size() / 2));
+            PackedGraph loaded;
+            bool caught = false;
+            try {
+                loaded.deserialize(truncated);
+            } catch (std::runtime_error& e) {
+                caught = true;
+            }
+            assert(caught);
+        }
+        {
+            // So should a format version from the future
+            string future = serialized;
+            uint64_t version = 1000;
+            future.replace(sizeof(uint32_t) + sizeof(int64_t), sizeof(version), (const char*) &version, sizeof(version));
+            stringstream future_strm(future);
+            PackedGraph loaded;
+            bool caught = false;
+            try {
+                loaded.deserialize(future_strm);
+            } catch (std::runtime_error& e) {
+                caught = true;
+            }
+            assert(caught);
+        }
     }
     // Go back to the default thread count.
     omp_set_num_threads(backup_thread_count);
     
-    cerr << "Multithreaded PackedPositionOverlay tests successful!" << endl;
+    {
+        // Tuning the page widths shouldn't change the graph, and the tuned
+        // graph should round-trip
+        stringstream strm;
+        graph.serialize(strm);
+        PackedGraph tuned;
+        tuned.deserialize(strm);
+        assert(!tuned.get_page_width_tuning());
+        tuned.set_page_width_tuning(true);
+        assert(tuned.get_page_width_tuning());
+        tuned.optimize(false);
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &tuned, true));
+        
+        stringstream tuned_strm;
+        tuned.serialize(tuned_strm);
+        PackedGraph loaded;
+        loaded.deserialize(tuned_strm);
+        check_graph(loaded);
+        
+        // Editing after tuning should also work
+        check_graph(tuned);
+    }
+    
+    {
+        // Empty graphs should round-trip too
+        PackedGraph empty, loaded;
+        stringstream strm;
+        empty.serialize(strm);
+        loaded.deserialize(strm);
+        assert(loaded.get_node_count() == 0);
+        assert(loaded.get_path_count() == 0);
+        handle_t h = loaded.create_handle("A");
+        assert(loaded.get_sequence(h) == "A");
+    }
+    
+    {
+        // Graphs in the original, unsectioned layout should still load. Each
+        // section holds the same bytes as some of the members of the original
+        // layout, so we can make one by putting them back in the original order.
+        stringstream strm;
+        graph.serialize(strm);
+        string serialized = strm.str();
+        auto read_word = [](const string& data, size_t offset) {
+            uint64_t value;
+            data.copy((char*) &value, sizeof(value), offset);
+            return value;
+        };
+        
+        // skip the magic number, the format marker, and the version
+        size_t section_count = read_word(serialized, sizeof(uint32_t) + 2 * sizeof(uint64_t));
+        size_t offsets_start = sizeof(uint32_t) + 3 * sizeof(uint64_t);
+        size_t body_start = offsets_start + (section_count + 1) * sizeof(uint64_t);
+        vector<string> sections;
+        for (size_t i = 0; i < section_count; ++i) {
+            size_t begin = read_word(serialized, offsets_start + i * sizeof(uint64_t));
+            size_t end = read_word(serialized, offsets_start + (i + 1) * sizeof(uint64_t));
+            sections.push_back(serialized.substr(body_start + begin, end - begin));
+        }
+        
+        // the first section is the ID range, the path name characters, and the deletion counts
+        const string& scalars = sections[0];
+        size_t chars_end = 3 * sizeof(uint64_t) + read_word(scalars, 2 * sizeof(uint64_t));
+        
+        string unsectioned = serialized.substr(0, sizeof(uint32_t));
+        unsectioned += scalars.substr(0, 2 * sizeof(uint64_t));
+        for (size_t i = 1; i <= 10; ++i) {
+            // the topology, sequences, and path memberships
+            unsectioned += sections[i];
+        }
+        unsectioned += scalars.substr(2 * sizeof(uint64_t), chars_end - 2 * sizeof(uint64_t));
+        for (size_t i = 11; i < section_count; ++i) {
+            // the path metadata, and then the paths themselves
+            unsectioned += sections[i];
+        }
+        unsectioned += scalars.substr(chars_end);
+        
+        stringstream unsectioned_strm(unsectioned);
+        PackedGraph loaded;
+        loaded.deserialize(unsectioned_strm);
+        assert(loaded.get_node_count() == graph.get_node_count());
+        assert(loaded.get_edge_count() == graph.get_edge_count());
+        assert(loaded.get_path_count() == graph.get_path_count());
+        
+        // and they get written back out in the sectioned layout
+        stringstream rewritten;
+        loaded.serialize(rewritten);
+        PackedGraph reloaded;
+        reloaded.deserialize(rewritten);
+        check_graph(loaded);
+        check_graph(reloaded);
+    }
+    
+    cerr << "PackedGraph serialization tests successful!" << endl;
 }
 
-void test_path_position_overlays() {
+void test_packed_graph_incremental_defragmentation() {
+    SyntheticGraphParams params;
+    params.seed = 7;
+    params.node_count = 800;
+    params.haplotype_count = 6;
     
-    vector<MutablePathDeletableHandleGraph*> implementations;
-
+    // Make the same graph twice, and only let one defragment incrementally
+    PackedGraph graph, reference;
+    generate_synthetic_graph(&graph, params);
+    generate_synthetic_graph(&reference, params);
+    assert(!graph.get_incremental_defragmentation());
+    graph.set_incremental_defragmentation(true);
+    assert(graph.get_incremental_defragmentation());
+    
+    nid_t min_id = graph.min_node_id();
+    nid_t next_id = graph.max_node_id() + 1;
+    
+    // Step handles on a path we keep should stay valid
+    path_handle_t kept = graph.get_path_handle("haplotype0");
+    vector<pair<step_handle_t, handle_t>> kept_steps;
+    graph.for_each_step_in_path(kept, [&](const step_handle_t& step) {
+        kept_steps.emplace_back(step, graph.get_handle_of_step(step));
+    });
+    auto check_kept_steps = [&](const PackedGraph& g) {
+        for (auto& kept_step : kept_steps) {
+            assert(g.get_handle_of_step(kept_step.first) == kept_step.second);
+        }
+    };
+    
+    // Destroying paths leaves many deleted records behind at once
+    for (size_t i = 1; i < 4; ++i) {
+        string name = "haplotype" + to_string(i);
+        graph.destroy_path(graph.get_path_handle(name));
+        reference.destroy_path(reference.get_path_handle(name));
+    }
+    assert(graph.compact_step(0));
+    assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &reference, true));
+    
+    default_random_engine prng(params.seed);
+    uniform_int_distribution<int> op_distr(0, 4);
+    vector<string> added_paths;
+    for (size_t i = 0; i < 3000; ++i) {
+        nid_t node_id = uniform_int_distribution<nid_t>(min_id, next_id - 1)(prng);
+        if (!graph.has_node(node_id)) {
+            assert(!reference.has_node(node_id));
+            continue;
+        }
+        handle_t h = graph.get_handle(node_id, prng() % 2);
+        switch (op_distr(prng)) {
+            case 0:
+            {
+                // Destroy a node that no path visits
+                if (graph.get_step_count(h) == 0) {
+                    graph.destroy_handle(h);
+                    reference.destroy_handle(h);
+                }
+                break;
+            }
+            case 1:
+            {
+                // Destroy an edge
+                handle_t next;
+                bool found = !graph.follow_edges(h, false, [&](const handle_t& n) {
+                    next = n;
+                    return false;
+                });
+                if (found) {
+                    graph.destroy_edge(h, next);
+                    reference.destroy_edge(h, next);
+                }
+                break;
+            }
+            case 2:
+            {
+                // Add a node, sometimes with a self edge
+                handle_t added = graph.create_handle("GATTACA", next_id);
+                reference.create_handle("GATTACA", next_id);
+                ++next_id;
+                graph.create_edge(h, added);
+                reference.create_edge(h, added);
+                switch (prng() % 4) {
+                    case 0:
+                        graph.create_edge(added, graph.flip(added));
+                        reference.create_edge(added, reference.flip(added));
+                        break;
+                    case 1:
+                        graph.create_edge(added, added);
+                        reference.create_edge(added, added);
+                        break;
+                }
+                break;
+            }
+            case 3:
+            {
+                // Add a path
+                string name = "added" + to_string(i);
+                path_handle_t path = graph.create_path_handle(name);
+                path_handle_t ref_path = reference.create_path_handle(name);
+                for (size_t j = 0; j < 5; ++j) {
+                    graph.append_step(path, h);
+                    reference.append_step(ref_path, h);
+                }
+                added_paths.push_back(name);
+                break;
+            }
+            case 4:
+            {
+                // Destroy an added path
+                if (!added_paths.empty()) {
+                    size_t j = prng() % added_paths.size();
+                    graph.destroy_path(graph.get_path_handle(added_paths[j]));
+                    reference.destroy_path(reference.get_path_handle(added_paths[j]));
+                    added_paths.erase(added_paths.begin() + j);
+                }
+                break;
+            }
+        }
+        if (i % 500 == 0) {
+            assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &reference, true));
+            check_kept_steps(graph);
+        }
+    }
+    assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &reference, true));
+    assert(graph.get_edge_count() == reference.get_edge_count());
+    check_kept_steps(graph);
+    
+    {
+        // Deleted records that are still waiting should survive serialization
+        stringstream strm;
+        graph.serialize(strm);
+        PackedGraph loaded;
+        loaded.deserialize(strm);
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&loaded, &reference, true));
+        while (loaded.compact_step(16)) {
+            // keep going
+        }
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&loaded, &reference, true));
+        assert(loaded.get_edge_count() == reference.get_edge_count());
+        check_kept_steps(loaded);
+    }
+    
+    {
+        // Counts of deleted records that are too big shouldn't make compaction
+        // drop live records
+        stringstream strm;
+        graph.serialize(strm);
+        string serialized = strm.str();
+        // skip the magic number, the format marker, the version, and the table of contents
+        uint64_t section_count;
+        serialized.copy((char*) &section_count, sizeof(section_count), sizeof(uint32_t) + 2 * sizeof(uint64_t));
+        size_t scalars_start = sizeof(uint32_t) + (4 + section_count) * sizeof(uint64_t);
+        // then the ID range and the path name characters
+        uint64_t char_count;
+        serialized.copy((char*) &char_count, sizeof(char_count), scalars_start + 2 * sizeof(uint64_t));
+        size_t counts_start = scalars_start + 3 * sizeof(uint64_t) + char_count;
+        for (size_t i = 0; i < 3; ++i) {
+            // add to the node, edge, and membership counts
+            uint64_t count;
+            serialized.copy((char*) &count, sizeof(count), counts_start + i * sizeof(uint64_t));
+            count += 1000;
+            serialized.replace(counts_start + i * sizeof(uint64_t), sizeof(count), (const char*) &count, sizeof(count));
+        }
+        
+        stringstream tampered(serialized);
+        PackedGraph loaded;
+        loaded.deserialize(tampered);
+        assert(loaded.get_node_count() == reference.get_node_count());
+        assert(loaded.get_edge_count() == reference.get_edge_count());
+        while (loaded.compact_step(16)) {
+            // keep going
+        }
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&loaded, &reference, true));
+        assert(loaded.get_edge_count() == reference.get_edge_count());
+        check_kept_steps(loaded);
+    }
+    
+    // Finish compacting, a little at a time
+    while (graph.compact_step(16)) {
+        // keep going
+    }
+    assert(!graph.compact_step(16));
+    assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &reference, true));
+    assert(graph.get_edge_count() == reference.get_edge_count());
+    check_kept_steps(graph);
+    
+    // The compacted graph should still be editable
+    handle_t h1 = graph.create_handle("CAT", next_id);
+    handle_t h2 = graph.create_handle("TAG", next_id + 1);
+    graph.create_edge(h1, h2);
+    assert(graph.has_edge(h1, h2));
+    graph.destroy_handle(h1);
+    assert(!graph.has_node(next_id));
+    assert(graph.get_degree(h2, true) == 0);
+    
+    {
+        // Finding the ID of an isolated node to move it should be spread over
+        // several steps when the ID range is big
+        PackedGraph sparse;
+        sparse.set_incremental_defragmentation(true);
+        handle_t first = sparse.create_handle("GAT", 1);
+        handle_t middle = sparse.create_handle("TA", 500000);
+        sparse.create_handle("CA", 1000000);
+        sparse.create_edge(first, middle);
+        sparse.destroy_handle(middle);
+        assert(sparse.compact_step(16));
+        size_t steps = 1;
+        while (sparse.compact_step(16)) {
+            ++steps;
+        }
+        assert(steps > 1000);
+        assert(sparse.get_node_count() == 2);
+        assert(sparse.get_sequence(sparse.get_handle(1)) == "GAT");
+        assert(sparse.get_sequence(sparse.get_handle(1000000)) == "CA");
+        assert(sparse.get_degree(sparse.get_handle(1), false) == 0);
+        handle_t added = sparse.create_handle("TAG", 2);
+        sparse.create_edge(added, sparse.get_handle(1000000));
+        assert(sparse.has_edge(sparse.get_handle(2), sparse.get_handle(1000000)));
+    }
+    
+    cerr << "PackedGraph incremental defragmentation tests successful!" << endl;
+}
+
+void test_frozen_packed_graph() {
+    SyntheticGraphParams params;
+    params.seed = 8;
+    params.node_count = 2000;
+    params.haplotype_count = 6;
+    
+    PackedGraph graph;
+    generate_synthetic_graph(&graph, params);
+    // Leave holes in the IDs, and have some unusual paths and edges
+    for (nid_t id = 100; id < 110; id++) {
+        if (graph.has_node(id)) {
+            graph.destroy_handle(graph.get_handle(id));
+        }
+    }
+    graph.create_path_handle("empty");
+    path_handle_t circle = graph.create_path_handle("circle", true);
+    graph.append_step(circle, graph.get_handle(5));
+    graph.append_step(circle, graph.flip(graph.get_handle(6)));
+    graph.append_step(circle, graph.get_handle(5));
+    path_handle_t linear = graph.create_path_handle("linear");
+    for (nid_t id = 10; id < 20; id++) {
+        graph.append_step(linear, graph.get_handle(id, id % 3 == 0));
+    }
+    graph.create_edge(graph.get_handle(7), graph.flip(graph.get_handle(7)));
+    graph.create_edge(graph.flip(graph.get_handle(8)), graph.get_handle(8));
+    
+    auto check_graph = [&](const FrozenPackedGraph& frozen) {
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &frozen, true));
+        assert(frozen.min_node_id() == graph.min_node_id());
+        assert(frozen.max_node_id() == graph.max_node_id());
+        assert(frozen.get_total_length() == graph.get_total_length());
+        assert(frozen.get_edge_count() == graph.get_edge_count());
+        assert(!frozen.has_node(105));
+        assert(!frozen.has_path("haplotype"));
+        
+        graph.for_each_handle([&](const handle_t& h) {
+            for (bool is_reverse : {false, true}) {
+                handle_t orig = is_reverse ? graph.flip(h) : h;
+                handle_t handle = frozen.get_handle(graph.get_id(h), is_reverse);
+                assert(frozen.get_id(handle) == graph.get_id(h));
+                assert(frozen.get_is_reverse(handle) == is_reverse);
+                for (bool go_left : {false, true}) {
+                    assert(frozen.get_degree(handle, go_left) == graph.get_degree(orig, go_left));
+                }
+                string seq = graph.get_sequence(orig);
+                for (size_t i = 0; i < seq.size(); i++) {
+                    assert(frozen.get_base(handle, i) == seq[i]);
+                }
+                assert(frozen.get_subsequence(handle, 1, 3) == seq.substr(1, 3));
+                
+                // every step on the node should be found from the node
+                size_t count = 0;
+                frozen.for_each_step_on_handle(handle, [&](const step_handle_t& step) {
+                    assert(frozen.get_id(frozen.get_handle_of_step(step)) == graph.get_id(h));
+                    count++;
+                });
+                assert(count == graph.get_step_count(orig));
+                assert(frozen.get_step_count(handle) == count);
+            }
+        });
+        
+        // Paths come in order of their names
+        string prev_name;
+        frozen.for_each_path_handle([&](const path_handle_t& path) {
+            assert(frozen.get_path_name(path) > prev_name);
+            prev_name = frozen.get_path_name(path);
+        });
+        
+        path_handle_t empty = frozen.get_path_handle("empty");
+        assert(frozen.is_empty(empty));
+        assert(frozen.path_begin(empty) == frozen.path_end(empty));
+        assert(frozen.path_back(empty) == frozen.path_front_end(empty));
+        
+        path_handle_t frozen_circle = frozen.get_path_handle("circle");
+        assert(frozen.get_is_circular(frozen_circle));
+        assert(frozen.get_step_count(frozen_circle) == 3);
+        step_handle_t step = frozen.path_back(frozen_circle);
+        assert(frozen.has_next_step(step));
+        assert(frozen.get_next_step(step) == frozen.path_begin(frozen_circle));
+        assert(frozen.has_previous_step(frozen.path_begin(frozen_circle)));
+        assert(frozen.get_previous_step(frozen.path_begin(frozen_circle)) == step);
+        
+        path_handle_t hap = frozen.get_path_handle("linear");
+        assert(!frozen.get_is_circular(hap));
+        assert(frozen.get_next_step(frozen.path_back(hap)) == frozen.path_end(hap));
+        assert(frozen.get_previous_step(frozen.path_end(hap)) == frozen.path_back(hap));
+        assert(frozen.get_previous_step(frozen.path_begin(hap)) == frozen.path_front_end(hap));
+        assert(frozen.get_next_step(frozen.path_front_end(hap)) == frozen.path_begin(hap));
+        assert(!frozen.has_next_step(frozen.path_back(hap)));
+        assert(!frozen.has_previous_step(frozen.path_begin(hap)));
+    };
+    
+    FrozenPackedGraph frozen(&graph);
+    check_graph(frozen);
+    
+    {
+        // Freezing should save space
+        stringstream packed_strm, frozen_strm;
+        graph.serialize(packed_strm);
+        frozen.serialize(frozen_strm);
+        assert(frozen_strm.str().size() < packed_strm.str().size());
+    }
+    
+    {
+        stringstream strm;
+        frozen.serialize(strm);
+        FrozenPackedGraph loaded;
+        loaded.deserialize(strm);
+        check_graph(loaded);
+    }
+    
+    {
+        // Empty graphs should freeze too
+        PackedGraph empty;
+        FrozenPackedGraph frozen_empty(&empty);
+        assert(frozen_empty.get_node_count() == 0);
+        assert(frozen_empty.get_path_count() == 0);
+        assert(!frozen_empty.has_node(1));
+        assert(!frozen_empty.has_path("x"));
+        stringstream strm;
+        frozen_empty.serialize(strm);
+        FrozenPackedGraph loaded(strm);
+        assert(loaded.get_node_count() == 0);
+    }
+    
+    cerr << "FrozenPackedGraph tests successful!" << endl;
+}
+
+void test_multithreaded_overlay_construction() {
+    HashGraph graph;
+    
+    std::string node_content = "GATTACACATTAG";
+    size_t node_count = 1000;
+    size_t true_path_length = node_count * node_content.size();
+    size_t path_count = 10;
+    // We should coalesce 2 paths into each index.
+    size_t steps_per_index = node_count * 2;
+    
+    // Make a long linear graph
+    std::vector<handle_t> nodes;
+    for (size_t i = 0; i < node_count; i++) {
+        nodes.push_back(graph.create_handle(node_content));
+        if (nodes.size() > 1) {
+            graph.create_edge(nodes[nodes.size() - 2], nodes[nodes.size() - 1]);
+        }
+    }
+    
+    // Make a bunch of paths and keep their names
+    std::vector<string> paths;
+    for (size_t i = 0; i < path_count; i++) {
+        string path_name = "path" + std::to_string(i);
+        paths.push_back(path_name);
+        path_handle_t path_handle = graph.create_path_handle(path_name);
+        for (auto& visit : nodes) {
+            graph.append_step(path_handle, visit);
+        }
+    }
+    
+    // Back up the thread count we have been using.
+    int backup_thread_count = omp_get_max_threads();
+    for (int thread_count = 1; thread_count <= 4; thread_count++) {
+        // Try this number of threads
+        omp_set_num_threads(thread_count);
+        
+        // Make an overlay with this many threads for construction
+        PackedPositionOverlay overlay(&graph, steps_per_index);
+        
+        // Make sure it is right
+        for (auto& path_name : paths) {
+            assert(overlay.has_path(path_name));
+            path_handle_t path_handle = overlay.get_path_handle(path_name);
+            // Make sure they have the right name and length.
+            assert(overlay.get_path_name(path_handle) == path_name);
+            assert(overlay.get_path_length(path_handle) == true_path_length);
+            for (size_t i = 0; i < true_path_length; i++) {
+                // For each position
+                // Figure out what node and orientation it should have.
+                handle_t true_underlying_handle = nodes.at(i / node_content.size());
+                // Find its step
+                step_handle_t seen_step = overlay.get_step_at_position(path_handle, i);
+                // Make sure it is on the right path
+                assert(overlay.get_path_handle_of_step(seen_step) == path_handle);
+                // Make sure it is the right node
+                handle_t observed_handle = overlay.get_handle_of_step(seen_step);
+                assert(overlay.get_underlying_handle(observed_handle) == true_underlying_handle);
+                // Make sure the step is at the right place
+                size_t true_step_start = i - (i % node_content.size());
+                assert(overlay.get_position_of_step(seen_step) == true_step_start);
+            }
+        }
+        
+    }
+    // Go back to the default thread count.
+    omp_set_num_threads(backup_thread_count);
+    
+    cerr << "Multithreaded PackedPositionOverlay tests successful!" << endl;
+}
+
+void test_mapped_packed_position_overlay() {
+    SyntheticGraphParams params;
+    params.seed = 8;
+    params.node_count = 2000;
+    params.bubble_density = 0.5;
+    params.inversion_rate = 0.2;
+    params.haplotype_count = 6;
+    
+    PackedGraph graph;
+    generate_synthetic_graph(&graph, params);
+    // Have an empty path too
+    graph.create_path_handle("empty");
+    
+    auto check_overlay = [&](const MappedPackedPositionOverlay& overlay) {
+        graph.for_each_path_handle([&](const path_handle_t& path_handle) {
+            size_t position = 0;
+            graph.for_each_step_in_path(path_handle, [&](const step_handle_t& step) {
+                assert(overlay.get_position_of_step(step) == position);
+                assert(overlay.get_step_at_position(path_handle, position) == step);
+                size_t length = graph.get_length(graph.get_handle_of_step(step));
+                assert(overlay.get_step_at_position(path_handle, position + length - 1) == step);
+                position += length;
+            });
+            assert(overlay.get_path_length(path_handle) == position);
+            assert(overlay.get_step_at_position(path_handle, position) == graph.path_end(path_handle));
+            assert(overlay.get_position_of_step(graph.path_end(path_handle)) == position);
+        });
+    };
+    
+    char filename[] = "tmpXXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    {
+        // Make several indexes, each over a few paths
+        MappedPackedPositionOverlay overlay(&graph, 3 * params.node_count);
+        check_overlay(overlay);
+        
+        // Copies should work too
+        MappedPackedPositionOverlay copy(overlay);
+        check_overlay(copy);
+        
+        overlay.serialize(fd);
+        check_overlay(overlay);
+    }
+    {
+        // Load it from the FD
+        MappedPackedPositionOverlay overlay;
+        overlay.deserialize(fd);
+        overlay.set_graph(&graph);
+        check_overlay(overlay);
+    }
+    assert(close(fd) == 0);
+    {
+        // Load it from a stream
+        MappedPackedPositionOverlay overlay;
+        std::ifstream stream(filename);
+        overlay.deserialize(stream);
+        overlay.set_graph(&graph);
+        check_overlay(overlay);
+        
+        // It should refuse a graph with different paths
+        PackedGraph other;
+        bool caught = false;
+        try {
+            overlay.set_graph(&other);
+        } catch (std::runtime_error& e) {
+            caught = true;
+        }
+        assert(caught);
+    }
+    unlink(filename);
+    
+    cerr << "MappedPackedPositionOverlay tests successful!" << endl;
+}
+
+void test_path_position_overlays() {
+    
+    vector<MutablePathDeletableHandleGraph*> implementations;
+
     HashGraph hg;
     implementations.push_back(&hg);
 
@@ -3730,9 +4819,11 @@ void test_path_position_overlays() {
             
             PositionOverlay basic_overlay(&graph);
             PackedPositionOverlay packed_overlay(&graph);
+            MappedPackedPositionOverlay mapped_overlay(&graph);
             
             overlays.push_back(&basic_overlay);
             overlays.push_back(&packed_overlay);
+            overlays.push_back(&mapped_overlay);
             
             for (PathPositionHandleGraph* implementation : overlays) {
                 PathPositionHandleGraph& overlay = *implementation;
@@ -4171,6 +5262,102 @@ void test_reference_path_overlay() {
     cerr << "ReferencePathOverlay tests successful!" << endl;
 }
 
+void test_mapped_reference_path_overlay() {
+    SyntheticGraphParams params;
+    params.seed = 11;
+    params.node_count = 3000;
+    params.max_node_length = 40;
+    params.bubble_density = 0.5;
+    params.inversion_rate = 0.2;
+    params.haplotype_count = 4;
+    
+    PackedGraph graph;
+    generate_synthetic_graph(&graph, params);
+    // Have an empty path too
+    graph.create_path_handle("empty");
+    
+    ReferencePathOverlay truth(&graph);
+    
+    // Make sure a mapped overlay agrees with the normal one
+    auto check_overlay = [&](const MappedReferencePathOverlay& overlay) {
+        assert(overlay.get_path_count() == truth.get_path_count());
+        truth.for_each_path_handle([&](const path_handle_t& path) {
+            assert(overlay.get_step_count(path) == truth.get_step_count(path));
+            assert(overlay.get_path_length(path) == truth.get_path_length(path));
+            for (auto s = truth.path_begin(path), end = truth.path_end(path); s != end; s = truth.get_next_step(s)) {
+                assert(overlay.get_handle_of_step(s) == truth.get_handle_of_step(s));
+                size_t position = truth.get_position_of_step(s);
+                assert(overlay.get_position_of_step(s) == position);
+                for (size_t i = 0; i < truth.get_length(truth.get_handle_of_step(s)); ++i) {
+                    assert(overlay.get_step_at_position(path, position + i) == s);
+                }
+            }
+            assert(overlay.get_step_at_position(path, overlay.get_path_length(path)) == overlay.path_end(path));
+        });
+        size_t path_count = 0;
+        overlay.for_each_path_handle([&](const path_handle_t& path) {
+            path_count++;
+        });
+        assert(path_count == truth.get_path_count());
+        truth.for_each_handle([&](const handle_t& handle) {
+            vector<step_handle_t> expected;
+            truth.for_each_step_on_handle(handle, [&](const step_handle_t& step) {
+                expected.push_back(step);
+            });
+            vector<step_handle_t> observed;
+            overlay.for_each_step_on_handle(handle, [&](const step_handle_t& step) {
+                observed.push_back(step);
+            });
+            assert(observed == expected);
+        });
+    };
+    
+    char filename[] = "tmpXXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    {
+        MappedReferencePathOverlay overlay(&graph);
+        check_overlay(overlay);
+        
+        // Copies should work too
+        MappedReferencePathOverlay copy(overlay);
+        check_overlay(copy);
+        
+        overlay.serialize(fd);
+        check_overlay(overlay);
+    }
+    {
+        // Load it from the FD
+        MappedReferencePathOverlay overlay;
+        overlay.deserialize(fd);
+        overlay.set_graph(&graph);
+        check_overlay(overlay);
+    }
+    assert(close(fd) == 0);
+    {
+        // Load it from a stream
+        MappedReferencePathOverlay overlay;
+        std::ifstream stream(filename);
+        overlay.deserialize(stream);
+        overlay.set_graph(&graph);
+        check_overlay(overlay);
+        
+        // It should refuse a graph with different nodes
+        PackedGraph other;
+        other.create_handle("GATTACA", 1);
+        bool caught = false;
+        try {
+            overlay.set_graph(&other);
+        } catch (std::runtime_error& e) {
+            caught = true;
+        }
+        assert(caught);
+    }
+    unlink(filename);
+    
+    cerr << "MappedReferencePathOverlay tests successful!" << endl;
+}
+
 void test_vectorizable_overlays() {
     
     vector<MutablePathDeletableHandleGraph*> implementations;
@@ -4504,6 +5691,26 @@ void test_packed_subgraph_overlay() {
         assert(found2);
         found1 = false;
         found2 = false;
+        
+        // adding a batch of nodes should give the same subgraph as adding them one at a time
+        PackedSubgraphOverlay batched(&graph);
+        batched.add_nodes({h2, graph.flip(h4), h2, h3});
+        assert(batched.get_node_count() == 3);
+        assert(!batched.has_node(graph.get_id(h1)));
+        assert(batched.has_node(graph.get_id(h2)));
+        assert(batched.has_node(graph.get_id(h3)));
+        assert(batched.has_node(graph.get_id(h4)));
+        assert(batched.min_node_id() == min(graph.get_id(h2), min(graph.get_id(h3), graph.get_id(h4))));
+        assert(batched.max_node_id() == max(graph.get_id(h2), max(graph.get_id(h3), graph.get_id(h4))));
+        assert(batched.get_degree(h2, true) == 0);
+        assert(batched.get_degree(h2, false) == 1);
+        assert(batched.get_degree(h3, false) == 1);
+        assert(batched.get_degree(h4, true) == 2);
+        
+        batched.add_nodes({h1});
+        assert(batched.get_node_count() == 4);
+        assert(batched.get_degree(h1, false) == 2);
+        assert(batched.get_degree(h4, true) == 2);
     }
     
     cerr << "PackedSubgraphOverlay tests successful!" << endl;
@@ -4565,6 +5772,27 @@ void test_mapped_packed_graph() {
         check_graph(mpg);
     }
     unlink(filename);
+    {
+        // Make an image with the magic number from before the layout changed
+        MappedPackedGraph mpg;
+        mpg.create_handle("GATTACA", 1);
+        std::stringstream stream;
+        mpg.serialize(stream);
+        std::string image = stream.str();
+        uint32_t old_magic = htonl(672226447);
+        image.replace(0, sizeof(old_magic), (const char*) &old_magic, sizeof(old_magic));
+        
+        // It must be refused instead of read with the new layout
+        std::stringstream old_stream(image);
+        MappedPackedGraph loaded;
+        bool refused = false;
+        try {
+            loaded.deserialize(old_stream);
+        } catch (std::runtime_error& e) {
+            refused = true;
+        }
+        assert(refused);
+    }
     
     cerr << "MappedPackedGraph tests successful!" << endl;
 }
@@ -4612,7 +5840,1602 @@ void test_hash_graph() {
     assert(handlegraph::algorithms::are_equivalent_with_paths(&g, &g_move_1, true));
     assert(handlegraph::algorithms::are_equivalent_with_paths(&g, &g_move_2, true));
     
-    cerr << "HashGraph tests successful!" << endl;
+    // make sure parallel iteration visits every node exactly once, across
+    // enough buckets to be split into several blocks
+    {
+        HashGraph big;
+        size_t node_count = 20000;
+        for (size_t i = 0; i < node_count; ++i) {
+            // leave gaps in the IDs so the buckets aren't uniformly filled
+            big.create_handle("A", 1 + 3 * i);
+        }
+        
+        int backup_thread_count = omp_get_max_threads();
+        for (int thread_count : {1, 2, 4}) {
+            omp_set_num_threads(thread_count);
+            
+            vector<atomic<int>> visits(3 * node_count + 1);
+            for (auto& count : visits) {
+                count.store(0);
+            }
+            bool finished = big.for_each_handle([&](const handle_t& h) {
+                assert(!big.get_is_reverse(h));
+                visits[big.get_id(h)]++;
+            }, true);
+            assert(finished);
+            for (size_t i = 0; i < visits.size(); ++i) {
+                assert(visits[i].load() == (i % 3 == 1 ? 1 : 0));
+            }
+            
+            // stopping early should stop well short of the whole graph
+            atomic<size_t> visited(0);
+            finished = big.for_each_handle([&](const handle_t& h) {
+                return ++visited < 10;
+            }, true);
+            assert(!finished);
+            assert(visited.load() < node_count);
+        }
+        omp_set_num_threads(backup_thread_count);
+    }
+    
+    // make sure step handles stay valid as paths grow, shrink, and get copied
+    {
+        HashGraph churn;
+        vector<handle_t> handles;
+        for (size_t i = 0; i < 10; ++i) {
+            handles.push_back(churn.create_handle("GATTACA"));
+        }
+        
+        // enough steps to spill over several slabs of steps
+        path_handle_t p1 = churn.create_path_handle("p1");
+        path_handle_t p2 = churn.create_path_handle("p2", true);
+        vector<step_handle_t> steps;
+        vector<handle_t> expected;
+        for (size_t i = 0; i < 5000; ++i) {
+            handle_t h = handles[i % handles.size()];
+            if (i % 7 == 0) {
+                h = churn.flip(h);
+            }
+            steps.push_back(churn.append_step(p1, h));
+            expected.push_back(h);
+            churn.prepend_step(p2, h);
+        }
+        for (size_t i = 0; i < steps.size(); ++i) {
+            assert(churn.get_handle_of_step(steps[i]) == expected[i]);
+        }
+        
+        // swap out a stretch of each path, which frees and reallocates steps
+        auto new_range = churn.rewrite_segment(steps[100], steps[4000], {handles[3], handles[4]});
+        assert(churn.get_handle_of_step(new_range.first) == handles[3]);
+        assert(new_range.second == steps[4000]);
+        assert(churn.get_step_count(p1) == 5000 - 3900 + 2);
+        expected.erase(expected.begin() + 100, expected.begin() + 4000);
+        expected.insert(expected.begin() + 100, {handles[3], handles[4]});
+        
+        auto check_path = [](const HashGraph& graph, const path_handle_t& path,
+                             const vector<handle_t>& path_handles) {
+            size_t i = 0;
+            graph.for_each_step_in_path(path, [&](const step_handle_t& step) {
+                assert(i < path_handles.size());
+                assert(graph.get_handle_of_step(step) == path_handles[i]);
+                ++i;
+            });
+            assert(i == path_handles.size());
+            assert(graph.get_step_count(path) == path_handles.size());
+        };
+        check_path(churn, p1, expected);
+        
+        // regrow the path into the freed steps
+        for (size_t i = 0; i < 3000; ++i) {
+            churn.append_step(p1, handles[i % 5]);
+            expected.push_back(handles[i % 5]);
+        }
+        check_path(churn, p1, expected);
+        
+        // occurrences should still agree with the paths
+        size_t occurrence_count = 0;
+        churn.for_each_handle([&](const handle_t& h) {
+            churn.for_each_step_on_handle(h, [&](const step_handle_t& step) {
+                assert(churn.get_id(churn.get_handle_of_step(step)) == churn.get_id(h));
+                ++occurrence_count;
+            });
+        });
+        assert(occurrence_count == expected.size() + 5000);
+        
+        // a copy should own its own steps
+        HashGraph copy(churn);
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&churn, &copy, true));
+        churn.destroy_path(p2);
+        churn.append_step(p1, handles[0]);
+        check_path(copy, copy.get_path_handle("p1"), expected);
+        assert(copy.get_is_circular(copy.get_path_handle("p2")));
+        assert(copy.get_step_count(copy.get_path_handle("p2")) == 5000);
+        
+        // steps should survive a move, and the moved-from graph should be reusable
+        HashGraph moved(move(copy));
+        check_path(moved, moved.get_path_handle("p1"), expected);
+        assert(copy.get_node_count() == 0);
+        assert(copy.get_path_count() == 0);
+        handle_t reused = copy.create_handle("A");
+        path_handle_t reused_path = copy.create_path_handle("p3");
+        copy.append_step(reused_path, reused);
+        check_path(copy, reused_path, {reused});
+        
+        // and clearing should leave a working graph
+        moved.clear();
+        assert(moved.get_path_count() == 0);
+        handle_t after = moved.create_handle("C");
+        path_handle_t after_path = moved.create_path_handle("p4");
+        moved.append_step(after_path, after);
+        moved.append_step(after_path, moved.flip(after));
+        check_path(moved, after_path, {after, moved.flip(after)});
+    }
+    
+    // make sure both ways of storing sequences give the same graph, through
+    // enough edits to fragment and compact the sequence arena
+    {
+        random_device rd;
+        default_random_engine gen(rd());
+        uniform_int_distribution<int> base_distr(0, 4);
+        uniform_int_distribution<size_t> length_distr(1, 200);
+        
+        HashGraph bytes;
+        HashGraph packed(HashGraph::PACKED_SEQUENCES);
+        assert(bytes.get_sequence_storage() == HashGraph::BYTE_SEQUENCES);
+        assert(packed.get_sequence_storage() == HashGraph::PACKED_SEQUENCES);
+        
+        // a sequence that is stored the same either way
+        auto random_sequence = [&]() {
+            string seq(length_distr(gen), 'N');
+            for (char& base : seq) {
+                base = "ACGTN"[base_distr(gen)];
+            }
+            return seq;
+        };
+        
+        size_t node_count = 2000;
+        for (size_t i = 0; i < node_count; ++i) {
+            string seq = random_sequence();
+            bytes.create_handle(seq);
+            packed.create_handle(seq);
+        }
+        for (size_t i = 1; i < node_count; ++i) {
+            // give some nodes long adjacency lists that won't fit inline
+            for (nid_t prev : {nid_t(i), nid_t(i / 2 + 1), nid_t(i % 7 + 1)}) {
+                for (HashGraph* graph : {&bytes, &packed}) {
+                    graph->create_edge(graph->get_handle(prev, i % 3 == 0), graph->get_handle(i + 1));
+                }
+            }
+        }
+        path_handle_t bytes_path = bytes.create_path_handle("p");
+        path_handle_t packed_path = packed.create_path_handle("p");
+        for (nid_t id = 1; id <= node_count; id += 2) {
+            bytes.append_step(bytes_path, bytes.get_handle(id));
+            packed.append_step(packed_path, packed.get_handle(id));
+        }
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&bytes, &packed, true));
+        
+        // edit the graphs in ways that release parts of the arena
+        uniform_int_distribution<nid_t> id_distr(1, node_count);
+        for (size_t i = 0; i < 1000; ++i) {
+            nid_t id = id_distr(gen);
+            if (!bytes.has_node(id)) {
+                continue;
+            }
+            handle_t h = bytes.get_handle(id, i % 2);
+            size_t length = bytes.get_length(h);
+            if (i % 4 == 0) {
+                bytes.destroy_handle(h);
+                packed.destroy_handle(h);
+            }
+            else if (i % 4 == 1 && length > 2) {
+                vector<size_t> offsets{1, length / 2};
+                auto bytes_parts = bytes.divide_handle(h, offsets);
+                auto packed_parts = packed.divide_handle(h, offsets);
+                assert(bytes_parts.size() == packed_parts.size());
+                for (size_t j = 0; j < bytes_parts.size(); ++j) {
+                    assert(bytes.get_sequence(bytes_parts[j]) == packed.get_sequence(packed_parts[j]));
+                }
+            }
+            else if (i % 4 == 2 && length > 1) {
+                bytes.truncate_handle(h, i % 8 < 4, length / 2);
+                packed.truncate_handle(h, i % 8 < 4, length / 2);
+            }
+            else {
+                bytes.apply_orientation(h);
+                packed.apply_orientation(h);
+            }
+        }
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&bytes, &packed, true));
+        
+        // spot check the base and subsequence accessors against the whole sequence
+        bytes.for_each_handle([&](const handle_t& h) {
+            for (bool rev : {false, true}) {
+                handle_t oriented = rev ? bytes.flip(h) : h;
+                string seq = packed.get_sequence(oriented);
+                assert(seq == bytes.get_sequence(oriented));
+                for (size_t j = 0; j < seq.size(); j += 7) {
+                    assert(packed.get_base(oriented, j) == seq[j]);
+                    assert(packed.get_subsequence(oriented, j, 5) == seq.substr(j, 5));
+                }
+            }
+        });
+        
+        // serialization doesn't depend on the storage
+        stringstream bytes_strm;
+        stringstream packed_strm;
+        bytes.serialize(bytes_strm);
+        packed.serialize(packed_strm);
+        HashGraph loaded(HashGraph::PACKED_SEQUENCES);
+        loaded.deserialize(bytes_strm);
+        assert(loaded.get_sequence_storage() == HashGraph::PACKED_SEQUENCES);
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&bytes, &loaded, true));
+        HashGraph loaded_bytes;
+        loaded_bytes.deserialize(packed_strm);
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&bytes, &loaded_bytes, true));
+        
+        // copies keep the storage, and optimizing keeps the sequences
+        HashGraph packed_copy(packed);
+        assert(packed_copy.get_sequence_storage() == HashGraph::PACKED_SEQUENCES);
+        packed.optimize();
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&packed_copy, &packed, true));
+        
+        // packing only loses information outside of ACGTN
+        HashGraph lossy(HashGraph::PACKED_SEQUENCES);
+        handle_t mixed = lossy.create_handle("acgtRYN");
+        assert(lossy.get_sequence(mixed) == "ACGTNNN");
+        assert(lossy.get_sequence(lossy.flip(mixed)) == "NNNACGT");
+        HashGraph exact;
+        assert(exact.get_sequence(exact.create_handle("acgtRYN")) == "acgtRYN");
+    }
+    
+    cerr << "HashGraph tests successful!" << endl;
+}
+
+void test_hash_graph_serialization() {
+    SyntheticGraphParams params;
+    params.seed = 13;
+    // enough nodes to be split into several node blocks
+    params.node_count = 150000;
+    params.haplotype_count = 4;
+    
+    HashGraph graph;
+    generate_synthetic_graph(&graph, params);
+    // Leave holes from deleted paths and nodes, and have some unusual paths
+    graph.destroy_path(graph.get_path_handle("haplotype2"));
+    // (only nodes that aren't on paths, so the paths survive)
+    for (nid_t id = 200; id < 400; id++) {
+        if (graph.has_node(id) && graph.for_each_step_on_handle(graph.get_handle(id), [](const step_handle_t&) {
+            return false;
+        })) {
+            graph.destroy_handle(graph.get_handle(id));
+        }
+    }
+    assert(graph.has_path("haplotype0") && graph.has_path("haplotype1"));
+    graph.create_path_handle("empty");
+    path_handle_t circle = graph.create_path_handle("circle", true);
+    graph.append_step(circle, graph.get_handle(5));
+    graph.append_step(circle, graph.flip(graph.get_handle(6)));
+    
+    auto check_graph = [&](HashGraph& loaded) {
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&graph, &loaded, true));
+        assert(loaded.get_is_circular(loaded.get_path_handle("circle")));
+        assert(!loaded.has_path("haplotype2"));
+        assert(loaded.min_node_id() == graph.min_node_id());
+        assert(loaded.max_node_id() == graph.max_node_id());
+        // The loaded graph should still be editable
+        path_handle_t added = loaded.create_path_handle("added");
+        loaded.append_step(added, loaded.get_handle(graph.min_node_id()));
+        assert(loaded.get_step_count(added) == 1);
+        handle_t h = loaded.create_handle("GATTACA");
+        loaded.create_edge(loaded.get_handle(graph.max_node_id()), h);
+        assert(loaded.get_sequence(h) == "GATTACA");
+        loaded.destroy_path(loaded.get_path_handle("haplotype0"));
+        assert(!loaded.has_path("haplotype0"));
+    };
+    
+    // Back up the thread count we have been using.
+    int backup_thread_count = omp_get_max_threads();
+    string reference;
+    for (int thread_count = 1; thread_count <= 4; thread_count *= 2) {
+        omp_set_num_threads(thread_count);
+        
+        stringstream strm;
+        graph.serialize(strm);
+        string serialized = strm.str();
+        // The layout shouldn't depend on the thread count
+        if (reference.empty()) {
+            reference = serialized;
+        }
+        assert(serialized == reference);
+        
+        {
+            // Load it from a stream
+            HashGraph loaded;
+            loaded.deserialize(strm);
+            check_graph(loaded);
+        }
+        {
+            // Load it into a graph that packs its sequences
+            stringstream packed_strm(serialized);
+            HashGraph loaded(HashGraph::PACKED_SEQUENCES);
+            loaded.deserialize(packed_strm);
+            check_graph(loaded);
+        }
+        
+        {
+            // Truncated data should be rejected
+            stringstream truncated(serialized.substr(0, serialized.size() / 2));
+            HashGraph loaded;
+            bool caught = false;
+            try {
+                loaded.deserialize(truncated);
+            } catch (std::runtime_error& e) {
+                caught = true;
+            }
+            assert(caught);
+        }
+        {
+            // So should a format version from the future
+            string future = serialized;
+            char version[sizeof(uint64_t)] = {0, 0, 0, 0, 0, 0, 3, (char) 232};
+            future.replace(sizeof(uint32_t) + sizeof(int64_t), sizeof(version), version, sizeof(version));
+            stringstream future_strm(future);
+            HashGraph loaded;
+            bool caught = false;
+            try {
+                loaded.deserialize(future_strm);
+            } catch (std::runtime_error& e) {
+                caught = true;
+            }
+            assert(caught);
+        }
+    }
+    // Go back to the default thread count.
+    omp_set_num_threads(backup_thread_count);
+    
+    {
+        // Empty graphs should round-trip too
+        HashGraph empty, loaded;
+        stringstream strm;
+        empty.serialize(strm);
+        loaded.deserialize(strm);
+        assert(loaded.get_node_count() == 0);
+        assert(loaded.get_path_count() == 0);
+        handle_t h = loaded.create_handle("A");
+        assert(loaded.get_sequence(h) == "A");
+    }
+    
+    {
+        // Graphs in the original layout should still load
+        stringstream strm;
+        auto write_int = [&](int64_t value, size_t width) {
+            for (size_t i = width; i > 0; --i) {
+                strm.put((char) ((value >> (8 * (i - 1))) & 0xff));
+            }
+        };
+        HashGraph reference_graph;
+        write_int(reference_graph.get_magic_number(), sizeof(uint32_t));
+        // max ID, min ID, next path ID, and node count
+        for (int64_t value : {3, 2, 2, 2}) {
+            write_int(value, sizeof(int64_t));
+        }
+        // node 2 is GAT, with an edge to the start of node 3
+        write_int(2, sizeof(int64_t));
+        write_int(3, sizeof(uint64_t));
+        strm << "GAT";
+        write_int(0, sizeof(uint64_t));
+        write_int(1, sizeof(uint64_t));
+        write_int(6, sizeof(int64_t));
+        // node 3 is TACA
+        write_int(3, sizeof(int64_t));
+        write_int(4, sizeof(uint64_t));
+        strm << "TACA";
+        write_int(1, sizeof(uint64_t));
+        write_int(5, sizeof(int64_t));
+        write_int(0, sizeof(uint64_t));
+        // one path, x, that visits both nodes
+        write_int(1, sizeof(uint64_t));
+        strm.put(0);
+        write_int(1, sizeof(int64_t));
+        write_int(1, sizeof(uint64_t));
+        strm << "x";
+        write_int(2, sizeof(uint64_t));
+        write_int(4, sizeof(int64_t));
+        write_int(6, sizeof(int64_t));
+        
+        HashGraph loaded;
+        loaded.deserialize(strm);
+        assert(loaded.get_node_count() == 2);
+        assert(loaded.get_sequence(loaded.get_handle(2)) == "GAT");
+        assert(loaded.get_sequence(loaded.get_handle(3)) == "TACA");
+        assert(loaded.has_edge(loaded.get_handle(2), loaded.get_handle(3)));
+        path_handle_t x = loaded.get_path_handle("x");
+        assert(loaded.get_step_count(x) == 2);
+        assert(loaded.get_handle_of_step(loaded.path_begin(x)) == loaded.get_handle(2));
+        assert(loaded.get_handle_of_step(loaded.path_back(x)) == loaded.get_handle(3));
+        loaded.for_each_handle([&](const handle_t& h) {
+            size_t step_count = 0;
+            loaded.for_each_step_on_handle(h, [&](const step_handle_t& step) {
+                assert(loaded.get_path_handle_of_step(step) == x);
+                ++step_count;
+            });
+            assert(step_count == 1);
+        });
+        
+        // and they get written back out in the sectioned layout
+        stringstream rewritten;
+        loaded.serialize(rewritten);
+        HashGraph reloaded;
+        reloaded.deserialize(rewritten);
+        assert(handlegraph::algorithms::are_equivalent_with_paths(&loaded, &reloaded, true));
+    }
+    
+    cerr << "HashGraph serialization tests successful!" << endl;
+}
+
+void test_synthetic_graph() {
+    
+    SyntheticGraphParams params;
+    params.seed = 27;
+    params.node_count = 2000;
+    params.bubble_density = 0.5;
+    params.nesting_depth = 3;
+    params.inversion_rate = 0.2;
+    params.haplotype_count = 5;
+    
+    PackedGraph packed;
+    HashGraph hashed;
+    MappedPackedGraph mapped;
+    generate_synthetic_graph(&packed, params);
+    generate_synthetic_graph(&hashed, params);
+    generate_synthetic_graph(&mapped, params);
+    
+    // The same seed makes the same graph in every backend
+    assert(packed.get_node_count() >= params.node_count);
+    assert(packed.get_path_count() == params.haplotype_count + 1);
+    assert(handlegraph::algorithms::are_equivalent_with_paths(&packed, &hashed, true));
+    assert(handlegraph::algorithms::are_equivalent_with_paths(&packed, &mapped, true));
+    
+    // Paths only take edges that exist, and we actually made some inversions
+    bool found_reversing_edge = false;
+    packed.for_each_path_handle([&](const path_handle_t& path) {
+        handle_t prev;
+        bool first = true;
+        packed.for_each_step_in_path(path, [&](const step_handle_t& step) {
+            handle_t here = packed.get_handle_of_step(step);
+            if (!first) {
+                assert(packed.has_edge(prev, here));
+                found_reversing_edge = found_reversing_edge || packed.get_is_reverse(prev) != packed.get_is_reverse(here);
+            }
+            prev = here;
+            first = false;
+        });
+    });
+    assert(found_reversing_edge);
+    
+    // The reference only goes forward
+    packed.for_each_step_in_path(packed.get_path_handle("ref"), [&](const step_handle_t& step) {
+        assert(!packed.get_is_reverse(packed.get_handle_of_step(step)));
+    });
+    
+    // A different seed makes a different graph
+    params.seed = 28;
+    PackedGraph other;
+    generate_synthetic_graph(&other, params);
+    assert(!handlegraph::algorithms::are_equivalent_with_paths(&packed, &other));
+    
+    // Without bubbles we get a linear graph
+    params.nesting_depth = 0;
+    params.haplotype_count = 1;
+    params.include_reference = false;
+    HashGraph linear;
+    generate_synthetic_graph(&linear, params);
+    assert(linear.get_node_count() == params.node_count);
+    assert(linear.get_edge_count() == params.node_count - 1);
+    assert(linear.get_step_count(linear.get_path_handle("haplotype0")) == params.node_count);
+    
+    cerr << "Synthetic graph tests successful!" << endl;
+}
+
+/// Add a chain of bubbles to a graph as a new connected component, and add it
+/// to a temporary distance index, with each bubble a snarl of nodes that are
+/// also chained to each other so the snarls have distances between children.
+void make_bubble_chain_distance_index(size_t bubble_count, size_t bubble_width, HashGraph& graph,
+                                      SnarlDistanceIndex::TemporaryDistanceIndex& temp_index) {
+    
+    typedef SnarlDistanceIndex::TemporaryDistanceIndex TemporaryDistanceIndex;
+    
+    // Make the graph, with the chain nodes before and after each bubble
+    vector<handle_t> chain_nodes;
+    vector<vector<handle_t>> bubble_nodes(bubble_count);
+    chain_nodes.push_back(graph.create_handle("GATTACA"));
+    for (size_t i = 0; i < bubble_count; i++) {
+        for (size_t j = 0; j < bubble_width; j++) {
+            bubble_nodes[i].push_back(graph.create_handle(string(1 + (i + j) % 5, 'A')));
+            graph.create_edge(chain_nodes.back(), bubble_nodes[i].back());
+            if (j != 0) {
+                graph.create_edge(bubble_nodes[i][j - 1], bubble_nodes[i][j]);
+            }
+        }
+        chain_nodes.push_back(graph.create_handle(string(1 + i % 3, 'C')));
+        for (handle_t& h : bubble_nodes[i]) {
+            graph.create_edge(h, chain_nodes.back());
+        }
+    }
+    
+    if (temp_index.components.empty()) {
+        temp_index.min_node_id = graph.get_id(chain_nodes.front());
+    }
+    temp_index.max_node_id = graph.get_id(chain_nodes.back());
+    temp_index.root_structure_count++;
+    temp_index.max_tree_depth = 2;
+    temp_index.temp_node_records.resize(temp_index.max_node_id - temp_index.min_node_id + 1);
+    auto node_record = [&](const handle_t& h) -> TemporaryDistanceIndex::TemporaryNodeRecord& {
+        TemporaryDistanceIndex::TemporaryNodeRecord& record = temp_index.temp_node_records[graph.get_id(h) - temp_index.min_node_id];
+        record.node_id = graph.get_id(h);
+        record.node_length = graph.get_length(h);
+        return record;
+    };
+    
+    // The top-level chain
+    size_t top_chain_i = temp_index.temp_chain_records.size();
+    temp_index.temp_chain_records.emplace_back();
+    temp_index.components.emplace_back(SnarlDistanceIndex::TEMP_CHAIN, top_chain_i);
+    size_t min_prefix = 0;
+    size_t max_prefix = 0;
+    for (size_t i = 0; i <= bubble_count; i++) {
+        TemporaryDistanceIndex::TemporaryChainRecord& chain = temp_index.temp_chain_records[top_chain_i];
+        TemporaryDistanceIndex::TemporaryNodeRecord& record = node_record(chain_nodes[i]);
+        record.parent = make_pair(SnarlDistanceIndex::TEMP_CHAIN, top_chain_i);
+        record.rank_in_parent = chain.children.size();
+        chain.children.emplace_back(SnarlDistanceIndex::TEMP_NODE, record.node_id);
+        chain.prefix_sum.push_back(min_prefix);
+        chain.max_prefix_sum.push_back(max_prefix);
+        chain.forward_loops.push_back(std::numeric_limits<size_t>::max());
+        chain.backward_loops.push_back(std::numeric_limits<size_t>::max());
+        chain.chain_components.push_back(0);
+        min_prefix += record.node_length;
+        max_prefix += record.node_length;
+        if (i == bubble_count) {
+            break;
+        }
+        
+        // The bubble after this chain node
+        size_t snarl_i = temp_index.temp_snarl_records.size();
+        chain.children.emplace_back(SnarlDistanceIndex::TEMP_SNARL, snarl_i);
+        temp_index.temp_snarl_records.emplace_back();
+        TemporaryDistanceIndex::TemporarySnarlRecord& snarl = temp_index.temp_snarl_records.back();
+        snarl.parent = make_pair(SnarlDistanceIndex::TEMP_CHAIN, top_chain_i);
+        snarl.start_node_id = graph.get_id(chain_nodes[i]);
+        snarl.start_node_length = graph.get_length(chain_nodes[i]);
+        snarl.end_node_id = graph.get_id(chain_nodes[i + 1]);
+        snarl.end_node_length = graph.get_length(chain_nodes[i + 1]);
+        snarl.node_count = bubble_width;
+        snarl.rank_in_parent = chain.children.size() - 1;
+        snarl.reversed_in_parent = false;
+        snarl.start_node_rev = false;
+        snarl.end_node_rev = false;
+        snarl.is_trivial = false;
+        snarl.is_simple = false;
+        for (size_t j = 0; j < bubble_width; j++) {
+            const handle_t& h = bubble_nodes[i][j];
+            snarl.min_length = std::min(snarl.min_length, graph.get_length(h));
+            snarl.max_length = std::max(snarl.max_length, graph.get_length(h));
+            
+            // Each bubble node is in a trivial chain
+            size_t chain_i = temp_index.temp_chain_records.size();
+            snarl.children.emplace_back(SnarlDistanceIndex::TEMP_CHAIN, chain_i);
+            temp_index.temp_chain_records.emplace_back();
+            TemporaryDistanceIndex::TemporaryChainRecord& trivial_chain = temp_index.temp_chain_records.back();
+            TemporaryDistanceIndex::TemporaryNodeRecord& record = node_record(h);
+            record.parent = make_pair(SnarlDistanceIndex::TEMP_CHAIN, chain_i);
+            record.rank_in_parent = j + 2;
+            trivial_chain.start_node_id = record.node_id;
+            trivial_chain.end_node_id = record.node_id;
+            trivial_chain.start_node_rev = false;
+            trivial_chain.end_node_rev = false;
+            trivial_chain.reversed_in_parent = false;
+            trivial_chain.is_trivial = true;
+            trivial_chain.parent = make_pair(SnarlDistanceIndex::TEMP_SNARL, snarl_i);
+            trivial_chain.rank_in_parent = j + 2;
+            trivial_chain.min_length = record.node_length;
+            trivial_chain.max_length = record.node_length;
+            trivial_chain.distance_left_start = 0;
+            trivial_chain.distance_right_end = 0;
+            trivial_chain.children.emplace_back(SnarlDistanceIndex::TEMP_NODE, record.node_id);
+            
+            // Bubble nodes reach the later ones through the nodes between them
+            size_t distance = 0;
+            for (size_t k = j + 1; k < bubble_width; k++) {
+                snarl.distances[make_pair(make_pair(j + 2, true), make_pair(k + 2, false))] = distance;
+                distance += graph.get_length(bubble_nodes[i][k]);
+            }
+            snarl.max_distance = std::max(snarl.max_distance, distance);
+        }
+        temp_index.max_distance = std::max(temp_index.max_distance, snarl.max_distance);
+        min_prefix += snarl.min_length;
+        max_prefix += snarl.max_length;
+    }
+    
+    TemporaryDistanceIndex::TemporaryChainRecord& chain = temp_index.temp_chain_records[top_chain_i];
+    chain.start_node_id = graph.get_id(chain_nodes.front());
+    chain.end_node_id = graph.get_id(chain_nodes.back());
+    chain.start_node_rev = false;
+    chain.end_node_rev = false;
+    chain.reversed_in_parent = false;
+    chain.is_trivial = false;
+    chain.parent = make_pair(SnarlDistanceIndex::TEMP_ROOT, 0);
+    chain.min_length = min_prefix;
+    chain.max_length = max_prefix;
+    temp_index.max_distance = std::max(temp_index.max_distance, max_prefix);
+    
+    temp_index.max_index_size = 0;
+    for (auto& chain_record : temp_index.temp_chain_records) {
+        temp_index.max_index_size += chain_record.get_max_record_length(true);
+    }
+    for (auto& snarl_record : temp_index.temp_snarl_records) {
+        temp_index.max_index_size += snarl_record.get_max_record_length();
+    }
+}
+
+/// Find the minimum distance from the end of one handle to the start of
+/// another, only walking through nodes in the given set in between, or inf if
+/// they aren't connected that way.
+size_t distance_through(const HandleGraph& graph, const unordered_set<handlegraph::nid_t>& allowed,
+                        const handle_t& from, const handle_t& to) {
+    typedef pair<size_t, handle_t> queue_item_t;
+    priority_queue<queue_item_t, vector<queue_item_t>, greater<queue_item_t>> queue;
+    unordered_set<handle_t> visited;
+    graph.follow_edges(from, false, [&](const handle_t& next) {
+        queue.emplace(0, next);
+    });
+    while (!queue.empty()) {
+        queue_item_t current = queue.top();
+        queue.pop();
+        if (current.second == to) {
+            return current.first;
+        }
+        if (!allowed.count(graph.get_id(current.second)) || visited.count(current.second)) {
+            continue;
+        }
+        visited.insert(current.second);
+        size_t next_distance = current.first + graph.get_length(current.second);
+        graph.follow_edges(current.second, false, [&](const handle_t& next) {
+            queue.emplace(next_distance, next);
+        });
+    }
+    return std::numeric_limits<size_t>::max();
+}
+
+/// A chain of a snarl decomposition, as its nodes read along the chain and,
+/// for the snarl after each node but the last, the indexes of the chains in
+/// it. A chain of one node is a trivial chain, which is a child of a snarl.
+struct DecompositionChain {
+    vector<handle_t> nodes;
+    vector<vector<size_t>> snarls;
+};
+
+/// Add a chain of a snarl decomposition, and everything in it, to a temporary
+/// distance index, filling in the distances by searching the graph. Returns the
+/// index of the chain's record and fills in the nodes in it.
+size_t add_decomposition_chain(const HandleGraph& graph, const vector<DecompositionChain>& chains, size_t chain_number,
+                               pair<SnarlDistanceIndex::temp_record_t, size_t> parent, size_t rank_in_parent, size_t depth,
+                               SnarlDistanceIndex::TemporaryDistanceIndex& temp_index,
+                               unordered_set<handlegraph::nid_t>& contents) {
+    
+    typedef SnarlDistanceIndex::TemporaryDistanceIndex TemporaryDistanceIndex;
+    const DecompositionChain& spec = chains[chain_number];
+    temp_index.max_tree_depth = std::max(temp_index.max_tree_depth, depth);
+    
+    size_t chain_i = temp_index.temp_chain_records.size();
+    temp_index.temp_chain_records.emplace_back();
+    {
+        TemporaryDistanceIndex::TemporaryChainRecord& chain = temp_index.temp_chain_records[chain_i];
+        chain.start_node_id = graph.get_id(spec.nodes.front());
+        chain.start_node_rev = graph.get_is_reverse(spec.nodes.front());
+        chain.end_node_id = graph.get_id(spec.nodes.back());
+        chain.end_node_rev = graph.get_is_reverse(spec.nodes.back());
+        chain.end_node_length = graph.get_length(spec.nodes.back());
+        chain.reversed_in_parent = false;
+        chain.is_trivial = spec.nodes.size() == 1;
+        chain.parent = parent;
+        chain.rank_in_parent = rank_in_parent;
+    }
+    auto add_node = [&](const handle_t& h, size_t rank) {
+        TemporaryDistanceIndex::TemporaryNodeRecord& record = temp_index.temp_node_records[graph.get_id(h) - temp_index.min_node_id];
+        record.node_id = graph.get_id(h);
+        record.node_length = graph.get_length(h);
+        record.parent = make_pair(SnarlDistanceIndex::TEMP_CHAIN, chain_i);
+        record.rank_in_parent = rank;
+        record.reversed_in_parent = graph.get_is_reverse(h);
+        temp_index.temp_chain_records[chain_i].children.emplace_back(SnarlDistanceIndex::TEMP_NODE, record.node_id);
+        contents.insert(record.node_id);
+    };
+    
+    if (spec.nodes.size() == 1) {
+        add_node(spec.nodes.front(), rank_in_parent);
+        TemporaryDistanceIndex::TemporaryChainRecord& chain = temp_index.temp_chain_records[chain_i];
+        chain.min_length = graph.get_length(spec.nodes.front());
+        chain.max_length = chain.min_length;
+        return chain_i;
+    }
+    
+    // Add the nodes and snarls, and remember what is in each snarl
+    vector<unordered_set<handlegraph::nid_t>> snarl_contents(spec.snarls.size());
+    vector<size_t> snarl_indexes;
+    for (size_t i = 0; i < spec.nodes.size(); i++) {
+        add_node(spec.nodes[i], temp_index.temp_chain_records[chain_i].children.size());
+        if (i + 1 == spec.nodes.size()) {
+            break;
+        }
+        
+        size_t snarl_i = temp_index.temp_snarl_records.size();
+        snarl_indexes.push_back(snarl_i);
+        temp_index.temp_snarl_records.emplace_back();
+        {
+            TemporaryDistanceIndex::TemporarySnarlRecord& snarl = temp_index.temp_snarl_records[snarl_i];
+            snarl.parent = make_pair(SnarlDistanceIndex::TEMP_CHAIN, chain_i);
+            snarl.start_node_id = graph.get_id(spec.nodes[i]);
+            snarl.start_node_rev = graph.get_is_reverse(spec.nodes[i]);
+            snarl.start_node_length = graph.get_length(spec.nodes[i]);
+            snarl.end_node_id = graph.get_id(spec.nodes[i + 1]);
+            snarl.end_node_rev = graph.get_is_reverse(spec.nodes[i + 1]);
+            snarl.end_node_length = graph.get_length(spec.nodes[i + 1]);
+            snarl.node_count = spec.snarls[i].size();
+            snarl.rank_in_parent = temp_index.temp_chain_records[chain_i].children.size();
+            snarl.reversed_in_parent = false;
+            snarl.is_trivial = false;
+            snarl.is_simple = false;
+        }
+        temp_index.temp_chain_records[chain_i].children.emplace_back(SnarlDistanceIndex::TEMP_SNARL, snarl_i);
+        for (size_t j = 0; j < spec.snarls[i].size(); j++) {
+            size_t child_i = add_decomposition_chain(graph, chains, spec.snarls[i][j], make_pair(SnarlDistanceIndex::TEMP_SNARL, snarl_i),
+                                                     j + 2, depth + 1, temp_index, snarl_contents[i]);
+            temp_index.temp_snarl_records[snarl_i].children.emplace_back(SnarlDistanceIndex::TEMP_CHAIN, child_i);
+        }
+        contents.insert(snarl_contents[i].begin(), snarl_contents[i].end());
+    }
+    
+    // Fill in the distances in each snarl
+    for (size_t i = 0; i < snarl_indexes.size(); i++) {
+        TemporaryDistanceIndex::TemporarySnarlRecord& snarl = temp_index.temp_snarl_records[snarl_indexes[i]];
+        const unordered_set<handlegraph::nid_t>& inside = snarl_contents[i];
+        handle_t start_in = spec.nodes[i];
+        handle_t end_out = spec.nodes[i + 1];
+        snarl.min_length = distance_through(graph, inside, start_in, end_out);
+        snarl.distance_start_start = distance_through(graph, inside, start_in, graph.flip(start_in));
+        snarl.distance_end_end = distance_through(graph, inside, graph.flip(end_out), end_out);
+        snarl.max_length = 0;
+        for (handlegraph::nid_t id : inside) {
+            snarl.max_length += graph.get_length(graph.get_handle(id));
+        }
+        // Leaving and entering each child by its left or right side
+        auto leave = [&](size_t j, bool right_side) {
+            const vector<handle_t>& child_nodes = chains[spec.snarls[i][j]].nodes;
+            return right_side ? child_nodes.back() : graph.flip(child_nodes.front());
+        };
+        for (size_t j = 0; j < spec.snarls[i].size(); j++) {
+            TemporaryDistanceIndex::TemporaryChainRecord& child = temp_index.temp_chain_records[snarl.children[j].second];
+            child.distance_left_start = distance_through(graph, inside, leave(j, false), graph.flip(start_in));
+            child.distance_right_start = distance_through(graph, inside, leave(j, true), graph.flip(start_in));
+            child.distance_left_end = distance_through(graph, inside, leave(j, false), end_out);
+            child.distance_right_end = distance_through(graph, inside, leave(j, true), end_out);
+            for (size_t k = j; k < spec.snarls[i].size(); k++) {
+                for (bool right_side1 : {false, true}) {
+                    for (bool right_side2 : {false, true}) {
+                        size_t distance = distance_through(graph, inside, leave(j, right_side1), graph.flip(leave(k, right_side2)));
+                        if (distance != std::numeric_limits<size_t>::max()) {
+                            snarl.distances[make_pair(make_pair(j + 2, right_side1), make_pair(k + 2, right_side2))] = distance;
+                            snarl.max_distance = std::max(snarl.max_distance, distance);
+                        }
+                    }
+                }
+            }
+        }
+        temp_index.max_distance = std::max(temp_index.max_distance, snarl.max_distance);
+    }
+    
+    // Fill in the distances along the chain, where loops stay on one side of the node
+    TemporaryDistanceIndex::TemporaryChainRecord& chain = temp_index.temp_chain_records[chain_i];
+    size_t min_prefix = 0;
+    size_t max_prefix = 0;
+    for (size_t i = 0; i < spec.nodes.size(); i++) {
+        unordered_set<handlegraph::nid_t> before;
+        unordered_set<handlegraph::nid_t> after;
+        for (size_t j = 0; j < spec.nodes.size(); j++) {
+            if (j != i) {
+                (j < i ? before : after).insert(graph.get_id(spec.nodes[j]));
+            }
+            if (j < snarl_contents.size()) {
+                (j < i ? before : after).insert(snarl_contents[j].begin(), snarl_contents[j].end());
+            }
+        }
+        chain.prefix_sum.push_back(min_prefix);
+        chain.max_prefix_sum.push_back(max_prefix);
+        chain.forward_loops.push_back(distance_through(graph, after, spec.nodes[i], graph.flip(spec.nodes[i])));
+        chain.backward_loops.push_back(distance_through(graph, before, graph.flip(spec.nodes[i]), spec.nodes[i]));
+        chain.chain_components.push_back(0);
+        min_prefix += graph.get_length(spec.nodes[i]);
+        max_prefix += graph.get_length(spec.nodes[i]);
+        if (i < snarl_indexes.size()) {
+            min_prefix += temp_index.temp_snarl_records[snarl_indexes[i]].min_length;
+            max_prefix += temp_index.temp_snarl_records[snarl_indexes[i]].max_length;
+        }
+    }
+    chain.min_length = min_prefix;
+    chain.max_length = max_prefix;
+    temp_index.max_distance = std::max(temp_index.max_distance, max_prefix);
+    return chain_i;
+}
+
+/// Make a graph whose snarl decomposition is nested three chains deep, and a
+/// temporary distance index for it. The top-level chain has a node that is
+/// reversed in it, and its first snarl has a self loop, a reversing edge, a
+/// child node that is only reached backward, and a child chain that can be
+/// walked either way and has a reversed node and a snarl that it can turn
+/// around in. Going through the child chain both ways makes a cycle.
+void make_nested_distance_index(HashGraph& graph, SnarlDistanceIndex::TemporaryDistanceIndex& temp_index) {
+    
+    handle_t a = graph.create_handle("GAT");
+    handle_t b = graph.create_handle("TA");
+    handle_t e = graph.create_handle("CA");
+    handle_t x = graph.create_handle("GG");
+    handle_t v = graph.create_handle("TTT");
+    handle_t c = graph.create_handle("A");
+    handle_t p = graph.create_handle("CC");
+    handle_t q = graph.create_handle("G");
+    handle_t d = graph.create_handle("AC");
+    handle_t y = graph.create_handle("T");
+    handle_t z = graph.create_handle("GCA");
+    
+    // The first top-level snarl, between a and b backward
+    graph.create_edge(a, x);
+    graph.create_edge(x, graph.flip(b));
+    graph.create_edge(x, x);
+    graph.create_edge(graph.flip(x), x);
+    graph.create_edge(a, graph.flip(v));
+    graph.create_edge(graph.flip(v), graph.flip(b));
+    graph.create_edge(v, graph.flip(v));
+    graph.create_edge(a, c);
+    graph.create_edge(graph.flip(d), graph.flip(b));
+    graph.create_edge(x, d);
+    graph.create_edge(graph.flip(c), v);
+    // The snarl in the child chain, between c and d backward
+    graph.create_edge(c, p);
+    graph.create_edge(p, graph.flip(d));
+    graph.create_edge(p, graph.flip(p));
+    graph.create_edge(c, graph.flip(q));
+    graph.create_edge(graph.flip(q), graph.flip(d));
+    // The second top-level snarl, between b backward and e
+    graph.create_edge(graph.flip(b), y);
+    graph.create_edge(y, e);
+    graph.create_edge(graph.flip(b), z);
+    graph.create_edge(z, e);
+    
+    vector<DecompositionChain> chains(8);
+    chains[0].nodes = {a, graph.flip(b), e};
+    chains[0].snarls = {{1, 2, 3}, {6, 7}};
+    chains[1].nodes = {x};
+    chains[2].nodes = {v};
+    chains[3].nodes = {c, graph.flip(d)};
+    chains[3].snarls = {{4, 5}};
+    chains[4].nodes = {p};
+    chains[5].nodes = {q};
+    chains[6].nodes = {y};
+    chains[7].nodes = {z};
+    
+    temp_index.min_node_id = graph.min_node_id();
+    temp_index.max_node_id = graph.max_node_id();
+    temp_index.temp_node_records.resize(temp_index.max_node_id - temp_index.min_node_id + 1);
+    temp_index.root_structure_count++;
+    unordered_set<handlegraph::nid_t> contents;
+    size_t top_chain_i = add_decomposition_chain(graph, chains, 0, make_pair(SnarlDistanceIndex::TEMP_ROOT, 0), 0, 1,
+                                                 temp_index, contents);
+    temp_index.components.emplace_back(SnarlDistanceIndex::TEMP_CHAIN, top_chain_i);
+    
+    temp_index.max_index_size = 0;
+    for (auto& chain_record : temp_index.temp_chain_records) {
+        temp_index.max_index_size += chain_record.get_max_record_length(true);
+    }
+    for (auto& snarl_record : temp_index.temp_snarl_records) {
+        temp_index.max_index_size += snarl_record.get_max_record_length();
+    }
+}
+
+void test_snarl_distance_index_construction() {
+    HashGraph graph;
+    SnarlDistanceIndex::TemporaryDistanceIndex temp_index;
+    make_bubble_chain_distance_index(300, 12, graph, temp_index);
+    vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> temp_indexes {&temp_index};
+    
+    auto serialize_index = [](const SnarlDistanceIndex& index) {
+        string serialized;
+        index.serialize([&](const void* start, size_t length) {
+            serialized.append((const char*) start, length);
+        });
+        return serialized;
+    };
+    
+    // Back up the thread count we have been using.
+    int backup_thread_count = omp_get_max_threads();
+    string reference;
+    for (int thread_count = 1; thread_count <= 4; thread_count *= 2) {
+        omp_set_num_threads(thread_count);
+        
+        SnarlDistanceIndex index;
+        index.get_snarl_tree_records(temp_indexes, &graph);
+        
+        // The index should be the same no matter how many threads built it
+        string serialized = serialize_index(index);
+        if (reference.empty()) {
+            reference = serialized;
+        }
+        assert(serialized == reference);
+        
+        // And the snarls should have their distances
+        for (size_t i = 0; i < 300; i += 37) {
+            handlegraph::nid_t first = temp_index.temp_snarl_records[i].start_node_id + 1;
+            for (handlegraph::nid_t other = first + 1; other < first + 12; other++) {
+                size_t between = 0;
+                for (handlegraph::nid_t id = first + 1; id < other; id++) {
+                    between += graph.get_length(graph.get_handle(id));
+                }
+                assert(index.minimum_distance(first, false, 0, other, false, 0) ==
+                       graph.get_length(graph.get_handle(first)) + between);
+            }
+        }
+    }
+    // Go back to the default thread count.
+    omp_set_num_threads(backup_thread_count);
+    
+    cerr << "SnarlDistanceIndex construction tests successful!" << endl;
+}
+
+void test_snarl_distance_index_oversized_snarls() {
+    HashGraph graph;
+    SnarlDistanceIndex::TemporaryDistanceIndex temp_index;
+    make_bubble_chain_distance_index(30, 12, graph, temp_index);
+    vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> temp_indexes {&temp_index};
+    
+    // Make one index with distance matrices for all the snarls, and two where
+    // the snarls are too big, with and without hub labels
+    SnarlDistanceIndex matrix_index;
+    matrix_index.get_snarl_tree_records(temp_indexes, &graph);
+    SnarlDistanceIndex oversized_index;
+    oversized_index.set_snarl_size_limit(5);
+    oversized_index.get_snarl_tree_records(temp_indexes, &graph);
+    SnarlDistanceIndex labeled_index;
+    labeled_index.set_snarl_size_limit(5);
+    labeled_index.set_oversized_snarl_hub_labels(true);
+    labeled_index.get_snarl_tree_records(temp_indexes, &graph);
+    
+    // The labeled index should get the same distances without the graph, and
+    // the other should get them by searching the graph, for pairs in the same
+    // snarl and in different ones
+    for (size_t i = 0; i < 30; i += 7) {
+        handlegraph::nid_t first = temp_index.temp_snarl_records[i].start_node_id + 1;
+        for (handlegraph::nid_t id1 = first; id1 < first + 12; id1++) {
+            for (handlegraph::nid_t id2 = first; id2 < first + 30 && id2 <= graph.max_node_id(); id2 += 3) {
+                for (bool rev : {false, true}) {
+                    size_t expected = matrix_index.minimum_distance(id1, rev, 0, id2, rev, 0);
+                    assert(labeled_index.minimum_distance(id1, rev, 0, id2, rev, 0) == expected);
+                    assert(oversized_index.minimum_distance(id1, rev, 0, id2, rev, 0, false, &graph) == expected);
+                }
+            }
+        }
+    }
+    
+    // The labels should survive serialization
+    char filename[] = "tmpXXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    assert(close(fd) == 0);
+    labeled_index.serialize(string(filename));
+    {
+        SnarlDistanceIndex loaded;
+        loaded.deserialize(string(filename));
+        handlegraph::nid_t first = temp_index.temp_snarl_records[3].start_node_id + 1;
+        for (handlegraph::nid_t id2 = first + 1; id2 < first + 12; id2++) {
+            assert(loaded.minimum_distance(first, false, 0, id2, false, 0) ==
+                   matrix_index.minimum_distance(first, false, 0, id2, false, 0));
+        }
+    }
+    unlink(filename);
+    
+    // Searching between the boundaries and the children should find the same distances, even when
+    // one side of the search runs out of handles before the two sides meet
+    for (size_t i = 0; i < 30; i += 7) {
+        handlegraph::nid_t first = temp_index.temp_snarl_records[i].start_node_id + 1;
+        net_handle_t matrix_snarl = matrix_index.get_parent(matrix_index.get_parent(matrix_index.get_node_net_handle(first)));
+        net_handle_t oversized_snarl = oversized_index.get_parent(oversized_index.get_parent(oversized_index.get_node_net_handle(first)));
+        for (size_t rank1 = 0; rank1 < 14; rank1++) {
+            for (size_t rank2 = 0; rank2 < 14; rank2++) {
+                for (bool right_side1 : {false, true}) {
+                    for (bool right_side2 : {false, true}) {
+                        assert(oversized_index.distance_in_snarl(oversized_snarl, rank1, right_side1, rank2, right_side2, &graph) ==
+                               matrix_index.distance_in_snarl(matrix_snarl, rank1, right_side1, rank2, right_side2));
+                    }
+                }
+            }
+        }
+    }
+    
+    // Walking from a child of one snarl to a child of the snarl after the next one searches across the
+    // whole snarl in between, from its start boundary to its end boundary. Both sides reach all of the
+    // children right away, so one side can run out of handles before the other side has reached any
+    {
+        handlegraph::nid_t first = temp_index.temp_snarl_records[3].start_node_id + 1;
+        handlegraph::nid_t crossed_start = temp_index.temp_snarl_records[4].start_node_id;
+        handlegraph::nid_t crossed_end = temp_index.temp_snarl_records[4].end_node_id;
+        for (const SnarlDistanceIndex* index : {&oversized_index, &labeled_index}) {
+            vector<pair<handlegraph::nid_t, size_t>> walked;
+            index->for_each_handle_in_shortest_path(first + 2, false, crossed_end + 5, false, &graph,
+                [&](const handlegraph::handle_t handle, size_t distance) {
+                walked.emplace_back(graph.get_id(handle), distance);
+                return true;
+            });
+            assert(walked.size() == 3);
+            assert(walked[0].first == crossed_start);
+            assert(walked[0].second == 0);
+            assert(walked[1].first > crossed_start && walked[1].first < crossed_end);
+            assert(walked[1].second == graph.get_length(graph.get_handle(crossed_start)));
+            assert(walked[2].first == crossed_end);
+            assert(walked[2].second == walked[1].second + graph.get_length(graph.get_handle(walked[1].first)));
+        }
+    }
+    
+    // The search should give up past the distance limit
+    net_handle_t snarl = oversized_index.get_parent(oversized_index.get_parent(oversized_index.get_node_net_handle(3)));
+    assert(oversized_index.is_snarl(snarl));
+    size_t rank1 = oversized_index.get_rank_in_parent(oversized_index.get_parent(oversized_index.get_node_net_handle(3)));
+    size_t rank2 = oversized_index.get_rank_in_parent(oversized_index.get_parent(oversized_index.get_node_net_handle(8)));
+    size_t distance = oversized_index.distance_in_snarl(snarl, rank1, true, rank2, false, &graph);
+    assert(distance != std::numeric_limits<size_t>::max());
+    assert(distance == labeled_index.distance_in_snarl(snarl, rank1, true, rank2, false));
+    assert(oversized_index.distance_in_snarl(snarl, rank1, true, rank2, false, &graph, distance) == distance);
+    assert(oversized_index.distance_in_snarl(snarl, rank1, true, rank2, false, &graph, distance - 1) == std::numeric_limits<size_t>::max());
+    
+    {
+        // In an oversized snarl with a self loop, reversing edges, a cycle, and a child chain, the search
+        // should find the same distances as the matrix, including from a child back to itself when the only
+        // walk is the self loop. The hub labels should find them too, without the graph
+        HashGraph nested_graph;
+        SnarlDistanceIndex::TemporaryDistanceIndex nested_temp_index;
+        make_nested_distance_index(nested_graph, nested_temp_index);
+        vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> nested_temp_indexes {&nested_temp_index};
+        SnarlDistanceIndex nested_matrix_index;
+        nested_matrix_index.get_snarl_tree_records(nested_temp_indexes, &nested_graph);
+        SnarlDistanceIndex nested_oversized_index;
+        nested_oversized_index.set_snarl_size_limit(3);
+        nested_oversized_index.get_snarl_tree_records(nested_temp_indexes, &nested_graph);
+        SnarlDistanceIndex nested_labeled_index;
+        nested_labeled_index.set_snarl_size_limit(3);
+        nested_labeled_index.set_oversized_snarl_hub_labels(true);
+        nested_labeled_index.get_snarl_tree_records(nested_temp_indexes, &nested_graph);
+        
+        // Node 4 is the child with the self loop
+        net_handle_t self_loop_chain = nested_oversized_index.get_parent(nested_oversized_index.get_node_net_handle(4));
+        net_handle_t oversized_snarl = nested_oversized_index.get_parent(self_loop_chain);
+        net_handle_t matrix_snarl = nested_matrix_index.get_parent(nested_matrix_index.get_parent(nested_matrix_index.get_node_net_handle(4)));
+        net_handle_t labeled_snarl = nested_labeled_index.get_parent(nested_labeled_index.get_parent(nested_labeled_index.get_node_net_handle(4)));
+        size_t self_loop_rank = nested_oversized_index.get_rank_in_parent(self_loop_chain);
+        assert(nested_oversized_index.distance_in_snarl(oversized_snarl, self_loop_rank, true, self_loop_rank, false, &nested_graph) == 0);
+        for (size_t rank1 = 0; rank1 < 5; rank1++) {
+            for (size_t rank2 = 0; rank2 < 5; rank2++) {
+                for (bool right_side1 : {false, true}) {
+                    for (bool right_side2 : {false, true}) {
+                        size_t distance = nested_oversized_index.distance_in_snarl(oversized_snarl, rank1, right_side1, rank2, right_side2, &nested_graph);
+                        assert(distance == nested_matrix_index.distance_in_snarl(matrix_snarl, rank1, right_side1, rank2, right_side2));
+                        assert(distance == nested_labeled_index.distance_in_snarl(labeled_snarl, rank1, right_side1, rank2, right_side2));
+                    }
+                }
+            }
+        }
+    }
+    
+    {
+        // If a hub label doesn't fit in the bit width of the index, then the
+        // index has to be widened without breaking the records already in it.
+        // Lengthen one bubble node in the graph but not in the temporary
+        // index, so that only the hub labels see the long node
+        HashGraph long_graph;
+        SnarlDistanceIndex::TemporaryDistanceIndex long_temp_index;
+        make_bubble_chain_distance_index(10, 8, long_graph, long_temp_index);
+        vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> long_temp_indexes {&long_temp_index};
+        handlegraph::nid_t first = long_temp_index.temp_snarl_records[4].start_node_id + 1;
+        handlegraph::nid_t long_id = first + 3;
+        vector<handle_t> prev_nodes;
+        vector<handle_t> next_nodes;
+        long_graph.follow_edges(long_graph.get_handle(long_id), true, [&](const handle_t& h) {
+            prev_nodes.push_back(h);
+        });
+        long_graph.follow_edges(long_graph.get_handle(long_id), false, [&](const handle_t& h) {
+            next_nodes.push_back(h);
+        });
+        long_graph.destroy_handle(long_graph.get_handle(long_id));
+        size_t long_length = size_t(1) << 26;
+        handle_t long_node = long_graph.create_handle(string(long_length, 'A'), long_id);
+        for (const handle_t& h : prev_nodes) {
+            long_graph.create_edge(h, long_node);
+        }
+        for (const handle_t& h : next_nodes) {
+            long_graph.create_edge(long_node, h);
+        }
+        
+        SnarlDistanceIndex short_index;
+        short_index.get_snarl_tree_records(long_temp_indexes, &long_graph);
+        SnarlDistanceIndex wide_index;
+        wide_index.set_snarl_size_limit(5);
+        wide_index.set_oversized_snarl_hub_labels(true);
+        wide_index.get_snarl_tree_records(long_temp_indexes, &long_graph);
+        
+        // The only walk between the nodes on either side of the long node goes through it
+        net_handle_t snarl = wide_index.get_parent(wide_index.get_parent(wide_index.get_node_net_handle(long_id)));
+        size_t rank1 = wide_index.get_rank_in_parent(wide_index.get_parent(wide_index.get_node_net_handle(long_id - 1)));
+        size_t rank2 = wide_index.get_rank_in_parent(wide_index.get_parent(wide_index.get_node_net_handle(long_id + 1)));
+        assert(wide_index.distance_in_snarl(snarl, rank1, true, rank2, false) == long_length);
+        
+        // Everything that doesn't use the long node should be the same as in the index without hub labels
+        for (handlegraph::nid_t id1 = long_graph.min_node_id(); id1 <= long_graph.max_node_id(); id1++) {
+            for (handlegraph::nid_t id2 = long_graph.min_node_id(); id2 <= long_graph.max_node_id(); id2 += 3) {
+                if (id1 == long_id || id2 == long_id) {
+                    continue;
+                }
+                for (bool rev : {false, true}) {
+                    size_t distance = wide_index.minimum_distance(id1, rev, 0, id2, rev, 0);
+                    if (distance < long_length) {
+                        assert(distance == short_index.minimum_distance(id1, rev, 0, id2, rev, 0));
+                    }
+                }
+            }
+        }
+    }
+    
+    cerr << "SnarlDistanceIndex oversized snarl tests successful!" << endl;
+}
+
+void test_snarl_distance_index_compact_distances() {
+    HashGraph graph;
+    SnarlDistanceIndex::TemporaryDistanceIndex temp_index;
+    make_bubble_chain_distance_index(20, 12, graph, temp_index);
+    
+    // Give a few distances in one snarl values too big for its bit width
+    auto& big_snarl = temp_index.temp_snarl_records[5];
+    size_t big_distance = 1 << 20;
+    big_snarl.distances[make_pair(make_pair(2, true), make_pair(13, false))] = big_distance;
+    big_snarl.distances[make_pair(make_pair(4, true), make_pair(7, false))] = big_distance + 1;
+    big_snarl.max_distance = big_distance + 1;
+    temp_index.max_distance = std::max(temp_index.max_distance, big_snarl.max_distance);
+    vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> temp_indexes {&temp_index};
+    
+    SnarlDistanceIndex full_index;
+    full_index.get_snarl_tree_records(temp_indexes, &graph);
+    SnarlDistanceIndex compact_index;
+    compact_index.set_compact_snarl_distances(true);
+    compact_index.get_snarl_tree_records(temp_indexes, &graph);
+    
+    // Every distance in every snarl should be the same
+    for (size_t i = 0; i < 20; i++) {
+        handlegraph::nid_t first = temp_index.temp_snarl_records[i].start_node_id + 1;
+        net_handle_t full_snarl = full_index.get_parent(full_index.get_parent(full_index.get_node_net_handle(first)));
+        net_handle_t compact_snarl = compact_index.get_parent(compact_index.get_parent(compact_index.get_node_net_handle(first)));
+        assert(compact_index.is_snarl(compact_snarl));
+        for (size_t rank1 = 2; rank1 < 14; rank1++) {
+            for (size_t rank2 = 2; rank2 < 14; rank2++) {
+                for (bool right_side1 : {false, true}) {
+                    for (bool right_side2 : {false, true}) {
+                        assert(compact_index.distance_in_snarl(compact_snarl, rank1, right_side1, rank2, right_side2) ==
+                               full_index.distance_in_snarl(full_snarl, rank1, right_side1, rank2, right_side2));
+                    }
+                }
+            }
+        }
+    }
+    net_handle_t big_snarl_handle = compact_index.get_parent(compact_index.get_parent(
+        compact_index.get_node_net_handle(big_snarl.start_node_id + 1)));
+    assert(compact_index.distance_in_snarl(big_snarl_handle, 2, true, 13, false) == big_distance);
+    assert(compact_index.distance_in_snarl(big_snarl_handle, 7, false, 4, true) == big_distance + 1);
+    
+    // And between nodes
+    for (handlegraph::nid_t id1 = graph.min_node_id(); id1 <= graph.max_node_id(); id1 += 5) {
+        for (handlegraph::nid_t id2 = graph.min_node_id(); id2 <= graph.max_node_id(); id2 += 3) {
+            assert(compact_index.minimum_distance(id1, false, 0, id2, false, 0) ==
+                   full_index.minimum_distance(id1, false, 0, id2, false, 0));
+        }
+    }
+    
+    // And it should take less space
+    MemoryReport full_report = full_index.memory_report();
+    MemoryReport compact_report = compact_index.memory_report();
+    assert(compact_report.bytes - compact_report.slack_bytes < full_report.bytes - full_report.slack_bytes);
+    
+    // And survive serialization
+    char filename[] = "tmpXXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    assert(close(fd) == 0);
+    compact_index.serialize(string(filename));
+    {
+        SnarlDistanceIndex loaded;
+        loaded.deserialize(string(filename));
+        for (size_t rank = 2; rank < 14; rank++) {
+            assert(loaded.distance_in_snarl(big_snarl_handle, 2, true, rank, false) ==
+                   compact_index.distance_in_snarl(big_snarl_handle, 2, true, rank, false));
+        }
+    }
+    unlink(filename);
+    
+    cerr << "SnarlDistanceIndex compact distance tests successful!" << endl;
+}
+
+void test_snarl_distance_index_shortest_paths() {
+    HashGraph graph;
+    SnarlDistanceIndex::TemporaryDistanceIndex temp_index;
+    make_bubble_chain_distance_index(4, 6, graph, temp_index);
+    vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> temp_indexes {&temp_index};
+    
+    // Walk paths with distance matrices, with hub labels, and by searching
+    // the graph in oversized snarls
+    SnarlDistanceIndex matrix_index;
+    matrix_index.get_snarl_tree_records(temp_indexes, &graph);
+    SnarlDistanceIndex labeled_index;
+    labeled_index.set_snarl_size_limit(3);
+    labeled_index.set_oversized_snarl_hub_labels(true);
+    labeled_index.get_snarl_tree_records(temp_indexes, &graph);
+    SnarlDistanceIndex oversized_index;
+    oversized_index.set_snarl_size_limit(3);
+    oversized_index.get_snarl_tree_records(temp_indexes, &graph);
+    
+    for (SnarlDistanceIndex* index : {&matrix_index, &labeled_index, &oversized_index}) {
+        for (handlegraph::nid_t id1 = graph.min_node_id(); id1 <= graph.max_node_id(); id1++) {
+            for (handlegraph::nid_t id2 = graph.min_node_id(); id2 <= graph.max_node_id(); id2++) {
+                if (id1 == id2) {
+                    continue;
+                }
+                for (bool rev : {false, true}) {
+                    size_t distance = index->minimum_distance(id1, rev, 0, id2, rev, 0, false, &graph);
+                    
+                    // The path should be a walk between the two nodes that
+                    // is as long as the minimum distance
+                    handle_t here = graph.get_handle(id1, rev);
+                    size_t walked = 0;
+                    index->for_each_handle_in_shortest_path(id1, rev, id2, rev, &graph, [&](const handle_t next, size_t distance_to_next) {
+                        assert(distance != std::numeric_limits<size_t>::max());
+                        assert(graph.has_edge(here, next));
+                        assert(distance_to_next == walked);
+                        walked += graph.get_length(next);
+                        here = next;
+                        return true;
+                    });
+                    if (distance != std::numeric_limits<size_t>::max()) {
+                        assert(graph.has_edge(here, graph.get_handle(id2, rev)));
+                        assert(graph.get_length(graph.get_handle(id1)) + walked == distance);
+                    }
+                }
+            }
+        }
+    }
+    
+    // On nested chains with reversed nodes, loops, and reversing edges, the walks should be shortest
+    // paths between every pair of orientations
+    HashGraph nested_graph;
+    SnarlDistanceIndex::TemporaryDistanceIndex nested_temp_index;
+    make_nested_distance_index(nested_graph, nested_temp_index);
+    vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> nested_temp_indexes {&nested_temp_index};
+    SnarlDistanceIndex nested_matrix_index;
+    nested_matrix_index.get_snarl_tree_records(nested_temp_indexes, &nested_graph);
+    SnarlDistanceIndex nested_labeled_index;
+    nested_labeled_index.set_snarl_size_limit(3);
+    nested_labeled_index.set_oversized_snarl_hub_labels(true);
+    nested_labeled_index.get_snarl_tree_records(nested_temp_indexes, &nested_graph);
+    SnarlDistanceIndex nested_oversized_index;
+    nested_oversized_index.set_snarl_size_limit(3);
+    nested_oversized_index.get_snarl_tree_records(nested_temp_indexes, &nested_graph);
+    unordered_set<handlegraph::nid_t> all_ids;
+    nested_graph.for_each_handle([&](const handle_t& h) {
+        all_ids.insert(nested_graph.get_id(h));
+    });
+    
+    for (SnarlDistanceIndex* index : {&nested_matrix_index, &nested_labeled_index, &nested_oversized_index}) {
+        for (handlegraph::nid_t id1 : all_ids) {
+            for (handlegraph::nid_t id2 : all_ids) {
+                for (bool rev1 : {false, true}) {
+                    for (bool rev2 : {false, true}) {
+                        if (id1 == id2 && rev1 == rev2) {
+                            continue;
+                        }
+                        handle_t start = nested_graph.get_handle(id1, rev1);
+                        handle_t end = nested_graph.get_handle(id2, rev2);
+                        size_t between = distance_through(nested_graph, all_ids, start, end);
+                        size_t distance = index->minimum_distance(id1, rev1, 0, id2, rev2, 0, false, &nested_graph);
+                        assert(distance == (between == std::numeric_limits<size_t>::max() ? between 
+                                                                                           : nested_graph.get_length(start) + between));
+                        
+                        handle_t here = start;
+                        size_t walked = 0;
+                        size_t calls = 0;
+                        index->for_each_handle_in_shortest_path(id1, rev1, id2, rev2, &nested_graph, [&](const handle_t next, size_t distance_to_next) {
+                            assert(nested_graph.has_edge(here, next));
+                            assert(distance_to_next == walked);
+                            walked += nested_graph.get_length(next);
+                            here = next;
+                            calls++;
+                            return true;
+                        });
+                        if (between == std::numeric_limits<size_t>::max()) {
+                            assert(calls == 0);
+                            continue;
+                        }
+                        assert(nested_graph.has_edge(here, end));
+                        assert(walked == between);
+                        
+                        // The walk should be as long as the one found by searching the whole graph
+                        size_t reference_walked = 0;
+                        handlegraph::algorithms::for_each_handle_in_shortest_path(&nested_graph, start, end, 
+                            [&](const handle_t& next, size_t distance_to_next) {
+                            reference_walked += nested_graph.get_length(next);
+                            return true;
+                        });
+                        assert(walked == reference_walked);
+                        
+                        // And the walk should stop when asked to
+                        size_t calls_until_stop = 0;
+                        index->for_each_handle_in_shortest_path(id1, rev1, id2, rev2, &nested_graph, [&](const handle_t next, size_t distance_to_next) {
+                            calls_until_stop++;
+                            return false;
+                        });
+                        assert(calls_until_stop == std::min(calls, (size_t) 1));
+                    }
+                }
+            }
+        }
+    }
+    
+    cerr << "SnarlDistanceIndex shortest path tests successful!" << endl;
+}
+
+void test_snarl_distance_index_batched_distances() {
+    // Make an index of two separate components
+    HashGraph graph;
+    SnarlDistanceIndex::TemporaryDistanceIndex temp_index;
+    make_bubble_chain_distance_index(20, 5, graph, temp_index);
+    make_bubble_chain_distance_index(10, 3, graph, temp_index);
+    vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> temp_indexes {&temp_index};
+    SnarlDistanceIndex index;
+    index.get_snarl_tree_records(temp_indexes, &graph);
+    
+    // Pick positions all over, including several on the same nodes
+    random_device rd;
+    default_random_engine generator(rd());
+    vector<tuple<handlegraph::nid_t, bool, size_t>> positions;
+    for (size_t i = 0; i < 80; i++) {
+        handlegraph::nid_t id = uniform_int_distribution<handlegraph::nid_t>(graph.min_node_id(), graph.max_node_id())(generator);
+        if (i % 10 == 9) {
+            // Reuse a node
+            id = std::get<0>(positions[i / 2]);
+        }
+        size_t length = graph.get_length(graph.get_handle(id));
+        positions.emplace_back(id, i % 3 == 0, uniform_int_distribution<size_t>(0, length - 1)(generator));
+    }
+    vector<tuple<handlegraph::nid_t, bool, size_t>> others(positions.begin() + 30, positions.end());
+    
+    for (bool unoriented : {false, true}) {
+        vector<vector<size_t>> matrix = index.minimum_distances(positions, others, unoriented, &graph);
+        assert(matrix.size() == positions.size());
+        bool saw_finite = false;
+        bool saw_infinite = false;
+        for (size_t i = 0; i < positions.size(); i++) {
+            vector<size_t> row = index.minimum_distances(positions[i], others, unoriented, &graph);
+            assert(row == matrix[i]);
+            for (size_t j = 0; j < others.size(); j++) {
+                size_t distance = index.minimum_distance(std::get<0>(positions[i]), std::get<1>(positions[i]), std::get<2>(positions[i]),
+                                                         std::get<0>(others[j]), std::get<1>(others[j]), std::get<2>(others[j]),
+                                                         unoriented, &graph);
+                assert(matrix[i][j] == distance);
+                if (distance == std::numeric_limits<size_t>::max()) {
+                    saw_infinite = true;
+                } else {
+                    saw_finite = true;
+                }
+            }
+        }
+        assert(saw_finite && saw_infinite);
+    }
+    
+    // Empty batches should work
+    vector<tuple<handlegraph::nid_t, bool, size_t>> no_positions;
+    assert(index.minimum_distances(positions.front(), no_positions).empty());
+    assert(index.minimum_distances(no_positions, others).empty());
+    
+    // And nonexistent nodes should be rejected
+    bool caught = false;
+    try {
+        index.minimum_distances(make_tuple(graph.max_node_id() + 10, false, (size_t) 0), others);
+    } catch (std::runtime_error& e) {
+        caught = true;
+    }
+    assert(caught);
+    
+    cerr << "SnarlDistanceIndex batched distance tests successful!" << endl;
+}
+
+void test_memory_report() {
+    random_device rd;
+    default_random_engine prng(rd());
+    uniform_int_distribution<uint64_t> val_distr(0, 1000);
+    
+    // Each node's bytes must cover those of its children
+    auto check_tree = [](const MemoryReport& report) {
+        report.for_each_node([&](const string& path, const MemoryReport& node) {
+            size_t child_bytes = 0, child_slack = 0;
+            for (const MemoryReport& child : node.children) {
+                child_bytes += child.bytes;
+                child_slack += child.slack_bytes;
+            }
+            assert(node.bytes >= child_bytes);
+            assert(node.slack_bytes >= child_slack);
+            assert(node.bytes >= node.slack_bytes);
+        });
+    };
+    
+    // The reports of the structs agree with their measured memory usage
+    {
+        PackedVector<> vec;
+        PagedVector<16> paged;
+        RobustPagedVector<16> robust;
+        TunablePagedVector<> tunable;
+        PackedDeque<> deque;
+        vector<uint64_t> sorted;
+        for (size_t i = 0; i < 500; ++i) {
+            uint64_t val = val_distr(prng);
+            vec.append(val);
+            paged.append(val);
+            robust.append(val);
+            tunable.append(val);
+            deque.append_front(val);
+            sorted.push_back(val);
+        }
+        sort(sorted.begin(), sorted.end());
+        EliasFanoVector<> elias_fano(sorted);
+        
+        MemoryReport vec_report = vec.memory_report("vec");
+        assert(vec_report.bytes == vec.memory_usage());
+        assert(vec_report.entries == vec.size());
+        assert(vec_report.bit_width != 0);
+        check_tree(vec_report);
+        
+        MemoryReport paged_report = paged.memory_report("paged");
+        assert(paged_report.bytes == paged.memory_usage());
+        assert(paged_report.entries == paged.size());
+        assert(paged_report.find("pages") != nullptr);
+        check_tree(paged_report);
+        
+        MemoryReport robust_report = robust.memory_report("robust");
+        assert(robust_report.bytes == robust.memory_usage());
+        check_tree(robust_report);
+        
+        MemoryReport tunable_report = tunable.memory_report("tunable");
+        assert(tunable_report.bytes == tunable.memory_usage());
+        check_tree(tunable_report);
+        
+        MemoryReport deque_report = deque.memory_report("deque");
+        assert(deque_report.bytes == deque.memory_usage());
+        assert(deque_report.entries == deque.size());
+        check_tree(deque_report);
+        
+        MemoryReport elias_fano_report = elias_fano.memory_report("elias_fano");
+        assert(elias_fano_report.bytes == elias_fano.memory_usage());
+        assert(elias_fano_report.find("high_bits") != nullptr);
+        check_tree(elias_fano_report);
+    }
+    
+    // Graphs report each member, and their deleted records
+    {
+        PackedGraph graph;
+        vector<handle_t> handles;
+        for (size_t i = 0; i < 20; ++i) {
+            handles.push_back(graph.create_handle("GATTACA"));
+            if (i != 0) {
+                graph.create_edge(handles[i - 1], handles[i]);
+            }
+        }
+        path_handle_t path = graph.create_path_handle("path");
+        path_handle_t other_path = graph.create_path_handle("other");
+        for (size_t i = 0; i < 20; ++i) {
+            graph.append_step(path, handles[i]);
+            if (i % 2 == 0) {
+                graph.append_step(other_path, handles[i]);
+            }
+        }
+        graph.destroy_path(other_path);
+        graph.destroy_handle(graph.create_handle("A"));
+        
+        MemoryReport report = graph.memory_report();
+        check_tree(report);
+        assert(report.entries == graph.get_node_count());
+        assert(report.find("graph_iv") != nullptr);
+        assert(report.find("seq_iv")->entries == 20 * 7 + 1);
+        assert(report.find("paths/steps")->entries == 20);
+        assert(report.find("paths/deleted_paths")->entries == 1);
+        assert(report.counters.at("deleted_node_records") == 1);
+        
+        // We can look at paths individually
+        MemoryReport path_report = graph.memory_report(true);
+        check_tree(path_report);
+        assert(path_report.bytes == report.bytes);
+        assert(path_report.find("paths/path/steps")->entries == 20);
+        assert(path_report.find("paths/other") == nullptr);
+        
+        size_t node_count = 0;
+        report.for_each_node([&](const string& name, const MemoryReport& node) {
+            if (node_count == 0) {
+                assert(name == report.name);
+            }
+            node_count++;
+        });
+        assert(node_count > report.children.size());
+        
+        // The position overlay reports each of its indexes
+        PackedPositionOverlay overlay(&graph);
+        MemoryReport overlay_report = overlay.memory_report();
+        check_tree(overlay_report);
+        assert(overlay_report.find("indexes/0/positions")->entries == 20);
+        assert(overlay_report.find("path_range")->entries == 1);
+        
+        PackedReferencePathOverlay reference_overlay(&graph);
+        MemoryReport reference_report = reference_overlay.memory_report();
+        check_tree(reference_report);
+        assert(reference_report.find("indexes/0/steps_0") != nullptr);
+        assert(reference_report.find("visit_indexes/0/visit_ranks") != nullptr);
+        
+        // Mapped structures report their memory chains
+        MappedPackedGraph mapped;
+        handle_t h = mapped.create_handle("GATTACA");
+        mapped.create_edge(h, mapped.create_handle("CAT"));
+        MemoryReport mapped_report = mapped.memory_report();
+        check_tree(mapped_report);
+        assert(mapped_report.counters.at("mapped_total_bytes") >= mapped_report.counters.at("mapped_free_bytes"));
+        
+        MappedPackedPositionOverlay mapped_overlay(&graph);
+        MemoryReport mapped_overlay_report = mapped_overlay.memory_report();
+        check_tree(mapped_overlay_report);
+        assert(mapped_overlay_report.find("indexes/0/step_slots") != nullptr);
+        assert(mapped_overlay_report.counters.count("mapped_total_bytes"));
+        
+        FrozenPackedGraph frozen(&graph);
+        MemoryReport frozen_report = frozen.memory_report();
+        check_tree(frozen_report);
+        assert(frozen_report.bytes == frozen.memory_usage());
+        assert(frozen_report.find("step_handles")->entries == 20);
+    }
+    
+    // The distance index counts its records
+    {
+        HashGraph graph;
+        SnarlDistanceIndex::TemporaryDistanceIndex temp_index;
+        make_bubble_chain_distance_index(10, 4, graph, temp_index);
+        vector<const SnarlDistanceIndex::TemporaryDistanceIndex*> temp_indexes {&temp_index};
+        SnarlDistanceIndex index;
+        index.get_snarl_tree_records(temp_indexes, &graph);
+        
+        MemoryReport report = index.memory_report();
+        check_tree(report);
+        const MemoryReport* records = report.find("snarl_tree_records");
+        assert(records != nullptr);
+        assert(records->entries != 0);
+        assert(records->bit_width != 0);
+        assert(report.counters.at("snarls") == 10);
+        assert(report.counters.at("chains") >= 1);
+        assert(report.counters.at("nodes") != 0);
+        assert(report.counters.count("mapped_total_bytes"));
+        
+        // An empty index reports no records
+        SnarlDistanceIndex empty;
+        assert(empty.memory_report().counters.at("snarls") == 0);
+    }
+    
+    cerr << "MemoryReport tests successful!" << endl;
 }
 
 void test_snarl_distance_index() {
@@ -4673,6 +7496,7 @@ int main(void) {
     test_bit_packing();
     test_mapped_structs();
     test_int_vector();
+    test_int_vector_ranges();
     test_packed_vector<PackedVector<>>();
     test_packed_vector<PackedVector<CompatBackend>>();
     test_packed_vector<PackedVector<MappedBackend>>();
@@ -4683,18 +7507,40 @@ int main(void) {
     test_paged_vector<PagedVector<5>>();
     test_paged_vector<PagedVector<5, CompatBackend>>();
     test_paged_vector<PagedVector<5, MappedBackend>>();
+    test_paged_vector_cursor<PagedVector<1>>();
+    test_paged_vector_cursor<PagedVector<5>>();
+    test_paged_vector_cursor<PagedVector<64>>();
+    test_paged_vector_cursor<PagedVector<5, MappedBackend>>();
+    test_paged_vector_cursor<RobustPagedVector<5>>();
+    test_paged_vector_cursor<RobustPagedVector<64>>();
+    test_tunable_paged_vector<STLBackend>();
+    test_tunable_paged_vector<MappedBackend>();
     test_packed_deque();
+    test_elias_fano_vector();
     test_packed_set();
     test_deletable_handle_graphs();
     test_mutable_path_handle_graphs();
     test_serializable_handle_graphs();
     test_packed_graph();
+    test_packed_graph_serialization();
+    test_packed_graph_incremental_defragmentation();
+    test_frozen_packed_graph();
     test_path_position_overlays();
     test_packed_reference_path_overlay();
+    test_mapped_reference_path_overlay();
     test_vectorizable_overlays();
     test_packed_subgraph_overlay();
     test_multithreaded_overlay_construction();
+    test_mapped_packed_position_overlay();
     test_mapped_packed_graph();
     test_hash_graph();
+    test_hash_graph_serialization();
+    test_synthetic_graph();
     test_snarl_distance_index();
+    test_snarl_distance_index_construction();
+    test_snarl_distance_index_oversized_snarls();
+    test_snarl_distance_index_compact_distances();
+    test_snarl_distance_index_shortest_paths();
+    test_snarl_distance_index_batched_distances();
+    test_memory_report();
 }
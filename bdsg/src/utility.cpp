@@ -2,6 +2,8 @@
 
 #include <omp.h> // BINDER_IGNORE because Binder can't find this
 
+#include <stdexcept>
+
 namespace bdsg {
 
 static const char complement[256] = {'N', 'N', 'N', 'N', 'N', 'N', 'N', 'N', // 8
@@ -137,6 +139,79 @@ string format_memory(size_t s) {
     }
 }
 
+MemoryReport::MemoryReport(const string& name, size_t bytes, size_t slack_bytes) :
+    name(name), bytes(bytes), slack_bytes(slack_bytes) {
+    // Nothing to do
+}
+
+MemoryReport& MemoryReport::add_child(const MemoryReport& child) {
+    bytes += child.bytes;
+    slack_bytes += child.slack_bytes;
+    children.push_back(child);
+    return children.back();
+}
+
+void MemoryReport::add_mapped_usage(const tuple<size_t, size_t, size_t>& total_free_reclaimable) {
+    counters["mapped_total_bytes"] = get<0>(total_free_reclaimable);
+    counters["mapped_free_bytes"] = get<1>(total_free_reclaimable);
+    counters["mapped_reclaimable_bytes"] = get<2>(total_free_reclaimable);
+}
+
+const MemoryReport* MemoryReport::find(const string& path) const {
+    const MemoryReport* here = this;
+    size_t begin = 0;
+    while (begin < path.size()) {
+        size_t end = path.find('/', begin);
+        if (end == string::npos) {
+            end = path.size();
+        }
+        string child_name = path.substr(begin, end - begin);
+        const MemoryReport* next = nullptr;
+        for (const MemoryReport& child : here->children) {
+            if (child.name == child_name) {
+                next = &child;
+                break;
+            }
+        }
+        if (next == nullptr) {
+            return nullptr;
+        }
+        here = next;
+        begin = end + 1;
+    }
+    return here;
+}
+
+void MemoryReport::for_each_node(const function<void(const string&, const MemoryReport&)>& iteratee) const {
+    function<void(const string&, const MemoryReport&)> visit = [&](const string& path, const MemoryReport& node) {
+        iteratee(path, node);
+        for (const MemoryReport& child : node.children) {
+            visit(path + "/" + child.name, child);
+        }
+    };
+    visit(name, *this);
+}
+
+void MemoryReport::print(ostream& out, size_t depth) const {
+    out << string(2 * depth, ' ') << name << ": " << format_memory(bytes);
+    if (slack_bytes != 0) {
+        out << " (" << format_memory(slack_bytes) << " unused)";
+    }
+    if (entries != 0) {
+        out << ", " << entries << " entries";
+    }
+    if (bit_width != 0) {
+        out << ", " << bit_width << " bits";
+    }
+    for (const auto& counter : counters) {
+        out << ", " << counter.first << " " << counter.second;
+    }
+    out << endl;
+    for (const MemoryReport& child : children) {
+        child.print(out, depth + 1);
+    }
+}
+
 int get_thread_count(void) {
     int thread_count = 1;
 #pragma omp parallel
@@ -147,4 +222,73 @@ int get_thread_count(void) {
     return thread_count;
 }
 
+MemoryStreamBuffer::MemoryStreamBuffer(const char* data, size_t size) {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+}
+
+const char* MemoryStreamBuffer::position() const {
+    return gptr();
+}
+
+size_t MemoryStreamBuffer::remaining() const {
+    return egptr() - gptr();
+}
+
+void MemoryStreamBuffer::advance(size_t bytes) {
+    if (bytes > remaining()) {
+        throw std::runtime_error("error:[MemoryStreamBuffer] cannot advance past the end of the buffer");
+    }
+    setg(eback(), gptr() + bytes, egptr());
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff(off_type off, ios_base::seekdir dir,
+                                                         ios_base::openmode which) {
+    off_type base;
+    if (dir == ios_base::beg) {
+        base = 0;
+    }
+    else if (dir == ios_base::cur) {
+        base = gptr() - eback();
+    }
+    else {
+        base = egptr() - eback();
+    }
+    return seekpos(pos_type(base + off), which);
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos(pos_type pos, ios_base::openmode which) {
+    off_type offset = off_type(pos);
+    if (!(which & ios_base::in) || offset < 0 || offset > egptr() - eback()) {
+        return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + offset, egptr());
+    return pos;
+}
+
+size_t CountingStreamBuffer::count() const {
+    return written;
+}
+
+CountingStreamBuffer::int_type CountingStreamBuffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        ++written;
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize CountingStreamBuffer::xsputn(const char* data, std::streamsize size) {
+    written += size;
+    return size;
+}
+
+CountingStreamBuffer::pos_type CountingStreamBuffer::seekoff(off_type off, ios_base::seekdir dir,
+                                                             ios_base::openmode which) {
+    // we can only report where we are
+    if (!(which & ios_base::out) || off != 0 || dir != ios_base::cur) {
+        return pos_type(off_type(-1));
+    }
+    return pos_type(off_type(written));
+}
+
 }